@@ -0,0 +1,124 @@
+// -----------------------------------------------------------------------------
+/**
+ * \file	archiver.c
+ * \author	Constantin MASSON
+ * \date	July 15, 2016
+ *
+ * \brief	Background job on rooms history (Compression and retention)
+ * \note	C Library for the Unix Programming Project
+ */
+// -----------------------------------------------------------------------------
+
+#include "archiver.h"
+
+
+//Job on the history of one room
+struct archiver_task{
+	char			name[ROOM_MAX_SIZE+1];
+	HistoryArchive	archive;
+};
+
+static pthread_mutex_t	archiver_mutex		= PTHREAD_MUTEX_INITIALIZER; //Held while a job runs
+static int				archiver_suspended	= 0; //1: no job starts (See archiver_suspend)
+
+
+// -----------------------------------------------------------------------------
+// Static functions
+// -----------------------------------------------------------------------------
+
+//Copy the segments of rooms with cold ones. Server must be locked.
+static struct archiver_task *archiver_prepare(ServerData *server, size_t *nb){
+	size_t					k;
+	RoomIndex				*index	= &(server->rooms_index);
+	struct archiver_task	*tasks	= (struct archiver_task*)calloc(index->size + 1, sizeof(struct archiver_task));
+	*nb = 0;
+	if(tasks == NULL){
+		return NULL;
+	}
+	for(k=0; k<index->size; k++){
+		Room *room = index->rooms[k];
+		if(room->node != NULL || history_archive_prepare(&(room->history), &(tasks[*nb].archive)) != 1){
+			continue; //History on its home node, or nothing cold
+		}
+		strcpy(tasks[*nb].name, room->name);
+		(*nb)++;
+	}
+	return tasks;
+}
+
+static int64_t archiver_now(void){
+	struct timespec now;
+	clock_gettime(CLOCK_REALTIME, &now);
+	return (int64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+}
+
+//Archive every HISTORY_ARCHIVE_SEC
+static void *archiver_handler(void *args){
+	ServerData *server = (ServerData*)args;
+	while(server->is_working == 1){
+		sleep(HISTORY_ARCHIVE_SEC);
+		pthread_mutex_lock(&archiver_mutex);
+		if(archiver_suspended == 0){
+			archiver_run(server);
+		}
+		pthread_mutex_unlock(&archiver_mutex);
+	}
+	return NULL;
+}
+
+
+// -----------------------------------------------------------------------------
+// Functions
+// -----------------------------------------------------------------------------
+
+int archiver_run(ServerData *server){
+	size_t	nb = 0, k;
+	int		removed = 0, err;
+	server_data_lock(server);
+	struct archiver_task *tasks = archiver_prepare(server, &nb);
+	server_data_unlock(server);
+	if(tasks == NULL){
+		return -1;
+	}
+	for(k=0; k<nb; k++){
+		err = history_archive_run(&(tasks[k].archive), archiver_now());
+		removed += (err > 0) ? err : 0;
+	}
+	//Room may have been removed (Or removed and added again) meanwhile
+	if(removed > 0){
+		server_data_lock(server);
+		for(k=0; k<nb; k++){
+			Room *room = server_data_get_room(server, tasks[k].name);
+			if(room != NULL && room->node == NULL){
+				history_archive_apply(&(room->history), &(tasks[k].archive));
+			}
+		}
+		server_data_unlock(server);
+	}
+	for(k=0; k<nb; k++){
+		history_archive_free(&(tasks[k].archive));
+	}
+	free(tasks);
+	return removed;
+}
+
+int archiver_start(ServerData *server){
+	pthread_t thread_id;
+	if(pthread_create(&thread_id, NULL, archiver_handler, (void*)server) != 0){
+		return -1;
+	}
+	pthread_detach(thread_id);
+	return 1;
+}
+
+void archiver_suspend(void){
+	pthread_mutex_lock(&archiver_mutex);
+	archiver_suspended = 1;
+	pthread_mutex_unlock(&archiver_mutex);
+}
+
+void archiver_resume(void){
+	pthread_mutex_lock(&archiver_mutex);
+	archiver_suspended = 0;
+	pthread_mutex_unlock(&archiver_mutex);
+}
@@ -0,0 +1,70 @@
+// -----------------------------------------------------------------------------
+/**
+ * \file	archiver.h
+ * \author	Constantin MASSON
+ * \date	July 15, 2016
+ *
+ * \brief	Background job on rooms history (Compression and retention)
+ * \note	C Library for the Unix Programming Project
+ *
+ * A background thread periodically copies the segments list of each room
+ * (Under server lock), then compresses cold segments and removes old ones
+ * without lock (See history_archive_run). Rooms are locked again only to
+ * forget the removed segments.
+ */
+// -----------------------------------------------------------------------------
+
+#ifndef UNIXPROJECT_ARCHIVER_H
+#define UNIXPROJECT_ARCHIVER_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "server_data.h"
+#include "room.h"
+#include "history.h"
+#include "constants.h"
+
+
+// -----------------------------------------------------------------------------
+// Functions
+// -----------------------------------------------------------------------------
+
+/**
+ * \brief			Archive the history of all rooms of this node.
+ * \details			Server is locked only while segments are copied and forgotten.
+ * \warning			Server must not be locked by caller.
+ *
+ * \param server	Server to archive
+ * \return			Number of segments removed, -1 if error
+ */
+int archiver_run(ServerData *server);
+
+/**
+ * \brief			Start a thread archiving the history every HISTORY_ARCHIVE_SEC.
+ *
+ * \param server	Server to archive
+ * \return			1 if thread started, otherwise, return -1
+ */
+int archiver_start(ServerData *server);
+
+/**
+ * \brief			Wait for the job in progress, then start no job until archiver_resume.
+ * \details			Segments are left as they are while the server is handed off (See upgrade).
+ * \warning			Server must not be locked by caller (The job locks it).
+ */
+void archiver_suspend(void);
+
+/**
+ * \brief			Start archiving again after archiver_suspend.
+ */
+void archiver_resume(void);
+
+
+#endif
+
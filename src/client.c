@@ -22,16 +22,79 @@ struct thread_info{
 // Static functions (Privates)
 // -----------------------------------------------------------------------------
 
+//Process the frames available in reader (Switch to blocks once compressed).
+//Return -1 if the blocks can't be decoded.
+static int client_process_frames(ClientData *client, FrameReader *reader, ZBlockReader *blocks){
+	char *frame;
+	while((frame = frame_reader_next(reader)) != NULL){
+		messaging_exec_client_receive(client, client->socket, frame);
+		//Bytes after the compression confirm are blocks
+		if(client->compressed == 1 && blocks->fd < 0){
+			size_t len, pending = reader->end - reader->start;
+			const char *dict = messaging_compression_dictionary(&len);
+			if(zblock_reader_init(blocks, client->socket, dict, len) != 1){
+				fprintf(stderr, "[ERR] Unable to decode compressed data from server\n");
+				return -1;
+			}
+			if(zblock_reader_push(blocks, reader->buffer + reader->start, pending) != 1){
+				return -1;
+			}
+			reader->start = reader->end;
+		}
+	}
+	return 1;
+}
+
+//Decode the received blocks, process their frames
+static int client_process_blocks(ClientData *client, FrameReader *reader, ZBlockReader *blocks){
+	char	*data;
+	size_t	len, done;
+	int		err;
+	while((err = zblock_reader_next(blocks, &data, &len)) == 1){
+		for(done=0; done<len; ){
+			done += frame_reader_push(reader, data + done, len - done);
+			if(client_process_frames(client, reader, blocks) != 1){
+				return -1;
+			}
+		}
+	}
+	return err;
+}
+
 // Listen a socket, simple read it (Meant to be used as thread function)
 void *client_listen_socket(void *args){
 	struct thread_info *tinfo = (struct thread_info*)args;
-	char buffer[MSG_MAX_SIZE];
+	ClientData *client = tinfo->client;
+	FrameReader reader;
+	ZBlockReader *blocks = (ZBlockReader*)malloc(sizeof(ZBlockReader)); //Used once compressed
+	if(blocks == NULL){
+		fprintf(stderr, "[ERR] Internal error: malloc failed (%s:%d)\n", __FILE__, __LINE__);
+		client->status = DISCONNECTED;
+		return NULL;
+	}
+	blocks->fd = -1;
+	frame_reader_init(&reader, client->socket);
 	while(1){
-		//TODO CRIT: Add exit process
-		memset(buffer, 0x00, sizeof(buffer));
-		recv(tinfo->client->socket, buffer, MSG_MAX_SIZE, 0);
-		messaging_exec_client_receive(tinfo->client, tinfo->client->socket, buffer);
+		int64_t nb = (blocks->fd < 0) ? frame_reader_fill(&reader) : zblock_reader_fill(blocks);
+		//Stop if connection closed (Or error)
+		if(nb <= 0){
+			fprintf(stderr, "\nConnection with server lost.\n");
+			client->status = DISCONNECTED;
+			break;
+		}
+		if((blocks->fd < 0 && client_process_frames(client, &reader, blocks) != 1)
+				|| (blocks->fd >= 0 && client_process_blocks(client, &reader, blocks) < 0)){
+			fprintf(stderr, "\nInvalid compressed data from server, disconnected.\n");
+			client->status = DISCONNECTED;
+			shutdown(client->socket, SHUT_RDWR); //Server sees the connection closed
+			break;
+		}
+	}
+	if(blocks->fd >= 0){
+		zblock_reader_destroy(blocks);
 	}
+	free(blocks);
+	return NULL;
 }
 
 // -----------------------------------------------------------------------------
@@ -43,8 +106,15 @@ int client_connect_to_server(ClientData *client, const char *address, const uint
 		return -1;
 	}
 	int socket;
-	fprintf(stdout, "Try to connect server (%s) at port %d...\n", address, port);
-	socket = create_client_tcp_socket(address, port);
+	//Server on the same host can be reached with its unix socket path
+	if(address[0] == '/'){
+		fprintf(stdout, "Try to connect server (%s)...\n", address);
+		socket = create_client_unix_socket(address, SOCK_STREAM);
+	}
+	else{
+		fprintf(stdout, "Try to connect server (%s) at port %d...\n", address, port);
+		socket = create_client_tcp_socket(address, port);
+	}
 	if(socket < 0){
 		fprintf(stderr, "Unable to connect to server.\n");
 		return -1;
@@ -56,7 +126,7 @@ int client_connect_to_server(ClientData *client, const char *address, const uint
 }
 
 void client_start_listening(ClientData *client){
-	struct thread_info tinfo;
+	static struct thread_info tinfo; //Must outlive this function (Used by thread)
 	memset(&tinfo, 0x00, sizeof(tinfo));
 	pthread_t		thread_id;
 	tinfo.client	= client;
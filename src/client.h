@@ -37,7 +37,7 @@
  * \warning			Client should be not null.
  *
  * \param client	Client to connect
- * \param address	Server to connect with (IP or name)
+ * \param address	Server to connect with (IP, name or unix socket path if starts with '/')
  * \param port		Port to use
  * \return			The socket or -1 if unable to connect
  */
@@ -15,4 +15,69 @@ void client_data_init(ClientData *client){
 	memset(client, 0x00, sizeof(ClientData));
 	client->is_working	= TRUE;
 	client->status		= DISCONNECTED;
+	pthread_mutex_init(&(client->requests_lock), NULL);
+}
+
+unsigned int client_data_add_request(ClientData *client, const char *cmd, const int batched){
+	pthread_mutex_lock(&(client->requests_lock));
+	unsigned int id = ++(client->last_request);
+	if(id == 0){
+		id = ++(client->last_request); //0 means no id
+	}
+	ClientRequest *request = &(client->requests[id % CLIENT_MAX_REQUESTS]);
+	if(request->id != 0){
+		client->latency.nb_lost++;
+	}
+	request->id			= id;
+	request->batched	= batched;
+	strncpy(request->cmd, cmd, CMD_MAX_SIZE);
+	request->cmd[CMD_MAX_SIZE] = '\0';
+	clock_gettime(CLOCK_MONOTONIC, &(request->sent));
+	pthread_mutex_unlock(&(client->requests_lock));
+	return id;
+}
+
+int64_t client_data_take_request(ClientData *client, const unsigned int id, ClientRequest *request){
+	int64_t			latency	= -1;
+	ClientLatency	*stats	= &(client->latency);
+	struct timespec	now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	pthread_mutex_lock(&(client->requests_lock));
+	ClientRequest *slot = &(client->requests[id % CLIENT_MAX_REQUESTS]);
+	if(id != 0 && slot->id == id){
+		*request	= *slot;
+		slot->id	= 0;
+		latency		= (int64_t)(now.tv_sec - request->sent.tv_sec) * 1000000
+					+ (now.tv_nsec - request->sent.tv_nsec) / 1000;
+		stats->min	= (stats->nb_replies == 0 || (uint64_t)latency < stats->min) ? (uint64_t)latency : stats->min;
+		stats->max	= ((uint64_t)latency > stats->max) ? (uint64_t)latency : stats->max;
+		stats->total += latency;
+		stats->nb_replies++;
+	}
+	pthread_mutex_unlock(&(client->requests_lock));
+	return latency;
+}
+
+void client_data_cancel_request(ClientData *client, const unsigned int id){
+	pthread_mutex_lock(&(client->requests_lock));
+	ClientRequest *slot = &(client->requests[id % CLIENT_MAX_REQUESTS]);
+	if(slot->id == id){
+		slot->id = 0;
+	}
+	pthread_mutex_unlock(&(client->requests_lock));
+}
+
+void client_data_display_latency(ClientData *client){
+	int k, nb_waiting = 0;
+	pthread_mutex_lock(&(client->requests_lock));
+	ClientLatency stats = client->latency;
+	for(k=0; k<CLIENT_MAX_REQUESTS; k++){
+		nb_waiting += (client->requests[k].id != 0) ? 1 : 0;
+	}
+	pthread_mutex_unlock(&(client->requests_lock));
+	fprintf(stdout, "Replies: %lu (Waiting: %d, Lost: %lu)\n", stats.nb_replies, nb_waiting, stats.nb_lost);
+	if(stats.nb_replies > 0){
+		fprintf(stdout, "Latency: min %.3f ms, avg %.3f ms, max %.3f ms\n",
+				stats.min / 1000.0, (stats.total / stats.nb_replies) / 1000.0, stats.max / 1000.0);
+	}
 }
@@ -21,6 +21,9 @@
 #include <stdlib.h>
 #include <signal.h>
 #include <string.h>
+#include <pthread.h>
+#include <time.h>
+#include <stdint.h>
 
 #include "wunixlib/assets.h"
 #include "constants.h"
@@ -36,6 +39,27 @@ typedef enum _clientstatus{
 	CONNECTING,		//Try to connect a server
 } ClientStatus;
 
+/**
+ * \brief	Request sent with an id, waiting for its reply
+ */
+typedef struct _client_request{
+	unsigned int	id; //0 if slot is free
+	char			cmd[CMD_MAX_SIZE+1];
+	int				batched; //1 if sent by a script (Reply shows the command)
+	struct timespec	sent; //Monotonic time when request was sent
+} ClientRequest;
+
+/**
+ * \brief	Time between requests and their first reply (Microseconds)
+ */
+typedef struct _client_latency{
+	unsigned long	nb_replies;
+	unsigned long	nb_lost; //Forgotten before reply (Too many requests waiting)
+	uint64_t		total;
+	uint64_t		min;
+	uint64_t		max;
+} ClientLatency;
+
 /**
  * \brief	Define the client status
  */
@@ -45,6 +69,13 @@ typedef struct _client{
 	char					login[USER_MAX_SIZE];
 	char					room[ROOM_MAX_SIZE];
 	int						socket;
+	int						compressed; //1 once server data is compressed (Listener thread only)
+	unsigned int			last_request; //Id of the last request sent
+	ClientRequest			requests[CLIENT_MAX_REQUESTS]; //Slot is id % max
+	pthread_mutex_t			requests_lock; //Requests are replied in listener thread
+	ClientLatency			latency;
+	char					last_room[ROOM_MAX_SIZE+1]; //Room of the last message received (Kept for !resume)
+	uint64_t				last_seq; //Number of this message
 } ClientData;
 
 
@@ -59,6 +90,44 @@ typedef struct _client{
  */
 void client_data_init(ClientData *client);
 
+/**
+ * \brief			Give an id to a request before sending it.
+ * \details			Command is kept until its reply is received. The oldest
+ * 					request is forgotten if too many are waiting.
+ *
+ * \param client	Client sending the request
+ * \param cmd		Command written by user
+ * \param batched	1 if sent by a script, otherwise, 0
+ * \return			Request id (Never 0)
+ */
+unsigned int client_data_add_request(ClientData *client, const char *cmd, const int batched);
+
+/**
+ * \brief			Recover the request of a reply (And forget it).
+ * \details			Latency of the request is added to client statistics.
+ *
+ * \param client	Client who sent the request
+ * \param id		Request id echoed in the reply
+ * \param request	Where to copy the request
+ * \return			Latency in microseconds or -1 if no request with this id
+ */
+int64_t client_data_take_request(ClientData *client, const unsigned int id, ClientRequest *request);
+
+/**
+ * \brief			Forget a request finally not sent.
+ *
+ * \param client	Client who added the request
+ * \param id		Request id
+ */
+void client_data_cancel_request(ClientData *client, const unsigned int id);
+
+/**
+ * \brief			Display latency statistics and requests waiting for their reply.
+ *
+ * \param client	Client to display
+ */
+void client_data_display_latency(ClientData *client);
+
 #endif
 
 
@@ -0,0 +1,430 @@
+// -----------------------------------------------------------------------------
+/**
+ * \file	cluster.c
+ * \author	Constantin MASSON
+ * \date	July 4, 2016
+ *
+ * \brief	Cluster of servers (Rooms and users shared by several nodes)
+ * \note	C Library for the Unix Programming Project
+ */
+// -----------------------------------------------------------------------------
+
+#include "cluster.h"
+
+
+//Used for thread arguments
+struct link_info{
+	ServerData	*server;
+	Node		*node;
+	int			socket;
+};
+
+
+// -----------------------------------------------------------------------------
+// Static functions (Directory)
+// -----------------------------------------------------------------------------
+
+//Send this node name then its local rooms and users (Rooms first: users refer them)
+static void cluster_send_directory(ServerData *server, Node *node){
+	LinkedlistNode *current;
+	messaging_send_node_hello(node->socket, server->node_name, server->node_address, server->node_secret);
+	for(current = server->list_rooms.first; current != NULL; current = current->next){
+		Room *room = (Room*)current->data;
+		if(room->node == NULL && room != server->room_welcome){
+			messaging_send_node_room(node->socket, room->name, room->owner_name);
+		}
+	}
+	for(current = server->list_users.first; current != NULL; current = current->next){
+		User *user = (User*)current->data;
+		if(user->node == NULL){
+			messaging_send_node_user(node->socket, user->login, (user->room == NULL) ? "" : user->room->name);
+		}
+	}
+}
+
+//User added or moved on the node
+static void cluster_exec_user(ServerData *server, Node *node, char *login, char *room_name){
+	User *user = server_data_get_user(server, login);
+	if(user == NULL){
+		user = user_create(login);
+		if(user == NULL){
+			return;
+		}
+		strcpy(user->login, login);
+		user->socket	= -1;
+		user->node		= node;
+		if(server_data_add_user(server, user) != 1){
+			user_destroy(user);
+			return;
+		}
+	}
+	else if(user->node != node){
+		fprintf(stderr, "[ERR] Node '%s' sends user '%s' already connected elsewhere\n", node->name, login);
+		return;
+	}
+	//Room may be unknown yet (Or welcome room)
+	Room *room = (room_name == NULL) ? NULL : server_data_get_room(server, room_name);
+	room = (room == NULL) ? server->room_welcome : room;
+	if(room != NULL && user->room != room){
+		server_data_move_user(server, user, room);
+	}
+}
+
+//User disconnected from the node
+static void cluster_exec_user_gone(ServerData *server, Node *node, char *login){
+	User *user = server_data_get_user(server, login);
+	if(user != NULL && user->node == node){
+		server_data_remove_user(server, user);
+		user_destroy(user);
+	}
+}
+
+//Room opened on the node
+static void cluster_exec_room(ServerData *server, Node *node, char *name, char *owner){
+	Room *room = server_data_get_room(server, name);
+	if(room != NULL){
+		if(room->node != node){
+			fprintf(stderr, "[ERR] Node '%s' sends room '%s' already hosted elsewhere\n", node->name, name);
+		}
+		return;
+	}
+	server_data_restore_room(server, name, owner, 1, node);
+}
+
+//Room closed on the node
+static void cluster_exec_room_gone(ServerData *server, Node *node, char *name){
+	Room *room = server_data_get_room(server, name);
+	if(room != NULL && room->node == node && room_is_empty(room) == 1){
+		server_data_delete_room(server, room);
+	}
+}
+
+//Compare the secret received with the one of the cluster (Time doesn't depend on where they differ)
+static int cluster_check_secret(const ServerData *server, const char *secret){
+	size_t			len		= strlen(server->node_secret), k;
+	unsigned char	diff	= 0;
+	if(len == 0 || strlen(secret) != len){
+		return -1;
+	}
+	for(k=0; k<len; k++){
+		diff |= (unsigned char)(server->node_secret[k] ^ secret[k]);
+	}
+	return (diff == 0) ? 1 : -1;
+}
+
+//Process one message from a node. Return -1 if link must be closed (Not a node of the cluster).
+static int cluster_exec_receive(ServerData *server, Node *node, char *msg){
+	char *fields[MSG_MAX_FIELDS];
+	messaging_split(msg, fields);
+	char *type = fields[0];
+	char *arg1 = fields[1];
+	char *arg2 = fields[2];
+	char *arg3 = fields[3];
+	//Nothing is accepted before a hello with the secret of the cluster
+	if(node->name[0] == '\0'){
+		if(type == NULL || arg1 == NULL || arg2 == NULL || arg3 == NULL
+				|| strcmp(type, MSG_TYPE_NODE_HELLO) != 0 || cluster_check_secret(server, arg3) != 1){
+			fprintf(stderr, "[ERR] Link refused: not a node of this cluster (Wrong secret)\n");
+			return -1;
+		}
+	}
+	if(type == NULL || arg1 == NULL){
+		return 1;
+	}
+	uint64_t	seq		= messaging_seq_parse(type);
+	int64_t		time	= messaging_time_parse(type);
+	if(strcmp(type, MSG_TYPE_NODE_HELLO) == 0 && arg2 != NULL && node->name[0] == '\0'){
+		snprintf(node->name, sizeof(node->name), "%s", arg1);
+		snprintf(node->address, sizeof(node->address), "%s", arg2);
+		hash_ring_add(&(server->ring), node->name, node); //New rooms may be placed on it
+		if(node->accepted == 1){
+			cluster_send_directory(server, node); //Secret only sent to a node knowing it
+		}
+		fprintf(stdout, "[NODE] Link open with node '%s' (Clients: %s)\n", node->name, node->address);
+	}
+	else if(strcmp(type, MSG_TYPE_NODE_USER) == 0){
+		cluster_exec_user(server, node, arg1, arg2);
+	}
+	else if(strcmp(type, MSG_TYPE_NODE_USER_GONE) == 0){
+		cluster_exec_user_gone(server, node, arg1);
+	}
+	else if(strcmp(type, MSG_TYPE_NODE_ROOM) == 0 && arg2 != NULL){
+		cluster_exec_room(server, node, arg1, arg2);
+	}
+	else if(strcmp(type, MSG_TYPE_NODE_ROOM_GONE) == 0){
+		cluster_exec_room_gone(server, node, arg1);
+	}
+	else if(strcmp(type, MSG_TYPE_NODE_BDCAST) == 0 && arg3 != NULL){
+		//Deliver to users of this server only (Node sent it to each node, saved and numbered it)
+		Room *room = server_data_get_room(server, arg1);
+		if(room != NULL){
+			room_deliver_message(room, arg2, arg3, time, seq);
+		}
+	}
+	else if(strcmp(type, MSG_TYPE_NODE_WHISPER) == 0 && arg3 != NULL){
+		User *user = server_data_get_user(server, arg2);
+		if(user != NULL && user->node == NULL){
+			messaging_send_whisper(user->socket, arg1, arg2, arg3);
+		}
+	}
+	return 1;
+}
+
+
+// -----------------------------------------------------------------------------
+// Static functions (Links)
+// -----------------------------------------------------------------------------
+
+//Link lost: remove users of the node and give its rooms to another node.
+//Each node left places a room on the same ring: only one adopts it (And
+//tells others with node_room). Server must be locked.
+static void cluster_remove_node(ServerData *server, Node *node){
+	LinkedlistNode *current = server->list_users.first;
+	while(current != NULL){
+		User *user	= (User*)current->data;
+		current		= current->next; //Node of the list is freed with the user
+		if(user->node == node){
+			server_data_remove_user(server, user);
+			user_destroy(user);
+		}
+	}
+	hash_ring_remove(&(server->ring), node);
+	for(current = server->list_rooms.first; current != NULL; current = current->next){
+		Room *room = (Room*)current->data;
+		if(room->node != node){
+			continue;
+		}
+		void *member = hash_ring_get(&(server->ring), room->name);
+		if(member == NULL || member == (void*)server){
+			fprintf(stdout, "[NODE] Room '%s' of node '%s' adopted\n", room->name, node->name);
+			server_data_adopt_room(server, room);
+		}
+		else{
+			room->node = (Node*)member; //Its adopter sends node_room too
+			server->rooms_version++;
+		}
+	}
+	list_remove_where(&(server->list_nodes), (void*)&(node->socket), node_match_socket);
+}
+
+//Process messages of one node (Same loop as client connections)
+static void *cluster_link_handler(void *args){
+	struct link_info *info = (struct link_info*)args;
+	ServerData	*server	= info->server;
+	Node		*node	= info->node;
+	char		*frame;
+	free(info);
+
+	server_data_lock(server);
+	while(server->is_working == 1){
+		if((frame = frame_reader_next(&(node->reader))) != NULL){
+			if(cluster_exec_receive(server, node, frame) != 1){
+				break;
+			}
+			server_data_unlock(server);
+			server_data_lock(server);
+			continue;
+		}
+		server_data_unlock(server);
+		int ready = wait_readable(node->socket, -1);
+		server_data_lock(server);
+		if(ready < 0 || frame_reader_fill(&(node->reader)) <= 0){
+			break;
+		}
+	}
+	fprintf(stdout, "[NODE] Link lost with node '%s'\n", node->name);
+	cluster_remove_node(server, node);
+	server_data_unlock(server);
+	outbox_close(node->socket);
+	TEMP_FAILURE_RETRY(close(node->socket));
+	node_destroy(node);
+	return NULL;
+}
+
+//Start the thread of a link (Iterator of list of nodes)
+static int cluster_start_link(void *node, void *server){
+	struct link_info *info = (struct link_info*)malloc(sizeof(struct link_info));
+	pthread_t thread_id;
+	if(info == NULL){
+		shutdown(((Node*)node)->socket, SHUT_RDWR);
+		return 1;
+	}
+	info->server	= (ServerData*)server;
+	info->node		= (Node*)node;
+	pthread_create(&thread_id, NULL, cluster_link_handler, (void*)info);
+	pthread_detach(thread_id);
+	return 1;
+}
+
+//Register the link and start its thread. Directory is sent now if this
+//server opened the link, otherwise, once the hello of the node is checked.
+static int cluster_open_link(ServerData *server, int socket, int accepted){
+	server_data_lock(server);
+	Node *node = node_create(socket);
+	if(node == NULL || list_append(&(server->list_nodes), node) != 1){
+		server_data_unlock(server);
+		node_destroy(node);
+		TEMP_FAILURE_RETRY(close(socket));
+		return -1;
+	}
+	node->accepted = accepted;
+	if(accepted == 0){
+		cluster_send_directory(server, node);
+	}
+	server_data_unlock(server);
+	return cluster_start_link(node, server);
+}
+
+//Accept links from other nodes
+static void *cluster_listen_handler(void *args){
+	struct link_info *info = (struct link_info*)args;
+	ServerData	*server	= info->server;
+	int			listen	= info->socket;
+	free(info);
+	while(server->is_working == 1){
+		int socket = accept_client(listen);
+		if(socket >= 0){
+			cluster_open_link(server, socket, 1);
+		}
+	}
+	return NULL;
+}
+
+
+// -----------------------------------------------------------------------------
+// Functions
+// -----------------------------------------------------------------------------
+
+int cluster_set_node(ServerData *server, const char *name, const char *address){
+	snprintf(server->node_name, sizeof(server->node_name), "%s", name);
+	snprintf(server->node_address, sizeof(server->node_address), "%s", address);
+	return hash_ring_add(&(server->ring), server->node_name, server);
+}
+
+int cluster_set_secret(ServerData *server, const char *path){
+	FILE *file = fopen(path, "r");
+	char *secret = server->node_secret;
+	if(file == NULL || fgets(secret, NODE_SECRET_SIZE + 1, file) == NULL){
+		fprintf(stderr, "[ERR] Unable to read the cluster secret from %s\n", path);
+		secret[0] = '\0';
+		if(file != NULL){
+			fclose(file);
+		}
+		return -1;
+	}
+	fclose(file);
+	secret[strcspn(secret, "\r\n")] = '\0';
+	//Secret is sent in node_hello: it can't contain the delimiter
+	if(secret[0] == '\0' || strstr(secret, MSG_DELIMITER) != NULL){
+		fprintf(stderr, "[ERR] Invalid cluster secret in %s\n", path);
+		secret[0] = '\0';
+		return -1;
+	}
+	return 1;
+}
+
+int cluster_start_listening(ServerData *server, const char *address){
+	struct link_info *info = (struct link_info*)malloc(sizeof(struct link_info));
+	pthread_t thread_id;
+	if(info == NULL){
+		return -1;
+	}
+	info->server = server;
+	//Socket may come from the previous process (Hot upgrade)
+	if(server->link_socket >= 0){
+		info->socket = server->link_socket;
+	}
+	else if(address[0] == '/'){
+		info->socket = create_server_unix_socket(address, SOCK_STREAM, CLUSTER_BACKLOG);
+		if(info->socket >= 0 && chmod(address, 0600) != 0){
+			TEMP_FAILURE_RETRY(close(info->socket));
+			info->socket = -1;
+		}
+	}
+	else{
+		//Address is host:port (Or port: this host only)
+		char host[256] = CLUSTER_DEFAULT_HOST;
+		const char *port = strrchr(address, ':');
+		if(port != NULL && (size_t)(port - address) < sizeof(host)){
+			memcpy(host, address, port - address);
+			host[port - address] = '\0';
+		}
+		info->socket = create_server_tcp_socket_on(host, atoi((port == NULL) ? address : port + 1), CLUSTER_BACKLOG);
+	}
+	if(info->socket < 0){
+		fprintf(stderr, "[ERR] Unable to listen for nodes on %s\n", address);
+		free(info);
+		return -1;
+	}
+	server->link_socket = info->socket;
+	pthread_create(&thread_id, NULL, cluster_listen_handler, (void*)info);
+	pthread_detach(thread_id);
+	return 1;
+}
+
+int cluster_join(ServerData *server, const char *address){
+	int socket;
+	if(address[0] == '/'){
+		socket = create_client_unix_socket(address, SOCK_STREAM);
+	}
+	else{
+		//Address is host:port
+		char host[256];
+		const char *port = strrchr(address, ':');
+		if(port == NULL || (size_t)(port - address) >= sizeof(host)){
+			fprintf(stderr, "[ERR] Invalid node address %s (host:port expected)\n", address);
+			return -1;
+		}
+		memcpy(host, address, port - address);
+		host[port - address] = '\0';
+		socket = create_client_tcp_socket(host, atoi(port + 1));
+	}
+	if(socket < 0){
+		fprintf(stderr, "[ERR] Unable to join the node %s\n", address);
+		return -1;
+	}
+	return cluster_open_link(server, socket, 0);
+}
+
+void cluster_forward_bdcast(ServerData *server, Room *room, User *user, const char *msg, const int64_t time){
+	LinkedlistNode *current;
+	unsigned long stamp = ++(server->bdcast_stamp);
+	for(current = room->list_users.first; current != NULL; current = current->next){
+		Node *node = ((User*)current->data)->node;
+		if(node != NULL && node->stamp != stamp){
+			node->stamp = stamp;
+			messaging_send_node_bdcast(node->socket, room->name, user->login, msg, time, room->seq);
+		}
+	}
+}
+
+Node* cluster_restore_link(ServerData *server, int socket, const char *name, const char *address){
+	Node *node = node_create(socket);
+	if(node == NULL || list_append(&(server->list_nodes), node) != 1){
+		node_destroy(node);
+		return NULL;
+	}
+	snprintf(node->name, sizeof(node->name), "%s", name);
+	snprintf(node->address, sizeof(node->address), "%s", address);
+	hash_ring_add(&(server->ring), node->name, node);
+	return node;
+}
+
+Node* cluster_get_node(const ServerData *server, const char *name){
+	LinkedlistNode *current;
+	for(current = server->list_nodes.first; current != NULL; current = current->next){
+		Node *node = (Node*)current->data;
+		if(strcmp(node->name, name) == 0){
+			return node;
+		}
+	}
+	return NULL;
+}
+
+void cluster_restore_user(ServerData *server, Node *node, char *login, char *room_name){
+	cluster_exec_user(server, node, login, room_name);
+}
+
+void cluster_start_links(ServerData *server){
+	list_iterate_args(&(server->list_nodes), cluster_start_link, (void*)server);
+}
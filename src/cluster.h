@@ -0,0 +1,173 @@
+// -----------------------------------------------------------------------------
+/**
+ * \file	cluster.h
+ * \author	Constantin MASSON
+ * \date	July 4, 2016
+ *
+ * \brief	Cluster of servers (Rooms and users shared by several nodes)
+ * \note	C Library for the Unix Programming Project
+ *
+ * Each server (Node) keeps a persistent link with each other node (Full
+ * mesh, TCP or unix socket). When the link is open, both nodes send their
+ * local rooms and users. Then each change (User connected, moved, gone,
+ * room opened, closed) is sent to all nodes (See server_data).
+ * Users and rooms of other nodes are in the server data with their node set:
+ * names are unique in the cluster and rooms list is the same everywhere.
+ *
+ * A room is hosted by the node where it was opened (Its home node, only one
+ * able to close it). Broadcast is sent once to each node having a user in
+ * the room. Whisper is sent to the node of the receiver.
+ * If a link is lost, users of this node are removed. Each of its rooms is
+ * adopted by the node owning its name on the ring (Without the lost node):
+ * all nodes left agree on it, the adopter opens the room history and tells
+ * the others (node_room).
+ *
+ * A link is accepted only once its node_hello carries the secret of the
+ * cluster (Same file on each node, see cluster_set_secret). Nodes listen on
+ * a given address (Loopback by default) or on a unix socket only readable by
+ * the user of the server. Secret is sent as is: links between hosts must be
+ * on a private network.
+ * On hot upgrade, links (And rooms and users of other nodes) are handed to
+ * the new process like client connections (See upgrade).
+ *
+ * New rooms are placed with a consistent hash ring of room names (Each node
+ * has NODE_VNODES points). A client opening or entering a room hosted by
+ * another node is redirected to it (MSG_ERR_REDIRECT with the node address).
+ * When a node joins, only about 1/N of names change owner, and existing
+ * rooms stay on their home node anyway.
+ */
+// -----------------------------------------------------------------------------
+
+#ifndef UNIXPROJECT_CLUSTER_H
+#define UNIXPROJECT_CLUSTER_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#include "wunixlib/network.h"
+#include "wunixlib/stream.h"
+#include "wunixlib/assets.h"
+#include "wunixlib/outbox.h"
+#include "server_data.h"
+#include "messaging.h"
+#include "node.h"
+#include "user.h"
+#include "room.h"
+
+/** \brief Max number of nodes in accept queue */
+#define CLUSTER_BACKLOG 10
+
+/** \brief Address where nodes connect if only a port is given */
+#define CLUSTER_DEFAULT_HOST "127.0.0.1"
+
+
+// -----------------------------------------------------------------------------
+// Functions
+// -----------------------------------------------------------------------------
+
+/**
+ * \brief			Set name and address of this node and place it on the ring.
+ * \details			Must be called once, before any link is open.
+ *
+ * \param server	Server of this node
+ * \param name		Name of this node (Same on each node of the cluster)
+ * \param address	Where clients connect this node (host:port)
+ * \return			1 if set, otherwise, return -1 (malloc)
+ */
+int cluster_set_node(ServerData *server, const char *name, const char *address);
+
+/**
+ * \brief			Load the secret shared by all nodes (First line of the file).
+ * \details			Must be called before any link is open: links are refused
+ * 					without a secret.
+ *
+ * \param server	Server of this node
+ * \param path		File of the secret
+ * \return			1 if loaded, otherwise, return -1 (No file, empty secret)
+ */
+int cluster_set_secret(ServerData *server, const char *path);
+
+/**
+ * \brief			Wait (In a new thread) for links from other nodes.
+ * \details			Socket recovered by hot upgrade (server->link_socket) is used
+ * 					if any. Unix socket is only open to the user of the server.
+ *
+ * \param server	Server of this node
+ * \param address	Where to listen: unix socket path (Starts with '/'),
+ * 					host:port or port (On CLUSTER_DEFAULT_HOST)
+ * \return			1 if listening, otherwise, return -1
+ */
+int cluster_start_listening(ServerData *server, const char *address);
+
+/**
+ * \brief			Open a link with another node.
+ *
+ * \param server	Server of this node
+ * \param address	Node address: unix socket path (Starts with '/') or host:port
+ * \return			1 if link open, otherwise, return -1
+ */
+int cluster_join(ServerData *server, const char *address);
+
+/**
+ * \brief			Send a broadcast to nodes having users in the room.
+ * \details			Each node receives it once, whatever its number of users.
+ * \warning			Server must be locked.
+ *
+ * \param server	Server of this node
+ * \param room		Room where message is sent
+ * \param user		Sender
+ * \param msg		Message
+ * \param time		Time given to the message (Its number is room->seq, see room_broadcast_message)
+ */
+void cluster_forward_bdcast(ServerData *server, Room *room, User *user, const char *msg, const int64_t time);
+
+/**
+ * \brief			Register a link recovered by hot upgrade (Hello already done).
+ * \details			Thread of the link is started by cluster_start_links.
+ * \warning			Server must be locked (Or not used yet).
+ *
+ * \param server	Server of this node
+ * \param socket	Link with the node
+ * \param name		Name of the node
+ * \param address	Where clients connect the node
+ * \return			The node or NULL if error (malloc)
+ */
+Node* cluster_restore_link(ServerData *server, int socket, const char *name, const char *address);
+
+/**
+ * \brief			Get a node linked with this server.
+ * \warning			Server must be locked.
+ *
+ * \param server	Server of this node
+ * \param name		Name of the node
+ * \return			The node or NULL if not linked
+ */
+Node* cluster_get_node(const ServerData *server, const char *name);
+
+/**
+ * \brief			Add a user of another node (Or move it).
+ * \warning			Server must be locked.
+ *
+ * \param server	Server of this node
+ * \param node		Node of the user
+ * \param login		Login of the user
+ * \param room_name	Room of the user (Welcome room if unknown)
+ */
+void cluster_restore_user(ServerData *server, Node *node, char *login, char *room_name);
+
+/**
+ * \brief			Start the threads of links recovered by hot upgrade.
+ *
+ * \param server	Server of this node
+ */
+void cluster_start_links(ServerData *server);
+
+
+#endif
+
+
+
@@ -24,13 +24,20 @@ static void commands_exec_open(ClientData *client, char *args);
 static void commands_exec_close(ClientData *client, char *args);
 static void commands_exec_enter(ClientData *client, char *args);
 static void commands_exec_leave(ClientData *client, char *args);
+static void commands_exec_history(ClientData *client, char *args);
+static void commands_exec_search(ClientData *client, char *args);
+static void commands_exec_resume(ClientData *client, char *args);
 static void commands_exec_whisper(ClientData *client, char *msg);
 static void commands_exec_broadcast(ClientData *client, char *msg);
+static void commands_exec_script(ClientData *client, char *args);
+static void commands_exec_stats(ClientData *client, char *args);
 
 //Assets functions
 static int commands_is_cmd(const char *str);
 static int commands_is_whisper(const char *str);
 static void commands_process(ClientData *client, char *cmd);
+static void commands_process_request(ClientData *client, char *str, const int batched);
+static int commands_script_pace(ClientData *client, TokenBucket *limits, const char *line);
 
 
 //------------------------------------------------------------------------------
@@ -56,7 +63,7 @@ void commands_prompt_start(ClientData *client, volatile sig_atomic_t *condition)
 				break;
 		}
 		readline_stdin(str, CMD_MAX_SIZE);
-		commands_prompt_process_line(client, str);
+		commands_process_request(client, str, FALSE);
 	}
 }
 
@@ -79,12 +86,16 @@ void commands_help(void){
 	fprintf(stdout, 
 			"\nCommands:\n"
 			"!connect <username>@<server> [:port]\n"
+			"!connect <username>@</unix/socket/path>\n"
 			"!bye\n"
-			"!rooms\n"
+			"!rooms [<prefix>|* [<after_room>]]\n"
 			"!open <room_name>\n"
 			"!close <room_name>\n"
 			"!enter <room_name>\n"
 			"!leave\n"
+			"!history <seconds>\n"
+			"!search <room_name> <terms>\n"
+			"!resume [<room_name> <last_message>]\n"
 			"*username* message\n"
 	);
 }
@@ -168,7 +179,8 @@ static void commands_exec_connect(ClientData *client, char *str){
 	if(socket == -1){ return; }
 	fprintf(stdout, "Send name to server...\n");
 	strcpy(client->login,username);
-	messaging_send_connect(socket, username);
+	client->compressed = 0;
+	messaging_send_connect(socket, username, MSG_COMPRESS_DEFLATE);
 	//Warning, I had a bug if starting listening before the send_connect process.
 	client_start_listening(client);
 }
@@ -183,8 +195,19 @@ static void commands_exec_bye(ClientData* client, char* args){
 }
 
 static void commands_exec_rooms(ClientData* client, char* args){
-	//TODO To implements
-	fprintf(stdout, "Command not working yet...\n");
+	//User must be connected
+	if(client->status != CONNECTED){
+		fprintf(stderr, "You must be connected to a server...\n");
+		return;
+	}
+	//Without prefix, the whole list is requested. Next page starts after the last room shown.
+	char prefix[CMD_MAX_SIZE] = "", after[CMD_MAX_SIZE] = "";
+	if(args == NULL || sscanf(args, "%s %s", prefix, after) < 1){
+		fprintf(stdout, "Rooms:\n");
+		messaging_send_rooms(client->socket);
+		return;
+	}
+	messaging_send_rooms_page(client->socket, prefix, after);
 }
 
 static void commands_exec_open(ClientData *client, char *args){
@@ -293,6 +316,119 @@ static void commands_exec_broadcast(ClientData *client, char *msg){
 	messaging_send_room_bdcast(client->socket, client->login, client->room, msg);
 }
 
+static void commands_exec_script(ClientData *client, char *args){
+	//User must be connected
+	if(client->status != CONNECTED){
+		fprintf(stderr, "You must be connected to a server...\n");
+		return;
+	}
+	args = (args == NULL) ? NULL : str_trim(args);
+	if(args == NULL || *args == '\0'){
+		fprintf(stderr, "Invalid command. Usage: !script <file>\n");
+		return;
+	}
+	FILE *file = fopen(args, "r");
+	if(file == NULL){
+		fprintf(stderr, "Unable to open %s\n", args);
+		return;
+	}
+
+	//Requests are sent together without waiting for replies. Each one has
+	//an id, replies are matched with their request by the listener thread.
+	//Sent at the rate of the server (Same buckets): none is throttled.
+	char line[CMD_MAX_SIZE+2], cmd[CMD_MAX_SIZE+2];
+	int nb = 0;
+	TokenBucket limits[3];
+	token_bucket_init(&(limits[0]), RATE_BDCAST_PER_SEC, RATE_BDCAST_BURST);
+	token_bucket_init(&(limits[1]), RATE_WHISPER_PER_SEC, RATE_WHISPER_BURST);
+	token_bucket_init(&(limits[2]), RATE_OTHER_PER_SEC, RATE_OTHER_BURST);
+	messaging_batch_begin(client->socket);
+	while(fgets(line, sizeof(line), file) != NULL){
+		line[strcspn(line, "\n")] = '\0';
+		//Skip empty lines and script commands (No nested script, no connection change)
+		if(line[0] == '\0' || strncmp(line, "!script", 7) == 0
+				|| strncmp(line, "!connect", 8) == 0 || strncmp(line, "!bye", 4) == 0){
+			continue;
+		}
+		if(commands_script_pace(client, limits, line) != 1){
+			fclose(file);
+			fprintf(stderr, "Unable to send the script...\n");
+			return;
+		}
+		strcpy(cmd, line); //Line is altered by the command
+		commands_process_request(client, cmd, TRUE);
+		nb++;
+	}
+	fclose(file);
+	if(messaging_batch_end() < 0){
+		fprintf(stderr, "Unable to send the script...\n");
+		return;
+	}
+	fprintf(stdout, "%d commands sent.\n", nb);
+}
+
+static void commands_exec_history(ClientData *client, char *args){
+	//User must be connected
+	if(client->status != CONNECTED){
+		fprintf(stderr, "You must be connected to a server...\n");
+		return;
+	}
+	long seconds;
+	if(args == NULL || sscanf(args, "%ld", &seconds) != 1 || seconds < 0){
+		fprintf(stderr, "Invalid command. Usage: !history <seconds>\n");
+		return;
+	}
+	//Server searches by time of messages (ms since epoch)
+	struct timespec now;
+	char since[32];
+	clock_gettime(CLOCK_REALTIME, &now);
+	sprintf(since, "%lld", (long long)now.tv_sec * 1000 + now.tv_nsec / 1000000 - (long long)seconds * 1000);
+	messaging_send_history(client->socket, since);
+}
+
+static void commands_exec_search(ClientData *client, char *args){
+	//User must be connected
+	if(client->status != CONNECTED){
+		fprintf(stderr, "You must be connected to a server...\n");
+		return;
+	}
+	//Room name, then terms (Rest of the line)
+	char room[CMD_MAX_SIZE];
+	int len = 0;
+	if(args == NULL || sscanf(args, "%s %n", room, &len) < 1 || len == 0 || args[len] == '\0'){
+		fprintf(stderr, "Invalid command. Usage: !search <room_name> <terms>\n");
+		return;
+	}
+	messaging_send_search(client->socket, room, args + len);
+}
+
+static void commands_exec_resume(ClientData *client, char *args){
+	//User must be connected
+	if(client->status != CONNECTED){
+		fprintf(stderr, "You must be connected to a server...\n");
+		return;
+	}
+	//Last message received by default (Kept across reconnects)
+	char room[CMD_MAX_SIZE];
+	unsigned long long seq = client->last_seq;
+	strcpy(room, client->last_room);
+	if(args != NULL && *str_trim(args) != '\0' && sscanf(args, "%s %llu", room, &seq) != 2){
+		fprintf(stderr, "Invalid command. Usage: !resume [<room_name> <last_message>]\n");
+		return;
+	}
+	if(room[0] == '\0'){
+		fprintf(stderr, "No message received yet. Usage: !resume <room_name> <last_message>\n");
+		return;
+	}
+	char str_seq[24];
+	sprintf(str_seq, "%llu", seq);
+	messaging_send_resume(client->socket, room, str_seq);
+}
+
+static void commands_exec_stats(ClientData *client, char *args){
+	client_data_display_latency(client);
+}
+
 
 //------------------------------------------------------------------------------
 // Asset functions
@@ -308,6 +444,47 @@ static int commands_is_whisper(const char *str){
 	return str[0] == '*' ? TRUE : FALSE;
 }
 
+//Wait for a token of the server bucket of this line (Frames batched meanwhile are sent).
+//Return -1 if batch can't be sent.
+static int commands_script_pace(ClientData *client, TokenBucket *limits, const char *line){
+	TokenBucket	*bucket	= &(limits[2]);
+	int			waited	= FALSE;
+	if(commands_is_whisper(line) == TRUE){
+		bucket = &(limits[1]);
+	}
+	else if(commands_is_cmd(line) == FALSE){
+		bucket = &(limits[0]);
+	}
+	while(token_bucket_take(bucket, 1) == 0){
+		if(waited == FALSE && messaging_batch_end() < 0){
+			return -1;
+		}
+		waited = TRUE;
+		usleep(1000000 / bucket->rate);
+	}
+	if(waited == TRUE){
+		messaging_batch_begin(client->socket);
+	}
+	return 1;
+}
+
+static void commands_process_request(ClientData *client, char *str, const int batched){
+	//Commands without request to the server (Or not connected yet)
+	if(client->status != CONNECTED || str[0] == '\0' || strncmp(str, "!connect", 8) == 0
+			|| strncmp(str, "!script", 7) == 0 || strncmp(str, "!stats", 6) == 0){
+		commands_prompt_process_line(client, str);
+		return;
+	}
+	//Request sent with an id: its reply gives the latency (See messaging_client)
+	unsigned int id = client_data_add_request(client, str, batched);
+	messaging_request_begin(client->socket, id);
+	commands_prompt_process_line(client, str);
+	if(messaging_request_tagged() == 0){
+		client_data_cancel_request(client, id); //Refused before sending
+	}
+	messaging_request_end();
+}
+
 static void commands_process(ClientData *client, char *cmd){
 	//Check whether command size is correct
 	if(strlen(cmd) > CMD_MAX_SIZE){
@@ -343,6 +520,21 @@ static void commands_process(ClientData *client, char *cmd){
 	else if(strcmp(cmd_name, "leave") == 0){
 		commands_exec_leave(client, args);
 	}
+	else if(strcmp(cmd_name, "history") == 0){
+		commands_exec_history(client, args);
+	}
+	else if(strcmp(cmd_name, "search") == 0){
+		commands_exec_search(client, args);
+	}
+	else if(strcmp(cmd_name, "resume") == 0){
+		commands_exec_resume(client, args);
+	}
+	else if(strcmp(cmd_name, "script") == 0){
+		commands_exec_script(client, args);
+	}
+	else if(strcmp(cmd_name, "stats") == 0){
+		commands_exec_stats(client, args);
+	}
 	else if(strcmp(cmd_name, "help") == 0){
 		commands_help();
 	}
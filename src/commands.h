@@ -16,8 +16,10 @@
 #include <string.h>
 #include <netinet/in.h>
 #include <inttypes.h>
+#include <time.h>
 
 #include "wunixlib/assets.h"
+#include "wunixlib/tokenbucket.h"
 
 #include "client_data.h"
 #include "helper.h"
@@ -13,6 +13,11 @@
 #define UNIXPROJECT_CONSTANTS_H
 
 #define PORT_DEFAULT 4242
+#define SERVER_UPGRADE_PATH "chatroom_%d.upgrade" //Hot upgrade socket, mode 0600 (%d is the port)
+#define SERVER_SNAPSHOT_PATH "chatroom_%d.rooms" //Rooms saved on disk (%d is the port)
+#define SERVER_SNAPSHOT_SEC 30 //Period between 2 snapshots of rooms
+#define SERVER_HISTORY_DIR "chatroom_%d.history" //Messages of rooms (%d is the port)
+#define SERVER_MAILBOX_DIR "chatroom_%d.mail" //Whispers for offline users (%d is the port)
 
 #define USER_MAX_SIZE 32
 #define USER_MIN_SIZE 6
@@ -20,10 +25,61 @@
 #define ROOM_MAX_SIZE 31
 #define ROOM_MIN_SIZE 4
 
+#define NODE_MAX_SIZE 32 //Name of a server in the cluster
+#define NODE_ADDRESS_SIZE 64 //Address where clients connect a server (host:port)
+#define NODE_VNODES 128 //Points of each server on the rooms hash ring
+#define NODE_SECRET_SIZE 64 //Secret shared by servers of the cluster (Checked on link open)
+
 #define CMD_MAX_SIZE 500 //Size of command enterred by user
 #define MSG_MAX_SIZE 600 //Size of message throught network
+#define CLIENT_MAX_REQUESTS 256 //Requests of the client waiting for their reply
 
 #define ROOM_WELCOME_NAME "enterroom"
+#define ROOMS_PAGE_SIZE 10 //Number of rooms in one page of !rooms <prefix> (Next one after its last room)
+#define ROOM_FANOUT_MIN 512 //Users in room before broadcast is split in partitions
+#define ROOM_FANOUT_PARTITION 1024 //Max users in one partition (Delivered by one worker)
+#define ROOM_RECENT_NB 64 //Last messages of a room kept in memory (Resumed without reading history)
+#define SERVER_FANOUT_WORKERS 4 //Worker threads delivering partitions
+
+//Write coalescing (Frames for a socket are sent together)
+#define SERVER_OUTBOX_WINDOW_MS 2 //Max added latency (0: frames sent at once)
+#define SERVER_OUTBOX_BYTES 8192 //Outbox sent at once when full
+#define SERVER_UPGRADE_TIMEOUT_MS 2000 //Max wait for clients at hot upgrade (Slower ones are disconnected)
+
+//Idle connections (In timer ticks)
+#define SERVER_TICK_MS 1000 //Duration of one tick
+#define SERVER_IDLE_TICKS 60 //Inactivity before sending a ping
+#define SERVER_PING_TICKS 15 //Time to answer the ping before being removed
+
+//Rate limit of each user (Tokens per second / Max burst) per message type
+#define RATE_BDCAST_PER_SEC 5
+#define RATE_BDCAST_BURST 10
+#define RATE_WHISPER_PER_SEC 5
+#define RATE_WHISPER_BURST 10
+#define RATE_OTHER_PER_SEC 2 //Connect, rooms management etc
+#define RATE_OTHER_BURST 10
+
+//Messages of a room saved on disk (See history.h)
+#define HISTORY_SEGMENT_SIZE (1024 * 1024) //New segment file when full (Holds many more frames than replayed)
+#define HISTORY_REPLAY_NB 50 //Last messages sent to a user entering the room
+#define HISTORY_INDEX_BLOCK 4096 //One index entry per block of segment (Bytes scanned by a query)
+#define HISTORY_QUERY_MAX (256 * 1024) //Max bytes sent for one history request
+#define HISTORY_ARCHIVE_SEC 60 //Period of the job compressing and removing old segments
+#define HISTORY_COLD_SEC (60 * 60) //Segment compressed once its last message is older
+#define HISTORY_RETENTION_SEC (90 * 24 * 3600) //Segment removed once its last message is older
+#define HISTORY_RETENTION_SIZE (256 * 1024 * 1024) //Oldest segments removed while a room uses more
+
+//Search in messages of a room (See search.h)
+#define SEARCH_LIVE_DOCS 4096 //Messages indexed in memory before being frozen in a segment
+#define SEARCH_RESULTS_NB 20 //Last matching messages sent for a search
+
+//Whispers for offline users (See mailbox.h)
+#define MAILBOX_COMMIT_MS 10 //Whispers queued meanwhile are saved by the same fsync
+#define MAILBOX_MAX_SIZE (1024 * 1024) //Whispers refused once a mailbox is full
+#define MAILBOX_SEND_TIMEOUT_MS 1000 //Mailbox kept if its whispers are not sent in this time
+
+//Same room message sent again by a user in this time is dropped (Seconds)
+#define USER_REPEAT_SEC 30
 
 #endif
 
@@ -0,0 +1,126 @@
+// -----------------------------------------------------------------------------
+/**
+ * \file	fanout.c
+ * \author	Constantin MASSON
+ * \date	July 6, 2016
+ *
+ * \brief	Parallel delivery of a frame to many users (Large rooms)
+ * \note	C Library for the Unix Programming Project
+ */
+// -----------------------------------------------------------------------------
+
+#include "fanout.h"
+
+
+//One partition of users (Argument of a job)
+struct fanout_partition{
+	SharedBuffer	*frame;
+	size_t			nb;
+	User			*users[ROOM_FANOUT_PARTITION];
+};
+
+//One pool of one worker for each queue: partitions of a queue are delivered in
+//order. A user is always in the same queue (socket % number of queues).
+static WorkPool	*fanout_pools		= NULL;
+static size_t	fanout_nb_pools		= 0;
+static size_t	fanout_nb_pending	= 0; //Partitions not yet delivered
+
+
+// -----------------------------------------------------------------------------
+// Static functions
+// -----------------------------------------------------------------------------
+
+//Job: write the frame to each user of the partition
+static void fanout_send_partition(void *arg){
+	struct fanout_partition *part = (struct fanout_partition*)arg;
+	size_t k;
+	for(k=0; k<part->nb; k++){
+		messaging_write_frame(part->users[k]->socket, part->frame);
+		user_release(part->users[k]);
+	}
+	sharedbuf_release(part->frame);
+	free(part);
+	__sync_sub_and_fetch(&fanout_nb_pending, 1);
+}
+
+//Queue the partition (Or send it now if no worker)
+static void fanout_push(struct fanout_partition *part, size_t queue){
+	__sync_add_and_fetch(&fanout_nb_pending, 1);
+	if(fanout_nb_pools == 0 || work_pool_push(&(fanout_pools[queue]), fanout_send_partition, part) != 1){
+		fanout_send_partition(part);
+	}
+}
+
+
+// -----------------------------------------------------------------------------
+// Functions
+// -----------------------------------------------------------------------------
+
+int fanout_init(size_t nb_workers){
+	if(fanout_pools != NULL){
+		return 1;
+	}
+	if(nb_workers > FANOUT_MAX_QUEUES){
+		nb_workers = FANOUT_MAX_QUEUES;
+	}
+	fanout_pools = (WorkPool*)malloc(nb_workers * sizeof(WorkPool));
+	if(fanout_pools == NULL){
+		return -1;
+	}
+	while(fanout_nb_pools < nb_workers && work_pool_init(&(fanout_pools[fanout_nb_pools]), 1) > 0){
+		fanout_nb_pools++;
+	}
+	return (fanout_nb_pools > 0) ? 1 : -1;
+}
+
+void fanout_deliver(const Linkedlist *users, SharedBuffer *frame){
+	LinkedlistNode			*current;
+	struct fanout_partition	*parts[FANOUT_MAX_QUEUES];
+	size_t					k, queue;
+	//Small list: sent now, unless partitions of a previous frame may still be queued
+	if(list_size(users) < ROOM_FANOUT_MIN && __sync_add_and_fetch(&fanout_nb_pending, 0) == 0){
+		list_iterate_args(users, user_send_frame, (void*)frame);
+		return;
+	}
+	memset(parts, 0x00, sizeof(parts));
+	for(current = users->first; current != NULL; current = current->next){
+		User *user = (User*)current->data;
+		if(user->node != NULL){
+			continue; //Remote users receive it from their node
+		}
+		queue = (fanout_nb_pools == 0) ? 0 : (size_t)user->socket % fanout_nb_pools;
+		if(parts[queue] == NULL){
+			parts[queue] = (struct fanout_partition*)malloc(sizeof(struct fanout_partition));
+			if(parts[queue] == NULL){
+				messaging_write_frame(user->socket, frame);
+				continue;
+			}
+			parts[queue]->frame	= sharedbuf_retain(frame);
+			parts[queue]->nb	= 0;
+		}
+		parts[queue]->users[parts[queue]->nb++] = user_retain(user);
+		if(parts[queue]->nb == ROOM_FANOUT_PARTITION){
+			fanout_push(parts[queue], queue);
+			parts[queue] = NULL;
+		}
+	}
+	for(k=0; k<FANOUT_MAX_QUEUES; k++){
+		if(parts[k] != NULL){
+			fanout_push(parts[k], k);
+		}
+	}
+}
+
+void fanout_wait(void){
+	size_t k;
+	for(k=0; k<fanout_nb_pools; k++){
+		work_pool_wait(&(fanout_pools[k]));
+	}
+}
+
+void fanout_stop(void){
+	size_t k;
+	for(k=0; k<fanout_nb_pools; k++){
+		work_pool_stop(&(fanout_pools[k]));
+	}
+}
@@ -0,0 +1,74 @@
+// -----------------------------------------------------------------------------
+/**
+ * \file	fanout.h
+ * \author	Constantin MASSON
+ * \date	July 6, 2016
+ *
+ * \brief	Parallel delivery of a frame to many users (Large rooms)
+ * \note	C Library for the Unix Programming Project
+ *
+ * Users are split in partitions of ROOM_FANOUT_PARTITION users. Each
+ * partition gets one reference on the frame and on its users, then is
+ * delivered by a worker thread (In parallel with other partitions), without
+ * the server lock. Users are released once written (See user_release).
+ *
+ * Each worker has its own queue, and a user is always in the same queue
+ * (socket % number of workers): frames of a user are written in order. Small
+ * lists are delivered by the caller, only when no partition is queued.
+ */
+// -----------------------------------------------------------------------------
+
+#ifndef UNIXPROJECT_FANOUT_H
+#define UNIXPROJECT_FANOUT_H
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "wunixlib/linkedlist.h"
+#include "wunixlib/sharedbuf.h"
+#include "wunixlib/workpool.h"
+#include "messaging.h"
+#include "constants.h"
+#include "user.h"
+
+#define FANOUT_MAX_QUEUES 16 //Max number of workers
+
+/**
+ * \brief				Start the workers (One queue each, at most FANOUT_MAX_QUEUES).
+ * \details				Without workers, frames are delivered by the caller.
+ *
+ * \param nb_workers	Number of worker threads
+ * \return				1 if started, otherwise, return -1
+ */
+int fanout_init(size_t nb_workers);
+
+/**
+ * \brief			Deliver the frame to all users of this server in the list.
+ * \details			Return once partitions are queued (Not delivered). List
+ * 					under ROOM_FANOUT_MIN users is delivered now if nothing is
+ * 					queued (Otherwise, after the frames queued).
+ * 					Users of other nodes are skipped.
+ * \warning			Server must be locked (List is read).
+ *
+ * \param users		List of users (User*)
+ * \param frame		Frame to send (Caller keeps its reference)
+ */
+void fanout_deliver(const Linkedlist *users, SharedBuffer *frame);
+
+/**
+ * \brief			Wait until all partitions queued are delivered.
+ * \details			Used before the server is handed off (See upgrade).
+ */
+void fanout_wait(void);
+
+/**
+ * \brief			Deliver partitions queued then stop the workers.
+ * \details			Frames are sent without worker after (Before exit, see upgrade).
+ */
+void fanout_stop(void);
+
+
+#endif
+
+
+
@@ -0,0 +1,1080 @@
+// -----------------------------------------------------------------------------
+/**
+ * \file	history.c
+ * \author	Constantin MASSON
+ * \date	July 13, 2016
+ *
+ * \brief	Messages of a room saved on disk (Replayed to users entering it)
+ * \note	C Library for the Unix Programming Project
+ */
+// -----------------------------------------------------------------------------
+
+#include "history.h"
+
+#define HISTORY_SCAN_SIZE 65536 //Read by block when positions are rebuilt (More than a frame)
+
+//Openings and removals of histories (Files changed by the background job are
+//checked against removals, under the lock)
+static pthread_mutex_t	history_files_lock	= PTHREAD_MUTEX_INITIALIZER;
+static uint64_t			history_nb_opened	= 0;
+static uint64_t			history_nb_removed	= 0;
+
+
+// -----------------------------------------------------------------------------
+// Static functions (Files)
+// -----------------------------------------------------------------------------
+
+//Path of one segment (ext: "log", "z" or "idx")
+static void history_segment_path(const History *history, const uint32_t segment, const char *ext, char *path){
+	snprintf(path, HISTORY_PATH_SIZE, "%s.%u.%s", history->path, segment, ext);
+}
+
+static int history_segment_open(const History *history, const uint32_t segment, const char *ext){
+	char path[HISTORY_PATH_SIZE];
+	history_segment_path(history, segment, ext, path);
+	return TEMP_FAILURE_RETRY(open(path, O_RDWR | O_APPEND | O_CREAT, 0644));
+}
+
+//Open a file of a segment for reading only (Never created)
+static int history_read_open(const char *path, const uint32_t segment, const char *ext){
+	char file[HISTORY_PATH_SIZE];
+	snprintf(file, sizeof(file), "%s.%u.%s", path, segment, ext);
+	return TEMP_FAILURE_RETRY(open(file, O_RDONLY));
+}
+
+//Size of the file (0 if error)
+static uint64_t history_file_size(const int fd){
+	struct stat st;
+	return (fstat(fd, &st) == 0) ? (uint64_t)st.st_size : 0;
+}
+
+//Read the whole index of a segment (To free), NULL if none
+static HistoryIndexEntry* history_index_load(const HistoryRequest *request, const uint32_t segment, size_t *nb){
+	HistoryIndexEntry *entries = NULL;
+	int fd = history_read_open(request->path, segment, "idx");
+	*nb = 0;
+	if(fd < 0){
+		return NULL;
+	}
+	size_t size = history_file_size(fd) / sizeof(HistoryIndexEntry) * sizeof(HistoryIndexEntry);
+	if(size > 0 && (entries = (HistoryIndexEntry*)malloc(size)) != NULL){
+		if(TEMP_FAILURE_RETRY(pread(fd, entries, size, 0)) == (ssize_t)size){
+			*nb = size / sizeof(HistoryIndexEntry);
+		}
+		else{
+			free(entries);
+			entries = NULL;
+		}
+	}
+	TEMP_FAILURE_RETRY(close(fd));
+	return entries;
+}
+
+//Time of a frame (0 if it has none)
+static int64_t history_frame_time(const char *frame){
+	for(; *frame != '\0' && *frame != MSG_TIME && *frame != MSG_DELIMITER[0]; frame++);
+	return (*frame == MSG_TIME) ? (int64_t)strtoll(frame + 1, NULL, 10) : 0;
+}
+
+//Number of a frame (0 if it has none)
+static uint64_t history_frame_seq(const char *frame){
+	for(; *frame != '\0' && *frame != MSG_SEQ && *frame != MSG_DELIMITER[0]; frame++);
+	return (*frame == MSG_SEQ) ? (uint64_t)strtoull(frame + 1, NULL, 10) : 0;
+}
+
+
+// -----------------------------------------------------------------------------
+// Static functions (Readers)
+// -----------------------------------------------------------------------------
+
+//Open a segment from its files (Raw one, else compressed one)
+static int history_reader_open_path(const char *path, const uint32_t segment, HistoryReader *reader){
+	size_t		dict_len;
+	const char	*dict = messaging_compression_dictionary(&dict_len);
+	int			fd;
+	memset(reader, 0x00, sizeof(HistoryReader));
+	if((reader->fd = history_read_open(path, segment, "log")) >= 0){
+		reader->size = history_file_size(reader->fd);
+		return 1;
+	}
+	fd				= history_read_open(path, segment, "z");
+	reader->zfile	= (fd < 0) ? NULL : (ZFile*)malloc(sizeof(ZFile));
+	if(reader->zfile == NULL || zfile_open(reader->zfile, fd, dict, dict_len) != 1){
+		if(fd >= 0){
+			TEMP_FAILURE_RETRY(close(fd));
+		}
+		free(reader->zfile);
+		reader->zfile = NULL;
+		return -1; //Removed
+	}
+	reader->size = reader->zfile->raw_size;
+	return 1;
+}
+
+//Open a segment of the request (Frames added to the last one since it was prepared are not read)
+static int history_reader_open(const HistoryRequest *request, const uint32_t segment, HistoryReader *reader){
+	if(segment > request->last || history_reader_open_path(request->path, segment, reader) != 1){
+		return -1;
+	}
+	if(segment == request->last && reader->size > request->end){
+		reader->size = request->end;
+	}
+	return 1;
+}
+
+static int64_t history_reader_pread(HistoryReader *reader, char *buf, const size_t len, const uint64_t offset){
+	if(reader->zfile != NULL){
+		return zfile_read(reader->zfile, buf, len, offset);
+	}
+	return TEMP_FAILURE_RETRY(pread(reader->fd, buf, len, offset));
+}
+
+//Send frames of the segment (Compressed ones are decoded by blocks of whole frames)
+static int64_t history_reader_send(HistoryReader *reader, const int socket, uint64_t offset, uint64_t len){
+	if(reader->zfile == NULL){
+		return messaging_write_file(socket, reader->fd, offset, len);
+	}
+	char	*buffer = (char*)malloc(HISTORY_CURSOR_SIZE);
+	int64_t	sent = 0, nb, err;
+	if(buffer == NULL){
+		return -1;
+	}
+	while(len > 0){
+		nb = zfile_read(reader->zfile, buffer, (len > HISTORY_CURSOR_SIZE) ? HISTORY_CURSOR_SIZE : len, offset);
+		for(; nb > 0 && buffer[nb-1] != '\0'; nb--); //No frame of another thread in the middle of one
+		if(nb <= 0){
+			break;
+		}
+		if((err = messaging_write(socket, buffer, nb)) < 0){
+			free(buffer);
+			return -1;
+		}
+		sent	+= err;
+		offset	+= nb;
+		len		-= nb;
+	}
+	free(buffer);
+	return sent;
+}
+
+//Number of the frame at offset (0 if none, only its type is read)
+static uint64_t history_reader_seq(HistoryReader *reader, const uint64_t offset){
+	char	type[64];
+	int64_t	nb = (offset < reader->size) ? history_reader_pread(reader, type, sizeof(type) - 1, offset) : 0;
+	if(nb <= 0){
+		return 0;
+	}
+	type[nb] = '\0';
+	return history_frame_seq(type);
+}
+
+static void history_reader_close(HistoryReader *reader){
+	if(reader->zfile != NULL){
+		zfile_close(reader->zfile);
+		free(reader->zfile);
+	}
+	else if(reader->fd >= 0){
+		TEMP_FAILURE_RETRY(close(reader->fd));
+	}
+	reader->fd		= -1;
+	reader->zfile	= NULL;
+}
+
+
+// -----------------------------------------------------------------------------
+// Static functions (Positions)
+// -----------------------------------------------------------------------------
+
+//Keep position of a new frame (Oldest one is forgotten if full)
+static void history_push(History *history, const uint32_t segment, const uint64_t offset){
+	HistoryEntry *entry;
+	if(history->nb == HISTORY_REPLAY_NB){
+		history->first = (history->first + 1) % HISTORY_REPLAY_NB;
+		history->nb--;
+	}
+	entry			= &(history->entries[(history->first + history->nb) % HISTORY_REPLAY_NB]);
+	entry->segment	= segment;
+	entry->offset	= offset;
+	history->nb++;
+}
+
+//Add an index entry for the frame if its block has none yet
+static int history_index_add(History *history, const int idx_fd, const uint32_t segment, const uint64_t offset, const int64_t time){
+	int64_t *start = &(history->starts[segment - history->first_segment]);
+	if(*start == HISTORY_NO_TIME){
+		*start = time;
+	}
+	if(offset < history->next_index){
+		return 1;
+	}
+	HistoryIndexEntry entry = {time, offset};
+	history->next_index = offset + HISTORY_INDEX_BLOCK;
+	return (bulk_write(idx_fd, (char*)&entry, sizeof(entry)) == sizeof(entry)) ? 1 : -1;
+}
+
+//Find the frames of a segment (Each frame ends with '\0'). Positions are
+//kept if ring is 1, index is rebuilt if idx_fd is given.
+static uint64_t history_scan(History *history, const int fd, const uint32_t segment, const int idx_fd, const int ring){
+	char		*buffer = (char*)malloc(HISTORY_SCAN_SIZE);
+	uint64_t	offset = 0;
+	ssize_t		nb, used, k;
+	if(buffer == NULL){
+		return 0;
+	}
+	history->next_index = 0;
+	while((nb = TEMP_FAILURE_RETRY(pread(fd, buffer, HISTORY_SCAN_SIZE, offset))) > 0){
+		//Only whole frames (Next read starts at a frame)
+		for(used=nb; used > 0 && buffer[used-1] != '\0'; used--);
+		if(used == 0){
+			break; //Truncated last frame (Crash), overwritten by next one
+		}
+		for(k=0; k<used; k+=strlen(buffer + k) + 1){
+			int64_t		time	= history_frame_time(buffer + k);
+			uint64_t	seq		= history_frame_seq(buffer + k);
+			if(ring == 1){
+				history_push(history, segment, offset + k);
+			}
+			if(idx_fd >= 0){
+				history_index_add(history, idx_fd, segment, offset + k, time);
+			}
+			history->last_time	= (time > history->last_time) ? time : history->last_time;
+			history->last_seq	= (seq > history->last_seq) ? seq : history->last_seq;
+		}
+		offset += used;
+	}
+	free(buffer);
+	return offset;
+}
+
+//Find the oldest and the last segments of the room (0 if none)
+static void history_find_segments(History *history, const char *dir, const char *file){
+	DIR				*d = opendir(dir);
+	struct dirent	*ent;
+	size_t			len = strlen(file);
+	unsigned int	segment;
+	int				found = 0;
+	char			end[5];
+	history->first_segment	= 0;
+	history->segment		= 0;
+	if(d == NULL){
+		return;
+	}
+	while((ent = readdir(d)) != NULL){
+		if(strncmp(ent->d_name, file, len) != 0 || ent->d_name[len] != '.'
+				|| sscanf(ent->d_name + len + 1, "%u.%4s", &segment, end) != 2
+				|| (strcmp(end, "log") != 0 && strcmp(end, "z") != 0)){
+			continue;
+		}
+		if(found == 0 || segment < history->first_segment){
+			history->first_segment = segment;
+		}
+		if(found == 0 || segment > history->segment){
+			history->segment = segment;
+		}
+		found = 1;
+	}
+	closedir(d);
+}
+
+//Place for the start time of segments until the given one
+static int history_reserve_starts(History *history, const uint32_t segment){
+	size_t nb = segment - history->first_segment + 1, k;
+	if(nb <= history->starts_capacity){
+		return 1;
+	}
+	size_t	capacity	= (history->starts_capacity == 0) ? 64 : history->starts_capacity;
+	while(capacity < nb){
+		capacity *= 2;
+	}
+	int64_t	*starts		= (int64_t*)realloc(history->starts, capacity * sizeof(int64_t));
+	if(starts == NULL){
+		return -1;
+	}
+	for(k=history->starts_capacity; k<capacity; k++){
+		starts[k] = HISTORY_NO_TIME;
+	}
+	history->starts				= starts;
+	history->starts_capacity	= capacity;
+	return 1;
+}
+
+//Recover start time of old segments (Index rebuilt if missing)
+static void history_load_starts(History *history){
+	HistoryIndexEntry	entry;
+	uint32_t			k;
+	for(k=history->first_segment; k<history->segment; k++){
+		int idx_fd	= history_segment_open(history, k, "idx");
+		if(idx_fd < 0){
+			continue;
+		}
+		if(TEMP_FAILURE_RETRY(pread(idx_fd, &entry, sizeof(entry), 0)) == sizeof(entry)){
+			history->starts[k - history->first_segment] = entry.time;
+		}
+		else{
+			int fd = history_read_open(history->path, k, "log");
+			if(fd >= 0){
+				history_scan(history, fd, k, idx_fd, 0);
+				TEMP_FAILURE_RETRY(close(fd));
+			}
+		}
+		TEMP_FAILURE_RETRY(close(idx_fd));
+	}
+}
+
+//Start a new segment (Current one becomes the previous one)
+static int history_roll(History *history){
+	if(history_reserve_starts(history, history->segment + 1) != 1){
+		return -1;
+	}
+	int fd		= history_segment_open(history, history->segment + 1, "log");
+	int idx_fd	= history_segment_open(history, history->segment + 1, "idx");
+	if(fd < 0 || idx_fd < 0){
+		if(fd >= 0){
+			TEMP_FAILURE_RETRY(close(fd));
+		}
+		if(idx_fd >= 0){
+			TEMP_FAILURE_RETRY(close(idx_fd));
+		}
+		return -1;
+	}
+	if(history->prev_fd >= 0){
+		TEMP_FAILURE_RETRY(close(history->prev_fd));
+	}
+	TEMP_FAILURE_RETRY(close(history->idx_fd));
+	history->prev_fd	= history->fd;
+	history->prev_size	= history->size;
+	history->fd			= fd;
+	history->idx_fd		= idx_fd;
+	history->size		= 0;
+	history->next_index	= 0;
+	history->segment++;
+	return 1;
+}
+
+
+// -----------------------------------------------------------------------------
+// Static functions (Query)
+// -----------------------------------------------------------------------------
+
+//Last segment with frames before the time (first segment if none)
+static uint32_t history_find_segment(const HistoryRequest *request, const int64_t since){
+	size_t low = 0, high = request->last - request->first_segment + 1, mid;
+	while(low < high){
+		mid = (low + high) / 2;
+		if(request->starts[mid] < since){
+			low = mid + 1;
+		}
+		else{
+			high = mid;
+		}
+	}
+	return request->first_segment + ((low == 0) ? 0 : low - 1);
+}
+
+//Offset of the first frame since the time in the segment (Segment size if none)
+static uint64_t history_find_offset(const HistoryRequest *request, HistoryReader *reader, const uint32_t segment,
+									const int64_t since){
+	size_t				nb, low = 0, high, mid;
+	HistoryIndexEntry	*entries = history_index_load(request, segment, &nb);
+	uint64_t			start = 0, end = reader->size, offset;
+	//Last entry before the time: frames since the time start in its block
+	for(high=nb; low < high; ){
+		mid = (low + high) / 2;
+		if(entries[mid].time < since){
+			low = mid + 1;
+		}
+		else{
+			high = mid;
+		}
+	}
+	if(low > 0){
+		start = entries[low - 1].offset;
+	}
+	if(low < nb && entries[low].offset < end){
+		end = entries[low].offset;
+	}
+	free(entries);
+	if(end <= start){
+		return start;
+	}
+	char *block = (char*)malloc(end - start);
+	if(block == NULL || history_reader_pread(reader, block, end - start, start) != (int64_t)(end - start)){
+		free(block);
+		return start; //Send the whole block
+	}
+	for(offset=0; offset < end - start; offset += strlen(block + offset) + 1){
+		if(history_frame_time(block + offset) >= since){
+			break;
+		}
+	}
+	free(block);
+	return start + offset;
+}
+
+//Last segment starting with a frame up to the number (first segment if none)
+static uint32_t history_find_segment_seq(const HistoryRequest *request, const uint64_t seq){
+	size_t			low = 0, high = request->last - request->first_segment + 1, mid;
+	HistoryReader	reader;
+	uint64_t		first;
+	while(low < high){
+		mid		= (low + high) / 2;
+		first	= 0; //Removed segments are the oldest ones
+		if(history_reader_open(request, request->first_segment + mid, &reader) == 1){
+			first = history_reader_seq(&reader, 0);
+			history_reader_close(&reader);
+		}
+		if(first <= seq){
+			low = mid + 1;
+		}
+		else{
+			high = mid;
+		}
+	}
+	return request->first_segment + ((low == 0) ? 0 : low - 1);
+}
+
+//Offset of the first frame after the number in the segment (Segment size if none)
+static uint64_t history_find_offset_seq(const HistoryRequest *request, HistoryReader *reader, const uint32_t segment,
+										const uint64_t seq){
+	size_t				nb, low = 0, high, mid;
+	HistoryIndexEntry	*entries = history_index_load(request, segment, &nb);
+	uint64_t			start = 0, end = reader->size, offset;
+	//Last entry up to the number: frames after it start in its block
+	for(high=nb; low < high; ){
+		mid = (low + high) / 2;
+		if(history_reader_seq(reader, entries[mid].offset) <= seq){
+			low = mid + 1;
+		}
+		else{
+			high = mid;
+		}
+	}
+	if(low > 0){
+		start = entries[low - 1].offset;
+	}
+	if(low < nb && entries[low].offset < end){
+		end = entries[low].offset;
+	}
+	free(entries);
+	if(end <= start){
+		return start;
+	}
+	char *block = (char*)malloc(end - start);
+	if(block == NULL || history_reader_pread(reader, block, end - start, start) != (int64_t)(end - start)){
+		free(block);
+		return start; //Send the whole block
+	}
+	for(offset=0; offset < end - start; offset += strlen(block + offset) + 1){
+		if(history_frame_seq(block + offset) > seq){
+			break;
+		}
+	}
+	free(block);
+	return start + offset;
+}
+
+//End of frames to send from offset (At least max bytes, whole frames)
+static uint64_t history_find_end(const HistoryRequest *request, const uint32_t segment,
+								const uint64_t size, const uint64_t offset, const size_t max){
+	size_t				nb, k;
+	uint64_t			end = size;
+	HistoryIndexEntry	*entries = history_index_load(request, segment, &nb);
+	for(k=0; k<nb && entries[k].offset < size; k++){
+		if(entries[k].offset >= offset + max){
+			end = entries[k].offset;
+			break;
+		}
+	}
+	free(entries);
+	return end;
+}
+
+//Send frames from the offset of the segment (At least max bytes, then number of the next frame is kept)
+static int64_t history_send_from(HistoryRequest *request, const int socket, uint32_t segment, uint64_t offset,
+								const size_t max){
+	int64_t	sent = 0, err;
+	size_t	read = 0; //Bytes of segments (Sent may be less if socket is compressed)
+	for(request->next=0; segment <= request->last && request->next == 0; segment++, offset=0){
+		HistoryReader	reader;
+		uint64_t		size, end;
+		if(history_reader_open(request, segment, &reader) != 1){
+			continue; //Removed
+		}
+		size	= reader.size;
+		offset	= (offset > size) ? size : offset;
+		end		= size;
+		if(read >= max){
+			end = offset; //Only the number of the next frame is read
+		}
+		else if(size - offset > max - read){
+			end = history_find_end(request, segment, size, offset, max - read);
+		}
+		err		= (end > offset) ? history_reader_send(&reader, socket, offset, end - offset) : 0;
+		if(end < size){
+			request->next = history_reader_seq(&reader, end);
+		}
+		history_reader_close(&reader);
+		if(err < 0){
+			return -1;
+		}
+		sent += err;
+		read += end - offset;
+	}
+	return sent;
+}
+
+
+//Copy what is needed to read the frames saved until now (Nothing to send yet)
+static void history_request_prepare(const History *history, HistoryRequest *request, const int type){
+	history_request_init(request);
+	if(history->fd < 0){
+		return;
+	}
+	strcpy(request->path, history->path);
+	request->type			= type;
+	request->first_segment	= history->first_segment;
+	request->last			= history->segment;
+	request->end			= history->size;
+}
+
+//Add frames following each other in a segment
+static int history_request_add(HistoryRequest *request, const uint32_t segment, const uint64_t offset,
+								const uint64_t len){
+	if(request->nb == request->capacity){
+		size_t			capacity	= (request->capacity == 0) ? 8 : request->capacity * 2;
+		HistoryRange	*ranges		= (HistoryRange*)realloc(request->ranges, capacity * sizeof(HistoryRange));
+		if(ranges == NULL){
+			fprintf(stderr, "[ERR] Internal error: realloc failed (%s:%d)\n", __FILE__, __LINE__);
+			return -1;
+		}
+		request->ranges		= ranges;
+		request->capacity	= capacity;
+	}
+	request->ranges[request->nb].segment	= segment;
+	request->ranges[request->nb].offset		= offset;
+	request->ranges[request->nb].len		= len;
+	request->nb++;
+	return 1;
+}
+
+//Send the ranges of frames (A segment is opened once for the ranges following each other in it)
+static int64_t history_request_send_ranges(const HistoryRequest *request, const int socket){
+	HistoryReader	reader;
+	int				opened = 0;
+	uint32_t		segment = 0;
+	int64_t			sent = 0, err;
+	size_t			k;
+	for(k=0; k<request->nb; k++){
+		HistoryRange *range = &(request->ranges[k]);
+		if(opened == 0 || range->segment != segment){
+			if(opened == 1){
+				history_reader_close(&reader);
+			}
+			segment	= range->segment;
+			opened	= (history_reader_open(request, segment, &reader) == 1) ? 1 : -1;
+		}
+		if(opened != 1 || range->offset + range->len > reader.size){
+			continue; //Removed
+		}
+		if((err = history_reader_send(&reader, socket, range->offset, range->len)) < 0){
+			sent = -1;
+			break;
+		}
+		sent += err;
+	}
+	if(opened == 1){
+		history_reader_close(&reader);
+	}
+	return sent;
+}
+
+
+// -----------------------------------------------------------------------------
+// Static functions (Archive)
+// -----------------------------------------------------------------------------
+
+//Lock the files of histories if none was removed since the job was prepared (1), otherwise, -1
+static int history_archive_lock(const HistoryArchive *archive){
+	pthread_mutex_lock(&history_files_lock);
+	if(history_nb_removed != archive->removals){
+		pthread_mutex_unlock(&history_files_lock);
+		return -1;
+	}
+	return 1;
+}
+
+//Size of a segment on disk (Raw, else compressed)
+static uint64_t history_archive_size(const HistoryArchive *archive, const uint32_t segment){
+	char		path[HISTORY_PATH_SIZE];
+	struct stat	st;
+	snprintf(path, sizeof(path), "%s.%u.log", archive->path, segment);
+	if(stat(path, &st) == 0){
+		return st.st_size;
+	}
+	snprintf(path, sizeof(path), "%s.%u.z", archive->path, segment);
+	return (stat(path, &st) == 0) ? (uint64_t)st.st_size : 0;
+}
+
+//1 if the last frame of the segment is older than sec, otherwise, 0
+static int history_archive_is_older(const HistoryArchive *archive, const uint32_t first, const uint32_t segment,
+									const int64_t sec, const int64_t now){
+	int64_t end = archive->ends[segment - first];
+	return (end != HISTORY_NO_TIME && end < now - sec * 1000) ? 1 : 0;
+}
+
+static int history_archive_remove(const HistoryArchive *archive, const uint32_t segment){
+	char path[HISTORY_PATH_SIZE];
+	if(history_archive_lock(archive) != 1){
+		return -1;
+	}
+	snprintf(path, sizeof(path), "%s.%u.log", archive->path, segment);
+	unlink(path);
+	snprintf(path, sizeof(path), "%s.%u.z", archive->path, segment);
+	unlink(path);
+	snprintf(path, sizeof(path), "%s.%u.idx", archive->path, segment);
+	unlink(path);
+	pthread_mutex_unlock(&history_files_lock);
+	return 1;
+}
+
+//Compress a segment (Temporary file renamed: a segment file is always complete)
+static int history_archive_compress(const HistoryArchive *archive, const uint32_t segment){
+	char		path[HISTORY_PATH_SIZE], tmp[HISTORY_PATH_SIZE + 16];
+	size_t		dict_len;
+	const char	*dict = messaging_compression_dictionary(&dict_len);
+	snprintf(path, sizeof(path), "%s.%u.log", archive->path, segment);
+	snprintf(tmp, sizeof(tmp), "%s.%u.z.tmp", archive->path, segment);
+	int in = TEMP_FAILURE_RETRY(open(path, O_RDONLY));
+	if(in < 0){
+		return 1; //Already compressed
+	}
+	int out = TEMP_FAILURE_RETRY(open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644));
+	int err = (out >= 0 && zfile_compress(in, out, dict, dict_len) >= 0 && fsync(out) == 0);
+	TEMP_FAILURE_RETRY(close(in));
+	if(out >= 0 && TEMP_FAILURE_RETRY(close(out)) != 0){
+		err = 0;
+	}
+	//Compressed without the lock, files replaced with it (Segment may be of another opening)
+	snprintf(path, sizeof(path), "%s.%u.z", archive->path, segment);
+	if(err == 0 || history_archive_lock(archive) != 1){
+		unlink(tmp);
+		return -1;
+	}
+	if(rename(tmp, path) != 0){
+		pthread_mutex_unlock(&history_files_lock);
+		fprintf(stderr, "[ERR] Unable to compress segment %s.%u\n", archive->path, segment);
+		unlink(tmp);
+		return -1;
+	}
+	//Readers which opened the raw file keep it until they close it
+	snprintf(tmp, sizeof(tmp), "%s.%u.log", archive->path, segment);
+	err = (unlink(tmp) == 0) ? 1 : -1;
+	pthread_mutex_unlock(&history_files_lock);
+	return err;
+}
+
+
+// -----------------------------------------------------------------------------
+// Functions
+// -----------------------------------------------------------------------------
+
+void history_init(History *history){
+	assert(history != NULL);
+	memset(history, 0x00, sizeof(History));
+	history->fd			= -1;
+	history->prev_fd	= -1;
+	history->idx_fd		= -1;
+}
+
+int history_open(History *history, const char *dir, const char *name){
+	assert(history != NULL && dir != NULL && name != NULL);
+	char	file[HISTORY_PATH_SIZE];
+	size_t	k = 0;
+	//Only letters, digits, '-' and '_' are kept in file name (Others are %XX)
+	for(; *name != '\0' && k + 4 < sizeof(file); name++){
+		unsigned char c = (unsigned char)*name;
+		if(isalnum(c) || c == '-' || c == '_'){
+			file[k++] = c;
+		}
+		else{
+			k += sprintf(file + k, "%%%02X", c);
+		}
+	}
+	file[k] = '\0';
+	if(snprintf(history->path, sizeof(history->path), "%s/%s", dir, file) >= (int)sizeof(history->path)){
+		return -1;
+	}
+	pthread_mutex_lock(&history_files_lock);
+	history->generation = ++history_nb_opened;
+	pthread_mutex_unlock(&history_files_lock);
+	history_find_segments(history, dir, file);
+	if(history_reserve_starts(history, history->segment) != 1){
+		return -1;
+	}
+	history_load_starts(history);
+
+	//Positions of last frames are in the last 2 segments
+	history->nb		= 0;
+	history->first	= 0;
+	if(history->segment > history->first_segment){
+		history->prev_fd = history_segment_open(history, history->segment - 1, "log");
+		if(history->prev_fd >= 0){
+			history->prev_size = history_scan(history, history->prev_fd, history->segment - 1, -1, 1);
+		}
+	}
+	//Index of current segment is rebuilt (May be late after a crash)
+	history->fd		= history_segment_open(history, history->segment, "log");
+	history->idx_fd	= history_segment_open(history, history->segment, "idx");
+	if(history->fd < 0 || history->idx_fd < 0 || ftruncate(history->idx_fd, 0) != 0){
+		history_close(history);
+		return -1;
+	}
+	history->size = history_scan(history, history->fd, history->segment, history->idx_fd, 1);
+	if(ftruncate(history->fd, history->size) != 0){
+		history_close(history);
+		return -1;
+	}
+	return 1;
+}
+
+int64_t history_time(const History *history){
+	struct timespec now;
+	clock_gettime(CLOCK_REALTIME, &now);
+	int64_t time = (int64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000;
+	return (time < history->last_time) ? history->last_time : time;
+}
+
+int history_append(History *history, const char *frame, const size_t len, const int64_t time, const uint64_t seq){
+	assert(history != NULL && frame != NULL);
+	if(history->fd < 0){
+		return -1;
+	}
+	if(history->size > 0 && history->size + len > HISTORY_SEGMENT_SIZE && history_roll(history) != 1){
+		return -1;
+	}
+	if(bulk_write(history->fd, (char*)frame, len) != (int64_t)len){
+		fprintf(stderr, "[ERR] Unable to save message in %s\n", history->path);
+		return -1;
+	}
+	history_index_add(history, history->idx_fd, history->segment, history->size, time);
+	history_push(history, history->segment, history->size);
+	history->size		+= len;
+	history->last_time	= time;
+	history->last_seq	= seq;
+	return 1;
+}
+
+int history_last(const History *history, HistoryEntry *entry){
+	assert(history != NULL && entry != NULL);
+	if(history->nb == 0){
+		return -1;
+	}
+	*entry = history->entries[(history->first + history->nb - 1) % HISTORY_REPLAY_NB];
+	return 1;
+}
+
+void history_request_init(HistoryRequest *request){
+	assert(request != NULL);
+	memset(request, 0x00, sizeof(HistoryRequest));
+	request->type = HISTORY_REQUEST_NONE;
+}
+
+int history_request_replay(const History *history, HistoryRequest *request){
+	assert(history != NULL && request != NULL);
+	history_request_prepare(history, request, HISTORY_REQUEST_RANGES);
+	if(history->fd < 0 || history->nb == 0){
+		return 1;
+	}
+	const HistoryEntry	*oldest = &(history->entries[history->first]);
+	uint64_t			offset = oldest->offset;
+	//Oldest frames are in the previous segment
+	if(oldest->segment != history->segment){
+		if(history_request_add(request, oldest->segment, offset, history->prev_size - offset) != 1){
+			return -1;
+		}
+		offset = 0;
+	}
+	return history_request_add(request, history->segment, offset, history->size - offset);
+}
+
+int history_request_query(const History *history, HistoryRequest *request, const int64_t since, const size_t max){
+	assert(history != NULL && request != NULL);
+	size_t nb = history->segment - history->first_segment + 1, k;
+	history_request_prepare(history, request, HISTORY_REQUEST_SINCE);
+	if(history->fd < 0){
+		return 1;
+	}
+	request->since	= since;
+	request->max	= max;
+	request->starts	= (int64_t*)malloc(nb * sizeof(int64_t));
+	if(request->starts == NULL){
+		fprintf(stderr, "[ERR] Internal error: malloc failed (%s:%d)\n", __FILE__, __LINE__);
+		request->type = HISTORY_REQUEST_NONE;
+		return -1;
+	}
+	memcpy(request->starts, history->starts, nb * sizeof(int64_t));
+	//Segment without known start (No frame, or index lost) starts with the next one: times stay sorted
+	for(k=nb-1; k>0; k--){
+		if(request->starts[k-1] == HISTORY_NO_TIME){
+			request->starts[k-1] = request->starts[k];
+		}
+	}
+	return 1;
+}
+
+int history_request_resume(const History *history, HistoryRequest *request, const uint64_t seq, const size_t max){
+	assert(history != NULL && request != NULL);
+	history_request_prepare(history, request, HISTORY_REQUEST_AFTER);
+	if(seq >= history->last_seq){
+		request->type = HISTORY_REQUEST_NONE;
+	}
+	request->seq	= seq;
+	request->max	= max;
+	return 1;
+}
+
+int history_request_ranges(const History *history, HistoryRequest *request){
+	assert(history != NULL && request != NULL);
+	history_request_prepare(history, request, HISTORY_REQUEST_RANGES);
+	return (request->type == HISTORY_REQUEST_RANGES) ? 1 : -1;
+}
+
+int history_request_frame(HistoryRequest *request, const HistoryEntry *entry, const size_t len){
+	assert(request != NULL && entry != NULL);
+	if(request->type != HISTORY_REQUEST_RANGES || entry->segment < request->first_segment){
+		return -1; //Removed
+	}
+	//Frames written after the request was prepared are not in it
+	if(entry->segment > request->last || (entry->segment == request->last && entry->offset + len > request->end)){
+		return -1;
+	}
+	return history_request_add(request, entry->segment, entry->offset, len);
+}
+
+int64_t history_request_send(HistoryRequest *request, const int socket){
+	assert(request != NULL);
+	uint32_t		segment;
+	uint64_t		offset = 0;
+	HistoryReader	reader;
+	switch(request->type){
+		case HISTORY_REQUEST_RANGES:
+			return history_request_send_ranges(request, socket);
+		case HISTORY_REQUEST_SINCE:
+			segment = history_find_segment(request, request->since);
+			if(history_reader_open(request, segment, &reader) == 1){
+				offset = history_find_offset(request, &reader, segment, request->since);
+				history_reader_close(&reader);
+			}
+			return history_send_from(request, socket, segment, offset, request->max);
+		case HISTORY_REQUEST_AFTER:
+			segment = history_find_segment_seq(request, request->seq);
+			if(history_reader_open(request, segment, &reader) == 1){
+				offset = history_find_offset_seq(request, &reader, segment, request->seq);
+				history_reader_close(&reader);
+			}
+			return history_send_from(request, socket, segment, offset, request->max);
+	}
+	return 0;
+}
+
+void history_request_free(HistoryRequest *request){
+	assert(request != NULL);
+	free(request->starts);
+	free(request->ranges);
+	history_request_init(request);
+}
+
+void history_cursor_init(const History *history, HistoryCursor *cursor){
+	assert(history != NULL && cursor != NULL);
+	memset(cursor, 0x00, sizeof(HistoryCursor));
+	strcpy(cursor->path, history->path);
+	cursor->segment	= history->first_segment;
+	cursor->last	= history->segment;
+	cursor->end		= history->size;
+	if(history->fd < 0){
+		cursor->segment	= 1;
+		cursor->last	= 0; //Nothing to read
+	}
+}
+
+int history_cursor_next(HistoryCursor *cursor, HistoryEntry *entry, char **frame, size_t *len){
+	assert(cursor != NULL && entry != NULL && frame != NULL && len != NULL);
+	while(cursor->segment <= cursor->last){
+		//Next frame in buffer (Buffer holds whole frames only)
+		if(cursor->start < cursor->used){
+			*frame			= cursor->buffer + cursor->start;
+			*len			= strlen(*frame) + 1;
+			entry->segment	= cursor->segment;
+			entry->offset	= cursor->offset + cursor->start;
+			cursor->start	+= *len;
+			return 1;
+		}
+		if(cursor->opened == 0){
+			cursor->opened	= (history_reader_open_path(cursor->path, cursor->segment, &(cursor->reader)) == 1) ? 1 : -1;
+			cursor->offset	= 0;
+			cursor->used	= 0;
+		}
+		cursor->offset	+= cursor->used;
+		cursor->start	= 0;
+		cursor->used	= 0;
+		//Last segment is read until its size when cursor was created (Frames added later are not complete yet)
+		size_t	size	= sizeof(cursor->buffer);
+		if(cursor->segment == cursor->last){
+			size = (cursor->end > cursor->offset + size) ? size : (size_t)(cursor->end - cursor->offset);
+		}
+		int64_t	nb		= (cursor->opened != 1 || size == 0) ? 0 : history_reader_pread(&(cursor->reader), cursor->buffer, size, cursor->offset);
+		for(; nb > 0 && cursor->buffer[nb-1] != '\0'; nb--);
+		if(nb > 0){
+			cursor->used = nb;
+			continue;
+		}
+		//End of segment (Or removed)
+		if(cursor->opened == 1){
+			history_reader_close(&(cursor->reader));
+		}
+		cursor->opened = 0;
+		cursor->segment++;
+	}
+	return 0;
+}
+
+void history_cursor_close(HistoryCursor *cursor){
+	assert(cursor != NULL);
+	if(cursor->opened == 1){
+		history_reader_close(&(cursor->reader));
+	}
+	cursor->opened	= 0;
+	cursor->segment	= cursor->last + 1;
+}
+
+int history_archive_prepare(const History *history, HistoryArchive *archive){
+	assert(history != NULL && archive != NULL);
+	uint32_t k;
+	memset(archive, 0x00, sizeof(HistoryArchive));
+	if(history->fd < 0 || history->segment < history->first_segment + 2){
+		return -1; //Nothing cold
+	}
+	strcpy(archive->path, history->path);
+	pthread_mutex_lock(&history_files_lock);
+	archive->removals	= history_nb_removed;
+	pthread_mutex_unlock(&history_files_lock);
+	archive->generation	= history->generation;
+	archive->first	= history->first_segment;
+	archive->hot	= history->segment - 1;
+	archive->last	= history->segment;
+	archive->ends	= (int64_t*)malloc((archive->hot - archive->first) * sizeof(int64_t));
+	if(archive->ends == NULL){
+		return -1;
+	}
+	//Last frame of a segment is before the first one of the next segment
+	for(k=archive->first; k<archive->hot; k++){
+		archive->ends[k - archive->first] = history->starts[k - history->first_segment + 1];
+	}
+	return 1;
+}
+
+int history_archive_run(HistoryArchive *archive, const int64_t now){
+	assert(archive != NULL);
+	uint64_t	total = 0;
+	uint64_t	*sizes;
+	uint32_t	first = archive->first, k;
+	int			nb = 0;
+	if(archive->ends == NULL || (sizes = (uint64_t*)malloc((archive->last - first + 1) * sizeof(uint64_t))) == NULL){
+		return -1;
+	}
+	for(k=first; k<=archive->last; k++){
+		sizes[k - first]	= history_archive_size(archive, k);
+		total				+= sizes[k - first];
+	}
+	//Oldest segments removed (Too old)
+	for(k=first; k<archive->hot && history_archive_is_older(archive, first, k, HISTORY_RETENTION_SEC, now) == 1; k++){
+		if(history_archive_remove(archive, k) != 1){
+			break; //A history was removed meanwhile
+		}
+		total -= sizes[k - first];
+		nb++;
+	}
+	//Cold segments compressed
+	for(archive->first=k; k<archive->hot && history_archive_is_older(archive, first, k, HISTORY_COLD_SEC, now) == 1; k++){
+		if(history_archive_compress(archive, k) != 1){
+			break;
+		}
+		total				-= sizes[k - first];
+		sizes[k - first]	= history_archive_size(archive, k);
+		total				+= sizes[k - first];
+	}
+	//Oldest segments removed (Room over its size)
+	for(k=archive->first; k<archive->hot && total > HISTORY_RETENTION_SIZE; k++){
+		if(history_archive_remove(archive, k) != 1){
+			break;
+		}
+		total -= sizes[k - first];
+		nb++;
+	}
+	archive->first = k;
+	free(sizes);
+	return nb;
+}
+
+void history_archive_apply(History *history, const HistoryArchive *archive){
+	assert(history != NULL && archive != NULL);
+	if(history->fd < 0 || history->generation != archive->generation || archive->first <= history->first_segment){
+		return;
+	}
+	uint32_t	first	= (archive->first < history->segment) ? archive->first : history->segment;
+	size_t		nb		= first - history->first_segment, k;
+	memmove(history->starts, history->starts + nb, (history->starts_capacity - nb) * sizeof(int64_t));
+	for(k=history->starts_capacity - nb; k<history->starts_capacity; k++){
+		history->starts[k] = HISTORY_NO_TIME;
+	}
+	history->first_segment = first;
+}
+
+void history_archive_free(HistoryArchive *archive){
+	assert(archive != NULL);
+	free(archive->ends);
+	archive->ends = NULL;
+}
+
+void history_close(History *history){
+	assert(history != NULL);
+	if(history->fd >= 0){
+		TEMP_FAILURE_RETRY(close(history->fd));
+	}
+	if(history->prev_fd >= 0){
+		TEMP_FAILURE_RETRY(close(history->prev_fd));
+	}
+	if(history->idx_fd >= 0){
+		TEMP_FAILURE_RETRY(close(history->idx_fd));
+	}
+	free(history->starts);
+	history->starts				= NULL;
+	history->starts_capacity	= 0;
+	history->fd					= -1;
+	history->prev_fd			= -1;
+	history->idx_fd				= -1;
+	history->nb					= 0;
+}
+
+void history_remove(History *history){
+	assert(history != NULL);
+	char		path[HISTORY_PATH_SIZE];
+	uint32_t	k;
+	int			opened = (history->fd >= 0);
+	history_close(history);
+	if(opened == 0){
+		return;
+	}
+	//Background job stops changing files (Same ones if room is opened again)
+	pthread_mutex_lock(&history_files_lock);
+	history_nb_removed++;
+	for(k=history->first_segment; k<=history->segment; k++){
+		history_segment_path(history, k, "log", path);
+		unlink(path);
+		history_segment_path(history, k, "idx", path);
+		unlink(path);
+		history_segment_path(history, k, "z", path);
+		unlink(path);
+	}
+	pthread_mutex_unlock(&history_files_lock);
+}
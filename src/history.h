@@ -0,0 +1,399 @@
+// -----------------------------------------------------------------------------
+/**
+ * \file	history.h
+ * \author	Constantin MASSON
+ * \date	July 13, 2016
+ *
+ * \brief	Messages of a room saved on disk (Replayed to users entering it)
+ * \note	C Library for the Unix Programming Project
+ *
+ * Broadcast frames of a room are appended to segment files, exactly as they
+ * are sent ("dir/room.N.log"). A new segment is started when the current one
+ * is full. The last frames are replayed from the file to the socket by the
+ * kernel (sendfile): no copy in user space, whatever the number of users
+ * entering the room.
+ * Position of the last HISTORY_REPLAY_NB frames is kept in memory (Rebuilt
+ * from the segments when the room is restored).
+ *
+ * Each frame has its time (See MSG_TIME), times never go back. Each segment
+ * has a sparse index ("dir/room.N.idx"): one entry (Time, offset of a frame)
+ * per HISTORY_INDEX_BLOCK bytes of segment. Time of the first frame of each
+ * segment is kept in memory. Frames since a time are found with 2 binary
+ * searches (Segment, then index entry) and the scan of at most one block.
+ * Frames also have their number in the room (See MSG_SEQ), found the same way
+ * by reading the first frame of segments and index entries.
+ *
+ * Segments are in 2 tiers. Hot ones (Current and previous) stay raw and are
+ * sent by sendfile. Older ones are cold: once their last frame is older than
+ * HISTORY_COLD_SEC, a background job compresses them ("dir/room.N.z", see
+ * zfile.h) and removes the raw file. Readers open the raw file, else the
+ * compressed one (Decoded by blocks): replay, queries and search read both.
+ * Same job removes the oldest segments (HISTORY_RETENTION_SEC and
+ * HISTORY_RETENTION_SIZE for each room). It works without the server lock,
+ * from a copy of the segments list (See history_archive_prepare). It stops
+ * touching files once any history is removed meanwhile (A room opened again
+ * has the same files), and its result is only applied to the same opening.
+ *
+ * Frames to send are read without the server lock too: a request is prepared
+ * from the history (Segments and size of the last one, see HistoryRequest),
+ * then sent from the files. Frames saved meanwhile are not part of it.
+ */
+// -----------------------------------------------------------------------------
+
+#ifndef UNIXPROJECT_HISTORY_H
+#define UNIXPROJECT_HISTORY_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <ctype.h>
+#include <assert.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include "wunixlib/stream.h"
+#include "wunixlib/zfile.h"
+#include "constants.h"
+#include "messaging.h"
+
+#define HISTORY_PATH_SIZE 256
+#define HISTORY_NO_TIME INT64_MAX //Time of a segment without frame
+#define HISTORY_CURSOR_SIZE 65536 //Read by block by a cursor (More than a frame)
+
+//Frames of a request (See HistoryRequest)
+#define HISTORY_REQUEST_NONE 0 //Nothing to send
+#define HISTORY_REQUEST_RANGES 1 //Given frames
+#define HISTORY_REQUEST_SINCE 2 //Frames since a time
+#define HISTORY_REQUEST_AFTER 3 //Frames after a number
+
+
+// -----------------------------------------------------------------------------
+// Structures
+// -----------------------------------------------------------------------------
+
+/** \brief Position of one frame in the segments. */
+typedef struct _history_entry{
+	uint32_t	segment; //Number of the segment file
+	uint64_t	offset; //Position of the frame in the segment
+} HistoryEntry;
+
+/** \brief Entry of a segment index (Written as it is in the index file). */
+typedef struct _history_index_entry{
+	int64_t		time; //Time of the frame (ms since epoch)
+	uint64_t	offset; //Position of the frame in the segment
+} HistoryIndexEntry;
+
+/**
+ * \brief		Messages of one room (Must be initialized with init).
+ * \details		Replayed frames are at most in the last 2 segments (A segment
+ * 				can hold more than HISTORY_REPLAY_NB frames).
+ */
+typedef struct _history{
+	char			path[HISTORY_PATH_SIZE - 16]; //Segments path without number (".N.log" added)
+	int				fd; //Current segment (-1 if history disabled)
+	int				prev_fd; //Previous segment (-1 if none)
+	uint32_t		first_segment; //Oldest segment on disk
+	uint32_t		segment; //Number of current segment
+	uint64_t		size; //Size of current segment
+	uint64_t		prev_size; //Size of previous segment
+	HistoryEntry	entries[HISTORY_REPLAY_NB]; //Last frames (Ring, oldest at first)
+	size_t			first;
+	size_t			nb;
+	int				idx_fd; //Index of current segment
+	uint64_t		next_index; //Next frame from this offset gets an index entry
+	int64_t			last_time; //Time of the last frame
+	uint64_t		last_seq; //Number of the last frame (0 if none)
+	int64_t			*starts; //Time of the first frame of each segment (From first_segment)
+	size_t			starts_capacity;
+	uint64_t		generation; //Number of this opening (0 if never opened)
+} History;
+
+/** \brief Segment opened for reading (Raw file, or compressed file once cold). */
+typedef struct _history_reader{
+	int			fd; //Raw file (-1 if compressed)
+	uint64_t	size; //Size of frames
+	ZFile		*zfile; //Compressed file (NULL if raw)
+} HistoryReader;
+
+/** \brief Work of the background job on one history (Copied from it). */
+typedef struct _history_archive{
+	char		path[HISTORY_PATH_SIZE - 16];
+	uint32_t	first; //Oldest segment (Oldest kept once run)
+	uint32_t	hot; //First hot segment (Never changed by the job)
+	uint32_t	last; //Current segment
+	int64_t		*ends; //Time of the last frame of each cold segment (Before the next one)
+	uint64_t	generation; //Opening of the history prepared
+	uint64_t	removals; //Histories removed when prepared (Files are left alone if it changes)
+} HistoryArchive;
+
+/**
+ * \brief		Read the frames of a history from another thread.
+ * \details		Frames saved when the cursor is created are read from the files
+ * 				(History may change meanwhile, not the frames already saved).
+ */
+typedef struct _history_cursor{
+	char			path[HISTORY_PATH_SIZE - 16];
+	uint32_t		segment; //Segment being read
+	uint32_t		last; //Last segment to read
+	uint64_t		end; //Size of last segment
+	HistoryReader	reader;
+	int				opened; //1 if segment is opened, -1 if removed, 0 if not tried yet
+	uint64_t		offset; //Position of buffer in segment
+	size_t			start; //Next frame in buffer
+	size_t			used; //Whole frames in buffer
+	char			buffer[HISTORY_CURSOR_SIZE];
+} HistoryCursor;
+
+
+/** \brief Frames following each other in one segment. */
+typedef struct _history_range{
+	uint32_t	segment;
+	uint64_t	offset; //Position of the first frame
+	uint64_t	len; //Bytes of whole frames
+} HistoryRange;
+
+/**
+ * \brief		Frames to send, prepared from a history and read from its files.
+ * \details		Prepared with the history (Locked), sent from any thread
+ * 				without it, even once history is closed. Frames saved after
+ * 				it was prepared are never sent.
+ */
+typedef struct _history_request{
+	char			path[HISTORY_PATH_SIZE - 16];
+	int				type; //HISTORY_REQUEST_*
+	uint32_t		first_segment; //Oldest segment when prepared
+	uint32_t		last; //Current segment when prepared
+	uint64_t		end; //Its size when prepared
+	int64_t			*starts; //Time of the first frame of each segment (SINCE only)
+	int64_t			since; //SINCE: time of the first frame
+	uint64_t		seq; //AFTER: number of the last frame received
+	size_t			max; //SINCE, AFTER: bytes to send
+	HistoryRange	*ranges; //RANGES: frames to send
+	size_t			nb;
+	size_t			capacity;
+	uint64_t		next; //SINCE, AFTER: number of the first frame not sent once max is reached (0 if none)
+} HistoryRequest;
+
+
+// -----------------------------------------------------------------------------
+// Functions
+// -----------------------------------------------------------------------------
+
+/**
+ * \brief			Initialize a disabled history (Nothing saved).
+ *
+ * \param history	History to initialize
+ */
+void history_init(History *history);
+
+/**
+ * \brief			Open the history of a room (Segments already there are kept).
+ * \details			Name is escaped in the file name (Any room name is safe).
+ *
+ * \param history	History initialized
+ * \param dir		Directory of histories
+ * \param name		Room name
+ * \return			1 if opened, otherwise, -1 (History stays disabled)
+ */
+int history_open(History *history, const char *dir, const char *name);
+
+/**
+ * \brief			Time of a new frame (Now, or time of the last frame if clock went back).
+ *
+ * \param history	History where the frame will be added
+ * \return			Time in ms since epoch
+ */
+int64_t history_time(const History *history);
+
+/**
+ * \brief			Append a frame at the end of history.
+ * \details			Do nothing if history is disabled.
+ *
+ * \param history	History where to add
+ * \param frame		Frame (With its '\0')
+ * \param len		Size of frame
+ * \param time		Time of the frame (See history_time)
+ * \param seq		Number of the frame (Greater than the last one)
+ * \return			1 if saved, otherwise, -1
+ */
+int history_append(History *history, const char *frame, const size_t len, const int64_t time, const uint64_t seq);
+
+/**
+ * \brief			Position of the last frame appended.
+ *
+ * \param history	History where to look for
+ * \param entry		Set to the position
+ * \return			1 if set, -1 if history is empty
+ */
+int history_last(const History *history, HistoryEntry *entry);
+
+/**
+ * \brief			Initialize an empty request (Nothing to send).
+ *
+ * \param request	Request to initialize
+ */
+void history_request_init(HistoryRequest *request);
+
+/**
+ * \brief			Prepare the last frames of history (Replayed to users entering the room).
+ *
+ * \param history	History to replay
+ * \param request	Set to the frames (Free it with history_request_free)
+ * \return			1 if prepared, otherwise, -1 (malloc)
+ */
+int history_request_replay(const History *history, HistoryRequest *request);
+
+/**
+ * \brief			Prepare the frames since the given time.
+ * \details			At most max bytes are sent (Rounded up to the next index
+ * 					entry, frames are never cut). If frames are left, their
+ * 					first number is set in next once sent: ask for the frames
+ * 					after it (See history_request_resume) for the next ones.
+ *
+ * \param history	History where to search
+ * \param request	Set to the frames (Free it with history_request_free)
+ * \param since		Time of the first frame (ms since epoch)
+ * \param max		Number of bytes to send
+ * \return			1 if prepared, otherwise, -1 (malloc)
+ */
+int history_request_query(const History *history, HistoryRequest *request, const int64_t since, const size_t max);
+
+/**
+ * \brief			Prepare the frames after the given number.
+ * \details			Same limit as history_request_query (next is set if
+ * 					frames are left). Frames removed from history are skipped.
+ *
+ * \param history	History where to search
+ * \param request	Set to the frames (Free it with history_request_free)
+ * \param seq		Number of the last frame already received
+ * \param max		Number of bytes to send
+ * \return			1 if prepared, otherwise, -1 (malloc)
+ */
+int history_request_resume(const History *history, HistoryRequest *request, const uint64_t seq, const size_t max);
+
+/**
+ * \brief			Prepare an empty request of frames (See history_request_frame).
+ * \details			Frames can be added without the history (Files as they were
+ * 					when prepared).
+ *
+ * \param history	History of the frames
+ * \param request	Request to prepare (Not initialized)
+ * \return			1 if prepared, -1 if history is not saved
+ */
+int history_request_ranges(const History *history, HistoryRequest *request);
+
+/**
+ * \brief			Add one frame of history to the request.
+ * \details			Request must be prepared by history_request_ranges.
+ *
+ * \param request	Request where to add
+ * \param entry		Position of the frame
+ * \param len		Size of the frame (With its '\0')
+ * \return			1 if added, -1 if error (Segment removed or frame written
+ * 					after the request was prepared)
+ */
+int history_request_frame(HistoryRequest *request, const HistoryEntry *entry, const size_t len);
+
+/**
+ * \brief			Send the frames of the request on the socket.
+ * \details			Read from the files (History must not be locked): sent
+ * 					by the kernel if possible (See messaging_write_file).
+ *
+ * \param request	Request prepared (next is set)
+ * \param socket	Socket where to send
+ * \return			Number of bytes sent, -1 if error
+ */
+int64_t history_request_send(HistoryRequest *request, const int socket);
+
+/**
+ * \brief			Free the request resources (Empty again).
+ *
+ * \param request	Request to free
+ */
+void history_request_free(HistoryRequest *request);
+
+/**
+ * \brief			Start reading all frames of history (From the oldest).
+ * \details			Cursor may be used by any thread, even once history is closed.
+ *
+ * \param history	History to read
+ * \param cursor	Cursor to initialize (Must be closed)
+ */
+void history_cursor_init(const History *history, HistoryCursor *cursor);
+
+/**
+ * \brief			Get the next frame.
+ * \details			Frame stays valid until the next call.
+ *
+ * \param cursor	Cursor where to read
+ * \param entry		Set to the position of the frame
+ * \param frame		Set to the frame
+ * \param len		Set to the size of the frame (With its '\0')
+ * \return			1 if a frame is read, 0 if no more frames
+ */
+int history_cursor_next(HistoryCursor *cursor, HistoryEntry *entry, char **frame, size_t *len);
+
+/**
+ * \brief			Free the cursor resources.
+ *
+ * \param cursor	Cursor to close
+ */
+void history_cursor_close(HistoryCursor *cursor);
+
+/**
+ * \brief			Copy what the background job needs (History must be locked).
+ *
+ * \param history	History to archive
+ * \param archive	Set to the job (Free it with history_archive_free)
+ * \return			1 if history has cold segments, otherwise, -1
+ */
+int history_archive_prepare(const History *history, HistoryArchive *archive);
+
+/**
+ * \brief			Remove the segments out of retention and compress cold ones.
+ * \details			Done on files only: history must not be locked.
+ *
+ * \param archive	Job prepared
+ * \param now		Current time (ms since epoch)
+ * \return			Number of segments removed, -1 if error
+ */
+int history_archive_run(HistoryArchive *archive, const int64_t now);
+
+/**
+ * \brief			Forget the segments removed by the job (History must be locked).
+ * \details			Do nothing if history is not the one prepared anymore.
+ *
+ * \param history	History archived
+ * \param archive	Job run
+ */
+void history_archive_apply(History *history, const HistoryArchive *archive);
+
+/**
+ * \brief			Free the job resources.
+ *
+ * \param archive	Job to free
+ */
+void history_archive_free(HistoryArchive *archive);
+
+/**
+ * \brief			Close the segments (Files are kept).
+ *
+ * \param history	History to close
+ */
+void history_close(History *history);
+
+/**
+ * \brief			Close and delete the segments (Room removed).
+ *
+ * \param history	History to remove
+ */
+void history_remove(History *history);
+
+#endif
+
@@ -0,0 +1,310 @@
+// -----------------------------------------------------------------------------
+/**
+ * \file	mailbox.c
+ * \author	Constantin MASSON
+ * \date	July 16, 2016
+ *
+ * \brief	Whispers kept on disk for offline users (Delivered on connect)
+ * \note	C Library for the Unix Programming Project
+ */
+// -----------------------------------------------------------------------------
+
+#include "mailbox.h"
+
+
+// -----------------------------------------------------------------------------
+// Static functions
+// -----------------------------------------------------------------------------
+
+//Path of the mailbox of a user (Only letters, digits, '-' and '_' are kept, others are %XX)
+static void mailbox_path(const Mailbox *mailbox, const char *login, char *path){
+	size_t k = snprintf(path, MAILBOX_PATH_SIZE, "%s/", mailbox->dir);
+	for(; *login != '\0' && k + 8 < MAILBOX_PATH_SIZE; login++){
+		unsigned char c = (unsigned char)*login;
+		if(isalnum(c) || c == '-' || c == '_'){
+			path[k++] = c;
+		}
+		else{
+			k += sprintf(path + k, "%%%02X", c);
+		}
+	}
+	strcpy(path + k, ".box");
+}
+
+//Records of the same user together, in order of arrival
+static int mailbox_compare(const void *a, const void *b){
+	const MailboxRecord *ra = (const MailboxRecord*)a;
+	const MailboxRecord *rb = (const MailboxRecord*)b;
+	int cmp = strcmp(ra->login, rb->login);
+	if(cmp != 0){
+		return cmp;
+	}
+	return (ra->seq < rb->seq) ? -1 : (ra->seq > rb->seq);
+}
+
+//Append records of one user in one write, then fsync (Records are released). io must be locked.
+static int mailbox_append(Mailbox *mailbox, MailboxRecord *records, const size_t nb){
+	char	path[MAILBOX_PATH_SIZE];
+	size_t	size = 0, k;
+	char	*data;
+	int		fd, err = -1;
+	for(k=0; k<nb; k++){
+		size += records[k].frame->size;
+	}
+	mailbox_path(mailbox, records[0].login, path);
+	data	= (char*)malloc(size);
+	fd		= TEMP_FAILURE_RETRY(open(path, O_WRONLY | O_APPEND | O_CREAT, 0644));
+	if(data != NULL && fd >= 0){
+		for(size=0, k=0; k<nb; k++){
+			memcpy(data + size, records[k].frame->data, records[k].frame->size);
+			size += records[k].frame->size;
+		}
+		err = (bulk_write(fd, data, size) == (int64_t)size && fsync(fd) == 0) ? 1 : -1;
+	}
+	if(err != 1){
+		fprintf(stderr, "[ERR] Unable to save %lu whispers in %s\n", (unsigned long)nb, path);
+	}
+	if(fd >= 0){
+		TEMP_FAILURE_RETRY(close(fd));
+	}
+	free(data);
+	for(k=0; k<nb; k++){
+		sharedbuf_release(records[k].frame);
+	}
+	return err;
+}
+
+//Remove the first size bytes of a mailbox (Whispers delivered), those appended since are kept.
+static int mailbox_remove(Mailbox *mailbox, int fd, const uint64_t size){
+	int err = -1;
+	pthread_mutex_lock(&(mailbox->io));
+	off_t	end		= lseek(fd, 0, SEEK_END);
+	size_t	left	= (end > (off_t)size) ? (size_t)(end - size) : 0;
+	char	*data	= (left > 0) ? (char*)malloc(left) : NULL;
+	if(left == 0 || (data != NULL && TEMP_FAILURE_RETRY(pread(fd, data, left, size)) == (ssize_t)left
+			&& TEMP_FAILURE_RETRY(pwrite(fd, data, left, 0)) == (ssize_t)left)){
+		err = (ftruncate(fd, left) == 0 && fsync(fd) == 0) ? 1 : -1;
+	}
+	pthread_mutex_unlock(&(mailbox->io));
+	free(data);
+	return err;
+}
+
+//Commit queued records. Thread waits MAILBOX_COMMIT_MS after the first one
+//(Whispers sent meanwhile are saved by the same fsync).
+static void *mailbox_handler(void *args){
+	Mailbox *mailbox = (Mailbox*)args;
+	int closing = 0;
+	while(closing == 0){
+		pthread_mutex_lock(&(mailbox->mutex));
+		while(mailbox->nb_records == 0 && mailbox->closing == 0){
+			pthread_cond_wait(&(mailbox->cond), &(mailbox->mutex));
+		}
+		closing = mailbox->closing;
+		pthread_mutex_unlock(&(mailbox->mutex));
+		if(closing == 0){
+			usleep(MAILBOX_COMMIT_MS * 1000);
+		}
+		mailbox_commit(mailbox);
+	}
+	return NULL;
+}
+
+
+// -----------------------------------------------------------------------------
+// Functions
+// -----------------------------------------------------------------------------
+
+void mailbox_init(Mailbox *mailbox){
+	assert(mailbox != NULL);
+	memset(mailbox, 0x00, sizeof(Mailbox));
+	pthread_mutex_init(&(mailbox->mutex), NULL);
+	pthread_mutex_init(&(mailbox->io), NULL);
+	pthread_cond_init(&(mailbox->cond), NULL);
+}
+
+int mailbox_open(Mailbox *mailbox, const char *dir){
+	assert(mailbox != NULL && dir != NULL);
+	if(strlen(dir) >= sizeof(mailbox->dir) || (mkdir(dir, 0755) != 0 && errno != EEXIST)){
+		fprintf(stderr, "[ERR] Unable to create mailbox directory %s\n", dir);
+		return -1;
+	}
+	strcpy(mailbox->dir, dir);
+	if(pthread_create(&(mailbox->thread), NULL, mailbox_handler, (void*)mailbox) != 0){
+		mailbox->dir[0] = '\0';
+		return -1;
+	}
+	return 1;
+}
+
+int mailbox_register(Mailbox *mailbox, const char *login){
+	assert(mailbox != NULL && login != NULL);
+	char path[MAILBOX_PATH_SIZE];
+	if(mailbox->dir[0] == '\0'){
+		return -1;
+	}
+	mailbox_path(mailbox, login, path);
+	int fd = TEMP_FAILURE_RETRY(open(path, O_WRONLY | O_CREAT, 0644));
+	if(fd < 0){
+		fprintf(stderr, "[ERR] Unable to create mailbox %s\n", path);
+		return -1;
+	}
+	TEMP_FAILURE_RETRY(close(fd));
+	return 1;
+}
+
+int mailbox_put(Mailbox *mailbox, const char *login, const char *sender, const char *msg){
+	assert(mailbox != NULL && login != NULL && sender != NULL && msg != NULL);
+	char			path[MAILBOX_PATH_SIZE];
+	struct stat		st;
+	struct timespec	now;
+	if(mailbox->dir[0] == '\0' || strlen(login) > USER_MAX_SIZE){
+		return -1;
+	}
+	mailbox_path(mailbox, login, path);
+	if(stat(path, &st) != 0){
+		return -1; //Never connected
+	}
+	clock_gettime(CLOCK_REALTIME, &now);
+	SharedBuffer *frame = messaging_encode_whisper(sender, login, msg, (int64_t)now.tv_sec * 1000 + now.tv_nsec / 1000000);
+	if(frame == NULL){
+		return -1;
+	}
+	//Whispers not yet committed count too
+	uint64_t size = (uint64_t)st.st_size + frame->size;
+	size_t k;
+	pthread_mutex_lock(&(mailbox->mutex));
+	for(k=0; k<mailbox->nb_records; k++){
+		if(strcmp(mailbox->records[k].login, login) == 0){
+			size += mailbox->records[k].frame->size;
+		}
+	}
+	if(size > MAILBOX_MAX_SIZE){
+		pthread_mutex_unlock(&(mailbox->mutex));
+		sharedbuf_release(frame);
+		return -2;
+	}
+	if(mailbox->nb_records == mailbox->capacity){
+		size_t			capacity	= (mailbox->capacity == 0) ? 64 : mailbox->capacity * 2;
+		MailboxRecord	*records	= (MailboxRecord*)realloc(mailbox->records, capacity * sizeof(MailboxRecord));
+		if(records == NULL){
+			pthread_mutex_unlock(&(mailbox->mutex));
+			sharedbuf_release(frame);
+			return -1;
+		}
+		mailbox->records	= records;
+		mailbox->capacity	= capacity;
+	}
+	MailboxRecord *record = &(mailbox->records[mailbox->nb_records++]);
+	strcpy(record->login, login);
+	record->frame	= frame;
+	record->seq		= mailbox->seq++;
+	pthread_cond_signal(&(mailbox->cond));
+	pthread_mutex_unlock(&(mailbox->mutex));
+	return 1;
+}
+
+int mailbox_commit(Mailbox *mailbox){
+	assert(mailbox != NULL);
+	MailboxRecord	*records;
+	size_t			nb, k, next;
+	int				saved = 0, err = 1;
+	//Records queued from now on go to the next commit
+	pthread_mutex_lock(&(mailbox->io));
+	pthread_mutex_lock(&(mailbox->mutex));
+	records				= mailbox->records;
+	nb					= mailbox->nb_records;
+	mailbox->records	= NULL;
+	mailbox->nb_records	= 0;
+	mailbox->capacity	= 0;
+	pthread_mutex_unlock(&(mailbox->mutex));
+
+	qsort(records, nb, sizeof(MailboxRecord), mailbox_compare);
+	for(k=0; k<nb; k=next){
+		for(next=k+1; next<nb && strcmp(records[next].login, records[k].login) == 0; next++);
+		if(mailbox_append(mailbox, records + k, next - k) == 1){
+			saved += next - k;
+		}
+		else{
+			err = -1;
+		}
+	}
+	pthread_mutex_unlock(&(mailbox->io));
+	free(records);
+	return (err == 1) ? saved : -1;
+}
+
+void mailbox_close(Mailbox *mailbox){
+	assert(mailbox != NULL);
+	if(mailbox->dir[0] == '\0'){
+		return;
+	}
+	pthread_mutex_lock(&(mailbox->mutex));
+	mailbox->closing = 1;
+	pthread_cond_signal(&(mailbox->cond));
+	pthread_mutex_unlock(&(mailbox->mutex));
+	pthread_join(mailbox->thread, NULL);
+	mailbox->dir[0] = '\0';
+}
+
+int mailbox_deliver(Mailbox *mailbox, const char *login, const int socket){
+	assert(mailbox != NULL && login != NULL);
+	char		path[MAILBOX_PATH_SIZE], str_nb[16];
+	char		*data = NULL;
+	uint64_t	size;
+	int64_t		len = 0;
+	size_t		k, nb = 0;
+	int			fd, err = -1;
+	if(mailbox->dir[0] == '\0'){
+		return 0;
+	}
+	//Whispers still queued for the user are saved first (Same order)
+	pthread_mutex_lock(&(mailbox->io));
+	pthread_mutex_lock(&(mailbox->mutex));
+	MailboxRecord *queued = (MailboxRecord*)malloc((mailbox->nb_records + 1) * sizeof(MailboxRecord));
+	for(k=0; queued != NULL && k<mailbox->nb_records; k++){
+		if(strcmp(mailbox->records[k].login, login) == 0){
+			queued[nb++] = mailbox->records[k];
+		}
+		else{
+			mailbox->records[k - nb] = mailbox->records[k];
+		}
+	}
+	mailbox->nb_records -= nb;
+	pthread_mutex_unlock(&(mailbox->mutex));
+	if(nb > 0){
+		mailbox_append(mailbox, queued, nb);
+	}
+	free(queued);
+
+	mailbox_path(mailbox, login, path);
+	fd		= TEMP_FAILURE_RETRY(open(path, O_RDWR));
+	size	= (fd < 0) ? 0 : lseek(fd, 0, SEEK_END);
+	data	= (size > 0) ? (char*)malloc(size) : NULL;
+	len		= (data == NULL) ? 0 : TEMP_FAILURE_RETRY(pread(fd, data, size, 0));
+	//Socket is written without io: commits never wait for a user
+	pthread_mutex_unlock(&(mailbox->io));
+	if(len > 0 && messaging_batch_begin(socket) == 1){
+		size = (uint64_t)len;
+		for(; len > 0 && data[len-1] != '\0'; len--); //Truncated last frame (Crash)
+		for(nb=0, k=0; k<(size_t)len; k++){
+			nb += (data[k] == '\0') ? 1 : 0;
+		}
+		//Mailbox is emptied only once all whispers are sent (Not only queued in the outbox)
+		sprintf(str_nb, "%lu", (unsigned long)nb);
+		messaging_send_confirm(socket, MSG_CONF_MAILBOX, str_nb);
+		messaging_write(socket, data, len);
+		if(messaging_batch_end() >= 0 && messaging_wait_sent(socket, MAILBOX_SEND_TIMEOUT_MS) == 1
+				&& mailbox_remove(mailbox, fd, size) == 1){
+			err = (int)nb;
+		}
+	}
+	else if(size == 0){
+		err = 0; //Nothing to deliver
+	}
+	if(fd >= 0){
+		TEMP_FAILURE_RETRY(close(fd));
+	}
+	free(data);
+	return err;
+}
@@ -0,0 +1,154 @@
+// -----------------------------------------------------------------------------
+/**
+ * \file	mailbox.h
+ * \author	Constantin MASSON
+ * \date	July 16, 2016
+ *
+ * \brief	Whispers kept on disk for offline users (Delivered on connect)
+ * \note	C Library for the Unix Programming Project
+ *
+ * Each user who connected once to this server has a mailbox file
+ * ("dir/login.box", created empty on connect). A whisper to such a user while
+ * offline is saved in it as the frame it would have received (With its time,
+ * see MSG_TIME). All frames are sent in one write on its next connect, then
+ * the mailbox is emptied.
+ *
+ * Files are written by a background thread only (Group commit): whispers are
+ * queued in memory, and the thread waits MAILBOX_COMMIT_MS to gather the
+ * whispers of other users, then appends them and calls fsync once for each
+ * mailbox changed. Server never waits for the disk while it is locked: a
+ * delivery is done by the thread of the user once server is unlocked.
+ * Whispers queued in the last MAILBOX_COMMIT_MS may be lost if server crashes.
+ */
+// -----------------------------------------------------------------------------
+
+#ifndef UNIXPROJECT_MAILBOX_H
+#define UNIXPROJECT_MAILBOX_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <assert.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include "wunixlib/assets.h"
+#include "wunixlib/stream.h"
+#include "wunixlib/sharedbuf.h"
+#include "constants.h"
+#include "messaging.h"
+
+#define MAILBOX_PATH_SIZE 256
+
+
+// -----------------------------------------------------------------------------
+// Structures
+// -----------------------------------------------------------------------------
+
+/** \brief Whisper waiting for the next commit. */
+typedef struct _mailbox_record{
+	char			login[USER_MAX_SIZE+1]; //Receiver
+	SharedBuffer	*frame;
+	size_t			seq; //Order of arrival (Kept for each receiver)
+} MailboxRecord;
+
+/**
+ * \brief		Mailboxes of all users (Must be initialized with init).
+ * \details		Protected by its own mutexes (Not by the server lock).
+ */
+typedef struct _mailbox{
+	char			dir[MAILBOX_PATH_SIZE - 128]; //Empty if disabled
+	pthread_mutex_t	mutex; //Protect the records queued
+	pthread_cond_t	cond; //Signaled when a record is queued
+	pthread_mutex_t	io; //Held while files are written (Commit or delivery)
+	MailboxRecord	*records; //Queued since last commit
+	size_t			nb_records;
+	size_t			capacity;
+	size_t			seq;
+	pthread_t		thread; //Commit thread (Started if dir is set)
+	int				closing; //1 once closed: thread commits then quits
+} Mailbox;
+
+
+// -----------------------------------------------------------------------------
+// Functions
+// -----------------------------------------------------------------------------
+
+/**
+ * \brief			Initialize disabled mailboxes (Nothing saved).
+ *
+ * \param mailbox	Mailbox to initialize
+ */
+void mailbox_init(Mailbox *mailbox);
+
+/**
+ * \brief			Enable the mailboxes and start the commit thread.
+ *
+ * \param mailbox	Mailbox initialized
+ * \param dir		Directory of mailboxes (Created if needed)
+ * \return			1 if success, otherwise, -1 (Mailboxes stay disabled)
+ */
+int mailbox_open(Mailbox *mailbox, const char *dir);
+
+/**
+ * \brief			Create the mailbox of a user (If not already there).
+ *
+ * \param mailbox	Mailboxes
+ * \param login		User connected
+ * \return			1 if user has a mailbox, otherwise, -1
+ */
+int mailbox_register(Mailbox *mailbox, const char *login);
+
+/**
+ * \brief			Queue a whisper for an offline user.
+ * \details			Saved on disk by the next commit. Mailbox is full once its
+ * 					file and whispers queued for it reach MAILBOX_MAX_SIZE.
+ *
+ * \param mailbox	Mailboxes
+ * \param login		Receiver
+ * \param sender	User sending the whisper
+ * \param msg		Whisper
+ * \return			1 if queued, -1 if user has no mailbox, -2 if mailbox is full
+ */
+int mailbox_put(Mailbox *mailbox, const char *login, const char *sender, const char *msg);
+
+/**
+ * \brief			Save all queued whispers now (fsync once for each mailbox).
+ *
+ * \param mailbox	Mailboxes
+ * \return			Number of whispers saved, -1 if a mailbox failed (Its whispers are lost)
+ */
+int mailbox_commit(Mailbox *mailbox);
+
+/**
+ * \brief			Save queued whispers and stop the commit thread (Wait for it).
+ * \details			Mailboxes are disabled after (Before exit, see upgrade).
+ *
+ * \param mailbox	Mailboxes
+ */
+void mailbox_close(Mailbox *mailbox);
+
+/**
+ * \brief			Send all whispers of the user in one write, then empty its mailbox.
+ * \details			Whispers are preceded by MSG_CONF_MAILBOX (Their number).
+ * 					Nothing is sent if mailbox is empty. Mailbox is emptied
+ * 					once they are sent (See messaging_wait_sent): kept if
+ * 					not sent in MAILBOX_SEND_TIMEOUT_MS (Sent again next time).
+ * \warning			Waits for the disk: server must not be locked.
+ *
+ * \param mailbox	Mailboxes
+ * \param login		User connected
+ * \param socket	Socket of the user
+ * \return			Number of whispers sent, -1 if error (Mailbox kept)
+ */
+int mailbox_deliver(Mailbox *mailbox, const char *login, const int socket);
+
+#endif
+
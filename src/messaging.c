@@ -31,13 +31,348 @@
  */
 static int messaging_sender(const int socket, const char *cmd, const int nb, const int size_fmt, ...);
 
+//Locks of sockets (One for several sockets, fd % MSG_NB_WRITE_LOCKS)
+static pthread_mutex_t	messaging_locks[MSG_NB_WRITE_LOCKS];
+static pthread_once_t	messaging_locks_once = PTHREAD_ONCE_INIT;
+static messaging_writer	messaging_custom_writer = NULL;
+static messaging_file_writer messaging_custom_file_writer = NULL;
+static messaging_holder	messaging_custom_hold		= NULL;
+static messaging_holder	messaging_custom_release	= NULL;
+static messaging_waiter	messaging_custom_wait		= NULL;
+static __thread pthread_mutex_t *messaging_held_lock = NULL; //Lock taken by messaging_hold (Default)
+
+//Request of this thread (See messaging_request_begin)
+static __thread int				messaging_request_socket	= -1;
+static __thread unsigned int	messaging_request_id		= 0;
+static __thread int				messaging_request_nb_tagged	= 0; //Frames tagged with the id
+
+//Frames kept by this thread (See messaging_batch_begin)
+static __thread int		messaging_batch_socket		= -1;
+static __thread char	*messaging_batch_data		= NULL;
+static __thread size_t	messaging_batch_size		= 0;
+static __thread size_t	messaging_batch_capacity	= 0;
+
+//Sockets whose data is compressed (See messaging_set_compression)
+static uint8_t messaging_compressed[MSG_MAX_COMPRESSED_FD];
+
+//Preset dictionary of compressed blocks: strings often sent by server (Most
+//frequent at the end, closer to the data). Never change it: both sides must
+//have the same.
+static const char messaging_dictionary[] =
+	"node_hello;;;node_user;;;node_room;;;rooms_page;;;"
+	"msg_err_connect;;;msg_err_unknown_user;;;msg_err_general;;;msg_err_throttle;;;"
+	"msg_err_repeat;;;msg_err_filtered;;;msg_err_redirect;;;"
+	"msg_conf_register;;;msg_conf_room_close;;;msg_conf_disconnect;;;msg_conf_ack;;;"
+	"error;;;You must be in a room. You are not allowed. Name is not valid. "
+	"the you that and this have what with for are not was but can just "
+	"hello thanks yes okay lol haha http://www. https:// .com "
+	"whisper;;;msg_conf_general;;;msg_conf_room_enter;;;You have been successfully "
+	"ping\0confirm;;;msg_conf_ack;;;\0bdcast;;;";
+
+static void messaging_locks_init(void){
+	int k;
+	for(k=0; k<MSG_NB_WRITE_LOCKS; k++){
+		pthread_mutex_init(&(messaging_locks[k]), NULL);
+	}
+}
+
+//Lock a socket (Unless this thread holds its lock, see messaging_hold)
+static pthread_mutex_t *messaging_lock_socket(const int socket){
+	pthread_once(&messaging_locks_once, messaging_locks_init);
+	pthread_mutex_t *lock = &(messaging_locks[socket % MSG_NB_WRITE_LOCKS]);
+	if(lock != messaging_held_lock){
+		pthread_mutex_lock(lock);
+	}
+	return lock;
+}
+
+static void messaging_unlock_socket(pthread_mutex_t *lock){
+	if(lock != messaging_held_lock){
+		pthread_mutex_unlock(lock);
+	}
+}
+
+
+// -----------------------------------------------------------------------------
+// Frames
+// -----------------------------------------------------------------------------
+
+void messaging_set_writer(messaging_writer writer, messaging_file_writer file_writer){
+	messaging_custom_writer		= writer;
+	messaging_custom_file_writer	= file_writer;
+}
+
+void messaging_set_holder(messaging_holder hold, messaging_holder release){
+	messaging_custom_hold		= hold;
+	messaging_custom_release	= release;
+}
+
+void messaging_set_waiter(messaging_waiter wait){
+	messaging_custom_wait = wait;
+}
+
+//Write data as it is (Frames of a socket are never mixed)
+static int64_t messaging_write_out(const int socket, const char *data, size_t len){
+	if(messaging_custom_writer != NULL){
+		return messaging_custom_writer(socket, data, len);
+	}
+	pthread_mutex_t *lock = messaging_lock_socket(socket);
+	int64_t err = bulk_write(socket, (char*)data, len);
+	messaging_unlock_socket(lock);
+	return err;
+}
+
+//Write data in compressed blocks
+static int64_t messaging_write_compressed(const int socket, const char *data, size_t len){
+	char *blocks = (char*)malloc(zblock_bound(len));
+	if(blocks == NULL){
+		fprintf(stderr, "[ERR] Internal error: malloc failed (%s:%d)\n", __FILE__, __LINE__);
+		return -1;
+	}
+	int64_t size	= zblock_encode(data, len, blocks, messaging_dictionary, sizeof(messaging_dictionary) - 1);
+	int64_t err		= (size < 0) ? -1 : messaging_write_out(socket, blocks, size);
+	free(blocks);
+	return err;
+}
+
+int64_t messaging_write(const int socket, const char *data, size_t len){
+	if(socket < 0){
+		return -1;
+	}
+	if(socket == messaging_batch_socket){
+		if(messaging_batch_size + len > messaging_batch_capacity){
+			size_t capacity = (messaging_batch_capacity == 0) ? MSG_BATCH_SIZE : messaging_batch_capacity;
+			while(capacity < messaging_batch_size + len){
+				capacity *= 2;
+			}
+			char *data = (char*)realloc(messaging_batch_data, capacity);
+			if(data == NULL){
+				fprintf(stderr, "[ERR] Internal error: realloc failed (%s:%d)\n", __FILE__, __LINE__);
+				return -1;
+			}
+			messaging_batch_data		= data;
+			messaging_batch_capacity	= capacity;
+		}
+		memcpy(messaging_batch_data + messaging_batch_size, data, len);
+		messaging_batch_size += len;
+		return len;
+	}
+	if(messaging_is_compressed(socket) == 1){
+		return messaging_write_compressed(socket, data, len);
+	}
+	return messaging_write_out(socket, data, len);
+}
+
+int64_t messaging_write_frame(const int socket, SharedBuffer *frame){
+	if(socket == messaging_batch_socket || messaging_is_compressed(socket) == 0){
+		return messaging_write(socket, frame->data, frame->size);
+	}
+	//First compressed receiver encodes it for the others
+	SharedBuffer *blocks = frame->variant;
+	if(blocks == NULL){
+		blocks = sharedbuf_create(zblock_bound(frame->size));
+		if(blocks == NULL){
+			return messaging_write_compressed(socket, frame->data, frame->size);
+		}
+		blocks->size	= zblock_encode(frame->data, frame->size, blocks->data,
+										messaging_dictionary, sizeof(messaging_dictionary) - 1);
+		blocks			= sharedbuf_set_variant(frame, blocks);
+	}
+	return messaging_write_out(socket, blocks->data, blocks->size);
+}
+
+int64_t messaging_write_file(const int socket, const int fd, off_t offset, size_t len){
+	if(socket < 0 || fd < 0){
+		return -1;
+	}
+	//Data must be read to be compressed or kept
+	if(socket == messaging_batch_socket || messaging_is_compressed(socket) == 1){
+		char	*data = (char*)malloc(len);
+		ssize_t	c;
+		size_t	done = 0;
+		if(data == NULL){
+			fprintf(stderr, "[ERR] Internal error: malloc failed (%s:%d)\n", __FILE__, __LINE__);
+			return -1;
+		}
+		while(done < len && (c = TEMP_FAILURE_RETRY(pread(fd, data + done, len - done, offset + done))) > 0){
+			done += c;
+		}
+		int64_t err = (done == len) ? messaging_write(socket, data, len) : -1;
+		free(data);
+		return err;
+	}
+	if(messaging_custom_file_writer != NULL){
+		return messaging_custom_file_writer(socket, fd, offset, len);
+	}
+	pthread_mutex_t *lock = messaging_lock_socket(socket);
+	int64_t err = bulk_sendfile(socket, fd, offset, len);
+	messaging_unlock_socket(lock);
+	return err;
+}
+
+int messaging_set_compression(const int socket, const int enabled){
+	if(socket < 0 || socket >= MSG_MAX_COMPRESSED_FD){
+		return (enabled == 0) ? 1 : -1;
+	}
+	messaging_compressed[socket] = (enabled == 0) ? 0 : 1;
+	return 1;
+}
+
+int messaging_is_compressed(const int socket){
+	if(socket < 0 || socket >= MSG_MAX_COMPRESSED_FD){
+		return 0;
+	}
+	return messaging_compressed[socket];
+}
+
+const char* messaging_compression_dictionary(size_t *len){
+	*len = sizeof(messaging_dictionary) - 1;
+	return messaging_dictionary;
+}
+
+int messaging_split(char *msg, char **fields){
+	int k, nb = scan_split(msg, MSG_DELIMITER, fields, MSG_MAX_FIELDS);
+	for(k=0; k<MSG_MAX_FIELDS; k++){
+		if(k >= nb || fields[k][0] == '\0'){
+			fields[k] = NULL;
+		}
+	}
+	return nb;
+}
+
+void messaging_request_begin(const int socket, const unsigned int id){
+	messaging_request_socket	= socket;
+	messaging_request_id		= id;
+	messaging_request_nb_tagged	= 0;
+}
+
+void messaging_request_end(void){
+	messaging_request_socket	= -1;
+	messaging_request_id		= 0;
+}
+
+int messaging_request_tagged(void){
+	return (messaging_request_nb_tagged > 0) ? 1 : 0;
+}
+
+unsigned int messaging_request_parse(char *type){
+	char *id = strchr(type, MSG_REQUEST_ID);
+	if(id == NULL){
+		return 0;
+	}
+	*id = '\0';
+	return (unsigned int)strtoul(id + 1, NULL, 10);
+}
+
+int64_t messaging_time_parse(char *type){
+	char *time = strchr(type, MSG_TIME);
+	if(time == NULL){
+		return 0;
+	}
+	*time = '\0';
+	return (int64_t)strtoll(time + 1, NULL, 10);
+}
+
+uint64_t messaging_seq_parse(char *type){
+	char *seq = strchr(type, MSG_SEQ);
+	if(seq == NULL){
+		return 0;
+	}
+	*seq = '\0';
+	return (uint64_t)strtoull(seq + 1, NULL, 10);
+}
+
+int messaging_batch_begin(const int socket){
+	if(messaging_batch_socket >= 0){
+		return -1;
+	}
+	messaging_batch_socket	= socket;
+	messaging_batch_size	= 0;
+	return 1;
+}
+
+int64_t messaging_batch_end(void){
+	int socket				= messaging_batch_socket;
+	messaging_batch_socket	= -1;
+	if(socket < 0 || messaging_batch_size == 0){
+		return 0;
+	}
+	int64_t err = messaging_write(socket, messaging_batch_data, messaging_batch_size);
+	messaging_batch_size = 0;
+	return err;
+}
+
+int messaging_hold(const int socket){
+	if(socket < 0){
+		return -1;
+	}
+	if(messaging_custom_hold != NULL){
+		return messaging_custom_hold(socket);
+	}
+	//Default: lock of the socket is kept, others wait to write on it
+	if(messaging_held_lock != NULL){
+		return -1;
+	}
+	messaging_held_lock = messaging_lock_socket(socket);
+	return 1;
+}
+
+void messaging_release(const int socket){
+	if(messaging_custom_release != NULL){
+		messaging_custom_release(socket);
+	}
+	else if(messaging_held_lock != NULL){
+		pthread_mutex_unlock(messaging_held_lock);
+		messaging_held_lock = NULL;
+	}
+}
+
+int messaging_wait_sent(const int socket, const int timeout){
+	if(socket < 0){
+		return -1;
+	}
+	//Default: frames are written at once (Error already returned by the write)
+	return (messaging_custom_wait == NULL) ? 1 : messaging_custom_wait(socket, timeout);
+}
+
+SharedBuffer* messaging_encode_room_bdcast(const char* sender, const char* room, const char *msg,
+											const int64_t time, const uint64_t seq){
+	//Same order as messaging_send_room_bdcast (Time and number after the type)
+	size_t size = strlen(MSG_TYPE_ROOM_BDCAST) + 42 + strlen(msg) + strlen(room) + strlen(sender)
+				+ 3*strlen(MSG_DELIMITER) + 1; //42: "@time+seq"
+	SharedBuffer *frame = sharedbuf_create(size);
+	if(frame == NULL){
+		return NULL;
+	}
+	frame->size = sprintf(frame->data, "%s%c%lld%c%llu%s%s%s%s%s%s", MSG_TYPE_ROOM_BDCAST, MSG_TIME, (long long)time,
+			MSG_SEQ, (unsigned long long)seq, MSG_DELIMITER, msg, MSG_DELIMITER, room, MSG_DELIMITER, sender) + 1;
+	return frame;
+}
+
+SharedBuffer* messaging_encode_whisper(const char *sender, const char *receiver, const char *msg, const int64_t time){
+	//Same order as messaging_send_whisper (Time after the type)
+	size_t size = strlen(MSG_TYPE_WHISPER) + 21 + strlen(sender) + strlen(receiver) + strlen(msg)
+				+ 3*strlen(MSG_DELIMITER) + 1; //21: "@time"
+	SharedBuffer *frame = sharedbuf_create(size);
+	if(frame == NULL){
+		return NULL;
+	}
+	frame->size = sprintf(frame->data, "%s%c%lld%s%s%s%s%s%s", MSG_TYPE_WHISPER, MSG_TIME, (long long)time,
+			MSG_DELIMITER, sender, MSG_DELIMITER, receiver, MSG_DELIMITER, msg) + 1;
+	return frame;
+}
+
 
 // -----------------------------------------------------------------------------
 // User messages
 // -----------------------------------------------------------------------------
 
-int messaging_send_connect(const int socket, const char *name){
-	return messaging_sender(socket, MSG_TYPE_CONNECT, 1, strlen(name), name);
+int messaging_send_connect(const int socket, const char *name, const char *compression){
+	if(compression == NULL){
+		return messaging_sender(socket, MSG_TYPE_CONNECT, 1, strlen(name), name);
+	}
+	int size = strlen(name) + strlen(compression);
+	return messaging_sender(socket, MSG_TYPE_CONNECT, 2, size, name, compression);
 }
 int messaging_send_bye(const int socket){
 	return messaging_sender(socket, MSG_TYPE_DISCONNECT, 0, 0);
@@ -46,6 +381,12 @@ int messaging_send_whisper(const int socket, const char *sender, const char *rec
 	int size = strlen(sender) + strlen(receiver) + strlen(msg);
 	return messaging_sender(socket, MSG_TYPE_WHISPER, 3, size, sender, receiver, msg);
 }
+int messaging_send_ping(const int socket){
+	return messaging_sender(socket, MSG_TYPE_PING, 0, 0);
+}
+int messaging_send_pong(const int socket){
+	return messaging_sender(socket, MSG_TYPE_PONG, 0, 0);
+}
 
 
 // -----------------------------------------------------------------------------
@@ -69,6 +410,66 @@ int messaging_send_room_bdcast(const int socket, const char* sender, const char*
 	int size = strlen(sender) + strlen(room) + strlen(msg);
 	return messaging_sender(socket, MSG_TYPE_ROOM_BDCAST, 3, size, msg, room, sender);
 }
+int messaging_send_rooms(const int socket){
+	return messaging_sender(socket, MSG_TYPE_ROOMS, 0, 0);
+}
+int messaging_send_rooms_page(const int socket, const char *prefix, const char *after){
+	int size = strlen(prefix) + strlen(after);
+	return messaging_sender(socket, MSG_TYPE_ROOMS_PAGE, 2, size, prefix, after);
+}
+int messaging_send_rooms_page_result(const int socket, const size_t nb_left, const char *last, const char *rooms){
+	char str_nb[24];
+	sprintf(str_nb, "%lu", (unsigned long)nb_left);
+	int size = strlen(str_nb) + strlen(last) + strlen(rooms);
+	return messaging_sender(socket, MSG_TYPE_ROOMS_PAGE, 3, size, str_nb, last, rooms);
+}
+int messaging_send_history(const int socket, const char *since){
+	return messaging_sender(socket, MSG_TYPE_HISTORY, 1, strlen(since), since);
+}
+int messaging_send_search(const int socket, const char *room, const char *terms){
+	int size = strlen(room) + strlen(terms);
+	return messaging_sender(socket, MSG_TYPE_SEARCH, 2, size, room, terms);
+}
+int messaging_send_resume(const int socket, const char *room, const char *seq){
+	int size = strlen(room) + strlen(seq);
+	return messaging_sender(socket, MSG_TYPE_RESUME, 2, size, room, seq);
+}
+
+
+// -----------------------------------------------------------------------------
+// Cluster messages
+// -----------------------------------------------------------------------------
+
+int messaging_send_node_hello(const int socket, const char *name, const char *address, const char *secret){
+	int size = strlen(name) + strlen(address) + strlen(secret);
+	return messaging_sender(socket, MSG_TYPE_NODE_HELLO, 3, size, name, address, secret);
+}
+int messaging_send_node_user(const int socket, const char *login, const char *room){
+	int size = strlen(login) + strlen(room);
+	return messaging_sender(socket, MSG_TYPE_NODE_USER, 2, size, login, room);
+}
+int messaging_send_node_user_gone(const int socket, const char *login){
+	return messaging_sender(socket, MSG_TYPE_NODE_USER_GONE, 1, strlen(login), login);
+}
+int messaging_send_node_room(const int socket, const char *name, const char *owner){
+	int size = strlen(name) + strlen(owner);
+	return messaging_sender(socket, MSG_TYPE_NODE_ROOM, 2, size, name, owner);
+}
+int messaging_send_node_room_gone(const int socket, const char *name){
+	return messaging_sender(socket, MSG_TYPE_NODE_ROOM_GONE, 1, strlen(name), name);
+}
+int messaging_send_node_bdcast(const int socket, const char *room, const char *sender, const char *msg,
+								const int64_t time, const uint64_t seq){
+	//Frame of the home node: delivered as it is (Time and number after the type)
+	char type[64];
+	sprintf(type, "%s%c%lld%c%llu", MSG_TYPE_NODE_BDCAST, MSG_TIME, (long long)time, MSG_SEQ, (unsigned long long)seq);
+	int size = strlen(room) + strlen(sender) + strlen(msg);
+	return messaging_sender(socket, type, 3, size, room, sender, msg);
+}
+int messaging_send_node_whisper(const int socket, const char *sender, const char *receiver, const char *msg){
+	int size = strlen(sender) + strlen(receiver) + strlen(msg);
+	return messaging_sender(socket, MSG_TYPE_NODE_WHISPER, 3, size, sender, receiver, msg);
+}
 
 
 // -----------------------------------------------------------------------------
@@ -93,28 +494,37 @@ static int messaging_sender(const int socket, const char *cmd, const int nb, con
 	//Prepare elements
 	int		k;
 	char	*ptr		= NULL;
-	size_t	buffer_size	= strlen(cmd) + size_fmt + (nb*strlen(MSG_DELIMITER)) + 1;
+	size_t	buffer_size	= strlen(cmd) + 11 + size_fmt + (nb*strlen(MSG_DELIMITER)) + 1; //11: "#id"
 	char	*buffer		= (char*)malloc(sizeof(char)*buffer_size);
 	//Check if malloc failed.
 	if(buffer == NULL){
 		fprintf(stderr, "[ERR] Internal error: malloc failed (%s:%d)\n", __FILE__, __LINE__);
 		return -1;
 	}
-	//Add cmd in first place in buffer
-	strcpy(buffer, cmd);
+	//Add cmd in first place in buffer (With the request id if sent for a request)
+	size_t size = strlen(cmd);
+	memcpy(buffer, cmd, size);
+	if(socket == messaging_request_socket && messaging_request_id != 0){
+		size += sprintf(buffer + size, "%c%u", MSG_REQUEST_ID, messaging_request_id);
+		messaging_request_nb_tagged++;
+	}
 
-	//Add each agurment (With MSG_DELIMITER before it)
-	va_list args;
+	//Add each agurment (With MSG_DELIMITER before it). Sizes are known, no strcat.
+	size_t	delim_size = strlen(MSG_DELIMITER), len;
+	va_list	args;
 	va_start(args, size_fmt);
 	for(k=0; k<nb; k++){
 		ptr = va_arg(args, char*);
-		strcat(buffer, MSG_DELIMITER);
-		strcat(buffer, ptr);
+		len = strlen(ptr);
+		memcpy(buffer + size, MSG_DELIMITER, delim_size);
+		memcpy(buffer + size + delim_size, ptr, len);
+		size += delim_size + len;
 	}
 	va_end(args);
+	buffer[size] = '\0';
 
-	//Send message and free buffer
-	bulk_write(socket, buffer, strlen(buffer));
+	//Send message (With its '\0', used as frame delimiter) and free buffer
+	messaging_write(socket, buffer, size + 1);
 	free(buffer);
 	return 1;
 }
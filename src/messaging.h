@@ -19,14 +19,37 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdarg.h> //For variable list of function arguments
+#include <pthread.h>
 #include "wunixlib/stream.h"
+#include "wunixlib/sharedbuf.h"
+#include "wunixlib/scan.h"
+#include "wunixlib/zblock.h"
 
 #define MSG_DELIMITER ";;;"
+#define MSG_NB_WRITE_LOCKS 64 //Frames sent on one socket are never mixed (Lock per fd % nb)
+#define MSG_REQUEST_ID '#' //Optional request id after the message type ("open#12"), echoed in replies
+#define MSG_TIME '@' //Server time after the type of room messages ("bdcast@1468400000000", ms since epoch)
+#define MSG_SEQ '+' //Number of a room message after its time ("bdcast@1468400000000+42", see MSG_TYPE_RESUME)
+#define MSG_MAX_FIELDS 4 //Type and arguments of a message (Last one keeps the rest)
+#define MSG_BATCH_SIZE 4096 //First size of the buffer of a batch (Grows if needed)
+#define MSG_MAX_COMPRESSED_FD 65536 //Sockets above can't be compressed
+#define MSG_COMPRESS_DEFLATE "deflate" //Compression asked by client in connect message
+
+// Each message is sent with its '\0' (Used as frame delimiter on the stream)
+// Any request may have an id chosen by client ("type#id"). Server echoes it in
+// each reply to this request, or sends MSG_CONF_ACK if request has no reply.
+// Client may ask compression in connect message ("connect;;;name;;;deflate").
+// If accepted, server sends MSG_CONF_COMPRESS, then every following byte it
+// sends is in compressed blocks (See zblock.h, dictionary is shared by both sides).
 
 // List of possible error value
 #define MSG_ERR_CONNECT "msg_err_connect"
 #define MSG_ERR_UNKOWN_USER "msg_err_unknown_user"
 #define MSG_ERR_GENERAL "msg_err_general"
+#define MSG_ERR_THROTTLE "msg_err_throttle"
+#define MSG_ERR_REPEAT "msg_err_repeat" //Same message sent recently
+#define MSG_ERR_FILTERED "msg_err_filtered" //Message has a banned term
+#define MSG_ERR_REDIRECT "msg_err_redirect" //Message is the address of the server hosting the room
 
 // List of possible confirm value
 #define MSG_CONF_REGISTER "msg_conf_register"
@@ -34,26 +57,44 @@
 #define MSG_CONF_ROOM_ENTER "msg_conf_room_enter"
 #define MSG_CONF_ROOM_CLOSE "msg_conf_room_close"
 #define MSG_CONF_DISCONNECT "msg_conf_disconnect"
+#define MSG_CONF_ACK "msg_conf_ack" //Request with an id processed without any other reply
+#define MSG_CONF_COMPRESS "msg_conf_compress" //Next data from server is compressed
+#define MSG_CONF_SEARCH "msg_conf_search" //Number of messages found (Messages follow)
+#define MSG_CONF_MAILBOX "msg_conf_mailbox" //Number of whispers received while offline (Whispers follow)
+#define MSG_CONF_RESUME "msg_conf_resume" //Number of the last message of the room (Missed messages follow)
+#define MSG_CONF_HISTORY "msg_conf_history" //Number of the first message left once max is sent (After the messages)
 
 // List of possible message type
 #define MSG_TYPE_CONNECT "connect"
 #define MSG_TYPE_DISCONNECT "bye"
 #define MSG_TYPE_WHISPER "whisper"
+#define MSG_TYPE_PING "ping"
+#define MSG_TYPE_PONG "pong"
 
 #define MSG_TYPE_ROOM_OPEN "open"
 #define MSG_TYPE_ROOM_CLOSE "close"
 #define MSG_TYPE_ROOM_ENTER "enter"
 #define MSG_TYPE_ROOM_LEAVE "leave"
 #define MSG_TYPE_ROOM_BDCAST "bdcast"
+#define MSG_TYPE_ROOMS "rooms" //List of rooms ("name:nb_users," for each room)
+#define MSG_TYPE_ROOMS_PAGE "rooms_page" //Request: prefix, last room of previous page (Optional). Answer: nb rooms left after, last room, rooms
+#define MSG_ROOMS_ALL "*" //Prefix matching all rooms
+#define MSG_TYPE_HISTORY "history" //Request: time (ms), or MSG_SEQ and number ("+42"). Answer: room messages since it, then MSG_CONF_HISTORY if some are left
+#define MSG_TYPE_SEARCH "search" //Request: room, terms. Answer: MSG_CONF_SEARCH then room messages
+#define MSG_TYPE_RESUME "resume" //Request: room, number of last message received. Enter room, answer: MSG_CONF_RESUME then messages after it
+
+// List of messages between servers of a cluster (See cluster.h)
+#define MSG_TYPE_NODE_HELLO "node_hello" //Node name, address for clients, secret of the cluster
+#define MSG_TYPE_NODE_USER "node_user" //Login, room (User added or moved)
+#define MSG_TYPE_NODE_USER_GONE "node_user_gone" //Login
+#define MSG_TYPE_NODE_ROOM "node_room" //Room name, owner name
+#define MSG_TYPE_NODE_ROOM_GONE "node_room_gone" //Room name
+#define MSG_TYPE_NODE_BDCAST "node_bdcast" //Room, sender, message (Time and number after the type, see MSG_SEQ)
+#define MSG_TYPE_NODE_WHISPER "node_whisper" //Sender, receiver, message
 
 #define MSG_TYPE_CONFIRM "confirm"
 #define MSG_TYPE_ERROR "error"
 
-typedef struct _room_bdcast_params{
-	char* user_name;
-	char* room_name;
-	char* msg;
-} bdcast_params;
 
 // -----------------------------------------------------------------------------
 // Send functions
@@ -66,10 +107,237 @@ typedef struct _room_bdcast_params{
 // Warning: atm, any parameter test is done and parameter should be valid (Not null etc)
 // -----------------------------------------------------------------------------
 
+/** \brief Function writing a whole frame (See messaging_set_writer). */
+typedef int64_t(*messaging_writer)(int socket, const char *data, size_t len);
+
+/** \brief Function sending part of a file (See messaging_set_writer). */
+typedef int64_t(*messaging_file_writer)(int socket, int fd, off_t offset, size_t len);
+
+/**
+ * \brief			Set the functions used to write frames (Like an outbox).
+ * \details			By default, frames are written at once. The writer must
+ * 					never mix frames written on the same socket by several threads.
+ * 					File writer must keep the order of data given to writer.
+ *
+ * \param writer		Function used by messaging_write (NULL for default)
+ * \param file_writer	Function used by messaging_write_file (NULL for default)
+ */
+void messaging_set_writer(messaging_writer writer, messaging_file_writer file_writer);
+
+/** \brief Function holding or releasing the frames of a socket (See messaging_set_holder). */
+typedef int(*messaging_holder)(int socket);
+
+/**
+ * \brief			Set the functions used to hold frames (Like an outbox).
+ * \details			See messaging_hold. By default, lock of the socket is kept.
+ *
+ * \param hold		Function used by messaging_hold (NULL for default)
+ * \param release	Function used by messaging_release
+ */
+void messaging_set_holder(messaging_holder hold, messaging_holder release);
+
+/** \brief Function waiting until the frames of a socket are sent (See messaging_set_waiter). */
+typedef int(*messaging_waiter)(int socket, const int timeout);
+
+/**
+ * \brief			Set the function used to wait for frames kept (Like an outbox).
+ * \details			See messaging_wait_sent. By default, frames are sent at once.
+ *
+ * \param wait		Function used by messaging_wait_sent (NULL for default)
+ */
+void messaging_set_waiter(messaging_waiter wait);
+
+/**
+ * \brief			Write a whole frame on the socket.
+ * \details			Can be called from any thread: frames written on the same
+ * 					socket by several threads are never mixed.
+ *
+ * \param socket	Socket where to write
+ * \param data		Frame (With its '\0')
+ * \param len		Frame size
+ * \return			Number of bytes written or -1 if error
+ */
+int64_t messaging_write(const int socket, const char *data, size_t len);
+
+/**
+ * \brief			Write a shared frame on the socket.
+ * \details			Same as messaging_write, but a frame sent to many compressed
+ * 					sockets is compressed only once (Kept with the frame).
+ *
+ * \param socket	Socket where to write
+ * \param frame		Frame (With its '\0')
+ * \return			Number of bytes written or -1 if error
+ */
+int64_t messaging_write_frame(const int socket, SharedBuffer *frame);
+
+/**
+ * \brief			Write frames saved in a file on the socket.
+ * \details			Sent by the kernel from the file (No copy in user space),
+ * 					unless data must be compressed or kept in a batch.
+ *
+ * \param socket	Socket where to write
+ * \param fd		File with the frames
+ * \param offset	Position of the first frame in file
+ * \param len		Number of bytes to send (Whole frames)
+ * \return			Number of bytes sent or -1 if error
+ */
+int64_t messaging_write_file(const int socket, const int fd, off_t offset, size_t len);
+
+/**
+ * \brief			Compress or not the data written on the socket from now.
+ * \details			Must be changed when no other thread writes on the socket.
+ *
+ * \param socket	Socket concerned
+ * \param enabled	1 to compress, 0 to send data as it is
+ * \return			1 if success, otherwise, -1 (Socket can't be compressed)
+ */
+int messaging_set_compression(const int socket, const int enabled);
+
+/**
+ * \brief			Check whether data written on the socket is compressed.
+ *
+ * \param socket	Socket to check
+ * \return			1 if compressed, otherwise, 0
+ */
+int messaging_is_compressed(const int socket);
+
+/**
+ * \brief			Preset dictionary used by both sides for compressed blocks.
+ *
+ * \param len		Set to the size of dictionary
+ * \return			The dictionary
+ */
+const char* messaging_compression_dictionary(size_t *len);
+
+/**
+ * \brief			Split a received message in type and arguments.
+ * \details			Missing or empty arguments are NULL.
+ * \warning			Message is altered (Fields point in it).
+ *
+ * \param msg		Message to split
+ * \param fields	Where to place type and arguments (MSG_MAX_FIELDS)
+ * \return			Number of fields found
+ */
+int messaging_split(char *msg, char **fields);
+
+/**
+ * \brief			Tag frames sent on the socket by this thread with a request id.
+ * \details			Client tags its request, server tags the replies of this
+ * 					request (Until messaging_request_end).
+ *
+ * \param socket	Socket of the request
+ * \param id		Request id (0 for no id)
+ */
+void messaging_request_begin(const int socket, const unsigned int id);
+
+/**
+ * \brief			Stop tagging frames of this thread (See messaging_request_begin).
+ */
+void messaging_request_end(void);
+
+/**
+ * \brief			Check whether a frame was tagged since messaging_request_begin.
+ *
+ * \return			1 if a frame was tagged with the request id, otherwise, 0
+ */
+int messaging_request_tagged(void);
+
+/**
+ * \brief			Remove the request id from a received message type.
+ *
+ * \param type		Message type (First token of the frame, altered)
+ * \return			Request id or 0 if none
+ */
+unsigned int messaging_request_parse(char *type);
+
+/**
+ * \brief			Remove the time from a received message type.
+ *
+ * \param type		Message type (First token of the frame, altered)
+ * \return			Time (ms since epoch) or 0 if none
+ */
+int64_t messaging_time_parse(char *type);
+
+/**
+ * \brief			Remove the sequence number from a received message type.
+ * \details			Must be called before messaging_time_parse (Number is after the time).
+ *
+ * \param type		Message type (First token of the frame, altered)
+ * \return			Sequence number or 0 if none
+ */
+uint64_t messaging_seq_parse(char *type);
+
+/**
+ * \brief			Keep frames written on the socket by this thread.
+ * \details			Frames are written in one call by messaging_batch_end.
+ * 					Frames for other sockets are written at once.
+ *
+ * \param socket	Socket where frames are kept
+ * \return			1 if success, otherwise, -1 (Batch already started)
+ */
+int messaging_batch_begin(const int socket);
+
+/**
+ * \brief			Write all frames kept since messaging_batch_begin.
+ *
+ * \return			Number of bytes written or -1 if error
+ */
+int64_t messaging_batch_end(void);
+
+/**
+ * \brief			Send frames written by this thread before frames of others.
+ * \details			Frames written on the socket by other threads from now
+ * 					wait until messaging_release. Frames of this thread
+ * 					are written at once (Even later, without lock).
+ * 					By default (See messaging_set_holder), lock of the
+ * 					socket is kept: others wait on it to write.
+ *
+ * \param socket	Socket to hold
+ * \return			1 if held, -1 if thread already holds a socket
+ */
+int messaging_hold(const int socket);
+
+/**
+ * \brief			Write the frames of other threads kept since messaging_hold.
+ *
+ * \param socket	Socket held by this thread
+ */
+void messaging_release(const int socket);
+
+/**
+ * \brief			Wait until frames written on the socket are sent (Not only kept).
+ * \details			Frames written by other threads after may be kept still.
+ *
+ * \param socket	Socket to wait for
+ * \param timeout	Max time to wait in ms
+ * \return			1 if sent, -1 if timeout or connection lost
+ */
+int messaging_wait_sent(const int socket, const int timeout);
+
+/**
+ * \brief			Prepare a room broadcast frame once for all receivers.
+ *
+ * \param time		Time of the message (ms since epoch)
+ * \param seq		Number of the message in the room
+ * \return			Frame (One reference) or NULL if malloc failed
+ */
+SharedBuffer* messaging_encode_room_bdcast(const char* sender, const char* room, const char *msg,
+											const int64_t time, const uint64_t seq);
+
+/**
+ * \brief			Prepare a whisper frame with its time (Sent later).
+ *
+ * \param time		Time of the message (ms since epoch)
+ * \return			Frame (One reference) or NULL if malloc failed
+ */
+SharedBuffer* messaging_encode_whisper(const char *sender, const char *receiver, const char *msg, const int64_t time);
+
 //User messages
-int messaging_send_connect(const int socket, const char *name);
+int messaging_send_connect(const int socket, const char *name, const char *compression); //Compression may be NULL
 int messaging_send_bye(const int socket);
 int messaging_send_whisper(const int socket, const char *sender, const char *receiver, const char *msg);
+int messaging_send_ping(const int socket);
+int messaging_send_pong(const int socket);
 
 //Room messages
 int messaging_send_room_open(const int socket, const char *name);
@@ -77,6 +345,22 @@ int messaging_send_room_close(const int socket, const char *name);
 int messaging_send_room_enter(const int socket, const char *name);
 int messaging_send_room_leave(const int socket);
 int messaging_send_room_bdcast(const int socket, const char* sender, const char* room, const char *msg);
+int messaging_send_rooms(const int socket);
+int messaging_send_rooms_page(const int socket, const char *prefix, const char *after);
+int messaging_send_rooms_page_result(const int socket, const size_t nb_left, const char *last, const char *rooms);
+int messaging_send_history(const int socket, const char *since);
+int messaging_send_search(const int socket, const char *room, const char *terms);
+int messaging_send_resume(const int socket, const char *room, const char *seq);
+
+//Cluster messages
+int messaging_send_node_hello(const int socket, const char *name, const char *address, const char *secret);
+int messaging_send_node_user(const int socket, const char *login, const char *room);
+int messaging_send_node_user_gone(const int socket, const char *login);
+int messaging_send_node_room(const int socket, const char *name, const char *owner);
+int messaging_send_node_room_gone(const int socket, const char *name);
+int messaging_send_node_bdcast(const int socket, const char *room, const char *sender, const char *msg,
+								const int64_t time, const uint64_t seq);
+int messaging_send_node_whisper(const int socket, const char *sender, const char *receiver, const char *msg);
 
 //Asset messages
 int messaging_send_confirm(const int socket, char *type, const char *msg);
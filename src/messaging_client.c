@@ -22,6 +22,31 @@ static int messaging_client_receiv_confirm(ClientData *client, char* type, const
 		commands_welcome_menu(msg);
 		return 1;
 	}
+	else if(strcmp(type, MSG_CONF_COMPRESS) == 0){
+		client->compressed = 1; //Next data is decoded by the listener
+		return 1;
+	}
+	else if(strcmp(type, MSG_CONF_SEARCH) == 0){
+		fprintf(stdout, "\nSearch: %s messages found\n", msg); //Messages follow
+		return 1;
+	}
+	else if(strcmp(type, MSG_CONF_MAILBOX) == 0){
+		fprintf(stdout, "\n%s whispers received while offline\n", msg); //Whispers follow
+		return 1;
+	}
+	else if(strcmp(type, MSG_CONF_RESUME) == 0){
+		fprintf(stdout, "\nResumed (Last message is %s), missed messages:\n", msg); //Messages follow
+		return 1;
+	}
+	else if(strcmp(type, MSG_CONF_HISTORY) == 0){
+		//Server sent its max: next messages are asked from the first one left
+		char from[32];
+		if(msg != NULL && isdigit((unsigned char)msg[0]) && strlen(msg) < sizeof(from) - 1){
+			sprintf(from, "%c%s", MSG_SEQ, msg);
+			messaging_send_history(client->socket, from);
+		}
+		return 1;
+	}
 	else if(strcmp(type, MSG_CONF_ROOM_ENTER) == 0){
 		//TODO could change the current room name in local
 	}
@@ -44,6 +69,15 @@ static int messaging_client_receiv_error(ClientData *client, char *type, char *m
 		fprintf(stderr, "\nUnable to connect: %s\n", msg);
 		client->status = DISCONNECTED;
 	}
+	//MSG_ERR_REDIRECT (Room is on another server of the cluster)
+	else if(strcmp(type, MSG_ERR_REDIRECT) == 0 && msg != NULL){
+		char *port = strrchr(msg, ':');
+		if(port != NULL){
+			*port = '\0';
+			fprintf(stderr, "\nThis room is hosted by another server: !bye then !connect %s@%s %s\n",
+					client->login, msg, port + 1);
+		}
+	}
 	//DEFAULT
 	else{
 		fprintf(stderr, "\nError message: %s\n", msg);
@@ -51,6 +85,61 @@ static int messaging_client_receiv_error(ClientData *client, char *type, char *m
 	return 1;
 }
 
+static int messaging_client_receiv_rooms(ClientData *client, char *rooms){
+	//Each room is 'name:nb_users,'
+	char *room = (rooms == NULL) ? NULL : strtok(rooms, ",");
+	while(room != NULL){
+		char *sep = strrchr(room, ':');
+		if(sep != NULL){
+			*sep = '\0';
+			fprintf(stdout, "\t%s (%s users)\n", room, sep + 1);
+		}
+		room = strtok(NULL, ",");
+	}
+	return 1;
+}
+
+static int messaging_client_receiv_bdcast(ClientData *client, const int64_t time, const uint64_t seq,
+											const char *room, const char *sender, const char *msg){
+	//Last message received, for !resume after a reconnect
+	if(seq > 0 && room != NULL && strlen(room) <= ROOM_MAX_SIZE){
+		if(strcmp(client->last_room, room) != 0 || seq > client->last_seq){
+			client->last_seq = seq;
+		}
+		strcpy(client->last_room, room);
+	}
+	//Time given by the server is shown (Local time of the message)
+	if(time <= 0){
+		fprintf(stdout, "\nroom %s [%s]: %s\n", room, sender, msg);
+		return 1;
+	}
+	char		hour[16] = "";
+	struct tm	tm;
+	time_t		sec = (time_t)(time / 1000);
+	if(localtime_r(&sec, &tm) != NULL){
+		strftime(hour, sizeof(hour), "%H:%M:%S", &tm);
+	}
+	fprintf(stdout, "\n%s room %s [%s]: %s\n", hour, room, sender, msg);
+	return 1;
+}
+
+
+static int messaging_client_receiv_whisper(const int64_t time, const char *sender, const char *msg){
+	//Time is shown for whispers received while offline (Local time of the message)
+	if(time <= 0){
+		fprintf(stdout, "\nwhisper [%s]: '%s'\n", sender, msg);
+		return 1;
+	}
+	char		hour[16] = "";
+	struct tm	tm;
+	time_t		sec = (time_t)(time / 1000);
+	if(localtime_r(&sec, &tm) != NULL){
+		strftime(hour, sizeof(hour), "%H:%M:%S", &tm);
+	}
+	fprintf(stdout, "\n%s whisper [%s]: '%s'\n", hour, sender, msg);
+	return 1;
+}
+
 
 // -----------------------------------------------------------------------------
 // Receive process Functions
@@ -60,33 +149,65 @@ int messaging_exec_client_receive(ClientData *client, const int socket, char *ms
 	if(msg == NULL){ return -1; }
 
 	//Recover the type of message (First element in msg, must be not NULL)
-	char *token = strtok(msg, MSG_DELIMITER);
+	char *fields[MSG_MAX_FIELDS];
+	messaging_split(msg, fields);
+	char *token = fields[0];
 	if(token == NULL){ return -1; }
 
+	//First reply of a request: show the request if sent by a script
+	ClientRequest request;
+	uint64_t seq = messaging_seq_parse(token);
+	int64_t time = messaging_time_parse(token);
+	unsigned int id = messaging_request_parse(token);
+	int64_t latency = client_data_take_request(client, id, &request);
+	if(latency >= 0 && request.batched == 1){
+		fprintf(stdout, "\n[#%u] %s (%.3f ms)", id, request.cmd, latency / 1000.0);
+	}
+
 	// Asset messages
 	if(strcmp(token, MSG_TYPE_CONFIRM) == 0){
-		char *type	= strtok(NULL, MSG_DELIMITER);
-		char *msg	= strtok(NULL, MSG_DELIMITER);
+		char *type	= fields[1];
+		char *msg	= fields[2];
 		messaging_client_receiv_confirm(client, type, msg);
 	}
 	else if(strcmp(token, MSG_TYPE_ERROR) == 0){
-		char *type	= strtok(NULL, MSG_DELIMITER);
-		char *msg	= strtok(NULL, MSG_DELIMITER);
+		char *type	= fields[1];
+		char *msg	= fields[2];
 		messaging_client_receiv_error(client, type, msg);
 	}
+	//Server checks whether we are still here
+	else if(strcmp(token, MSG_TYPE_PING) == 0){
+		messaging_send_pong(socket);
+	}
 	//User message
 	else if(strcmp(token, MSG_TYPE_WHISPER) == 0){
-		char *sender	= strtok(NULL, MSG_DELIMITER);
-		char *receiver	= strtok(NULL, MSG_DELIMITER);
-		char *msg		= strtok(NULL, MSG_DELIMITER);
-		fprintf(stdout, "\nwhisper [%s]: '%s'\n", sender, msg);
+		char *sender	= fields[1];
+		char *receiver	= fields[2];
+		char *msg		= fields[3];
+		messaging_client_receiv_whisper(time, sender, msg);
 	}
 	//Room messages
 	else if(strcmp(token, MSG_TYPE_ROOM_BDCAST) == 0){
-		char *msg		= strtok(NULL, MSG_DELIMITER);
-		char *room		= strtok(NULL, MSG_DELIMITER);
-		char *sender	= strtok(NULL, MSG_DELIMITER);
-		fprintf(stdout, "\nroom %s [%s]: %s\n", room, sender, msg);
+		char *msg		= fields[1];
+		char *room		= fields[2];
+		char *sender	= fields[3];
+		messaging_client_receiv_bdcast(client, time, seq, room, sender, msg);
+	}
+	else if(strcmp(token, MSG_TYPE_ROOMS) == 0){
+		char *rooms = fields[1];
+		messaging_client_receiv_rooms(client, rooms);
+	}
+	else if(strcmp(token, MSG_TYPE_ROOMS_PAGE) == 0){
+		char *nb_left	= fields[1];
+		char *last		= fields[2];
+		char *rooms		= fields[3];
+		if(nb_left != NULL && last != NULL && strcmp(nb_left, "0") != 0){
+			fprintf(stdout, "\nRooms (%s more after '%s', next page: !rooms <prefix> %s):\n", nb_left, last, last);
+		}
+		else{
+			fprintf(stdout, "\nRooms (Last page):\n");
+		}
+		messaging_client_receiv_rooms(client, rooms);
 	}
 	return -1; //Means no message match
 }
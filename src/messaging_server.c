@@ -15,14 +15,34 @@
 // -----------------------------------------------------------------------------
 // Static functions
 // -----------------------------------------------------------------------------
-static void messaging_server_exec_connect(ServerData*, User*, const char*);
+static void messaging_server_exec_connect(ServerData*, User*, const char*, const char*);
 static void messaging_server_exec_disconnect(ServerData*, User*);
 static void messaging_server_exec_whisper(ServerData*, User*, char*, char*);
+static void messaging_server_whisper_offline(ServerData*, User*, char*, char*);
 static void messaging_server_exec_room_open(ServerData*, User*, char*);
 static void messaging_server_exec_room_close(ServerData*, User*, char*);
 static void messaging_server_exec_room_enter(ServerData*, User*, char*);
+static Room* messaging_server_room_to_enter(ServerData*, User*, char*);
+static void messaging_server_exec_resume(ServerData*, User*, char*, char*);
 static void messaging_server_exec_room_leave(ServerData*, User*);
 static void messaging_server_exec_room_bdcast(ServerData*, User*, char*);
+static void messaging_server_exec_rooms(ServerData*, User*);
+static void messaging_server_exec_rooms_page(ServerData*, User*, char*, char*);
+static void messaging_server_exec_history(ServerData*, User*, char*);
+static void messaging_server_exec_search(ServerData*, User*, char*, char*);
+static void messaging_server_run_search(User*);
+static int messaging_server_check_limit(ServerData*, User*, const char*, const unsigned int);
+static int messaging_server_dispatch(ServerData*, User*, char**, const unsigned int);
+static void messaging_server_sanitize(ServerData*, User*, char*);
+static void messaging_server_defer_history(User*, HistoryRequest*);
+static void messaging_server_send_history(User*, HistoryRequest*);
+
+//Work left to do once server is unlocked (See messaging_server_exec_deferred)
+static __thread int messaging_server_deliver_mailbox = 0;
+static __thread HistoryRequest messaging_server_history; //Empty if none
+static __thread SearchIndex *messaging_server_search = NULL; //Retained, queried for the history request
+static __thread char messaging_server_search_terms[MSG_MAX_SIZE + 1];
+static __thread unsigned int messaging_server_search_id = 0;
 
 
 
@@ -34,38 +54,87 @@ int messaging_server_exec_receive(ServerData *server, User *user, char *msg){
 	if(msg == NULL){ return -1; }
 
 	//Recover the type of message (First element in msg, must be not NULL)
-	char *token = strtok(msg, MSG_DELIMITER);
-	if(token == NULL){ return -1; }
+	char *fields[MSG_MAX_FIELDS];
+	messaging_split(msg, fields);
+	if(fields[0] == NULL){ return -1; }
+
+	//Replies sent to the user echo the id of its request (If one)
+	unsigned int id = messaging_request_parse(fields[0]);
+	messaging_request_begin(user->socket, id);
+	int err = messaging_server_dispatch(server, user, fields, id);
+	//Request without reply (Broadcast etc) is acknowledged anyway (Search replies once unlocked)
+	messaging_server_search_id = id;
+	if(id != 0 && messaging_request_tagged() == 0 && messaging_server_search == NULL){
+		messaging_send_confirm(user->socket, MSG_CONF_ACK, "");
+	}
+	messaging_request_end();
+	return err;
+}
+
+void messaging_server_exec_deferred(ServerData *server, User *user){
+	//Mailbox is read (And emptied) without server lock: only this thread delivers it
+	if(messaging_server_deliver_mailbox == 1){
+		messaging_server_deliver_mailbox = 0;
+		if(mailbox_deliver(&(server->mailbox), user->login, user->socket) < 0){
+			fprintf(stderr, "[ERR] Unable to deliver the mailbox of '%s'\n", user->login);
+		}
+	}
+	//Search adds the messages found to the history request
+	if(messaging_server_search != NULL){
+		messaging_server_run_search(user);
+	}
+	//Frames of history are read from the files, then frames written by others meanwhile follow
+	if(messaging_server_history.type != HISTORY_REQUEST_NONE){
+		messaging_server_send_history(user, &messaging_server_history);
+		messaging_release(user->socket);
+	}
+}
+
+
+// -----------------------------------------------------------------------------
+// Static functions (DISPATCH)
+// -----------------------------------------------------------------------------
+
+static int messaging_server_dispatch(ServerData *server, User *user, char **fields, const unsigned int id){
+	char *token = fields[0];
+	//Refuse message if user sends too many of them
+	server->stats.frames_received++;
+	if(messaging_server_check_limit(server, user, token, id) != 1){
+		return -1;
+	}
 
 	//User messages
 	if(strcmp(token, MSG_TYPE_CONNECT) == 0){
-		messaging_server_exec_connect(server, user, strtok(NULL, MSG_DELIMITER));
+		messaging_server_exec_connect(server, user, fields[1], fields[2]);
 		return 1;
 	}
 	else if(strcmp(token, MSG_TYPE_DISCONNECT) == 0){
 		messaging_server_exec_disconnect(server, user);
 		return 1;
 	}
+	else if(strcmp(token, MSG_TYPE_PONG) == 0){
+		return 1; //Nothing to do, any message resets the idle timer
+	}
 	else if(strcmp(token, MSG_TYPE_WHISPER) == 0){
-		char *sender	= strtok(NULL, MSG_DELIMITER);
-		char *receiver	= strtok(NULL, MSG_DELIMITER);
-		char *msg		= strtok(NULL, MSG_DELIMITER);
+		char *sender	= fields[1];
+		char *receiver	= fields[2];
+		char *msg		= fields[3];
 		messaging_server_exec_whisper(server, user, receiver, msg);
 		return 1;
 	}
 
 	//Room messages
 	else if(strcmp(token, MSG_TYPE_ROOM_OPEN) == 0){
-		char *name = strtok(NULL, MSG_DELIMITER);
+		char *name = fields[1];
 		messaging_server_exec_room_open(server, user, name);
 	}
 	else if(strcmp(token, MSG_TYPE_ROOM_CLOSE) == 0){
-		char *name = strtok(NULL, MSG_DELIMITER);
+		char *name = fields[1];
 		messaging_server_exec_room_close(server, user, name);
 		return 1;
 	}
 	else if(strcmp(token, MSG_TYPE_ROOM_ENTER) == 0){
-		char *name = strtok(NULL, MSG_DELIMITER);
+		char *name = fields[1];
 		messaging_server_exec_room_enter(server, user, name);
 		return 1;
 	}
@@ -74,9 +143,36 @@ int messaging_server_exec_receive(ServerData *server, User *user, char *msg){
 		return 1;
 	}
 	else if(strcmp(token, MSG_TYPE_ROOM_BDCAST) == 0){
-		char *msg = strtok(NULL, MSG_DELIMITER);
+		char *msg = fields[1];
 		messaging_server_exec_room_bdcast(server, user, msg);
 	}
+	else if(strcmp(token, MSG_TYPE_ROOMS) == 0){
+		messaging_server_exec_rooms(server, user);
+		return 1;
+	}
+	else if(strcmp(token, MSG_TYPE_ROOMS_PAGE) == 0){
+		char *prefix	= fields[1];
+		char *after		= fields[2];
+		messaging_server_exec_rooms_page(server, user, prefix, after);
+		return 1;
+	}
+	else if(strcmp(token, MSG_TYPE_HISTORY) == 0){
+		char *since = fields[1];
+		messaging_server_exec_history(server, user, since);
+		return 1;
+	}
+	else if(strcmp(token, MSG_TYPE_SEARCH) == 0){
+		char *name	= fields[1];
+		char *terms	= fields[2];
+		messaging_server_exec_search(server, user, name, terms);
+		return 1;
+	}
+	else if(strcmp(token, MSG_TYPE_RESUME) == 0){
+		char *name	= fields[1];
+		char *seq	= fields[2];
+		messaging_server_exec_resume(server, user, name, seq);
+		return 1;
+	}
 	return -1; //Means no message match
 }
 
@@ -85,7 +181,19 @@ int messaging_server_exec_receive(ServerData *server, User *user, char *msg){
 // Static functions (USER MESSAGES)
 // -----------------------------------------------------------------------------
 
-static void messaging_server_exec_connect(ServerData *server, User *user, const char *user_name){
+static void messaging_server_exec_connect(ServerData *server, User *user, const char *user_name, const char *compression){
+	//User can't connect twice
+	if(user->id != 0){
+		messaging_send_error(user->socket, MSG_ERR_CONNECT, "You are already connected.");
+		return;
+	}
+	//Compression starts before user is added: no other thread writes to it yet
+	if(compression != NULL && strcmp(compression, MSG_COMPRESS_DEFLATE) == 0
+			&& messaging_is_compressed(user->socket) == 0 && user->socket < MSG_MAX_COMPRESSED_FD){
+		messaging_send_confirm(user->socket, MSG_CONF_COMPRESS, MSG_COMPRESS_DEFLATE);
+		messaging_set_compression(user->socket, 1);
+		server->stats.connections_compressed++;
+	}
 	//name must be not null
 	if(user_name == NULL){
 		fprintf(stderr, "Connect requested with invalid name (NULL)\n");
@@ -108,7 +216,7 @@ static void messaging_server_exec_connect(ServerData *server, User *user, const
 	}
 
 	//Place user in default room and send registration confirmation
-	Room *defaultRoom = list_get_where(&(server->list_rooms), ROOM_WELCOME_NAME, room_match_name);
+	Room *defaultRoom = server->room_welcome;
 	if(defaultRoom == NULL){
 		//TODO user should be removed from server
 		fprintf(stderr, "[ERR] Unable to recover the default room for new user\n");
@@ -117,7 +225,11 @@ static void messaging_server_exec_connect(ServerData *server, User *user, const
 	}
 	fprintf(stdout, "[USER] New user (%s) added in server (Sending confirmation)\n", user_name);
 	messaging_send_confirm(user->socket, MSG_CONF_REGISTER, "You have been successfully registered in server");
-	room_add_user(defaultRoom, user);
+	server_data_move_user(server, user, defaultRoom);
+	//Whispers received while offline (Delivered once server is unlocked)
+	if(mailbox_register(&(server->mailbox), user->login) == 1){
+		messaging_server_deliver_mailbox = 1;
+	}
 	return;
 }
 
@@ -128,12 +240,13 @@ static void messaging_server_exec_disconnect(ServerData* server, User* user){
 		return;
 	}
 
+	Room *room = user->room;
 	int errstatus = server_data_remove_user(server, user);
 	if(errstatus != 1){
 		fprintf(stdout, "[ERR] Unable to recover the room user %s was before disconnecting\n", user->login);
 		return;
 	}
-	fprintf(stdout, "[USER] '%s' disconnect (In room '%s')\n", user->login, user->room);
+	fprintf(stdout, "[USER] '%s' disconnect (In room '%s')\n", user->login, room->name);
 	messaging_send_confirm(user->socket, MSG_CONF_DISCONNECT, "You have been successfully disconnected");
 }
 
@@ -150,19 +263,40 @@ static void messaging_server_exec_whisper(ServerData *server, User *user, char *
 		fprintf(stderr, "[ERR] Invalid whisper message (Empty message)\n");
 		return;
 	}
+	messaging_server_sanitize(server, user, msg);
 
 	//Recover the receiver from list of user (Send error if wrong)
-	User *u = list_get_where(&(server->list_users), receiver, user_match_name);
+	User *u = server_data_get_user(server, receiver);
 	if(u == NULL){
-		messaging_send_error(user->socket, MSG_ERR_UNKOWN_USER, "User doesn't exists.");
+		messaging_server_whisper_offline(server, user, receiver, msg);
 		return;
 	}
 
+	//Receiver connected on another node gets it from its node
+	if(u->node != NULL){
+		messaging_send_node_whisper(u->node->socket, user->login, receiver, msg);
+		return;
+	}
 	//@TODO add mutex for writing in socket
 	messaging_send_whisper(u->socket, user->login, receiver, msg);
 }
 
 
+//Keep the whisper in the mailbox of the receiver (If it connected once)
+static void messaging_server_whisper_offline(ServerData *server, User *user, char *receiver, char *msg){
+	int err = mailbox_put(&(server->mailbox), receiver, user->login, msg);
+	if(err == -1){
+		messaging_send_error(user->socket, MSG_ERR_UNKOWN_USER, "User doesn't exists.");
+	}
+	else if(err == -2){
+		messaging_send_error(user->socket, MSG_ERR_GENERAL, "User is offline and its mailbox is full.");
+	}
+	else{
+		messaging_send_confirm(user->socket, MSG_CONF_GENERAL, "User is offline, message will be delivered on its next connection.");
+	}
+}
+
+
 // -----------------------------------------------------------------------------
 // Static functions (ROOM MESSAGES)
 // -----------------------------------------------------------------------------
@@ -175,8 +309,16 @@ static void messaging_server_exec_room_open(ServerData *server, User *user, char
 		return;
 	}
 
-	//Try to add room and check error
+	//Room placed on another node: client must open it there
 	name = str_trim(name);
+	Node *node = server_data_room_node(server, name);
+	if(node != NULL){
+		fprintf(stdout, "[ROOM] '%s' is placed on node '%s', redirect '%s'\n", name, node->name, user->login);
+		messaging_send_error(user->socket, MSG_ERR_REDIRECT, node->address);
+		return;
+	}
+
+	//Try to add room and check error
 	int errstatus = server_data_add_room(server, user, name);
 	switch(errstatus){
 		case 1: //OK
@@ -226,38 +368,89 @@ static void messaging_server_exec_room_close(ServerData* server, User* user, cha
 		case -4:
 			messaging_send_error(user->socket, MSG_ERR_GENERAL, "Error occured while closing.");
 			return;
+		case -5:
+			messaging_send_error(user->socket, MSG_ERR_GENERAL, "Room must be closed from the server hosting it.");
+			return;
 	}
 }
 
 static void messaging_server_exec_room_enter(ServerData* server, User* user, char* name){
+	Room* old_room = (user == NULL) ? NULL : user->room;
+	Room* new_room = messaging_server_room_to_enter(server, user, name);
+	if(new_room == NULL){
+		return;
+	}
+
+	//Change user room
+	server_data_move_user(server, user, new_room);
+	messaging_send_confirm(user->socket, MSG_CONF_ROOM_ENTER, "You successfully enterred the room.");
+	HistoryRequest request;
+	history_request_replay(&(new_room->history), &request);
+	messaging_server_defer_history(user, &request);
+	fprintf(stdout, "[ROOM] User '%s' moved from '%s' to '%s'\n", user->login, old_room->name, new_room->name);
+}
+
+static Room* messaging_server_room_to_enter(ServerData* server, User* user, char* name){
 	//Params must be not null
 	name = (name == NULL) ? NULL : str_trim(name);
 	if(user == NULL || name == NULL || room_is_valid_name(name) != 1){
 		fprintf(stderr, "[ERR] Invalid enter message\n");
 		messaging_send_error(user->socket, MSG_ERR_GENERAL, "Invalid room name.");
-		return;
+		return NULL;
 	}
 
 	//To enter a room, user must be first in the default room (The one from connection)
-	if(strcmp(user->room, ROOM_WELCOME_NAME) != 0){
+	if(user->room == NULL || user->room != server->room_welcome){
 		messaging_send_error(user->socket, MSG_ERR_GENERAL, "You must leave your current room first.");
-		return;
+		return NULL;
 	}
 
 	//Check whether the requested room exists
-	//TODO Add mutex on the room list
-	Room* new_room = list_get_where(&(server->list_rooms), (void*)name, room_match_name);
-	Room* old_room = list_get_where(&(server->list_rooms), (void*)user->room, room_match_name);
-	if(new_room == NULL || old_room == NULL){
+	Room* new_room = server_data_get_room(server, name);
+	if(new_room == NULL){
 		messaging_send_error(user->socket, MSG_ERR_GENERAL, "Room doesn't exists...");
+		return NULL;
+	}
+	//Room hosted by another node: client must enter it there
+	if(new_room->node != NULL){
+		messaging_send_error(user->socket, MSG_ERR_REDIRECT, new_room->node->address);
+		return NULL;
+	}
+	return new_room;
+}
+
+static void messaging_server_exec_resume(ServerData *server, User *user, char *name, char *seq){
+	//Number of the last message received by the client
+	char *end = NULL;
+	uint64_t last = (seq == NULL) ? 0 : (uint64_t)strtoull(seq, &end, 10);
+	if(user == NULL || name == NULL || end == NULL || *str_trim(end) != '\0'){
+		messaging_send_error(user->socket, MSG_ERR_GENERAL, "Invalid resume request.");
 		return;
 	}
 
-	//Change user room
-	room_remove_user(old_room, user);
-	room_add_user(new_room, user);
-	messaging_send_confirm(user->socket, MSG_CONF_ROOM_ENTER, "You successfully enterred the room.");
-	fprintf(stdout, "[ROOM] User '%s' moved from '%s' to '%s'\n", user->login, old_room->name, new_room->name);
+	//Room is entered like with enter (Unless user is already in it)
+	name = str_trim(name);
+	Room* old_room = user->room;
+	Room* room = (old_room != NULL && strcmp(old_room->name, name) == 0) ? old_room
+				: messaging_server_room_to_enter(server, user, name);
+	if(room == NULL){
+		return;
+	}
+	if(room != old_room){
+		server_data_move_user(server, user, room);
+		fprintf(stdout, "[ROOM] User '%s' moved from '%s' to '%s' (Resumed after %llu)\n",
+				user->login, old_room->name, room->name, (unsigned long long)last);
+	}
+
+	//Only the missed messages are sent, with the confirmation (One write, older ones from history)
+	char str_seq[24];
+	HistoryRequest request;
+	sprintf(str_seq, "%llu", (unsigned long long)room->seq);
+	messaging_batch_begin(user->socket);
+	messaging_send_confirm(user->socket, MSG_CONF_RESUME, str_seq);
+	room_resume(room, user->socket, last, &request);
+	messaging_batch_end();
+	messaging_server_defer_history(user, &request);
 }
 
 static void messaging_server_exec_room_leave(ServerData* server, User* user){
@@ -268,23 +461,21 @@ static void messaging_server_exec_room_leave(ServerData* server, User* user){
 	}
 
 	//If was already in welcome room, then disconnect user instead.
-	if(strcmp(user->room, ROOM_WELCOME_NAME) == 0){
+	if(user->room == server->room_welcome){
 		messaging_server_exec_disconnect(server, user);
 		return;
 	}
 
 	//Recover current user room and welcome room
-	//TODO Add mutex on the room list
-	Room* old_room = list_get_where(&(server->list_rooms), (void*)user->room, room_match_name);
-	Room* new_room = list_get_where(&(server->list_rooms), (void*)ROOM_WELCOME_NAME, room_match_name);
+	Room* old_room = user->room;
+	Room* new_room = server->room_welcome;
 	if(old_room == NULL || new_room == NULL){
 		messaging_send_error(user->socket, MSG_ERR_GENERAL, "Error occurent, unable to leave room.");
 		return;
 	}
 
 	//Change user room
-	room_remove_user(old_room, user);
-	room_add_user(new_room, user);
+	server_data_move_user(server, user, new_room);
 	messaging_send_confirm(user->socket, MSG_CONF_ROOM_ENTER, "You successfully leaved the room.");
 	fprintf(stdout, "[ROOM] User '%s' leave room '%s'\n", user->login, old_room->name);
 }
@@ -297,14 +488,235 @@ static void messaging_server_exec_room_bdcast(ServerData *server, User *user, ch
 	}
 
 	//Recover room where user is
-	Room* room = list_get_where(&(server->list_rooms), user->room, room_match_name);
+	Room* room = user->room;
 	if(room == NULL){
 		fprintf(stderr, "[ERR] Unable to recover the room of user '%s'\n", user->login);
 		messaging_send_error(user->socket, MSG_ERR_GENERAL, "Unable to send message in room.");
 		return;
 	}
-	fprintf(stdout, "[CHAT] '%s': '%s' send '%s'\n", user->room, user->login, msg);
-	room_broadcast_message(room, user, msg);
+	//Repeat is dropped before any work (Flood)
+	if(recent_window_add(&(user->recent_bdcast), msg, strlen(msg)) == 0){
+		server->stats.frames_repeated++;
+		messaging_send_error(user->socket, MSG_ERR_REPEAT, "Message already sent.");
+		return;
+	}
+	messaging_server_sanitize(server, user, msg);
+	if(server->filter != NULL && ac_matcher_find(server->filter, msg, strlen(msg)) >= 0){
+		server->stats.frames_filtered++;
+		fprintf(stderr, "[FILTER] '%s': message of '%s' refused\n", room->name, user->login);
+		messaging_send_error(user->socket, MSG_ERR_FILTERED, "Message refused (Banned term).");
+		return;
+	}
+	fprintf(stdout, "[CHAT] '%s': '%s' send '%s'\n", room->name, user->login, msg);
+	int64_t time = room_broadcast_message(room, user->login, msg);
+	if(time >= 0){
+		cluster_forward_bdcast(server, room, user, msg, time);
+	}
 }
 
 
+static void messaging_server_exec_rooms(ServerData *server, User *user){
+	//Same prepared list is sent to everyone (Rebuilt only if rooms changed)
+	SharedBuffer *rooms = server_data_get_rooms(server);
+	if(rooms == NULL){
+		messaging_send_error(user->socket, MSG_ERR_GENERAL, "Unable to list the rooms.");
+		return;
+	}
+	messaging_write_frame(user->socket, rooms);
+	sharedbuf_release(rooms);
+}
+
+
+static void messaging_server_exec_rooms_page(ServerData *server, User *user, char *prefix, char *after){
+	//Prefix is required, cursor is optional (First page by default)
+	if(prefix == NULL){
+		messaging_send_error(user->socket, MSG_ERR_GENERAL, "Invalid rooms request.");
+		return;
+	}
+	prefix	= str_trim(prefix);
+	prefix	= (strcmp(prefix, MSG_ROOMS_ALL) == 0) ? "" : prefix;
+	after	= (after == NULL) ? "" : str_trim(after);
+
+	//Recover matching rooms after the cursor (Binary searches in the sorted index)
+	size_t first;
+	size_t nb		= room_index_find_prefix(&(server->rooms_index), prefix, &first);
+	size_t end		= first + nb;
+	size_t start	= (after[0] == '\0') ? first : room_index_find_after(&(server->rooms_index), after);
+	start			= (start < first) ? first : ((start > end) ? end : start);
+	size_t last		= (start + ROOMS_PAGE_SIZE < end) ? start + ROOMS_PAGE_SIZE : end;
+
+	//Write each room of the page ("name:nb_users,"), its last name is the next cursor
+	char rooms[ROOMS_PAGE_SIZE * (ROOM_MAX_SIZE + 16) + 1] = "";
+	size_t len = 0, k;
+	for(k = start; k < last; k++){
+		Room *room = server->rooms_index.rooms[k];
+		len += sprintf(rooms + len, "%s:%d,", room->name, list_size(&(room->list_users)));
+	}
+	const char *cursor = (last > start) ? server->rooms_index.rooms[last - 1]->name : after;
+	messaging_send_rooms_page_result(user->socket, end - last, cursor, rooms);
+}
+
+
+static void messaging_server_exec_history(ServerData *server, User *user, char *since){
+	//Only rooms hosted here have their messages
+	Room *room = user->room;
+	if(room == NULL || room->node != NULL){
+		messaging_send_error(user->socket, MSG_ERR_GENERAL, "You must be in a room.");
+		return;
+	}
+	//Since a time, or from a number ("+42": frames left by a previous request)
+	char *end	= NULL;
+	char *value	= (since != NULL && since[0] == MSG_SEQ) ? since + 1 : since;
+	int64_t from	= (value == NULL || !isdigit((unsigned char)value[0])) ? 0 : (int64_t)strtoll(value, &end, 10);
+	if(end == NULL || *end != '\0'){
+		messaging_send_error(user->socket, MSG_ERR_GENERAL, "Invalid history request.");
+		return;
+	}
+	//Frames are sent as they were, then number of the frames left if max is reached (MSG_CONF_HISTORY)
+	HistoryRequest request;
+	if(value != since){
+		history_request_resume(&(room->history), &request, (from > 0) ? (uint64_t)from - 1 : 0, HISTORY_QUERY_MAX);
+	}
+	else{
+		history_request_query(&(room->history), &request, from, HISTORY_QUERY_MAX);
+	}
+	messaging_server_defer_history(user, &request);
+}
+
+
+static void messaging_server_exec_search(ServerData *server, User *user, char *name, char *terms){
+	name = (name == NULL) ? NULL : str_trim(name);
+	if(name == NULL || terms == NULL){
+		messaging_send_error(user->socket, MSG_ERR_GENERAL, "Invalid search request.");
+		return;
+	}
+	Room *room = server_data_get_room(server, name);
+	if(room == NULL){
+		messaging_send_error(user->socket, MSG_ERR_GENERAL, "Room doesn't exists...");
+		return;
+	}
+	//Index is on the node hosting the room
+	if(room->node != NULL){
+		messaging_send_error(user->socket, MSG_ERR_REDIRECT, room->node->address);
+		return;
+	}
+	if(room->search == NULL){
+		messaging_send_error(user->socket, MSG_ERR_GENERAL, "Messages of this room are not saved.");
+		return;
+	}
+
+	//Query runs once server is unlocked (Decoding the lists of common terms is long)
+	HistoryRequest request;
+	if(history_request_ranges(&(room->history), &request) != 1){
+		messaging_send_error(user->socket, MSG_ERR_GENERAL, "Messages of this room are not saved.");
+		return;
+	}
+	messaging_server_defer_history(user, &request);
+	if(messaging_server_history.type != HISTORY_REQUEST_NONE){
+		messaging_server_search = search_index_retain(room->search);
+		snprintf(messaging_server_search_terms, sizeof(messaging_server_search_terms), "%s", terms);
+	}
+}
+
+//Run the search deferred by exec_search: messages found are sent from history (As they were broadcast)
+static void messaging_server_run_search(User *user){
+	SearchDoc	results[SEARCH_RESULTS_NB];
+	char		str_nb[16];
+	int			nb = search_index_find(messaging_server_search, messaging_server_search_terms, results, SEARCH_RESULTS_NB);
+	int			k, added = 0;
+	search_index_release(messaging_server_search);
+	messaging_server_search = NULL;
+	messaging_request_begin(user->socket, messaging_server_search_id);
+	if(nb < 0){
+		messaging_send_error(user->socket, MSG_ERR_GENERAL, "Nothing to search (Terms are letters and digits).");
+		messaging_request_end();
+		return;
+	}
+	//Oldest results may be in segments already removed (Retention)
+	for(k=0; k<nb; k++){
+		added += (history_request_frame(&messaging_server_history, &(results[k].position), results[k].len) == 1);
+	}
+	sprintf(str_nb, "%d", added);
+	messaging_send_confirm(user->socket, MSG_CONF_SEARCH, str_nb);
+	messaging_request_end();
+}
+
+
+// -----------------------------------------------------------------------------
+// Static functions (HISTORY)
+// -----------------------------------------------------------------------------
+
+//Send the frames of history once server is unlocked (Before the frames written from now)
+static void messaging_server_defer_history(User *user, HistoryRequest *request){
+	if(request->type == HISTORY_REQUEST_NONE){
+		history_request_free(request);
+		return;
+	}
+	//Never sent with server lock: a client not reading would stop all others
+	if(messaging_server_history.type != HISTORY_REQUEST_NONE || messaging_hold(user->socket) != 1){
+		fprintf(stderr, "[ERR] Unable to send history to '%s'\n", user->login);
+		history_request_free(request);
+		return;
+	}
+	messaging_server_history = *request;
+}
+
+//Send the frames of history, then the number of the frames left if any (Request is freed)
+static void messaging_server_send_history(User *user, HistoryRequest *request){
+	char str_next[24];
+	if(history_request_send(request, user->socket) < 0){
+		fprintf(stderr, "[ERR] Unable to send history to '%s'\n", user->login);
+	}
+	else if(request->next > 0){
+		sprintf(str_next, "%llu", (unsigned long long)request->next);
+		messaging_send_confirm(user->socket, MSG_CONF_HISTORY, str_next);
+	}
+	history_request_free(request);
+}
+
+
+// -----------------------------------------------------------------------------
+// Static functions (CHAT TEXT)
+// -----------------------------------------------------------------------------
+
+//Chat text is checked once when received (Before any copy for receivers)
+static void messaging_server_sanitize(ServerData *server, User *user, char *msg){
+	size_t nb = utf8_sanitize(msg, strlen(msg));
+	if(nb > 0){
+		server->stats.frames_sanitized++;
+		fprintf(stderr, "[ERR] Invalid UTF-8 from '%s' (%zu bytes replaced)\n", user->login, nb);
+	}
+}
+
+
+// -----------------------------------------------------------------------------
+// Static functions (RATE LIMIT)
+// -----------------------------------------------------------------------------
+
+static int messaging_server_check_limit(ServerData *server, User *user, const char *type, const unsigned int id){
+	//Each kind of message has its own bucket
+	UserLimit limit = USER_LIMIT_OTHER;
+	if(strcmp(type, MSG_TYPE_ROOM_BDCAST) == 0){
+		limit = USER_LIMIT_BDCAST;
+	}
+	else if(strcmp(type, MSG_TYPE_WHISPER) == 0){
+		limit = USER_LIMIT_WHISPER;
+	}
+	if(user_take_limit(user, limit) == 1){
+		user->throttled = 0;
+		return 1;
+	}
+
+	//Only the first refused message is answered (Spammer won't get a flood back),
+	//but a request with an id always gets its error (Never acknowledged)
+	server->stats.frames_throttled++;
+	if(user->throttled == 0){
+		fprintf(stderr, "[THROTTLE] '%s' sends too many '%s' (Total throttled: %lu)\n",
+				user->login, type, server->stats.frames_throttled);
+	}
+	if(user->throttled == 0 || id != 0){
+		messaging_send_error(user->socket, MSG_ERR_THROTTLE, "Too many messages, slow down.");
+	}
+	user->throttled = 1;
+	return -1;
+}
@@ -17,10 +17,12 @@
 #include <string.h>
 
 #include "wunixlib/stream.h"
+#include "wunixlib/utf8.h"
 #include "server_data.h"
 #include "messaging.h"
 #include "room.h"
 #include "user.h"
+#include "cluster.h"
 
 
 // -----------------------------------------------------------------------------
@@ -32,6 +34,8 @@
  * \details			Recover the type of message from the given msg and execute
  * 					the action for that kind of message.
  * 					NULL message return -1.
+ * 					Replies to a request with an id ("type#id") carry the same id
+ * 					(MSG_CONF_ACK is sent if request has no other reply).
  * \note			This function is meant to be used by server side.
  * \warning			Message parameter will be altered and shouldn't be used anymore.
  * \warning			Server shouldn't be null.
@@ -43,6 +47,17 @@
  */
 int messaging_server_exec_receive(ServerData *server, User *user, char *msg);
 
+/**
+ * \brief			Do the slow work of the last message processed (Disk etc).
+ * \details			Must be called by the thread of the user, once server is
+ * 					unlocked: whispers received while offline and frames of
+ * 					history asked are sent here.
+ *
+ * \param server	Server used (Not locked)
+ * \param user		User who sent the message
+ */
+void messaging_server_exec_deferred(ServerData *server, User *user);
+
 
 #endif
 
@@ -0,0 +1,36 @@
+// -----------------------------------------------------------------------------
+/**
+ * \file	node.c
+ * \author	Constantin MASSON
+ * \date	July 4, 2016
+ *
+ * \brief	Node component (Another server of the cluster)
+ * \note	C Library for the Unix Programming Project
+ */
+// -----------------------------------------------------------------------------
+
+#include "node.h"
+
+Node* node_create(const int socket){
+	Node *node = (Node*)malloc(sizeof(Node));
+	if(node == NULL){
+		return NULL;
+	}
+	memset(node, 0x00, sizeof(Node));
+	node->socket = socket;
+	frame_reader_init(&(node->reader), socket);
+	return node;
+}
+
+void node_destroy(Node *node){
+	free(node);
+}
+
+
+// -----------------------------------------------------------------------------
+// List function implementations
+// -----------------------------------------------------------------------------
+
+int node_match_socket(void *node, void *socket){
+	return ((Node*)node)->socket == *(int*)socket;
+}
@@ -0,0 +1,81 @@
+// -----------------------------------------------------------------------------
+/**
+ * \file	node.h
+ * \author	Constantin MASSON
+ * \date	July 4, 2016
+ *
+ * \brief	Node component (Another server of the cluster)
+ * \note	C Library for the Unix Programming Project
+ */
+// -----------------------------------------------------------------------------
+
+#ifndef UNIXPROJECT_NODE_H
+#define UNIXPROJECT_NODE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "wunixlib/stream.h"
+#include "constants.h"
+
+
+// -----------------------------------------------------------------------------
+// Structures
+// -----------------------------------------------------------------------------
+
+/**
+ * \brief		Define a node (Link with another server of the cluster).
+ * \details		Name and address are set when the hello message is received
+ * 				(Empty before).
+ */
+typedef struct _node{
+	int socket; //Persistent link with this node
+	char name[NODE_MAX_SIZE+1]; //+1 for '\0'
+	char address[NODE_ADDRESS_SIZE+1]; //Where clients connect this node
+	unsigned long stamp; //Last broadcast forwarded to this node
+	int accepted; //1 if link opened by the node (Its hello comes first)
+	FrameReader reader; //Data received on link (Not processed yet)
+} Node;
+
+
+// -----------------------------------------------------------------------------
+// General Functions
+// -----------------------------------------------------------------------------
+
+/**
+ * \brief			Create a new node.
+ * \details			Node must be destroyed after use.
+ *
+ * \param socket	Link with the node
+ * \return			Pointer to the new node or NULL if error (malloc)
+ */
+Node* node_create(const int socket);
+
+/**
+ * \brief		Destroy a node (Link is not closed).
+ *
+ * \param node	Node to destroy
+ */
+void node_destroy(Node *node);
+
+
+// -----------------------------------------------------------------------------
+// List function implementations
+// -----------------------------------------------------------------------------
+
+/**
+ * \brief			Check whether the node uses this socket.
+ *
+ * \param node		Node to test (Node*)
+ * \param socket	Socket to look for (int*)
+ * \return			1 if match, otherwise, 0
+ */
+int node_match_socket(void *node, void *socket);
+
+
+#endif
+
+
+
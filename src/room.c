@@ -27,12 +27,21 @@ Room* room_create(User *owner, const char *name){
 	memset(room, 0x00, sizeof(Room));
 	list_init(&(room->list_users), NULL);
 	strcpy(room->owner_name, owner->login);
+	room->owner_id = owner->id;
+	room->node = owner->node;
 	strcpy(room->name, name);
+	history_init(&(room->history));
 	return room;
 }
 
 int room_destroy(Room *room){
 	assert(room != NULL);
+	size_t k;
+	for(k=0; k<room->recent_nb; k++){
+		sharedbuf_release(room->recent[(room->recent_first + k) % ROOM_RECENT_NB]);
+	}
+	history_close(&(room->history));
+	search_index_release(room->search);
 	free(room);
 	return 1;
 }
@@ -57,31 +66,80 @@ int room_add_user(Room *room, User *user){
 	assert(room != NULL);
 	assert(user != NULL);
 	//If user already in room
-	if(list_contains_where(&(room->list_users), user->login, room_match_name) == 1){
+	if(user->room == room){
 		return -1;
 	}
 	list_append(&(room->list_users), user);
-	strcpy(user->room, room->name);
+	user->room = room;
+	return 1;
 }
 
 int room_remove_user(Room *room, User *user){
 	assert(room != NULL);
 	assert(user != NULL);
 	//If user is not in the room
-	if(list_contains_where(&(room->list_users), user->login, user_match_name) != 1){
+	if(user->room != room){
 		return -1;
 	}
-	list_remove_where(&(room->list_users), user->login, user_match_name);
-	strcpy(user->room, ""); //Remove room from user data
+	list_remove_where(&(room->list_users), &(user->id), user_match_id);
+	user->room = NULL; //Remove room from user data
+	return 1;
+}
+
+int64_t room_broadcast_message(Room *room, const char *sender, const char *msg){
+	assert(room != NULL);
+	int64_t			time	= history_time(&(room->history));
+	SharedBuffer	*frame	= messaging_encode_room_bdcast(sender, room->name, msg, time, room->seq + 1);
+	if(frame == NULL){
+		return -1;
+	}
+	room->seq++;
+	HistoryEntry position;
+	if(history_append(&(room->history), frame->data, frame->size, time, room->seq) == 1 && room->search != NULL
+			&& history_last(&(room->history), &position) == 1){
+		search_index_push(room->search, frame, &position);
+	}
+	//Kept for resume (Oldest one is released if full)
+	if(room->recent_nb == ROOM_RECENT_NB){
+		sharedbuf_release(room->recent[room->recent_first]);
+		room->recent_first = (room->recent_first + 1) % ROOM_RECENT_NB;
+		room->recent_nb--;
+	}
+	room->recent[(room->recent_first + room->recent_nb) % ROOM_RECENT_NB] = sharedbuf_retain(frame);
+	room->recent_nb++;
+	fanout_deliver(&(room->list_users), frame);
+	sharedbuf_release(frame);
+	return time;
 }
 
-void room_broadcast_message(Room *room, User *user, char* msg){
+void room_deliver_message(Room *room, const char *sender, const char *msg, const int64_t time, const uint64_t seq){
 	assert(room != NULL);
-	bdcast_params params;
-	params.user_name	= user->login;
-	params.room_name	= room->name;
-	params.msg			= msg;
-	list_iterate_args(&(room->list_users), user_send_room_bdcast, (void*)&params);
+	SharedBuffer *frame = messaging_encode_room_bdcast(sender, room->name, msg, time, seq);
+	if(frame != NULL){
+		fanout_deliver(&(room->list_users), frame);
+		sharedbuf_release(frame);
+	}
+}
+
+int64_t room_resume(Room *room, const int socket, const uint64_t seq, HistoryRequest *request){
+	assert(room != NULL && request != NULL);
+	int64_t	sent = 0, err;
+	size_t	k;
+	history_request_init(request);
+	if(seq > room->seq){
+		return (history_request_replay(&(room->history), request) == 1) ? 0 : -1;
+	}
+	if(room->seq - seq > room->recent_nb){
+		return (history_request_resume(&(room->history), request, seq, HISTORY_QUERY_MAX) == 1) ? 0 : -1;
+	}
+	for(k=room->recent_nb - (room->seq - seq); k<room->recent_nb; k++){
+		err = messaging_write_frame(socket, room->recent[(room->recent_first + k) % ROOM_RECENT_NB]);
+		if(err < 0){
+			return -1;
+		}
+		sent += err;
+	}
+	return sent;
 }
 
 
@@ -98,13 +156,17 @@ int room_match_name(void* room, void* name){
 	return 0;
 }
 
+int room_match_id(void* room, void* id){
+	return ((Room*)room)->id == *(unsigned int*)id;
+}
+
 int room_display(void* room){
 	if(room == NULL){
 		fprintf(stdout, "Room is null\n");
 		return 1;
 	}
 	Room r = *(Room*) room;
-	fprintf(stdout, "Room name: '%s'\n", r.name);
+	fprintf(stdout, "Room name: '%s' (id %u)\n", r.name, r.id);
 	return 1;
 }
 
@@ -15,6 +15,9 @@
 #include <stdio.h>
 #include "constants.h"
 #include "user.h"
+#include "fanout.h"
+#include "history.h"
+#include "search.h"
 
 #include "wunixlib/linkedlist.h"
 
@@ -24,12 +27,25 @@
 // -----------------------------------------------------------------------------
 
 /**
- * \brief Define a room component.
+ * \brief		Define a room component.
+ * \details		The id is given by the server when room is added (0 before).
+ * 				Room is hosted by the node of its owner (See cluster.h).
+ * 				Each message has a number (See MSG_SEQ): the last ones are
+ * 				kept in memory, older ones are resumed from history.
  */
 typedef struct _room{
+	unsigned int id; //Server id (interned name)
 	char name[ROOM_MAX_SIZE+1]; //+1 for '\0'
 	Linkedlist list_users; //List user in this room
-	char owner_name[USER_MAX_SIZE];
+	unsigned int owner_id; //Id of the owner (0 if owner has no id)
+	char owner_name[USER_MAX_SIZE+1];
+	struct _node *node; //Home node (NULL if this server)
+	History history; //Messages saved on disk (Disabled for rooms of other nodes)
+	SearchIndex *search; //Index of saved messages (NULL if history disabled)
+	uint64_t seq; //Number of the last message (Continued from history)
+	SharedBuffer *recent[ROOM_RECENT_NB]; //Last messages (Ring, oldest at recent_first)
+	size_t recent_first;
+	size_t recent_nb;
 } Room;
 
 
@@ -72,12 +88,46 @@ int room_is_valid_name(const char *name);
 
 /**
  * \brief		Send a message to all user in the char room.
+ * \details		Only users connected on this server (See cluster for others).
+ * 				Frame is encoded once. Small rooms are delivered by the caller,
+ * 				large ones (ROOM_FANOUT_MIN users) in parallel (See fanout).
+ * \details		Frame is also saved in room history (And queued for search index).
  *
  * \param room	Room where to broadcast
- * \param user	Sender of the message
+ * \param sender	Login of the sender of the message
  * \param msg	Message to send
+ * \return		Time given to the message (Its number is room->seq), -1 if error
  */
-void room_broadcast_message(Room *room, User *user, char* msg);
+int64_t room_broadcast_message(Room *room, const char *sender, const char *msg);
+
+/**
+ * \brief		Send a message broadcast by another node to users of this server.
+ * \details		Frame is the one of the node (Same time and number). Message
+ * 				is neither saved nor numbered here: the node did it.
+ *
+ * \param room	Room where to deliver
+ * \param sender	Login of the sender of the message
+ * \param msg	Message to send
+ * \param time	Time given by the node
+ * \param seq	Number given by the node
+ */
+void room_deliver_message(Room *room, const char *sender, const char *msg, const int64_t time, const uint64_t seq);
+
+/**
+ * \brief		Send the messages the user missed in the room.
+ * \details		Sent from the last messages kept in memory, otherwise,
+ * 				prepared in request, to send from history (At most
+ * 				HISTORY_QUERY_MAX bytes, see history_request_send). If the
+ * 				number is unknown (Room opened again since), last messages
+ * 				are replayed.
+ *
+ * \param room	Room to resume
+ * \param socket	Socket of the user
+ * \param seq	Number of the last message received by the user
+ * \param request	Set to the messages to send from history (Free it with history_request_free)
+ * \return		Number of bytes sent, -1 if error
+ */
+int64_t room_resume(Room *room, const int socket, const uint64_t seq, HistoryRequest *request);
 
 /**
  * \brief		Check whether the room is empty (No user inside).
@@ -131,6 +181,17 @@ int room_remove_user(Room *room, User *user);
  */
 int room_match_name(void* room, void* name);
 
+/**
+ * \brief		Used for list.
+ * \details		Check whether id given match room id from list.
+ * \details		See wunixlib/Linkedlist documentation for further informations.
+ *
+ * \param room	Room tested
+ * \param id	Pointer to the id to test (unsigned int)
+ * \return		1 if match, otherwise, return 0
+ */
+int room_match_id(void* room, void* id);
+
 /**
  * \brief		Display one room data.
  * \details		Meant to be used as iterate function for list.
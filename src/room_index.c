@@ -0,0 +1,102 @@
+// -----------------------------------------------------------------------------
+/**
+ * \file	room_index.c
+ * \author	Constantin MASSON
+ * \date	July 1, 2016
+ *
+ * \brief	Rooms sorted by name
+ * \note	C Library for the Unix Programming Project
+ */
+// -----------------------------------------------------------------------------
+
+#include "room_index.h"
+
+
+// -----------------------------------------------------------------------------
+// Static functions
+// -----------------------------------------------------------------------------
+
+//Position of the first room with name >= given name
+static size_t room_index_lower_bound(const RoomIndex *index, const char *name){
+	size_t low = 0, high = index->size;
+	while(low < high){
+		size_t middle = low + (high - low) / 2;
+		if(strcmp(index->rooms[middle]->name, name) < 0){
+			low = middle + 1;
+		}
+		else{
+			high = middle;
+		}
+	}
+	return low;
+}
+
+//Position of the first room after all names starting with prefix
+static size_t room_index_prefix_end(const RoomIndex *index, const char *prefix){
+	size_t low = 0, high = index->size, len = strlen(prefix);
+	while(low < high){
+		size_t middle = low + (high - low) / 2;
+		if(strncmp(index->rooms[middle]->name, prefix, len) <= 0){
+			low = middle + 1;
+		}
+		else{
+			high = middle;
+		}
+	}
+	return low;
+}
+
+
+// -----------------------------------------------------------------------------
+// Functions
+// -----------------------------------------------------------------------------
+
+void room_index_init(RoomIndex *index){
+	index->rooms	= NULL;
+	index->size		= 0;
+	index->capacity	= 0;
+}
+
+void room_index_clear(RoomIndex *index){
+	free(index->rooms);
+	room_index_init(index);
+}
+
+int room_index_add(RoomIndex *index, Room *room){
+	//Grow array if full
+	if(index->size == index->capacity){
+		size_t capacity	= (index->capacity == 0) ? 64 : index->capacity * 2;
+		Room **rooms	= (Room**)realloc(index->rooms, capacity * sizeof(Room*));
+		if(rooms == NULL){
+			return -1;
+		}
+		index->rooms	= rooms;
+		index->capacity	= capacity;
+	}
+	//Insert at its place
+	size_t pos = room_index_lower_bound(index, room->name);
+	memmove(index->rooms + pos + 1, index->rooms + pos, (index->size - pos) * sizeof(Room*));
+	index->rooms[pos] = room;
+	index->size++;
+	return 1;
+}
+
+int room_index_remove(RoomIndex *index, Room *room){
+	size_t pos = room_index_lower_bound(index, room->name);
+	if(pos >= index->size || index->rooms[pos] != room){
+		return -1;
+	}
+	memmove(index->rooms + pos, index->rooms + pos + 1, (index->size - pos - 1) * sizeof(Room*));
+	index->size--;
+	return 1;
+}
+
+size_t room_index_find_prefix(const RoomIndex *index, const char *prefix, size_t *first){
+	*first = room_index_lower_bound(index, prefix);
+	return room_index_prefix_end(index, prefix) - *first;
+}
+
+size_t room_index_find_after(const RoomIndex *index, const char *name){
+	size_t k = room_index_lower_bound(index, name);
+	return (k < index->size && strcmp(index->rooms[k]->name, name) == 0) ? k + 1 : k;
+}
@@ -0,0 +1,101 @@
+// -----------------------------------------------------------------------------
+/**
+ * \file	room_index.h
+ * \author	Constantin MASSON
+ * \date	July 1, 2016
+ *
+ * \brief	Rooms sorted by name
+ * \note	C Library for the Unix Programming Project
+ *
+ * Array of rooms kept sorted by name. Search by name or by prefix is a
+ * binary search (O(log n)), a page of k rooms is O(log n + k). Pages start
+ * after a name (The last one of the previous page, see room_index_find_after):
+ * rooms opened or closed meanwhile never shift the next pages.
+ * Add / remove move the pointers after the position (memmove).
+ */
+// -----------------------------------------------------------------------------
+
+#ifndef UNIXPROJECT_ROOM_INDEX_H
+#define UNIXPROJECT_ROOM_INDEX_H
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "room.h"
+
+
+// -----------------------------------------------------------------------------
+// Structures
+// -----------------------------------------------------------------------------
+
+/** \brief Define a sorted index of rooms (Must be initialized with init). */
+typedef struct _room_index{
+	Room	**rooms;
+	size_t	size;
+	size_t	capacity;
+} RoomIndex;
+
+
+// -----------------------------------------------------------------------------
+// Functions
+// -----------------------------------------------------------------------------
+
+/**
+ * \brief			Initialize an empty index.
+ *
+ * \param index		Index to initialize
+ */
+void room_index_init(RoomIndex *index);
+
+/**
+ * \brief			Free the index memory (Rooms are not free).
+ *
+ * \param index		Index to clear
+ */
+void room_index_clear(RoomIndex *index);
+
+/**
+ * \brief			Add a room in the index.
+ * \warning			Room name must not be in the index already.
+ *
+ * \param index		Index where to add
+ * \param room		Room to add
+ * \return			1 if added, otherwise, return -1 (Unable to malloc)
+ */
+int room_index_add(RoomIndex *index, Room *room);
+
+/**
+ * \brief			Remove a room from the index.
+ *
+ * \param index		Index where to remove
+ * \param room		Room to remove
+ * \return			1 if removed, otherwise, return -1 (Not in index)
+ */
+int room_index_remove(RoomIndex *index, Room *room);
+
+/**
+ * \brief			Find the range of rooms whose name starts with prefix.
+ * \details			Matching rooms are rooms[first] to rooms[first + nb - 1].
+ *
+ * \param index		Index where to look for
+ * \param prefix	Prefix to match (Empty string matches all rooms)
+ * \param first		Set with position of the first matching room
+ * \return			Number of matching rooms
+ */
+size_t room_index_find_prefix(const RoomIndex *index, const char *prefix, size_t *first);
+
+/**
+ * \brief			Find the first room whose name comes after name.
+ * \details			Name doesn't need to be in the index (Room closed since).
+ *
+ * \param index		Index where to look for
+ * \param name		Name to start after
+ * \return			Position of the room (size of index if none)
+ */
+size_t room_index_find_after(const RoomIndex *index, const char *name);
+
+
+#endif
+
+
+
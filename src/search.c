@@ -0,0 +1,630 @@
+// -----------------------------------------------------------------------------
+/**
+ * \file	search.c
+ * \author	Constantin MASSON
+ * \date	July 14, 2016
+ *
+ * \brief	Search words in the messages of a room (Inverted index)
+ * \note	C Library for the Unix Programming Project
+ */
+// -----------------------------------------------------------------------------
+
+#include "search.h"
+
+#define SEARCH_LIVE_CAPACITY 1024 //First size of the live hash table
+
+//Indexing job (One frame, or the whole history if cursor is set)
+struct search_job{
+	SearchIndex		*index;
+	SharedBuffer	*frame;
+	HistoryEntry	position;
+	HistoryCursor	*cursor;
+};
+
+//Segment being built (Terms must be added in order)
+struct search_builder{
+	SearchSegment	*segment;
+	size_t			terms_capacity;
+	size_t			names_size;
+	size_t			names_capacity;
+	size_t			postings_size;
+	size_t			postings_capacity;
+};
+
+static WorkPool	search_pool;
+static int		search_started = 0;
+
+
+// -----------------------------------------------------------------------------
+// Static functions (Terms)
+// -----------------------------------------------------------------------------
+
+//Next term of the text (Lower case, cut at SEARCH_TERM_MAX), return its size (0 if none)
+static size_t search_next_term(const char **text, const char *end, char *term){
+	const unsigned char	*p = (const unsigned char*)*text, *e = (const unsigned char*)end;
+	size_t				len;
+	do{
+		//Letters, digits and any UTF-8 byte are part of terms
+		for(; p < e && !isalnum(*p) && *p < 0x80; p++);
+		for(len=0; p < e && (isalnum(*p) || *p >= 0x80); p++){
+			if(len < SEARCH_TERM_MAX){
+				term[len++] = tolower(*p);
+			}
+		}
+	} while(len > 0 && len < SEARCH_TERM_MIN);
+	term[len]	= '\0';
+	*text		= (const char*)p;
+	return len;
+}
+
+//Message text of a broadcast frame ("bdcast;;;msg;;;room;;;sender")
+static const char* search_frame_text(const char *frame, const char **end){
+	const char *text = strstr(frame, MSG_DELIMITER);
+	if(text == NULL){
+		return NULL;
+	}
+	text	+= strlen(MSG_DELIMITER);
+	*end	= strstr(text, MSG_DELIMITER);
+	*end	= (*end == NULL) ? text + strlen(text) : *end;
+	return text;
+}
+
+static size_t search_hash(const char *term){
+	size_t hash = 2166136261u; //FNV-1a
+	for(; *term != '\0'; term++){
+		hash = (hash ^ (unsigned char)*term) * 16777619u;
+	}
+	return hash;
+}
+
+
+// -----------------------------------------------------------------------------
+// Static functions (Live part)
+// -----------------------------------------------------------------------------
+
+static SearchLiveTerm* search_live_get(const SearchLive *live, const char *term){
+	size_t slot, mask = live->capacity - 1;
+	if(live->capacity == 0){
+		return NULL;
+	}
+	for(slot = search_hash(term) & mask; live->terms[slot].term != NULL; slot = (slot + 1) & mask){
+		if(strcmp(live->terms[slot].term, term) == 0){
+			return &(live->terms[slot]);
+		}
+	}
+	return &(live->terms[slot]); //Free slot
+}
+
+static int search_live_grow(SearchLive *live){
+	size_t			capacity = (live->capacity == 0) ? SEARCH_LIVE_CAPACITY : live->capacity * 2, k, slot;
+	SearchLiveTerm	*terms = (SearchLiveTerm*)calloc(capacity, sizeof(SearchLiveTerm));
+	if(terms == NULL){
+		return -1;
+	}
+	for(k=0; k<live->capacity; k++){
+		if(live->terms[k].term == NULL){
+			continue;
+		}
+		for(slot = search_hash(live->terms[k].term) & (capacity - 1); terms[slot].term != NULL; slot = (slot + 1) & (capacity - 1));
+		terms[slot] = live->terms[k];
+	}
+	free(live->terms);
+	live->terms		= terms;
+	live->capacity	= capacity;
+	return 1;
+}
+
+static int search_live_add(SearchLive *live, const char *term, const uint32_t id){
+	if((live->nb_terms + 1) * 10 > live->capacity * 7 && search_live_grow(live) != 1){
+		return -1;
+	}
+	SearchLiveTerm *entry = search_live_get(live, term);
+	if(entry->term == NULL){
+		if((entry->term = strdup(term)) == NULL){
+			return -1;
+		}
+		live->nb_terms++;
+	}
+	if(entry->nb > 0 && entry->ids[entry->nb - 1] == id){
+		return 1; //Term already in this message
+	}
+	if(entry->nb == entry->capacity){
+		uint32_t	capacity	= (entry->capacity == 0) ? 4 : entry->capacity * 2;
+		uint32_t	*ids		= (uint32_t*)realloc(entry->ids, capacity * sizeof(uint32_t));
+		if(ids == NULL){
+			return -1;
+		}
+		entry->ids		= ids;
+		entry->capacity	= capacity;
+	}
+	entry->ids[entry->nb++] = id;
+	return 1;
+}
+
+static void search_live_clear(SearchLive *live){
+	size_t k;
+	for(k=0; k<live->capacity; k++){
+		free(live->terms[k].term);
+		free(live->terms[k].ids);
+	}
+	free(live->terms);
+	memset(live, 0x00, sizeof(SearchLive));
+}
+
+static int search_live_compare(const void *a, const void *b){
+	return strcmp((*(SearchLiveTerm* const*)a)->term, (*(SearchLiveTerm* const*)b)->term);
+}
+
+
+// -----------------------------------------------------------------------------
+// Static functions (Segments)
+// -----------------------------------------------------------------------------
+
+static size_t search_varint_encode(uint8_t *out, uint32_t value){
+	size_t len = 0;
+	for(; value >= 0x80; value >>= 7){
+		out[len++] = (uint8_t)(value | 0x80);
+	}
+	out[len++] = (uint8_t)value;
+	return len;
+}
+
+//Ids of a term of the segment (ids must hold term->nb ids)
+static uint32_t search_decode(const SearchSegment *segment, const SearchTerm *term, uint32_t *ids){
+	const uint8_t	*p = segment->postings + term->start;
+	uint32_t		id = 0, value, k;
+	int				shift;
+	for(k=0; k<term->nb; k++){
+		for(value=0, shift=0; *p & 0x80; p++, shift+=7){
+			value |= (uint32_t)(*p & 0x7F) << shift;
+		}
+		value	|= (uint32_t)(*p++) << shift;
+		id		+= value;
+		ids[k]	= id;
+	}
+	return term->nb;
+}
+
+//Term in the segment (Binary search), NULL if none
+static const SearchTerm* search_segment_get(const SearchSegment *segment, const char *term){
+	size_t	low = 0, high = segment->nb_terms, mid;
+	int		cmp;
+	while(low < high){
+		mid	= (low + high) / 2;
+		cmp	= strcmp(segment->names + segment->terms[mid].name, term);
+		if(cmp == 0){
+			return &(segment->terms[mid]);
+		}
+		else if(cmp < 0){
+			low = mid + 1;
+		}
+		else{
+			high = mid;
+		}
+	}
+	return NULL;
+}
+
+static void search_segment_free(SearchSegment *segment){
+	if(segment == NULL){
+		return;
+	}
+	free(segment->terms);
+	free(segment->names);
+	free(segment->postings);
+	free(segment);
+}
+
+//Grow an array to hold needed elements (Return the array, NULL if error: array unchanged)
+static void* search_reserve(void *data, size_t *capacity, const size_t needed, const size_t size){
+	if(needed <= *capacity){
+		return data;
+	}
+	size_t capacity_new = (*capacity == 0) ? 256 : *capacity;
+	while(capacity_new < needed){
+		capacity_new *= 2;
+	}
+	data = realloc(data, capacity_new * size);
+	if(data != NULL){
+		*capacity = capacity_new;
+	}
+	return data;
+}
+
+static int search_builder_init(struct search_builder *builder){
+	memset(builder, 0x00, sizeof(struct search_builder));
+	builder->segment = (SearchSegment*)calloc(1, sizeof(SearchSegment));
+	return (builder->segment == NULL) ? -1 : 1;
+}
+
+static int search_builder_add(struct search_builder *builder, const char *name, const uint32_t *ids, const uint32_t nb){
+	SearchSegment	*segment	= builder->segment;
+	size_t			name_len	= strlen(name) + 1;
+	void			*tmp;
+	uint32_t		prev = 0, k;
+	if((tmp = search_reserve(segment->terms, &(builder->terms_capacity), segment->nb_terms + 1, sizeof(SearchTerm))) == NULL){
+		return -1;
+	}
+	segment->terms = (SearchTerm*)tmp;
+	if((tmp = search_reserve(segment->names, &(builder->names_capacity), builder->names_size + name_len, 1)) == NULL){
+		return -1;
+	}
+	segment->names = (char*)tmp;
+	if((tmp = search_reserve(segment->postings, &(builder->postings_capacity), builder->postings_size + (size_t)nb * 5, 1)) == NULL){
+		return -1;
+	}
+	segment->postings = (uint8_t*)tmp;
+
+	SearchTerm *term = &(segment->terms[segment->nb_terms++]);
+	term->name	= builder->names_size;
+	term->nb	= nb;
+	term->start	= builder->postings_size;
+	memcpy(segment->names + builder->names_size, name, name_len);
+	builder->names_size += name_len;
+	for(k=0; k<nb; k++){
+		builder->postings_size += search_varint_encode(segment->postings + builder->postings_size, ids[k] - prev);
+		prev = ids[k];
+	}
+	term->len = builder->postings_size - term->start;
+	return 1;
+}
+
+//Build the segment of the live part (Terms sorted, ids encoded)
+static SearchSegment* search_segment_freeze(const SearchLive *live){
+	struct search_builder	builder;
+	SearchLiveTerm			**sorted = (SearchLiveTerm**)malloc((live->nb_terms + 1) * sizeof(SearchLiveTerm*));
+	size_t					nb = 0, k;
+	if(sorted == NULL || search_builder_init(&builder) != 1){
+		free(sorted);
+		return NULL;
+	}
+	for(k=0; k<live->capacity; k++){
+		if(live->terms[k].term != NULL){
+			sorted[nb++] = &(live->terms[k]);
+		}
+	}
+	qsort(sorted, nb, sizeof(SearchLiveTerm*), search_live_compare);
+	for(k=0; k<nb; k++){
+		if(search_builder_add(&builder, sorted[k]->term, sorted[k]->ids, sorted[k]->nb) != 1){
+			free(sorted);
+			search_segment_free(builder.segment);
+			return NULL;
+		}
+	}
+	free(sorted);
+	builder.segment->nb_docs = live->nb_docs;
+	return builder.segment;
+}
+
+//Merge 2 segments (Ids of newer are all after ids of older)
+static SearchSegment* search_segment_merge(const SearchSegment *older, const SearchSegment *newer){
+	struct search_builder	builder;
+	uint32_t				*ids = (uint32_t*)malloc(((size_t)older->nb_docs + newer->nb_docs + 1) * sizeof(uint32_t));
+	size_t					i = 0, j = 0;
+	if(ids == NULL || search_builder_init(&builder) != 1){
+		free(ids);
+		return NULL;
+	}
+	while(i < older->nb_terms || j < newer->nb_terms){
+		const SearchTerm	*a = (i < older->nb_terms) ? &(older->terms[i]) : NULL;
+		const SearchTerm	*b = (j < newer->nb_terms) ? &(newer->terms[j]) : NULL;
+		const char			*name = NULL;
+		uint32_t			nb = 0;
+		int					cmp = (a == NULL) ? 1 : (b == NULL) ? -1 : strcmp(older->names + a->name, newer->names + b->name);
+		if(cmp <= 0){
+			nb		+= search_decode(older, a, ids);
+			name	= older->names + a->name;
+			i++;
+		}
+		if(cmp >= 0){
+			nb		+= search_decode(newer, b, ids + nb);
+			name	= newer->names + b->name;
+			j++;
+		}
+		if(search_builder_add(&builder, name, ids, nb) != 1){
+			free(ids);
+			search_segment_free(builder.segment);
+			return NULL;
+		}
+	}
+	free(ids);
+	builder.segment->nb_docs = older->nb_docs + newer->nb_docs;
+	return builder.segment;
+}
+
+
+// -----------------------------------------------------------------------------
+// Static functions (Search)
+// -----------------------------------------------------------------------------
+
+static uint32_t search_smallest(const uint32_t *sizes, const size_t nb_lists){
+	uint32_t	smallest = sizes[0];
+	size_t		k;
+	for(k=1; k<nb_lists; k++){
+		smallest = (sizes[k] < smallest) ? sizes[k] : smallest;
+	}
+	return smallest;
+}
+
+//Ids in all lists (Each list increasing), out must hold the smallest list
+static size_t search_intersect(const uint32_t **lists, const uint32_t *sizes, const size_t nb_lists, uint32_t *out){
+	size_t smallest = 0, nb, k, i, j, n;
+	for(k=1; k<nb_lists; k++){
+		smallest = (sizes[k] < sizes[smallest]) ? k : smallest;
+	}
+	nb = sizes[smallest];
+	memcpy(out, lists[smallest], nb * sizeof(uint32_t));
+	for(k=0; k<nb_lists && nb > 0; k++){
+		if(k == smallest){
+			continue;
+		}
+		for(i=0, j=0, n=0; i < nb && j < sizes[k]; ){
+			if(out[i] < lists[k][j]){
+				i++;
+			}
+			else if(out[i] > lists[k][j]){
+				j++;
+			}
+			else{
+				out[n++] = out[i];
+				i++;
+				j++;
+			}
+		}
+		nb = n;
+	}
+	return nb;
+}
+
+//Place the last matching ids in found (Newest first), return the number added
+static size_t search_take_last(const uint32_t *ids, const size_t nb, uint32_t *found, const size_t max){
+	size_t k;
+	for(k=0; k<nb && k<max; k++){
+		found[k] = ids[nb - 1 - k];
+	}
+	return k;
+}
+
+static size_t search_live_find(const SearchLive *live, char terms[][SEARCH_TERM_MAX+1], const size_t nb_terms,
+							uint32_t *found, const size_t max){
+	const uint32_t	*lists[SEARCH_QUERY_TERMS];
+	uint32_t		sizes[SEARCH_QUERY_TERMS];
+	size_t			k, nb;
+	for(k=0; k<nb_terms; k++){
+		SearchLiveTerm *term = search_live_get(live, terms[k]);
+		if(term == NULL || term->term == NULL){
+			return 0;
+		}
+		lists[k]	= term->ids;
+		sizes[k]	= term->nb;
+	}
+	uint32_t *ids = (uint32_t*)malloc((search_smallest(sizes, nb_terms) + 1) * sizeof(uint32_t));
+	if(ids == NULL){
+		return 0;
+	}
+	nb = search_intersect(lists, sizes, nb_terms, ids);
+	nb = search_take_last(ids, nb, found, max);
+	free(ids);
+	return nb;
+}
+
+static size_t search_segment_find(const SearchSegment *segment, char terms[][SEARCH_TERM_MAX+1], const size_t nb_terms,
+								uint32_t *found, const size_t max){
+	const SearchTerm	*matches[SEARCH_QUERY_TERMS];
+	const uint32_t		*lists[SEARCH_QUERY_TERMS];
+	uint32_t			sizes[SEARCH_QUERY_TERMS], *decoded[SEARCH_QUERY_TERMS];
+	size_t				k, nb = 0, nb_decoded = 0;
+	for(k=0; k<nb_terms; k++){
+		if((matches[k] = search_segment_get(segment, terms[k])) == NULL){
+			return 0;
+		}
+		sizes[k] = matches[k]->nb;
+	}
+	uint32_t *ids = (uint32_t*)malloc((search_smallest(sizes, nb_terms) + 1) * sizeof(uint32_t));
+	for(k=0; k<nb_terms && ids != NULL; k++, nb_decoded++){
+		if((decoded[k] = (uint32_t*)malloc((matches[k]->nb + 1) * sizeof(uint32_t))) == NULL){
+			break;
+		}
+		lists[k] = decoded[k];
+		sizes[k] = search_decode(segment, matches[k], decoded[k]);
+	}
+	if(ids != NULL && nb_decoded == nb_terms){
+		nb = search_intersect(lists, sizes, nb_terms, ids);
+		nb = search_take_last(ids, nb, found, max);
+	}
+	for(k=0; k<nb_decoded; k++){
+		free(decoded[k]);
+	}
+	free(ids);
+	return nb;
+}
+
+
+// -----------------------------------------------------------------------------
+// Static functions (Indexer)
+// -----------------------------------------------------------------------------
+
+//Live part becomes a segment, then segments of same size are merged
+static void search_index_freeze(SearchIndex *index){
+	//Only the indexer changes live part and segments: read without lock
+	SearchSegment	*segment = search_segment_freeze(&(index->live));
+	SearchLive		old;
+	if(segment == NULL || index->nb_segments == SEARCH_SEGMENTS_MAX){
+		search_segment_free(segment);
+		return; //Tried again with next message
+	}
+	pthread_mutex_lock(&(index->mutex));
+	index->segments[index->nb_segments++] = segment;
+	old = index->live;
+	memset(&(index->live), 0x00, sizeof(SearchLive));
+	pthread_mutex_unlock(&(index->mutex));
+	search_live_clear(&old);
+
+	while(index->nb_segments >= 2){
+		SearchSegment *older = index->segments[index->nb_segments - 2];
+		SearchSegment *newer = index->segments[index->nb_segments - 1];
+		if(newer->nb_docs < older->nb_docs){
+			break;
+		}
+		SearchSegment *merged = search_segment_merge(older, newer);
+		if(merged == NULL){
+			break;
+		}
+		pthread_mutex_lock(&(index->mutex));
+		index->segments[index->nb_segments - 2] = merged;
+		index->nb_segments--;
+		pthread_mutex_unlock(&(index->mutex));
+		search_segment_free(older);
+		search_segment_free(newer);
+	}
+}
+
+static void search_index_add(SearchIndex *index, const char *frame, const size_t len, const HistoryEntry *position){
+	const char	*end = NULL, *text = search_frame_text(frame, &end);
+	char		term[SEARCH_TERM_MAX+1];
+	void		*docs;
+	pthread_mutex_lock(&(index->mutex));
+	if((docs = search_reserve(index->docs, &(index->docs_capacity), index->nb_docs + 1, sizeof(SearchDoc))) == NULL){
+		pthread_mutex_unlock(&(index->mutex));
+		return;
+	}
+	index->docs = (SearchDoc*)docs;
+	uint32_t id = index->nb_docs++;
+	index->docs[id].position	= *position;
+	index->docs[id].len			= len;
+	while(text != NULL && search_next_term(&text, end, term) > 0){
+		search_live_add(&(index->live), term, id);
+	}
+	index->live.nb_docs++;
+	pthread_mutex_unlock(&(index->mutex));
+	if(index->live.nb_docs >= SEARCH_LIVE_DOCS){
+		search_index_freeze(index);
+	}
+}
+
+static void search_job_run(void *arg){
+	struct search_job	*job = (struct search_job*)arg;
+	HistoryEntry		position;
+	char				*frame;
+	size_t				len;
+	if(job->cursor != NULL){
+		while(history_cursor_next(job->cursor, &position, &frame, &len) == 1){
+			search_index_add(job->index, frame, len, &position);
+		}
+		history_cursor_close(job->cursor);
+		free(job->cursor);
+	}
+	else{
+		search_index_add(job->index, job->frame->data, job->frame->size, &(job->position));
+		sharedbuf_release(job->frame);
+	}
+	search_index_release(job->index);
+	free(job);
+}
+
+//Queue the job (Or run it now if no indexer)
+static void search_job_push(struct search_job *job){
+	if(search_started == 0 || work_pool_push(&search_pool, search_job_run, job) != 1){
+		search_job_run(job);
+	}
+}
+
+
+// -----------------------------------------------------------------------------
+// Functions
+// -----------------------------------------------------------------------------
+
+int search_init(void){
+	if(search_started == 1){
+		return 1;
+	}
+	//One indexer: messages are indexed in order
+	search_started = (work_pool_init(&search_pool, 1) > 0) ? 1 : 0;
+	return (search_started == 1) ? 1 : -1;
+}
+
+SearchIndex* search_index_create(void){
+	SearchIndex *index = (SearchIndex*)calloc(1, sizeof(SearchIndex));
+	if(index == NULL){
+		return NULL;
+	}
+	pthread_mutex_init(&(index->mutex), NULL);
+	index->refcount = 1;
+	return index;
+}
+
+SearchIndex* search_index_retain(SearchIndex *index){
+	assert(index != NULL);
+	__sync_add_and_fetch(&(index->refcount), 1);
+	return index;
+}
+
+void search_index_release(SearchIndex *index){
+	size_t k;
+	if(index == NULL || __sync_sub_and_fetch(&(index->refcount), 1) != 0){
+		return;
+	}
+	for(k=0; k<index->nb_segments; k++){
+		search_segment_free(index->segments[k]);
+	}
+	search_live_clear(&(index->live));
+	pthread_mutex_destroy(&(index->mutex));
+	free(index->docs);
+	free(index);
+}
+
+void search_index_push(SearchIndex *index, SharedBuffer *frame, const HistoryEntry *position){
+	assert(index != NULL && frame != NULL && position != NULL);
+	struct search_job *job = (struct search_job*)malloc(sizeof(struct search_job));
+	if(job == NULL){
+		return;
+	}
+	job->index		= search_index_retain(index);
+	job->frame		= sharedbuf_retain(frame);
+	job->position	= *position;
+	job->cursor		= NULL;
+	search_job_push(job);
+}
+
+void search_index_rebuild(SearchIndex *index, const History *history){
+	assert(index != NULL && history != NULL);
+	struct search_job	*job	= (struct search_job*)malloc(sizeof(struct search_job));
+	HistoryCursor		*cursor	= (HistoryCursor*)malloc(sizeof(HistoryCursor));
+	if(job == NULL || cursor == NULL){
+		free(job);
+		free(cursor);
+		return;
+	}
+	history_cursor_init(history, cursor);
+	job->index	= search_index_retain(index);
+	job->frame	= NULL;
+	job->cursor	= cursor;
+	search_job_push(job);
+}
+
+int search_index_find(SearchIndex *index, const char *query, SearchDoc *results, const size_t max){
+	assert(index != NULL && query != NULL && results != NULL);
+	char		terms[SEARCH_QUERY_TERMS][SEARCH_TERM_MAX+1];
+	const char	*end = query + strlen(query);
+	size_t		nb_terms = 0, nb = 0, k;
+	while(nb_terms < SEARCH_QUERY_TERMS && search_next_term(&query, end, terms[nb_terms]) > 0){
+		nb_terms++;
+	}
+	uint32_t *found = (uint32_t*)malloc((max + 1) * sizeof(uint32_t));
+	if(nb_terms == 0 || found == NULL){
+		free(found);
+		return -1;
+	}
+	//Newest messages first: live part, then segments from the newest
+	pthread_mutex_lock(&(index->mutex));
+	nb = search_live_find(&(index->live), terms, nb_terms, found, max);
+	for(k=index->nb_segments; k > 0 && nb < max; k--){
+		nb += search_segment_find(index->segments[k-1], terms, nb_terms, found + nb, max - nb);
+	}
+	for(k=0; k<nb; k++){
+		results[k] = index->docs[found[nb - 1 - k]];
+	}
+	pthread_mutex_unlock(&(index->mutex));
+	free(found);
+	return (int)nb;
+}
@@ -0,0 +1,174 @@
+// -----------------------------------------------------------------------------
+/**
+ * \file	search.h
+ * \author	Constantin MASSON
+ * \date	July 14, 2016
+ *
+ * \brief	Search words in the messages of a room (Inverted index)
+ * \note	C Library for the Unix Programming Project
+ *
+ * Each message saved in history gets an id (In order of the messages). The
+ * index gives, for each term, the ids of messages with this term (Postings).
+ * Messages are indexed by a background thread: broadcast only queues them.
+ *
+ * Last messages are indexed in memory (Live part, SEARCH_LIVE_DOCS messages),
+ * then the live part is frozen in a segment: sorted terms, postings encoded
+ * as deltas of ids in varint (Ids are increasing). A segment with as many
+ * messages as the previous one is merged with it (Like a binary counter): a
+ * room with N messages has log2(N / SEARCH_LIVE_DOCS) segments at most.
+ *
+ * A search intersects the postings of its terms, newest segment first, and
+ * stops once SEARCH_RESULTS_NB messages are found. Messages are sent from
+ * history (See history_send_frame).
+ * Index is in memory only: rebuilt from history when the room is restored.
+ */
+// -----------------------------------------------------------------------------
+
+#ifndef UNIXPROJECT_SEARCH_H
+#define UNIXPROJECT_SEARCH_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <ctype.h>
+#include <assert.h>
+#include <pthread.h>
+
+#include "wunixlib/sharedbuf.h"
+#include "wunixlib/workpool.h"
+#include "constants.h"
+#include "messaging.h"
+#include "history.h"
+
+#define SEARCH_TERM_MAX 32 //Longer terms are cut
+#define SEARCH_TERM_MIN 2 //Shorter terms are not indexed
+#define SEARCH_QUERY_TERMS 8 //Max terms of a search
+#define SEARCH_SEGMENTS_MAX 64
+
+
+// -----------------------------------------------------------------------------
+// Structures
+// -----------------------------------------------------------------------------
+
+/** \brief Message of the index (Position in history). */
+typedef struct _search_doc{
+	HistoryEntry	position;
+	uint32_t		len; //Size of the frame
+} SearchDoc;
+
+/** \brief Term of the live part (Ids not encoded). */
+typedef struct _search_live_term{
+	char		*term; //NULL if slot is free
+	uint32_t	*ids;
+	uint32_t	nb;
+	uint32_t	capacity;
+} SearchLiveTerm;
+
+/** \brief Live part of the index (Hash table of terms, open addressing). */
+typedef struct _search_live{
+	SearchLiveTerm	*terms;
+	size_t			capacity; //Power of 2
+	size_t			nb_terms;
+	uint32_t		nb_docs;
+} SearchLive;
+
+/** \brief Term of a segment. */
+typedef struct _search_term{
+	uint32_t	name; //Position of the term in names
+	uint32_t	nb; //Number of messages with this term
+	uint64_t	start; //Position of its postings
+	uint64_t	len; //Size of its postings
+} SearchTerm;
+
+/** \brief Frozen part of the index (Never changed once built). */
+typedef struct _search_segment{
+	SearchTerm	*terms; //Sorted by name
+	size_t		nb_terms;
+	char		*names; //Terms (With their '\0')
+	uint8_t		*postings;
+	uint32_t	nb_docs;
+} SearchSegment;
+
+/**
+ * \brief		Index of the messages of one room (Reference counted).
+ * \details		Protected by its own mutex (Indexer thread and searches).
+ */
+typedef struct _search_index{
+	pthread_mutex_t	mutex;
+	int				refcount;
+	SearchDoc		*docs; //Position of each message (Index is the id)
+	size_t			nb_docs;
+	size_t			docs_capacity;
+	SearchLive		live;
+	SearchSegment	*segments[SEARCH_SEGMENTS_MAX]; //Oldest first
+	size_t			nb_segments;
+} SearchIndex;
+
+
+// -----------------------------------------------------------------------------
+// Functions
+// -----------------------------------------------------------------------------
+
+/**
+ * \brief		Start the indexer thread.
+ * \details		Without it, messages are indexed by the caller.
+ *
+ * \return		1 if started, otherwise, -1
+ */
+int search_init(void);
+
+/**
+ * \brief		Create an empty index.
+ *
+ * \return		Index (One reference) or NULL if error
+ */
+SearchIndex* search_index_create(void);
+
+/**
+ * \brief		Get a new reference on the index.
+ *
+ * \param index	Index to retain
+ * \return		The index
+ */
+SearchIndex* search_index_retain(SearchIndex *index);
+
+/**
+ * \brief		Release a reference (Index freed with the last one).
+ *
+ * \param index	Index to release (May be NULL)
+ */
+void search_index_release(SearchIndex *index);
+
+/**
+ * \brief		Queue a frame saved in history for indexing.
+ *
+ * \param index	Index of the room
+ * \param frame	Frame saved (Retained until indexed)
+ * \param position	Position of the frame in history
+ */
+void search_index_push(SearchIndex *index, SharedBuffer *frame, const HistoryEntry *position);
+
+/**
+ * \brief		Queue the indexing of all frames already in history.
+ * \details		Must be called before any push (Ids follow the order of frames).
+ *
+ * \param index	Index of the room
+ * \param history	History of the room (Opened)
+ */
+void search_index_rebuild(SearchIndex *index, const History *history);
+
+/**
+ * \brief		Find the last messages with all the terms.
+ * \details		Only messages already indexed are found.
+ *
+ * \param index	Index where to search
+ * \param query	Terms separated by anything else than letters and digits
+ * \param results	Set to the messages found (Oldest first)
+ * \param max	Max number of results
+ * \return		Number of results, -1 if query has no valid term
+ */
+int search_index_find(SearchIndex *index, const char *query, SearchDoc *results, const size_t max);
+
+#endif
+
@@ -12,9 +12,12 @@
 #include "server.h"
 
 
+static volatile sig_atomic_t filter_reload = 0; //Set by SIGHUP (Banned terms file changed)
+static const char *filter_path = NULL;
+
 //Used for thread arguments
 struct thread_info{
-	int			socket;
+	User		*user;
 	ServerData	*server;
 };
 
@@ -26,28 +29,81 @@ void *client_handler(void *args){
 	//Recover parameters
 	fprintf(stdout, "New client request.\n");
 	struct thread_info *tinfo = (struct thread_info*)args;
-	char buff[MSG_MAX_SIZE];
-
-	//Create the new client user
-	ServerData *server = tinfo->server;
-	User *user = user_create("new_user");
-	if(user == NULL){
-		fprintf(stderr, "Unable to create the user for socket %d\n", tinfo->socket);
-		pthread_exit(NULL);
-	}
-	user->socket = tinfo->socket;
+	ServerData	*server	= tinfo->server;
+	User		*user	= tinfo->user;
+	char		*frame;
+	free(tinfo);
 
-	//Listen for message
+	server_data_lock(server);
+	server_data_watch_user(server, user);
 	while(server->is_working == 1 && user->connected == 1){
-		//TODO CRIT: Add exit process
-		memset(buff, 0x00, sizeof(buff));
-		recv(user->socket, buff, MSG_MAX_SIZE, 0);
-		messaging_server_exec_receive(server, user, buff);
+		//Process received frames one by one. Lock is released after each
+		//frame: since lock is fair, frames of all clients are processed in turn.
+		if((frame = frame_reader_next(&(user->reader))) != NULL){
+			server_data_touch_user(server, user);
+			messaging_server_exec_receive(server, user, frame);
+			__sync_add_and_fetch(&(server->nb_deferred), 1); //Counted before unlock (See upgrade)
+			server_data_unlock(server);
+			messaging_server_exec_deferred(server, user);
+			__sync_sub_and_fetch(&(server->nb_deferred), 1);
+			server_data_lock(server);
+			continue;
+		}
+		//Wait for data without lock, but read with lock: received data are
+		//always in server data when server is not locked (See upgrade).
+		server_data_unlock(server);
+		int ready = wait_readable(user->socket, -1);
+		server_data_lock(server);
+		//Stop if connection closed (Or error)
+		if(ready < 0 || frame_reader_fill(&(user->reader)) <= 0){
+			break;
+		}
 	}
 
-	//Free data
+	//Remove user from server (If connection lost without 'bye')
+	server_data_remove_connection(server, user);
+	server_data_unlock(server);
+
+	//Free data (Socket is closed once broadcasts in progress are written)
 	fprintf(stdout, "Client deconnected\n");
-	user_destroy(user);
+	user_release(user);
+	return NULL;
+}
+
+//Start the thread of a client connection (Iterator of list of connections)
+static int server_start_client(void *user, void *server){
+	struct thread_info *tinfo = (struct thread_info*)malloc(sizeof(struct thread_info));
+	pthread_t thread_id;
+	if(tinfo == NULL){
+		shutdown(((User*)user)->socket, SHUT_RDWR);
+		return 1;
+	}
+	tinfo->server	= (ServerData*)server;
+	tinfo->user		= (User*)user;
+	pthread_create(&thread_id, NULL, client_handler, (void*)tinfo);
+	pthread_detach(thread_id);
+	return 1;
+}
+
+void *timer_handler(void *args){
+	ServerData *server = (ServerData*)args;
+	struct timespec tick;
+	tick.tv_sec		= SERVER_TICK_MS / 1000;
+	tick.tv_nsec	= (SERVER_TICK_MS % 1000) * 1000000L;
+	while(server->is_working == 1){
+		nanosleep(&tick, NULL);
+		if(filter_reload == 1 && filter_path != NULL){
+			filter_reload = 0;
+			int nb = server_data_load_filter(server, filter_path);
+			if(nb >= 0){
+				fprintf(stdout, "%d banned terms reloaded from %s\n", nb, filter_path);
+			}
+		}
+		server_data_lock(server);
+		timer_wheel_tick(&(server->wheel));
+		server_data_unlock(server);
+	}
+	return NULL;
 }
 
 void server_start_listening_clients(ServerData *server, const int socket){
@@ -56,20 +112,44 @@ void server_start_listening_clients(ServerData *server, const int socket){
 		fprintf(stdout, "Server is already listening.\n");
 		return;
 	}
-	server->is_listening = TRUE;
+	struct pollfd	listeners[2];
+	int				k;
+	server->is_listening	= TRUE;
+	server->listen_socket	= socket;
+	listeners[0].fd			= socket;
+	listeners[1].fd			= server->unix_socket; //Ignored by poll if -1
+	for(k=0; k<2; k++){
+		listeners[k].events = POLLIN;
+		if(listeners[k].fd >= 0){
+			fcntl(listeners[k].fd, F_SETFL, fcntl(listeners[k].fd, F_GETFL) | O_NONBLOCK);
+		}
+	}
 	fprintf(stdout, "Server start listening for new clients.\n");
-	//Listen for client, start thread for each new connected
+	//Listen for client (TCP and unix socket), start thread for each new connected
 	while(server->is_listening == TRUE){
-		fprintf(stdout, "Wait for client...\n");
-		int client_socket = accept_client(socket); //accept new client
-		//Create thread args
-		struct thread_info tinfo;
-		pthread_t thread_id;
-		memset(&tinfo, 0x00, sizeof(tinfo));
-		tinfo.server	= server;
-		tinfo.socket	= client_socket;
-		pthread_create(&thread_id, NULL, client_handler, (void*)&tinfo);
-		pthread_detach(thread_id);
+		//Wait without lock, accept with lock (See upgrade)
+		if(TEMP_FAILURE_RETRY(poll(listeners, 2, -1)) < 0){
+			continue;
+		}
+		for(k=0; k<2; k++){
+			if((listeners[k].revents & POLLIN) == 0){
+				continue;
+			}
+			server_data_lock(server);
+			User *user			= NULL;
+			int client_socket	= accept_client(listeners[k].fd); //accept new client
+			if(client_socket >= 0){
+				user = server_data_add_connection(server, client_socket);
+			}
+			server_data_unlock(server);
+			if(user == NULL){
+				if(client_socket >= 0){
+					TEMP_FAILURE_RETRY(close(client_socket));
+				}
+				continue;
+			}
+			server_start_client(user, server);
+		}
 	}
 }
 
@@ -92,8 +172,21 @@ static void siginthandler(ServerData *server, int sig){
 	server->is_working = 0;
 }
 
+static void sighuphandler(int sig){
+	filter_reload = 1;
+}
+
 static void usage(char *name){
-	fprintf(stderr, "USAGE: %s port\n", name);
+	fprintf(stderr, "USAGE: %s port [-u] [-s path] [-w ms] [-f path] [-n name -a address -k path -l address [-j address]...]\n", name);
+	fprintf(stderr, "\t-u: take over the server running on this port (Hot upgrade)\n");
+	fprintf(stderr, "\t-s: also listen on this unix socket (Clients on the same host)\n");
+	fprintf(stderr, "\t-w: max time frames wait to be sent together (ms, 0 to disable)\n");
+	fprintf(stderr, "\t-f: file of banned terms in rooms (One per line, reloaded on SIGHUP)\n");
+	fprintf(stderr, "\t-n: name of this server in the cluster\n");
+	fprintf(stderr, "\t-a: address given to clients redirected here (host:port)\n");
+	fprintf(stderr, "\t-k: file of the secret shared by servers of the cluster (Needed by -l and -j)\n");
+	fprintf(stderr, "\t-l: listen for other servers of the cluster (Unix socket path, host:port or port on 127.0.0.1)\n");
+	fprintf(stderr, "\t-j: join a server of the cluster (Unix socket path or host:port)\n");
 	exit(EXIT_FAILURE);
 }
 
@@ -101,34 +194,158 @@ int main(int argc, char **argv){
 	system("clear");
 	fprintf(stdout, "Server start\n");
 
-	//check parameters (Must be: port_number)
-	if(argc != 2){
+	//check parameters (Must be: port_number [-u] [-s path] [-w ms] [-f path] [-n name -a address -k path -l address [-j address]...])
+	int opt, takeover = 0, nb_joins = 0, window = SERVER_OUTBOX_WINDOW_MS;
+	char *unix_path = NULL, *node_name = NULL, *node_address = NULL, *link_address = NULL, *secret_path = NULL;
+	char **joins = (char**)calloc(argc, sizeof(char*));
+	while((opt = getopt(argc, argv, "us:w:f:n:a:k:l:j:")) != -1){
+		switch(opt){
+			case 'u':
+				takeover = 1;
+				break;
+			case 's':
+				unix_path = optarg;
+				break;
+			case 'w':
+				window = atoi(optarg);
+				break;
+			case 'f':
+				filter_path = optarg;
+				break;
+			case 'n':
+				node_name = optarg;
+				break;
+			case 'a':
+				node_address = optarg;
+				break;
+			case 'k':
+				secret_path = optarg;
+				break;
+			case 'l':
+				link_address = optarg;
+				break;
+			case 'j':
+				joins[nb_joins++] = optarg;
+				break;
+			default:
+				usage(argv[0]);
+		}
+	}
+	if(optind != argc - 1 || joins == NULL){
 		usage(argv[0]);
 	}
+	int port = atoi(argv[optind]);
+	char upgrade_path[108], snapshot_path[108], history_dir[108], mailbox_dir[108];
+	snprintf(upgrade_path, sizeof(upgrade_path), SERVER_UPGRADE_PATH, port);
+	snprintf(snapshot_path, sizeof(snapshot_path), SERVER_SNAPSHOT_PATH, port);
+	snprintf(history_dir, sizeof(history_dir), SERVER_HISTORY_DIR, port);
+	snprintf(mailbox_dir, sizeof(mailbox_dir), SERVER_MAILBOX_DIR, port);
 
 	//Init signal process
 	//TODO To update
 	sigset_t mask, oldmask;
 	sethandler(SIG_IGN, SIGPIPE);
+	sethandler(sighuphandler, SIGHUP);
 	//sethandler(siginthandler, SIGINT);
 	sigemptyset(&mask);
 	sigaddset(&mask, SIGINT);
 	//sigprocmask(SIG_BLOCK, &mask, &oldmask);
 
-	//Create the server socket, bind it, start listening
-	int sock = create_server_tcp_socket(atoi(argv[1]), BACKLOG);
-	if(sock < 0){
-		fprintf(stderr, "Unable to start the server (Unable to create the socket)...\n");
-		return EXIT_FAILURE;
-	}
-
 	//Initialize server data
 	ServerData server;
 	server_data_init(&server);
-	User *admin = user_create("admin"); //Admin user just for the default room
-	server_data_add_room(&server, admin, ROOM_WELCOME_NAME);
+	char default_name[NODE_MAX_SIZE+1], default_address[NODE_ADDRESS_SIZE+1];
+	snprintf(default_name, sizeof(default_name), "node%d", port);
+	snprintf(default_address, sizeof(default_address), "127.0.0.1:%d", port);
+	cluster_set_node(&server, (node_name == NULL) ? default_name : node_name,
+			(node_address == NULL) ? default_address : node_address);
+	server_data_set_history(&server, history_dir); //Before any room
+	search_init(); //Indexer of room messages (Before any room)
+	mailbox_open(&(server.mailbox), mailbox_dir); //Before any user
+
+	//Recover sockets and data from the running server (Hot upgrade)
+	int sock = -1;
+	if(takeover == 1){
+		if(upgrade_takeover(&server, upgrade_path) == 1){
+			sock = server.listen_socket;
+		}
+		else{
+			fprintf(stderr, "Unable to take over a running server, start a new one.\n");
+		}
+	}
+
+	//Otherwise, create the server socket, bind it, start listening
+	if(sock < 0){
+		sock = create_server_tcp_socket(port, BACKLOG);
+		if(sock < 0){
+			fprintf(stderr, "Unable to start the server (Unable to create the socket)...\n");
+			return EXIT_FAILURE;
+		}
+		User *admin = user_create("admin"); //Admin user just for the default room
+		server_data_add_room(&server, admin, ROOM_WELCOME_NAME);
+		//Recreate rooms of the last run
+		int nb = snapshot_load(&server, snapshot_path);
+		if(nb >= 0){
+			fprintf(stdout, "%d rooms restored from %s\n", nb, snapshot_path);
+		}
+	}
+
+	//Unix socket (Unless already recovered from the running server)
+	if(unix_path != NULL && server.unix_socket < 0){
+		server.unix_socket = create_server_unix_socket(unix_path, SOCK_STREAM, BACKLOG);
+		if(server.unix_socket < 0){
+			fprintf(stderr, "Unable to listen on the unix socket %s\n", unix_path);
+		}
+	}
+
+	//Banned terms in rooms
+	if(filter_path != NULL){
+		int nb = server_data_load_filter(&server, filter_path);
+		if(nb >= 0){
+			fprintf(stdout, "%d banned terms loaded from %s\n", nb, filter_path);
+		}
+	}
+
+	//Next version of the server will take over from here
+	upgrade_start_listening(&server, upgrade_path);
+	snapshot_start(&server, snapshot_path);
+	archiver_start(&server); //Old messages of rooms compressed, then removed
+
+	//Links with the other servers of the cluster (Only nodes knowing the secret)
+	int has_secret = (secret_path != NULL && cluster_set_secret(&server, secret_path) == 1);
+	if((link_address != NULL || nb_joins > 0) && has_secret == 0){
+		fprintf(stderr, "No cluster secret (-k): server stays out of the cluster\n");
+	}
+	if(server.link_socket >= 0 || (link_address != NULL && has_secret == 1)){
+		cluster_start_listening(&server, (link_address == NULL) ? "" : link_address);
+	}
+	//Links recovered from the running server are already open
+	int recovered = list_size(&(server.list_nodes));
+	cluster_start_links(&server);
+	for(opt=0; opt<nb_joins && has_secret == 1 && recovered == 0; opt++){
+		cluster_join(&server, joins[opt]);
+	}
+	free(joins);
+
+	//Frames for the same socket are sent together
+	if(window > 0 && outbox_init(window, SERVER_OUTBOX_BYTES) == 1){
+		messaging_set_writer(outbox_write, outbox_sendfile);
+		messaging_set_holder(outbox_hold, outbox_release);
+		messaging_set_waiter(outbox_wait);
+	}
+
+	//Workers for broadcast in large rooms
+	fanout_init(SERVER_FANOUT_WORKERS);
+
+	//Start the idle connection timer
+	pthread_t timer_thread;
+	pthread_create(&timer_thread, NULL, timer_handler, (void*)&server);
+	pthread_detach(timer_thread);
 
-	//Start listening for new clients
+	//Start listening for new clients (And resume clients recovered by upgrade)
+	server_data_lock(&server);
+	list_iterate_args(&(server.list_connections), server_start_client, &server);
+	server_data_unlock(&server);
 	server_start_listening_clients(&server, sock);
 
 	//Close the socket
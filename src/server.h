@@ -16,16 +16,24 @@
 #include <stdlib.h>
 #include <signal.h>
 #include <pthread.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
 
 #include "wunixlib/network.h"
 #include "wunixlib/sighandler.h"
 #include "wunixlib/assets.h"
 #include "wunixlib/stream.h"
+#include "wunixlib/outbox.h"
 
 #include "server_data.h"
 #include "user.h"
 #include "messaging.h"
 #include "messaging_server.h"
+#include "upgrade.h"
+#include "snapshot.h"
+#include "archiver.h"
+#include "cluster.h"
 #include "constants.h"
 
 /** \brief Max number of client possible in accept queue */
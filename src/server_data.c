@@ -12,12 +12,183 @@
 #include "server_data.h"
 
 
+// -----------------------------------------------------------------------------
+// Static functions
+// -----------------------------------------------------------------------------
+
+//Idle timer expired: first time, ping user. Second time, close connection.
+static void server_data_idle_timeout(TimerWheel *wheel, Timer *timer, void *data){
+	User		*user	= (User*)data;
+	ServerData	*server	= (ServerData*)wheel->data;
+	if(user->ping_sent == 0){
+		user->ping_sent = 1;
+		server->stats.pings_sent++;
+		messaging_send_ping(user->socket);
+		timer_wheel_add(wheel, timer, SERVER_PING_TICKS);
+		return;
+	}
+	//No answer: shutdown the socket, user thread will stop and clean data
+	fprintf(stdout, "[USER] Connection of '%s' (socket %d) idle, closing it\n", user->login, user->socket);
+	server->stats.connections_reaped++;
+	shutdown(user->socket, SHUT_RDWR);
+}
+
+//Send the change of a local user to all nodes of the cluster
+static void server_data_publish_user(ServerData *server, User *user, int gone){
+	LinkedlistNode *current;
+	if(user->node != NULL){
+		return; //Change comes from its node
+	}
+	for(current = server->list_nodes.first; current != NULL; current = current->next){
+		Node *node = (Node*)current->data;
+		if(gone == 1){
+			messaging_send_node_user_gone(node->socket, user->login);
+		}
+		else{
+			messaging_send_node_user(node->socket, user->login, (user->room == NULL) ? "" : user->room->name);
+		}
+	}
+}
+
+//Send the change of a local room to all nodes of the cluster
+static void server_data_publish_room(ServerData *server, Room *room, int gone){
+	LinkedlistNode *current;
+	if(room->node != NULL || room == server->room_welcome){
+		return; //Change comes from its node (Welcome room is on each node)
+	}
+	for(current = server->list_nodes.first; current != NULL; current = current->next){
+		Node *node = (Node*)current->data;
+		if(gone == 1){
+			messaging_send_node_room_gone(node->socket, room->name);
+		}
+		else{
+			messaging_send_node_room(node->socket, room->name, room->owner_name);
+		}
+	}
+}
+
+
+//Open the history of a room hosted here (And index its messages)
+static void server_data_open_history(ServerData *server, Room *room){
+	if(server->history_dir[0] == '\0'){
+		return;
+	}
+	if(history_open(&(room->history), server->history_dir, room->name) != 1){
+		fprintf(stderr, "[ERR] Unable to open history of room '%s'\n", room->name);
+		return;
+	}
+	if(room->history.last_seq > room->seq){
+		room->seq = room->history.last_seq; //Numbers go on after a restart
+	}
+	if((room->search = search_index_create()) != NULL){
+		search_index_rebuild(room->search, &(room->history)); //Messages already saved
+	}
+}
+
+
 void server_data_init(ServerData *data){
 	assert(data != NULL);
-	list_init(&(data->list_users), NULL); //User is destroyer from the thread.
+	list_init(&(data->list_connections), NULL); //User is destroyed from the thread.
+	list_init(&(data->list_users), NULL);
 	list_init(&(data->list_rooms), room_free_elt);
+	list_init(&(data->list_nodes), NULL); //Node is destroyed from its thread.
+	room_index_init(&(data->rooms_index));
+	intern_init(&(data->users_names), 1024);
+	intern_init(&(data->rooms_names), 256);
+	ticket_lock_init(&(data->lock));
+	memset(&(data->stats), 0x00, sizeof(ServerStats));
+	timer_wheel_init(&(data->wheel), data);
+	hash_ring_init(&(data->ring), NODE_VNODES);
+	data->rooms_snapshot = NULL;
+	data->rooms_version	= 0;
+	data->bdcast_stamp	= 0;
+	data->filter		= NULL;
+	data->history_dir[0] = '\0';
+	mailbox_init(&(data->mailbox));
+	data->node_name[0]	= '\0';
+	data->node_address[0] = '\0';
+	data->node_secret[0] = '\0';
+	data->room_welcome	= NULL;
+	data->listen_socket	= -1;
+	data->unix_socket	= -1;
+	data->link_socket	= -1;
 	data->is_listening	= 0;
 	data->is_working	= 1;
+	data->nb_deferred	= 0;
+}
+
+void server_data_lock(ServerData *server){
+	ticket_lock(&(server->lock));
+}
+
+void server_data_unlock(ServerData *server){
+	ticket_unlock(&(server->lock));
+}
+
+int server_data_set_history(ServerData *server, const char *dir){
+	if(mkdir(dir, 0755) != 0 && errno != EEXIST){
+		fprintf(stderr, "[ERR] Unable to create history directory %s\n", dir);
+		server->history_dir[0] = '\0';
+		return -1;
+	}
+	snprintf(server->history_dir, sizeof(server->history_dir), "%s", dir);
+	return 1;
+}
+
+int server_data_load_filter(ServerData *server, const char *path){
+	AcMatcher *filter = ac_matcher_load(path);
+	if(filter == NULL){
+		fprintf(stderr, "[ERR] Unable to load banned terms from %s\n", path);
+		return -1;
+	}
+	//No banned term: messages are not scanned at all
+	int nb = filter->nb_patterns;
+	if(nb == 0){
+		ac_matcher_destroy(filter);
+		filter = NULL;
+	}
+	server_data_lock(server);
+	AcMatcher *old = server->filter;
+	server->filter = filter;
+	server_data_unlock(server);
+	ac_matcher_destroy(old); //Only used with lock
+	return nb;
+}
+
+User* server_data_add_connection(ServerData *server, const int socket){
+	User *user = user_create("new_user");
+	if(user == NULL){
+		return NULL;
+	}
+	user->socket = socket;
+	frame_reader_init(&(user->reader), socket);
+	if(list_append(&(server->list_connections), user) != 1){
+		user_destroy(user);
+		return NULL;
+	}
+	return user;
+}
+
+void server_data_remove_connection(ServerData *server, User *user){
+	server_data_unwatch_user(user);
+	list_remove_where(&(server->list_connections), (void*)&(user->socket), user_match_socket);
+	if(user->connected == 1 && user->id != 0){
+		server_data_remove_user(server, user);
+	}
+}
+
+void server_data_watch_user(ServerData *server, User *user){
+	timer_init(&(user->idle_timer), server_data_idle_timeout, user);
+	server_data_touch_user(server, user);
+}
+
+void server_data_touch_user(ServerData *server, User *user){
+	user->ping_sent = 0;
+	timer_wheel_add(&(server->wheel), &(user->idle_timer), SERVER_IDLE_TICKS);
+}
+
+void server_data_unwatch_user(User *user){
+	timer_wheel_remove(&(user->idle_timer));
 }
 
 int server_data_add_user(ServerData *server, User *user){
@@ -26,32 +197,52 @@ int server_data_add_user(ServerData *server, User *user){
 		return -1;
 	}
 	//Check name is not used
-	if(server_data_name_is_used(&(server->list_users), user->login) == 1){
+	if(server_data_name_is_used(server, user->login) == 1){
 		return -2;
 	}
-	//Add name in server
+	//Intern name (Same id is given back while the user owns a room)
+	InternEntry *entry = intern_add(&(server->users_names), user->login);
+	if(entry == NULL){
+		return -1;
+	}
+	intern_retain(entry); //Released with the user
+	entry->data	= user;
+	user->id	= entry->id;
 	list_append(&(server->list_users), user); //Add user in server list
+	server_data_publish_user(server, user, 0);
 	return 1;
 }
 
 int server_data_remove_user(ServerData *server, User *user){
-	//TODO Add mutex on the user list
+	server_data_publish_user(server, user, 1);
+	//Unbind name from user
+	InternEntry *entry = intern_get(&(server->users_names), user->login);
+	if(entry != NULL && entry->data == user){
+		entry->data = NULL;
+		intern_release(&(server->users_names), entry);
+	}
 	//Recover current user room
-	Room* room = list_get_where(&(server->list_rooms), (void*)(user->room), room_match_name);
+	Room* room = user->room;
 	if(room == NULL){
 		user->connected = 0; //Disconnect anyway
-		list_remove_where(&(server->list_users), (void*)(user->login), user_match_name);
+		list_remove_where(&(server->list_users), (void*)&(user->id), user_match_id);
 		return -1;
 	}
 	//Remove user from room and disconnect user
 	room_remove_user(room, user);
+	server_data_invalidate_rooms(server);
 	user->connected = 0;
-	list_remove_where(&(server->list_users), (void*)(user->login), user_match_name);
+	list_remove_where(&(server->list_users), (void*)&(user->id), user_match_id);
 	return 1;
 }
 
-int server_data_name_is_used(const Linkedlist *list, char *name){
-	return list_contains_where(list, (void*)name, user_match_name);
+int server_data_name_is_used(const ServerData *server, const char *name){
+	return server_data_get_user(server, name) != NULL;
+}
+
+User* server_data_get_user(const ServerData *server, const char *name){
+	InternEntry *entry = intern_get(&(server->users_names), name);
+	return (entry == NULL) ? NULL : (User*)entry->data;
 }
 
 int server_data_add_room(ServerData *server, User *user, char *name){
@@ -60,22 +251,83 @@ int server_data_add_room(ServerData *server, User *user, char *name){
 		return -1;
 	}
 	//Check name used in server
-	if(server_data_room_is_used(&(server->list_rooms), name) == 1){
+	if(server_data_room_is_used(server, name) == 1){
 		return -2;
 	}
 	//Create room
-	Room *room = room_create(user, name);
+	InternEntry *entry = intern_add(&(server->rooms_names), name);
+	Room *room = (entry == NULL) ? NULL : room_create(user, name);
 	if(room == NULL){
+		intern_release(&(server->rooms_names), entry);
+		return -3;
+	}
+	if(room_index_add(&(server->rooms_index), room) != 1){
+		room_destroy(room);
+		intern_release(&(server->rooms_names), entry);
 		return -3;
 	}
+	//Names are kept with the room (Owner keeps its id to close it later)
+	intern_retain(entry);
+	if(room->owner_id != 0){
+		intern_retain(intern_get(&(server->users_names), room->owner_name));
+	}
+	room->id	= entry->id;
+	entry->data	= room;
+	if(room->node == NULL){
+		server_data_open_history(server, room);
+	}
 	list_append(&(server->list_rooms), room);
+	server->rooms_version++;
+	server_data_invalidate_rooms(server);
+	if(strcmp(name, ROOM_WELCOME_NAME) == 0){
+		server->room_welcome = room;
+	}
+	server_data_publish_room(server, room, 0);
 	return 1;
 }
 
+Node* server_data_room_node(const ServerData *server, const char *name){
+	Room *room = server_data_get_room(server, name);
+	if(room != NULL){
+		return room->node;
+	}
+	void *member = hash_ring_get(&(server->ring), name);
+	return (member == NULL || member == (void*)server) ? NULL : (Node*)member;
+}
+
+int server_data_restore_room(ServerData *server, char *name, const char *owner, int has_owner, Node *node){
+	User user;
+	memset(&user, 0x00, sizeof(User));
+	strcpy(user.login, owner);
+	user.node = node; //Room is hosted by the node of its owner
+	InternEntry *entry = NULL;
+	if(has_owner == 1){
+		entry = intern_add(&(server->users_names), owner);
+		if(entry == NULL){
+			return -3;
+		}
+		intern_retain(entry); //Until retained by the room
+		user.id = entry->id;
+	}
+	int err = server_data_add_room(server, &user, name);
+	intern_release(&(server->users_names), entry);
+	return err;
+}
+
+void server_data_adopt_room(ServerData *server, Room *room){
+	if(room->node == NULL){
+		return;
+	}
+	room->node = NULL;
+	server_data_open_history(server, room);
+	server->rooms_version++;
+	server_data_invalidate_rooms(server);
+	server_data_publish_room(server, room, 0);
+}
+
 int server_data_remove_room(ServerData *server, User *user, char *name){
-	//TODO Add mutex on the room list
 	//Check if room exists
-	Room* room = list_get_where(&(server->list_rooms), (void*)name, room_match_name);
+	Room* room = server_data_get_room(server, name);
 	if(room == NULL){
 		return -1;
 	}
@@ -84,14 +336,109 @@ int server_data_remove_room(ServerData *server, User *user, char *name){
 		return -2;
 	}
 	//Check whether user is owner
-	if(strcmp(user->login, room->owner_name) != 0){
+	if(user->id != room->owner_id){
 		return -3;
 	}
-	//Actually delete the room
-	int err = list_free_where(&(server->list_rooms), (void*)name, room_match_name);
+	//Only its home node can close it
+	if(room->node != NULL){
+		return -5;
+	}
+	return server_data_delete_room(server, room);
+}
+
+int server_data_delete_room(ServerData *server, Room *room){
+	server_data_publish_room(server, room, 1);
+	InternEntry *entry = intern_get(&(server->rooms_names), room->name);
+	entry->data = NULL;
+	intern_release(&(server->rooms_names), entry);
+	if(room->owner_id != 0){
+		intern_release(&(server->users_names), intern_get(&(server->users_names), room->owner_name));
+	}
+	room_index_remove(&(server->rooms_index), room);
+	history_remove(&(room->history));
+	server->rooms_version++;
+	server_data_invalidate_rooms(server);
+	int err = list_free_where(&(server->list_rooms), (void*)&(room->id), room_match_id);
 	return (err == 1) ? 1 : -4;
 }
 
-int server_data_room_is_used(const Linkedlist *list, char *name){
-	return list_contains_where(list, (void*)name, room_match_name);
+int server_data_room_is_used(const ServerData *server, const char *name){
+	return server_data_get_room(server, name) != NULL;
+}
+
+Room* server_data_get_room(const ServerData *server, const char *name){
+	InternEntry *entry = intern_get(&(server->rooms_names), name);
+	return (entry == NULL) ? NULL : (Room*)entry->data;
+}
+
+int server_data_move_user(ServerData *server, User *user, Room *room){
+	if(user->room != NULL){
+		room_remove_user(user->room, user);
+	}
+	server_data_invalidate_rooms(server);
+	int err = room_add_user(room, user);
+	server_data_publish_user(server, user, 0);
+	return err;
+}
+
+
+// -----------------------------------------------------------------------------
+// Rooms list snapshot
+// -----------------------------------------------------------------------------
+
+//Used to build the rooms list (Iterator on list of rooms)
+struct rooms_builder{
+	SharedBuffer	*buffer;
+	char			frame[MSG_MAX_SIZE]; //Current message
+	size_t			len; //Current message length
+	int				err;
+};
+
+//Add the current message in the buffer (With its '\0')
+static void server_data_rooms_flush(struct rooms_builder *builder){
+	if(sharedbuf_append(&(builder->buffer), builder->frame, builder->len + 1) != 1){
+		builder->err = 1;
+	}
+	builder->len = sprintf(builder->frame, "%s", MSG_TYPE_ROOMS MSG_DELIMITER);
+}
+
+static int server_data_rooms_add(void *data, void *args){
+	Room					*room		= (Room*)data;
+	struct rooms_builder	*builder	= (struct rooms_builder*)args;
+	char					entry[ROOM_MAX_SIZE + 16];
+	int						len;
+	len = sprintf(entry, "%s:%d,", room->name, list_size(&(room->list_users)));
+	//Start a new message if this one is full
+	if(builder->len + len >= MSG_MAX_SIZE){
+		server_data_rooms_flush(builder);
+	}
+	memcpy(builder->frame + builder->len, entry, len + 1);
+	builder->len += len;
+	return 1;
+}
+
+SharedBuffer* server_data_get_rooms(ServerData *server){
+	//Build the list only if outdated
+	if(server->rooms_snapshot == NULL){
+		struct rooms_builder builder;
+		builder.buffer	= sharedbuf_create(MSG_MAX_SIZE);
+		builder.err		= 0;
+		builder.len		= sprintf(builder.frame, "%s", MSG_TYPE_ROOMS MSG_DELIMITER);
+		if(builder.buffer == NULL){
+			return NULL;
+		}
+		list_iterate_args(&(server->list_rooms), server_data_rooms_add, &builder);
+		server_data_rooms_flush(&builder);
+		if(builder.err == 1){
+			sharedbuf_release(builder.buffer);
+			return NULL;
+		}
+		server->rooms_snapshot = builder.buffer;
+	}
+	return sharedbuf_retain(server->rooms_snapshot);
+}
+
+void server_data_invalidate_rooms(ServerData *server){
+	sharedbuf_release(server->rooms_snapshot);
+	server->rooms_snapshot = NULL;
 }
@@ -13,27 +13,85 @@
 #define UNIXPROJECT_SERVER_DATA_H
 
 #include <signal.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/stat.h>
 
 #include "wunixlib/linkedlist.h"
+#include "wunixlib/intern.h"
+#include "wunixlib/ticketlock.h"
+#include "wunixlib/timerwheel.h"
+#include "wunixlib/sharedbuf.h"
+#include "wunixlib/hashring.h"
+#include "wunixlib/acmatcher.h"
 #include "constants.h"
 #include "user.h"
 #include "room.h"
+#include "room_index.h"
+#include "node.h"
+#include "mailbox.h"
 
 
 // -----------------------------------------------------------------------------
 // Structures / Data
 // -----------------------------------------------------------------------------
 
+/**
+ * \brief		Server counters (Protected by the server lock).
+ */
+typedef struct _server_stats{
+	unsigned long frames_received; //Frames processed from clients
+	unsigned long frames_throttled; //Frames refused by rate limit
+	unsigned long frames_sanitized; //Chat messages with invalid UTF-8 (Replaced)
+	unsigned long frames_filtered; //Room messages refused (Banned term)
+	unsigned long frames_repeated; //Room messages dropped (Same as a recent one)
+	unsigned long pings_sent; //Pings sent to idle connections
+	unsigned long connections_reaped; //Connections closed for inactivity
+	unsigned long connections_compressed; //Connections sending compressed data
+} ServerStats;
+
 /**
  * \brief		Represents a server.
  * \details		Keep a list of all connected users and several data about
  * 				server status.
+ * \details		User and room names are interned: each name has a stable id
+ * 				and the intern entry points to the current user / room object.
+ * \details		Users and rooms of other nodes of the cluster are also here
+ * 				(With their node set). Changes of local ones are sent to nodes.
+ * \warning		Data are shared by all client threads, server must be locked
+ * 				before any use (Except for the status flags).
+ * 				Lock is fair: threads get it in arrival order.
  */
 typedef struct _server_data{
 	volatile sig_atomic_t is_listening;
 	volatile sig_atomic_t is_working;
+	size_t nb_deferred; //Client threads writing without lock (See messaging_server_exec_deferred)
+	int listen_socket; //Socket where clients connect
+	int unix_socket; //Socket where same host clients connect (-1 if none)
+	int link_socket; //Socket where other nodes of the cluster connect (-1 if none)
+	TicketLock lock; //Protect all data below
+	Linkedlist list_connections; //All client connections (Even before 'connect')
 	Linkedlist list_users; //List of connected users.
 	Linkedlist list_rooms;
+	RoomIndex rooms_index; //Rooms sorted by name
+	InternTable users_names; //Login -> id (data: connected User or NULL)
+	InternTable rooms_names; //Room name -> id (data: Room or NULL)
+	Room *room_welcome; //Default room (Set when room ROOM_WELCOME_NAME is added)
+	TimerWheel wheel; //Idle timer of each connection
+	SharedBuffer *rooms_snapshot; //Serialized list of rooms (NULL if outdated)
+	unsigned long rooms_version; //Incremented each time a room is added / removed
+	ServerStats stats;
+	Linkedlist list_nodes; //Links with other servers of the cluster (See cluster.h)
+	char node_name[NODE_MAX_SIZE+1]; //Name of this server in the cluster
+	char node_address[NODE_ADDRESS_SIZE+1]; //Where clients connect this server
+	char node_secret[NODE_SECRET_SIZE+1]; //Shared by all nodes (Sent in node_hello)
+	HashRing ring; //Node where each new room is placed (Node* or this ServerData*)
+	unsigned long bdcast_stamp; //Incremented for each broadcast forwarded to nodes
+	AcMatcher *filter; //Banned terms in rooms (NULL if none)
+	char history_dir[HISTORY_PATH_SIZE]; //Where rooms messages are saved (Empty if not saved)
+	Mailbox mailbox; //Whispers for offline users (Own locks, see mailbox.h)
 } ServerData;
 
 
@@ -49,6 +107,93 @@ typedef struct _server_data{
  */
 void server_data_init(ServerData *server);
 
+/**
+ * \brief			Lock the server data (Wait for its turn).
+ *
+ * \param server	Server to lock
+ */
+void server_data_lock(ServerData *server);
+
+/**
+ * \brief			Unlock the server data.
+ * \warning			Must have been locked by the caller.
+ *
+ * \param server	Server to unlock
+ */
+void server_data_unlock(ServerData *server);
+
+/**
+ * \brief			Save messages of the rooms of this server in the directory.
+ * \details			Must be set before rooms are added (Directory is created).
+ *
+ * \param server	Server to set
+ * \param dir		Directory of histories
+ * \return			1 if success, otherwise, -1 (Messages are not saved)
+ */
+int server_data_set_history(ServerData *server, const char *dir);
+
+/**
+ * \brief			Load the banned terms of rooms (Replace the current ones).
+ * \details			Terms are compiled before locking the server. Current
+ * 					terms are kept if file can't be read.
+ * \warning			Server must not be locked by the caller.
+ *
+ * \param server	Server where to set the terms
+ * \param path		File with one term per line (See ac_matcher_load)
+ * \return			Number of terms loaded or -1 if error
+ */
+int server_data_load_filter(ServerData *server, const char *path);
+
+/**
+ * \brief			Create the user for a new client connection.
+ * \details			User is added in the list of connections (Not connected
+ * 					in server until its 'connect' message).
+ *
+ * \param server	Server where client is connected
+ * \param socket	Client socket
+ * \return			The created user or NULL if internal error (malloc)
+ */
+User* server_data_add_connection(ServerData *server, const int socket);
+
+/**
+ * \brief			Remove a client connection.
+ * \details			User is also removed from server if was connected.
+ * 					User is not destroyed and its socket is not closed.
+ *
+ * \param server	Server where client is connected
+ * \param user		User of this connection
+ */
+void server_data_remove_connection(ServerData *server, User *user);
+
+/**
+ * \brief			Start watching activity of a new connection.
+ * \details			If no activity during SERVER_IDLE_TICKS, a ping is sent.
+ * 					If still no activity SERVER_PING_TICKS later, the
+ * 					connection is shut down.
+ * \warning			Server must be locked.
+ *
+ * \param server	Server where user is connected
+ * \param user		User to watch
+ */
+void server_data_watch_user(ServerData *server, User *user);
+
+/**
+ * \brief			Reset the idle timer of the user (Activity received).
+ * \warning			Server must be locked.
+ *
+ * \param server	Server where user is connected
+ * \param user		User who was active
+ */
+void server_data_touch_user(ServerData *server, User *user);
+
+/**
+ * \brief			Stop watching the user activity.
+ * \warning			Server must be locked.
+ *
+ * \param user		User to stop watching
+ */
+void server_data_unwatch_user(User *user);
+
 /**
  * \brief			Add the user in the server
  * \details			User shouldn't be in the server list already.
@@ -76,11 +221,20 @@ int server_data_remove_user(ServerData *server, User *user);
 /**
  * \brief			Check whether the given name is already used in the server
  *
- * \param list		List where to check.
+ * \param server	Server where to check.
  * \param name		User name
- * \return			1 if is already used yet in the list, otherwise, return 0
+ * \return			1 if is already used in the server, otherwise, return 0
  */
-int server_data_name_is_used(const Linkedlist *list, char *name);
+int server_data_name_is_used(const ServerData *server, const char *name);
+
+/**
+ * \brief			Recover a connected user from its name.
+ *
+ * \param server	Server where to look for
+ * \param name		User name
+ * \return			The user or NULL if not connected
+ */
+User* server_data_get_user(const ServerData *server, const char *name);
 
 /**
  * \brief			Add a room in the server.
@@ -97,6 +251,42 @@ int server_data_name_is_used(const Linkedlist *list, char *name);
  */
 int server_data_add_room(ServerData *server, User *user, char *name);
 
+/**
+ * \brief			Get the node where this room is (Or must be) hosted.
+ * \details			An existing room stays on its home node. A new room is
+ * 					placed on the node given by the hash ring of room names.
+ *
+ * \param server	Server where to look for
+ * \param name		Room's name
+ * \return			The node or NULL if hosted by this server
+ */
+Node* server_data_room_node(const ServerData *server, const char *name);
+
+/**
+ * \brief			Recreate a room saved before (Snapshot or upgrade).
+ * \details			Owner doesn't have to be connected: its name is interned
+ * 					so that the owner gets the room back when connected.
+ * \warning			Valid parameters expected (Not null)
+ *
+ * \param server	Server where to add room
+ * \param name		Room's name
+ * \param owner		Name of the owner
+ * \param has_owner	0 if room has no owner (Like welcome room), otherwise 1
+ * \param node		Home node of the room (NULL if this server)
+ * \return			Same as server_data_add_room
+ */
+int server_data_restore_room(ServerData *server, char *name, const char *owner, int has_owner, Node *node);
+
+/**
+ * \brief			Host here a room of another node (Its node is lost).
+ * \details			History of the room is opened and other nodes are told
+ * 					(node_room). Nothing done if room is already hosted here.
+ *
+ * \param server	Server of this node
+ * \param room		Room to adopt
+ */
+void server_data_adopt_room(ServerData *server, Room *room);
+
 /**
  * \brief			Remove the room from server.
  * \details			Room must be owned by this user and exists in the server.
@@ -109,18 +299,69 @@ int server_data_add_room(ServerData *server, User *user, char *name);
  * 					-1 if room is not in server,
  * 					-2 if room is not empty,
  * 					-3 if user is not owner,
- * 					-4 if internal error (Unable to free data)
+ * 					-4 if internal error (Unable to free data),
+ * 					-5 if room is hosted by another node
  */
 int server_data_remove_room(ServerData *server, User *user, char *name);
 
+/**
+ * \brief			Delete the room from server (Without any check).
+ * \details			Room must be empty. Room is freed.
+ *
+ * \param server	Server where to remove room
+ * \param room		Room to delete
+ * \return			1 if successfully removed, otherwise, return -4 (Unable to free data)
+ */
+int server_data_delete_room(ServerData *server, Room *room);
+
+/**
+ * \brief			Move the user in the given room.
+ * \details			User leaves its current room first (If any).
+ *
+ * \param server	Server where user is
+ * \param user		User to move
+ * \param room		Room where to place user
+ * \return			1 if successfully moved, otherwise, return -1
+ */
+int server_data_move_user(ServerData *server, User *user, Room *room);
+
+/**
+ * \brief			Get the serialized list of rooms (Name and number of users).
+ * \details			The list is built once and kept until rooms or their
+ * 					users change. It is ready to be written on a socket:
+ * 					one or several MSG_TYPE_ROOMS messages (With their '\0').
+ * \warning			Returned buffer must be released after use.
+ *
+ * \param server	Server where rooms are
+ * \return			The buffer (Retained) or NULL if internal error (malloc)
+ */
+SharedBuffer* server_data_get_rooms(ServerData *server);
+
+/**
+ * \brief			Mark the serialized list of rooms as outdated.
+ * \details			Called each time a room or its users change.
+ *
+ * \param server	Server where rooms changed
+ */
+void server_data_invalidate_rooms(ServerData *server);
+
 /**
  * \brief			Check whether the given name is already used by a room in server.
  *
- * \param list		List of rooms in server.
+ * \param server	Server where to check.
  * \param name		Name to check
  * \return			1 if is already used, otherwise, return 0
  */
-int server_data_room_is_used(const Linkedlist *list, char *name);
+int server_data_room_is_used(const ServerData *server, const char *name);
+
+/**
+ * \brief			Recover a room from its name.
+ *
+ * \param server	Server where to look for
+ * \param name		Room name
+ * \return			The room or NULL if doesn't exists
+ */
+Room* server_data_get_room(const ServerData *server, const char *name);
 
 
 
@@ -0,0 +1,152 @@
+// -----------------------------------------------------------------------------
+/**
+ * \file	snapshot.c
+ * \author	Constantin MASSON
+ * \date	July 3, 2016
+ *
+ * \brief	Snapshot of rooms on disk (Restored at server start)
+ * \note	C Library for the Unix Programming Project
+ */
+// -----------------------------------------------------------------------------
+
+#include "snapshot.h"
+
+
+//Used for thread arguments
+struct snapshot_info{
+	ServerData	*server;
+	char		path[108];
+};
+
+
+// -----------------------------------------------------------------------------
+// Static functions
+// -----------------------------------------------------------------------------
+
+//Copy the rooms (Sorted by name). Server must be locked.
+static SnapshotRoom *snapshot_copy(ServerData *server, uint32_t *nb){
+	size_t			k, nb_rooms = 0;
+	RoomIndex		*index	= &(server->rooms_index);
+	SnapshotRoom	*rooms	= (SnapshotRoom*)calloc(index->size + 1, sizeof(SnapshotRoom));
+	if(rooms == NULL){
+		return NULL;
+	}
+	for(k=0; k<index->size; k++){
+		Room *room = index->rooms[k];
+		if(room->node != NULL){
+			continue; //Saved by its home node
+		}
+		strcpy(rooms[nb_rooms].name, room->name);
+		strcpy(rooms[nb_rooms].owner, room->owner_name);
+		rooms[nb_rooms].has_owner = (room->owner_id != 0) ? 1 : 0;
+		nb_rooms++;
+	}
+	*nb = (uint32_t)nb_rooms;
+	return rooms;
+}
+
+//Write the file (Temporary file renamed: the snapshot is never half written)
+static int snapshot_write(const char *path, SnapshotRoom *rooms, uint32_t nb){
+	char			tmp[128];
+	SnapshotHeader	header;
+	memset(&header, 0x00, sizeof(SnapshotHeader));
+	strcpy(header.magic, SNAPSHOT_MAGIC);
+	header.nb_rooms = nb;
+	snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+
+	FILE *file = fopen(tmp, "wb");
+	if(file == NULL){
+		LOG_ERR("fopen");
+		return -1;
+	}
+	int err = fwrite(&header, sizeof(SnapshotHeader), 1, file) == 1
+			&& fwrite(rooms, sizeof(SnapshotRoom), nb, file) == nb
+			&& fflush(file) == 0
+			&& fsync(fileno(file)) == 0;
+	if(fclose(file) != 0 || err == 0 || rename(tmp, path) != 0){
+		fprintf(stderr, "[ERR] Unable to write the snapshot %s\n", path);
+		unlink(tmp);
+		return -1;
+	}
+	return 1;
+}
+
+//Save rooms every SERVER_SNAPSHOT_SEC (If changed)
+static void *snapshot_handler(void *args){
+	struct snapshot_info *info = (struct snapshot_info*)args;
+	ServerData		*server		= info->server;
+	unsigned long	version;
+	server_data_lock(server);
+	version = server->rooms_version;
+	server_data_unlock(server);
+
+	while(server->is_working == 1){
+		sleep(SERVER_SNAPSHOT_SEC);
+		server_data_lock(server);
+		int changed = (server->rooms_version != version);
+		version		= server->rooms_version;
+		server_data_unlock(server);
+		if(changed == 1){
+			snapshot_save(server, info->path);
+		}
+	}
+	free(info);
+	return NULL;
+}
+
+
+// -----------------------------------------------------------------------------
+// Functions
+// -----------------------------------------------------------------------------
+
+int snapshot_save(ServerData *server, const char *path){
+	uint32_t nb = 0;
+	server_data_lock(server);
+	SnapshotRoom *rooms = snapshot_copy(server, &nb);
+	server_data_unlock(server);
+	if(rooms == NULL){
+		return -1;
+	}
+	int err = snapshot_write(path, rooms, nb);
+	free(rooms);
+	return err;
+}
+
+int snapshot_load(ServerData *server, const char *path){
+	SnapshotHeader	header;
+	SnapshotRoom	room;
+	uint32_t		k;
+	int				nb = 0;
+	FILE *file = fopen(path, "rb");
+	if(file == NULL){
+		return -1;
+	}
+	if(fread(&header, sizeof(SnapshotHeader), 1, file) != 1
+			|| strncmp(header.magic, SNAPSHOT_MAGIC, SNAPSHOT_MAGIC_SIZE) != 0){
+		fprintf(stderr, "[ERR] Invalid snapshot %s\n", path);
+		fclose(file);
+		return -1;
+	}
+	for(k=0; k<header.nb_rooms && fread(&room, sizeof(SnapshotRoom), 1, file) == 1; k++){
+		room.name[ROOM_MAX_SIZE]	= '\0';
+		room.owner[USER_MAX_SIZE]	= '\0';
+		if(server_data_restore_room(server, room.name, room.owner, room.has_owner, NULL) == 1){
+			nb++;
+		}
+	}
+	fclose(file);
+	return nb;
+}
+
+int snapshot_start(ServerData *server, const char *path){
+	struct snapshot_info *info = (struct snapshot_info*)malloc(sizeof(struct snapshot_info));
+	pthread_t thread_id;
+	if(info == NULL){
+		return -1;
+	}
+	info->server = server;
+	snprintf(info->path, sizeof(info->path), "%s", path);
+	pthread_create(&thread_id, NULL, snapshot_handler, (void*)info);
+	pthread_detach(thread_id);
+	return 1;
+}
@@ -0,0 +1,96 @@
+// -----------------------------------------------------------------------------
+/**
+ * \file	snapshot.h
+ * \author	Constantin MASSON
+ * \date	July 3, 2016
+ *
+ * \brief	Snapshot of rooms on disk (Restored at server start)
+ * \note	C Library for the Unix Programming Project
+ *
+ * A background thread periodically copies the rooms (Under server lock,
+ * which is a consistent point-in-time read), then writes them without lock
+ * in a temporary file, renamed over the previous snapshot.
+ * File is binary (Host byte order): a SnapshotHeader, then one SnapshotRoom
+ * per room, sorted by name (Restoring them is only appends in the index).
+ */
+// -----------------------------------------------------------------------------
+
+#ifndef UNIXPROJECT_SNAPSHOT_H
+#define UNIXPROJECT_SNAPSHOT_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "wunixlib/assets.h"
+#include "server_data.h"
+#include "room.h"
+#include "constants.h"
+
+
+// -----------------------------------------------------------------------------
+// Structures
+// -----------------------------------------------------------------------------
+
+#define SNAPSHOT_MAGIC		"CHATROOMS1"
+#define SNAPSHOT_MAGIC_SIZE	12
+
+/** \brief Beginning of the snapshot file. */
+typedef struct _snapshot_header{
+	char		magic[SNAPSHOT_MAGIC_SIZE]; //SNAPSHOT_MAGIC
+	uint32_t	nb_rooms;
+} SnapshotHeader;
+
+/** \brief One room in the snapshot file. */
+typedef struct _snapshot_room{
+	char		name[ROOM_MAX_SIZE+1];
+	char		owner[USER_MAX_SIZE+1];
+	uint8_t		has_owner; //0 if room has no owner (Welcome room)
+} SnapshotRoom;
+
+
+// -----------------------------------------------------------------------------
+// Functions
+// -----------------------------------------------------------------------------
+
+/**
+ * \brief			Save the rooms of the server in the file.
+ * \details			Server is locked only while rooms are copied.
+ * \warning			Server must not be locked by caller.
+ *
+ * \param server	Server to save
+ * \param path		Path of the snapshot file
+ * \return			1 if saved, otherwise, return -1
+ */
+int snapshot_save(ServerData *server, const char *path);
+
+/**
+ * \brief			Recreate the rooms saved in the file.
+ * \details			Rooms already in the server are kept (Snapshot ignored).
+ * 					Must be called before any client is accepted.
+ *
+ * \param server	Server where to add the rooms
+ * \param path		Path of the snapshot file
+ * \return			Number of rooms restored or -1 if no valid snapshot
+ */
+int snapshot_load(ServerData *server, const char *path);
+
+/**
+ * \brief			Start a thread saving the rooms every period.
+ * \details			File is written only if rooms changed since last save.
+ *
+ * \param server	Server to save
+ * \param path		Path of the snapshot file
+ * \return			1 if thread started, otherwise, return -1
+ */
+int snapshot_start(ServerData *server, const char *path);
+
+
+#endif
+
+
+
@@ -0,0 +1,356 @@
+// -----------------------------------------------------------------------------
+/**
+ * \file	upgrade.c
+ * \author	Constantin MASSON
+ * \date	July 2, 2016
+ *
+ * \brief	Hot upgrade (Hand off server to a new process)
+ * \note	C Library for the Unix Programming Project
+ */
+// -----------------------------------------------------------------------------
+
+#include "upgrade.h"
+
+
+//Used for thread arguments
+struct upgrade_info{
+	ServerData	*server;
+	int			socket;
+};
+
+//Used for iterators arguments
+struct upgrade_sender{
+	int	socket;
+	int	err;
+};
+
+
+// -----------------------------------------------------------------------------
+// Static functions (Old server side)
+// -----------------------------------------------------------------------------
+
+//Send one record (Only the used part of data)
+static int upgrade_send(int socket, UpgradeRecord *record, int fd){
+	size_t len = sizeof(UpgradeRecord) - FRAME_READER_SIZE + record->pending;
+	return send_fd(socket, record, len, fd);
+}
+
+//Send one room (Iterator on list of rooms)
+static int upgrade_send_room(void *data, void *args){
+	Room					*room	= (Room*)data;
+	struct upgrade_sender	*sender	= (struct upgrade_sender*)args;
+	UpgradeRecord	record;
+	memset(&record, 0x00, sizeof(UpgradeRecord) - FRAME_READER_SIZE);
+	record.kind		= UPGRADE_ROOM;
+	record.flags	= (room->owner_id != 0) ? 1 : 0;
+	strcpy(record.name, room->name);
+	strcpy(record.other, room->owner_name);
+	if(room->node != NULL){
+		strcpy(record.node, room->node->name);
+	}
+	sender->err = upgrade_send(sender->socket, &record, -1);
+	return sender->err == 1;
+}
+
+//Send one client connection (Iterator on list of connections)
+static int upgrade_send_user(void *data, void *args){
+	User					*user	= (User*)data;
+	struct upgrade_sender	*sender	= (struct upgrade_sender*)args;
+	UpgradeRecord	record;
+	memset(&record, 0x00, sizeof(UpgradeRecord) - FRAME_READER_SIZE);
+	record.kind		= UPGRADE_USER;
+	record.flags	= (user->connected == 1 && user->id != 0) ? UPGRADE_USER_CONNECTED : 0;
+	record.flags	|= (messaging_is_compressed(user->socket) == 1) ? UPGRADE_USER_COMPRESSED : 0;
+	record.flags	|= (user->reader.skip == 1) ? UPGRADE_READER_SKIP : 0;
+	record.pending	= user->reader.end - user->reader.start;
+	strcpy(record.name, user->login);
+	if(user->room != NULL){
+		strcpy(record.other, user->room->name);
+	}
+	memcpy(record.data, user->reader.buffer + user->reader.start, record.pending);
+	sender->err = upgrade_send(sender->socket, &record, user->socket);
+	return sender->err == 1;
+}
+
+//Send one link with a node (Iterator on list of nodes)
+static int upgrade_send_node(void *data, void *args){
+	Node					*node	= (Node*)data;
+	struct upgrade_sender	*sender	= (struct upgrade_sender*)args;
+	UpgradeRecord	record;
+	if(node->name[0] == '\0'){
+		return 1; //No hello yet: node will open the link again
+	}
+	memset(&record, 0x00, sizeof(UpgradeRecord) - FRAME_READER_SIZE);
+	record.kind		= UPGRADE_NODE;
+	record.flags	= (node->reader.skip == 1) ? UPGRADE_READER_SKIP : 0;
+	record.pending	= node->reader.end - node->reader.start;
+	strcpy(record.name, node->name);
+	strcpy(record.address, node->address);
+	memcpy(record.data, node->reader.buffer + node->reader.start, record.pending);
+	sender->err = upgrade_send(sender->socket, &record, node->socket);
+	return sender->err == 1;
+}
+
+//Send one user of another node (Iterator on list of users)
+static int upgrade_send_remote_user(void *data, void *args){
+	User					*user	= (User*)data;
+	struct upgrade_sender	*sender	= (struct upgrade_sender*)args;
+	UpgradeRecord	record;
+	if(user->node == NULL || user->node->name[0] == '\0'){
+		return 1;
+	}
+	memset(&record, 0x00, sizeof(UpgradeRecord) - FRAME_READER_SIZE);
+	record.kind = UPGRADE_REMOTE_USER;
+	strcpy(record.name, user->login);
+	strcpy(record.node, user->node->name);
+	if(user->room != NULL){
+		strcpy(record.other, user->room->name);
+	}
+	sender->err = upgrade_send(sender->socket, &record, -1);
+	return sender->err == 1;
+}
+
+//Send the whole server. Server must be locked.
+static int upgrade_send_server(ServerData *server, int socket){
+	UpgradeRecord			record;
+	struct upgrade_sender	sender = {socket, 1};
+	memset(&record, 0x00, sizeof(UpgradeRecord) - FRAME_READER_SIZE);
+	record.kind = UPGRADE_LISTENER;
+	if(upgrade_send(socket, &record, server->listen_socket) != 1){
+		return -1;
+	}
+	record.flags = 1;
+	if(server->unix_socket >= 0 && upgrade_send(socket, &record, server->unix_socket) != 1){
+		return -1;
+	}
+	record.flags = 2;
+	if(server->link_socket >= 0 && upgrade_send(socket, &record, server->link_socket) != 1){
+		return -1;
+	}
+	//Iterations stop at first error (Nodes first: rooms and users refer them)
+	list_iterate_args(&(server->list_nodes), upgrade_send_node, &sender);
+	if(sender.err == 1){
+		list_iterate_args(&(server->list_rooms), upgrade_send_room, &sender);
+	}
+	if(sender.err == 1){
+		list_iterate_args(&(server->list_connections), upgrade_send_user, &sender);
+	}
+	if(sender.err == 1){
+		list_iterate_args(&(server->list_users), upgrade_send_remote_user, &sender);
+	}
+	record.kind = UPGRADE_END;
+	if(sender.err != 1 || upgrade_send(socket, &record, -1) != 1){
+		return -1;
+	}
+	return 1;
+}
+
+//Let all data in progress be written (Or saved). Server must be locked.
+//Return -1 if a client thread still writes without lock after SERVER_UPGRADE_TIMEOUT_MS.
+static int upgrade_wait_clients(ServerData *server){
+	int waited = 0;
+	while(__sync_add_and_fetch(&(server->nb_deferred), 0) > 0){
+		if(waited++ >= SERVER_UPGRADE_TIMEOUT_MS){
+			fprintf(stderr, "[ERR] Client threads still writing after %d ms\n", SERVER_UPGRADE_TIMEOUT_MS);
+			return -1;
+		}
+		usleep(1000); //Client threads writing without lock finish first
+	}
+	fanout_wait(); //Broadcasts in progress go to the outboxes first
+	outbox_flush_all(SERVER_UPGRADE_TIMEOUT_MS); //Queued data must be sent by this process
+	mailbox_commit(&(server->mailbox)); //Queued whispers must be saved by this process
+	return 1;
+}
+
+//Wait for the new server process, hand off everything, then exit
+static void *upgrade_handler(void *args){
+	struct upgrade_info *info = (struct upgrade_info*)args;
+	ServerData	*server	= info->server;
+	int			listen	= info->socket;
+	free(info);
+
+	while(1){
+		int socket = accept_client(listen);
+		if(socket < 0){
+			continue;
+		}
+		if(check_peer_user(socket) != 1){
+			fprintf(stderr, "[ERR] Upgrade refused: new process runs as another user\n");
+			TEMP_FAILURE_RETRY(close(socket));
+			continue;
+		}
+		fprintf(stdout, "[UPGRADE] New server process, hand off the server\n");
+		archiver_suspend(); //Before lock: a job locks the server
+		//Lock is never released if hand off succeed: this process stops
+		server_data_lock(server);
+		char ack;
+		if(upgrade_wait_clients(server) == 1
+				&& upgrade_send_server(server, socket) == 1
+				&& TEMP_FAILURE_RETRY(read(socket, &ack, 1)) == 1){
+			//Nothing is queued: threads stop before exit, none is cut while writing
+			fanout_stop();
+			outbox_stop();
+			mailbox_close(&(server->mailbox));
+			fprintf(stdout, "[UPGRADE] Server handed off, exit\n");
+			exit(EXIT_SUCCESS);
+		}
+		fprintf(stderr, "[ERR] Hand off failed, server keeps running\n");
+		server_data_unlock(server);
+		archiver_resume();
+		TEMP_FAILURE_RETRY(close(socket));
+	}
+	return NULL;
+}
+
+
+// -----------------------------------------------------------------------------
+// Static functions (New server side)
+// -----------------------------------------------------------------------------
+
+//Recreate a client connection
+static int upgrade_recv_user(ServerData *server, UpgradeRecord *record, int fd){
+	User *user = server_data_add_connection(server, fd);
+	if(user == NULL){
+		return -1;
+	}
+	strcpy(user->login, record->name);
+	if(record->flags & UPGRADE_USER_COMPRESSED){
+		messaging_set_compression(fd, 1);
+	}
+	if(record->flags & UPGRADE_USER_CONNECTED){
+		Room *room = server_data_get_room(server, record->other);
+		room = (room == NULL) ? server->room_welcome : room; //Room of another node
+		user->connected = 1;
+		if(server_data_add_user(server, user) != 1){
+			return -1;
+		}
+		if(room != NULL){
+			server_data_move_user(server, user, room);
+		}
+	}
+	memcpy(user->reader.buffer, record->data, record->pending);
+	user->reader.end	= record->pending;
+	user->reader.skip	= (record->flags & UPGRADE_READER_SKIP) ? 1 : 0;
+	return 1;
+}
+
+//Recreate a link with a node
+static int upgrade_recv_node(ServerData *server, UpgradeRecord *record, int fd){
+	Node *node = cluster_restore_link(server, fd, record->name, record->address);
+	if(node == NULL){
+		return -1;
+	}
+	memcpy(node->reader.buffer, record->data, record->pending);
+	node->reader.end	= record->pending;
+	node->reader.skip	= (record->flags & UPGRADE_READER_SKIP) ? 1 : 0;
+	return 1;
+}
+
+//Recreate a room (Its node must be linked already)
+static int upgrade_recv_room(ServerData *server, UpgradeRecord *record){
+	Node *node = (record->node[0] == '\0') ? NULL : cluster_get_node(server, record->node);
+	if(record->node[0] != '\0' && node == NULL){
+		return -1;
+	}
+	return server_data_restore_room(server, record->name, record->other, record->flags, node) == 1 ? 1 : -1;
+}
+
+//Recreate a user of another node
+static int upgrade_recv_remote_user(ServerData *server, UpgradeRecord *record){
+	Node *node = cluster_get_node(server, record->node);
+	if(node == NULL){
+		return -1;
+	}
+	cluster_restore_user(server, node, record->name, record->other);
+	return 1;
+}
+
+
+// -----------------------------------------------------------------------------
+// Functions
+// -----------------------------------------------------------------------------
+
+int upgrade_start_listening(ServerData *server, const char *path){
+	struct upgrade_info *info = (struct upgrade_info*)malloc(sizeof(struct upgrade_info));
+	pthread_t thread_id;
+	if(info == NULL){
+		return -1;
+	}
+	info->server = server;
+	info->socket = create_server_unix_socket(path, SOCK_SEQPACKET, 1);
+	if(info->socket >= 0 && chmod(path, 0600) != 0){
+		TEMP_FAILURE_RETRY(close(info->socket));
+		info->socket = -1;
+	}
+	if(info->socket < 0){
+		fprintf(stderr, "[ERR] Unable to listen for upgrade on %s\n", path);
+		free(info);
+		return -1;
+	}
+	pthread_create(&thread_id, NULL, upgrade_handler, (void*)info);
+	pthread_detach(thread_id);
+	return 1;
+}
+
+int upgrade_takeover(ServerData *server, const char *path){
+	UpgradeRecord	record;
+	int				fd;
+	int				err		= 1;
+	int				socket	= create_client_unix_socket(path, SOCK_SEQPACKET);
+	if(socket < 0){
+		return -1;
+	}
+	if(check_peer_user(socket) != 1){
+		fprintf(stderr, "[ERR] Server on %s runs as another user\n", path);
+		TEMP_FAILURE_RETRY(close(socket));
+		return -1;
+	}
+	while(err == 1){
+		fd = -1;
+		int64_t n = recv_fd(socket, &record, sizeof(UpgradeRecord), &fd);
+		if(n < (int64_t)(sizeof(UpgradeRecord) - FRAME_READER_SIZE)
+				|| record.pending > FRAME_READER_SIZE){
+			err = -1;
+			break;
+		}
+		switch(record.kind){
+			case UPGRADE_LISTENER:
+				if(record.flags == 1){
+					server->unix_socket = fd;
+				}
+				else if(record.flags == 2){
+					server->link_socket = fd;
+				}
+				else{
+					server->listen_socket = fd;
+				}
+				err = (fd < 0) ? -1 : 1;
+				break;
+			case UPGRADE_ROOM:
+				err = upgrade_recv_room(server, &record);
+				break;
+			case UPGRADE_USER:
+				err = (fd < 0) ? -1 : upgrade_recv_user(server, &record, fd);
+				break;
+			case UPGRADE_NODE:
+				err = (fd < 0) ? -1 : upgrade_recv_node(server, &record, fd);
+				break;
+			case UPGRADE_REMOTE_USER:
+				err = upgrade_recv_remote_user(server, &record);
+				break;
+			case UPGRADE_END:
+				err = (TEMP_FAILURE_RETRY(write(socket, "k", 1)) == 1) ? 0 : -1;
+				break;
+			default:
+				err = -1;
+		}
+	}
+	TEMP_FAILURE_RETRY(close(socket));
+	if(err < 0){
+		fprintf(stderr, "[ERR] Server take over failed\n");
+		return -1;
+	}
+	fprintf(stdout, "[UPGRADE] Server taken over (%d connections, %d nodes)\n",
+			list_size(&(server->list_connections)), list_size(&(server->list_nodes)));
+	return 1;
+}
@@ -0,0 +1,106 @@
+// -----------------------------------------------------------------------------
+/**
+ * \file	upgrade.h
+ * \author	Constantin MASSON
+ * \date	July 2, 2016
+ *
+ * \brief	Hot upgrade (Hand off server to a new process)
+ * \note	C Library for the Unix Programming Project
+ *
+ * The running server waits on a unix socket (SOCK_SEQPACKET) for a new
+ * server process. When one connects, the running server is locked for
+ * good, then sends its listening socket, its rooms and each client
+ * connection (User data, data received but not processed yet and the
+ * socket itself with SCM_RIGHTS). Links with other nodes of the cluster are
+ * sent the same way (Before rooms and users of these nodes). Once the new
+ * process confirms, the old one exits. Clients and nodes keep their
+ * connection and see no disconnect.
+ */
+// -----------------------------------------------------------------------------
+
+#ifndef UNIXPROJECT_UPGRADE_H
+#define UNIXPROJECT_UPGRADE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#include "wunixlib/network.h"
+#include "wunixlib/stream.h"
+#include "wunixlib/outbox.h"
+#include "server_data.h"
+#include "fanout.h"
+#include "archiver.h"
+#include "cluster.h"
+#include "constants.h"
+
+
+// -----------------------------------------------------------------------------
+// Structures
+// -----------------------------------------------------------------------------
+
+//Kind of record sent by the old server
+#define UPGRADE_LISTENER	1 //Listening socket (fd). Flags: 1 if unix socket, 2 if nodes socket
+#define UPGRADE_ROOM		2 //One room
+#define UPGRADE_USER		3 //One client connection (fd)
+#define UPGRADE_END			4 //No more records
+#define UPGRADE_NODE		5 //One link with a node (fd)
+#define UPGRADE_REMOTE_USER	6 //One user of another node
+
+#define UPGRADE_USER_CONNECTED	(1<<0) //User flag: connected in server
+#define UPGRADE_USER_COMPRESSED	(1<<1) //User flag: data sent to user is compressed
+#define UPGRADE_READER_SKIP		(1<<2) //User, node flag: end of a truncated frame is skipped
+
+/**
+ * \brief	One record sent from the old server to the new one.
+ * \details	Only the used part of data is sent (See pending).
+ */
+typedef struct _upgrade_record{
+	uint32_t	kind; //See UPGRADE_ values
+	uint32_t	flags; //Room: 1 if has owner. User: UPGRADE_USER_ bits. Node: UPGRADE_READER_SKIP
+	char		name[USER_MAX_SIZE+1]; //Room name or user login
+	char		other[USER_MAX_SIZE+1]; //Room: owner name. User: room name
+	char		node[NODE_MAX_SIZE+1]; //Room, remote user: name of its node (Empty if this server)
+	char		address[NODE_ADDRESS_SIZE+1]; //Node: where clients connect it
+	uint32_t	pending; //User, node: number of bytes in data
+	char		data[FRAME_READER_SIZE]; //User, node: data received not processed yet
+} UpgradeRecord;
+
+
+// -----------------------------------------------------------------------------
+// Functions
+// -----------------------------------------------------------------------------
+
+/**
+ * \brief			Wait (In a new thread) for a new server process.
+ * \details			When a new process connects, the server data are sent
+ * 					to it and this process exits.
+ *
+ * \param server	Server to hand off
+ * \param path		Path of the unix socket where to wait
+ * \return			1 if waiting, otherwise, return -1 (Upgrade not possible)
+ */
+int upgrade_start_listening(ServerData *server, const char *path);
+
+/**
+ * \brief			Take over the server running at the given path.
+ * \details			Recover the listening socket (server->listen_socket),
+ * 					rooms and client connections (server->list_connections),
+ * 					links with nodes (server->list_nodes, server->link_socket).
+ * 					Client and link threads must be started by the caller.
+ *
+ * \param server	Server to fill (Initialized and empty)
+ * \param path		Path of the unix socket of the running server
+ * \return			1 if recovered, otherwise, return -1 (No running server or error)
+ */
+int upgrade_takeover(ServerData *server, const char *path);
+
+
+#endif
+
+
+
@@ -10,6 +10,7 @@
 // -----------------------------------------------------------------------------
 
 #include "user.h"
+#include "room.h"
 
 User* user_create(const char *name){
 	assert(name != NULL);
@@ -18,13 +19,39 @@ User* user_create(const char *name){
 	memset(user, 0x00, sizeof(User));
 	memcpy(user->login, name, sizeof(name));
 	user->connected = 1;
+	user->refcount	= 1;
+	token_bucket_init(&(user->limits[USER_LIMIT_BDCAST]), RATE_BDCAST_PER_SEC, RATE_BDCAST_BURST);
+	token_bucket_init(&(user->limits[USER_LIMIT_WHISPER]), RATE_WHISPER_PER_SEC, RATE_WHISPER_BURST);
+	token_bucket_init(&(user->limits[USER_LIMIT_OTHER]), RATE_OTHER_PER_SEC, RATE_OTHER_BURST);
+	recent_window_init(&(user->recent_bdcast), USER_REPEAT_SEC);
 	return user;
 }
 
+int user_take_limit(User *user, UserLimit limit){
+	assert(user != NULL);
+	return token_bucket_take(&(user->limits[limit]), 1);
+}
+
 void user_destroy(User* user){
 	free(user);
 }
 
+User* user_retain(User *user){
+	assert(user != NULL);
+	__sync_add_and_fetch(&(user->refcount), 1);
+	return user;
+}
+
+void user_release(User *user){
+	assert(user != NULL);
+	if(__sync_sub_and_fetch(&(user->refcount), 1) == 0){
+		outbox_close(user->socket);
+		messaging_set_compression(user->socket, 0);
+		TEMP_FAILURE_RETRY(close(user->socket));
+		user_destroy(user);
+	}
+}
+
 int user_is_valid_name(const char *name){
 	if(name == NULL){ return -1; }
 	size_t size = strlen(name);
@@ -45,19 +72,31 @@ int user_match_name(void* user, void* name){
 	return 0;
 }
 
+int user_match_id(void* user, void* id){
+	return ((User*)user)->id == *(unsigned int*)id;
+}
+
+int user_match_socket(void* user, void* socket){
+	return ((User*)user)->socket == *(int*)socket;
+}
+
 int user_display(void* user){
 	if(user == NULL){
 		fprintf(stdout, "User is null\n");
 		return 1;
 	}
 	User u = *(User*) user;
-	fprintf(stdout, "User '%s' %p (Room: %s) / socket '%d' \n", u.login, &u, u.room, u.socket);
+	const char *room = (u.room == NULL) ? "none" : u.room->name;
+	fprintf(stdout, "User '%s' (id %u) %p (Room: %s) / socket '%d' \n", u.login, u.id, &u, room, u.socket);
 	return 1;
 }
 
-int user_send_room_bdcast(void* user, void* params){
-	User u = *(User*) user;
-	bdcast_params p = *(bdcast_params*)params;
-	messaging_send_room_bdcast(u.socket, p.user_name, p.room_name, p.msg);
+int user_send_frame(void* user, void* frame){
+	User *u = (User*)user;
+	SharedBuffer *f = (SharedBuffer*)frame;
+	if(u->node != NULL){
+		return 1; //Remote users receive it from their node
+	}
+	messaging_write_frame(u->socket, f);
 	return 1;
 }
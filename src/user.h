@@ -16,6 +16,11 @@
 #include <string.h>
 #include <signal.h>
 #include "wunixlib/linkedlist.h"
+#include "wunixlib/tokenbucket.h"
+#include "wunixlib/recentwindow.h"
+#include "wunixlib/timerwheel.h"
+#include "wunixlib/stream.h"
+#include "wunixlib/outbox.h"
 #include "constants.h"
 #include "messaging.h"
 
@@ -24,16 +29,37 @@
 // Structures
 // -----------------------------------------------------------------------------
 
+struct _room; //Defined in room.h (Which includes this file)
+struct _node; //Defined in node.h
+
+/** \brief Kind of rate limit (One token bucket per kind for each user). */
+typedef enum _user_limit{
+	USER_LIMIT_BDCAST,
+	USER_LIMIT_WHISPER,
+	USER_LIMIT_OTHER,
+	USER_NB_LIMITS
+} UserLimit;
+
 /**
- * \todo Not implemented yet
- *
- * \brief Define a user
+ * \brief		Define a user
+ * \details		The id is given by the server when user is added (0 before).
+ * 				User references its current room directly (NULL if none).
+ * 				A user connected on another node of the cluster has no socket (-1).
  */
 typedef struct _user{
 	int socket;
 	volatile sig_atomic_t connected;
+	unsigned int id; //Server id (interned login)
 	char login[USER_MAX_SIZE+1]; //+1 for '\0'
-	char room[ROOM_MAX_SIZE+1]; //Name of the current room where user is
+	struct _room *room; //Current room where user is
+	TokenBucket limits[USER_NB_LIMITS]; //Rate limit (See UserLimit)
+	int throttled; //1 if last message was refused by rate limit
+	RecentWindow recent_bdcast; //Last room messages (Repeats are dropped)
+	Timer idle_timer; //Expires when connection is idle for too long
+	int ping_sent; //1 if a ping was sent since last activity
+	FrameReader reader; //Data received on socket (Not processed yet)
+	struct _node *node; //Node where user is connected (NULL if this server)
+	int refcount; //Connection thread + broadcasts in progress (See user_release)
 } User;
 
 
@@ -51,6 +77,16 @@ typedef struct _user{
  */
 User* user_create(const char *name);
 
+/**
+ * \brief		Check whether user is allowed to send one more message.
+ * \details		Take one token from the bucket of this kind of message.
+ *
+ * \param user	User who sends the message
+ * \param limit	Kind of message
+ * \return		1 if allowed, otherwise, return 0
+ */
+int user_take_limit(User *user, UserLimit limit);
+
 /**
  * \brief		Destroy the given user. (Free memory)
  * \warning		Assert error thrown if null parameter.
@@ -59,6 +95,24 @@ User* user_create(const char *name);
  */
 void user_destroy(User* user);
 
+/**
+ * \brief		Get one more reference on the user.
+ * \details		User (And its socket) stays valid until released.
+ *
+ * \param user	User to retain
+ * \return		The same user
+ */
+User* user_retain(User *user);
+
+/**
+ * \brief		Release one reference on a connected user.
+ * \details		The last one closes the socket and destroys the user.
+ * 				Socket number can't be reused while user is retained.
+ *
+ * \param user	User to release
+ */
+void user_release(User *user);
+
 /**
  * \brief	Check whether the given name is valid.
  *
@@ -83,6 +137,28 @@ int user_is_valid_name(const char *name);
  */
 int user_match_name(void* user, void* name);
 
+/**
+ * \brief		Used for list.
+ * \details		Check whether id given match user id from list.
+ * \details		See wunixlib/Linkedlist documentation for further informations.
+ *
+ * \param user	User tested
+ * \param id	Pointer to the id to test (unsigned int)
+ * \return		1 if match, otherwise, return 0
+ */
+int user_match_id(void* user, void* id);
+
+/**
+ * \brief		Used for list.
+ * \details		Check whether socket given match user socket from list.
+ * \details		See wunixlib/Linkedlist documentation for further informations.
+ *
+ * \param user	User tested
+ * \param socket	Pointer to the socket to test (int)
+ * \return		1 if match, otherwise, return 0
+ */
+int user_match_socket(void* user, void* socket);
+
 /**
  * \brief		Display one user data.
  * \details		Meant to be used as iterate function for list.
@@ -94,14 +170,15 @@ int user_match_name(void* user, void* name);
 int user_display(void* user);
 
 /**
- * \brief			Send a message from room to user.
- * \details			Used by iterator for user list.
+ * \brief			Send a prepared frame to the user.
+ * \details			Used by iterator for user list. Users of other nodes
+ * 					are skipped (Their node delivers it).
  *
  * \param user		User where to send
- * \param params	Broadcast params with all data
+ * \param frame		Frame to send (SharedBuffer*)
  * \return			1
  */
-int user_send_room_bdcast(void* user, void* params);
+int user_send_frame(void* user, void* frame);
 
 #endif
 
@@ -0,0 +1,210 @@
+// -----------------------------------------------------------------------------
+/**
+ * \file	acmatcher.c
+ * \author	Constantin MASSON
+ * \date	July 10, 2016
+ *
+ * \brief	Multi patterns matcher (Aho-Corasick)
+ * \note	C Library for the Unix Programming Project
+ */
+// -----------------------------------------------------------------------------
+
+#include "acmatcher.h"
+
+#define AC_FINAL 0x80000000u //Bit of a transition to a state where a pattern ends
+
+
+// -----------------------------------------------------------------------------
+// Static functions
+// -----------------------------------------------------------------------------
+
+//Give a class to each char used by patterns (Upper case shares lower case one)
+static void ac_matcher_set_classes(AcMatcher *matcher, const char **patterns, const int nb){
+	int k, c;
+	const unsigned char *p;
+	matcher->nb_classes = 1; //Class 0: chars of no pattern
+	for(k=0; k<nb; k++){
+		for(p=(const unsigned char*)patterns[k]; *p != '\0'; p++){
+			c = tolower(*p);
+			if(matcher->classes[c] == 0 && matcher->nb_classes < 256){
+				matcher->classes[c] = matcher->nb_classes++;
+			}
+		}
+	}
+	for(c='A'; c<='Z'; c++){
+		matcher->classes[c] = matcher->classes[tolower(c)];
+	}
+}
+
+//Build the trie of patterns in delta (0 means no child, root is state 0)
+static void ac_matcher_add_trie(AcMatcher *matcher, uint8_t *final, const char **patterns, const int nb){
+	int			k;
+	uint32_t	state, *next;
+	const unsigned char *p;
+	for(k=0; k<nb; k++){
+		if(patterns[k][0] == '\0'){
+			continue;
+		}
+		state = 0;
+		for(p=(const unsigned char*)patterns[k]; *p != '\0'; p++){
+			next = &(matcher->delta[state * matcher->nb_classes + matcher->classes[*p]]);
+			if(*next == 0){
+				*next = matcher->nb_states++;
+			}
+			state = *next;
+		}
+		final[state] = 1;
+		matcher->nb_patterns++;
+	}
+}
+
+//Turn the trie in automaton: missing transitions follow the failure link
+//(Longest suffix which is a prefix of a pattern). States are processed in
+//breadth order, the failure state is always done before.
+static int ac_matcher_add_failures(AcMatcher *matcher, uint8_t *final){
+	int			nb_classes	= matcher->nb_classes, c;
+	uint32_t	*queue		= (uint32_t*)malloc(matcher->nb_states * sizeof(uint32_t));
+	uint32_t	*fail		= (uint32_t*)calloc(matcher->nb_states, sizeof(uint32_t));
+	uint32_t	first = 0, last = 0, state, *next;
+	if(queue == NULL || fail == NULL){
+		free(queue);
+		free(fail);
+		return -1;
+	}
+	for(c=0; c<nb_classes; c++){
+		if(matcher->delta[c] != 0){
+			queue[last++] = matcher->delta[c];
+		}
+	}
+	while(first < last){
+		state = queue[first++];
+		final[state] |= final[fail[state]];
+		for(c=0; c<nb_classes; c++){
+			next = &(matcher->delta[state * nb_classes + c]);
+			if(*next != 0){
+				fail[*next]		= matcher->delta[fail[state] * nb_classes + c];
+				queue[last++]	= *next;
+			}
+			else{
+				*next = matcher->delta[fail[state] * nb_classes + c];
+			}
+		}
+	}
+	free(queue);
+	free(fail);
+	return 1;
+}
+
+
+// -----------------------------------------------------------------------------
+// Functions
+// -----------------------------------------------------------------------------
+
+AcMatcher* ac_matcher_create(const char **patterns, const int nb){
+	assert(patterns != NULL || nb == 0);
+	int		k;
+	size_t	max_states = 1;
+	for(k=0; k<nb; k++){
+		max_states += strlen(patterns[k]);
+	}
+	AcMatcher	*matcher	= (AcMatcher*)calloc(1, sizeof(AcMatcher));
+	uint8_t		*final		= (uint8_t*)calloc(max_states, sizeof(uint8_t));
+	if(matcher == NULL || final == NULL){
+		free(matcher);
+		free(final);
+		return NULL;
+	}
+	ac_matcher_set_classes(matcher, patterns, nb);
+	matcher->nb_states	= 1;
+	matcher->delta		= (uint32_t*)calloc(max_states * matcher->nb_classes, sizeof(uint32_t));
+	if(matcher->delta == NULL){
+		free(final);
+		free(matcher);
+		return NULL;
+	}
+	ac_matcher_add_trie(matcher, final, patterns, nb);
+	if(ac_matcher_add_failures(matcher, final) != 1){
+		free(final);
+		ac_matcher_destroy(matcher);
+		return NULL;
+	}
+
+	//Transitions give the row of next state directly (No multiply when matching)
+	size_t size = (size_t)matcher->nb_states * matcher->nb_classes;
+	for(k=0; (size_t)k<size; k++){
+		uint32_t state		= matcher->delta[k];
+		matcher->delta[k]	= (state * matcher->nb_classes) | (final[state] ? AC_FINAL : 0);
+	}
+	free(final);
+	uint32_t *delta = (uint32_t*)realloc(matcher->delta, size * sizeof(uint32_t));
+	matcher->delta = (delta != NULL) ? delta : matcher->delta;
+	return matcher;
+}
+
+AcMatcher* ac_matcher_load(const char *path){
+	FILE *file = fopen(path, "r");
+	if(file == NULL){
+		return NULL;
+	}
+	char	line[AC_MATCHER_LINE_SIZE], *start, *end;
+	char	**patterns = NULL, **tmp;
+	int		nb = 0, capacity = 0, k, c, num = 0;
+	while(fgets(line, sizeof(line), file) != NULL){
+		num++;
+		//Line too long for a pattern: skipped (Never cut in several patterns)
+		if(strchr(line, '\n') == NULL && feof(file) == 0){
+			fprintf(stderr, "[ERR] %s:%d: pattern longer than %d chars skipped\n", path, num, AC_MATCHER_LINE_SIZE - 2);
+			while((c = fgetc(file)) != EOF && c != '\n');
+			continue;
+		}
+		for(start=line; isspace((unsigned char)*start); start++);
+		for(end=start+strlen(start); end > start && isspace((unsigned char)end[-1]); end--);
+		*end = '\0';
+		if(*start == '\0' || *start == '#'){
+			continue;
+		}
+		if(nb == capacity){
+			capacity	= (capacity == 0) ? 64 : capacity * 2;
+			tmp			= (char**)realloc(patterns, capacity * sizeof(char*));
+			if(tmp == NULL){
+				break;
+			}
+			patterns = tmp;
+		}
+		if((patterns[nb] = strdup(start)) == NULL){
+			break;
+		}
+		nb++;
+	}
+	fclose(file);
+	AcMatcher *matcher = ac_matcher_create((const char**)patterns, nb);
+	for(k=0; k<nb; k++){
+		free(patterns[k]);
+	}
+	free(patterns);
+	return matcher;
+}
+
+void ac_matcher_destroy(AcMatcher *matcher){
+	if(matcher == NULL){
+		return;
+	}
+	free(matcher->delta);
+	free(matcher);
+}
+
+int64_t ac_matcher_find(const AcMatcher *matcher, const char *text, const size_t len){
+	assert(matcher != NULL && text != NULL);
+	const unsigned char	*p			= (const unsigned char*)text;
+	const uint32_t		*delta		= matcher->delta;
+	const uint8_t		*classes	= matcher->classes;
+	uint32_t			state		= 0;
+	size_t				k;
+	for(k=0; k<len; k++){
+		state = delta[state + classes[p[k]]];
+		if(state & AC_FINAL){
+			return (int64_t)k + 1;
+		}
+	}
+	return -1;
+}
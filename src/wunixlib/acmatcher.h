@@ -0,0 +1,92 @@
+// -----------------------------------------------------------------------------
+/**
+ * \file	acmatcher.h
+ * \author	Constantin MASSON
+ * \date	July 10, 2016
+ *
+ * \brief	Multi patterns matcher (Aho-Corasick)
+ * \note	C Library for the Unix Programming Project
+ *
+ * All patterns are compiled in one automaton: text is read once, one
+ * transition per char, whatever the number of patterns.
+ * Transitions are a single table (One row per state, one column per class
+ * of chars). Only chars used by patterns have their own class, so rows
+ * stay small. Matching ignores ASCII case.
+ */
+// -----------------------------------------------------------------------------
+
+#ifndef WUNIXLIB_ACMATCHER_H
+#define WUNIXLIB_ACMATCHER_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <ctype.h>
+#include <assert.h>
+
+#define AC_MATCHER_LINE_SIZE 256 //Max size of a pattern in a file
+
+
+// -----------------------------------------------------------------------------
+// Structures / Data
+// -----------------------------------------------------------------------------
+
+/**
+ * \brief	Compiled patterns (Read only once created, can be shared by threads).
+ */
+typedef struct _ac_matcher{
+	uint8_t		classes[256]; //Class of each char (0 for chars of no pattern)
+	int			nb_classes;
+	int			nb_states;
+	int			nb_patterns;
+	uint32_t	*delta; //Row offset of the next state (High bit set if a pattern ends there)
+} AcMatcher;
+
+
+// -----------------------------------------------------------------------------
+// Functions prototypes
+// -----------------------------------------------------------------------------
+
+/**
+ * \brief			Compile the given patterns.
+ * \details			Empty patterns are ignored (Matcher of no pattern finds nothing).
+ * \warning			Assert error thrown if null patterns (Unless nb is 0).
+ *
+ * \param patterns	Patterns to find
+ * \param nb		Number of patterns
+ * \return			New matcher (To destroy) or NULL if malloc failed
+ */
+AcMatcher* ac_matcher_create(const char **patterns, const int nb);
+
+/**
+ * \brief			Compile the patterns of a file (One per line).
+ * \details			Spaces around a pattern are ignored, like empty lines and
+ * 					lines starting with '#'. Lines longer than
+ * 					AC_MATCHER_LINE_SIZE - 2 chars are skipped (Error logged).
+ *
+ * \param path		File to load
+ * \return			New matcher (To destroy) or NULL if unable to read the file
+ */
+AcMatcher* ac_matcher_load(const char *path);
+
+/**
+ * \brief			Destroy the matcher. (Free memory)
+ *
+ * \param matcher	Matcher to destroy
+ */
+void ac_matcher_destroy(AcMatcher *matcher);
+
+/**
+ * \brief			Find the first pattern in the text.
+ * \warning			Assert error thrown if null parameter.
+ *
+ * \param matcher	Compiled patterns
+ * \param text		Text where to search
+ * \param len		Size of text
+ * \return			Position just after the first pattern found, -1 if none
+ */
+int64_t ac_matcher_find(const AcMatcher *matcher, const char *text, const size_t len);
+
+#endif
+
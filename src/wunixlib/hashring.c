@@ -0,0 +1,119 @@
+// -----------------------------------------------------------------------------
+/**
+ * \file	hashring.c
+ * \author	Constantin MASSON
+ * \date	July 5, 2016
+ *
+ * \brief	Consistent hash ring (Key -> member)
+ * \note	C Library for the Unix Programming Project
+ */
+// -----------------------------------------------------------------------------
+
+#include "hashring.h"
+
+
+// -----------------------------------------------------------------------------
+// Static functions
+// -----------------------------------------------------------------------------
+
+//FNV-1a then final mix (Close names like 'a#1', 'a#2' must be spread)
+static unsigned long hash_ring_hash(const char *str){
+	unsigned long long hash = 14695981039346656037ULL;
+	while(*str != '\0'){
+		hash ^= (unsigned char)*str++;
+		hash *= 1099511628211ULL;
+	}
+	hash ^= hash >> 33;
+	hash *= 0xff51afd7ed558ccdULL;
+	hash ^= hash >> 33;
+	hash *= 0xc4ceb9fe1a85ec53ULL;
+	hash ^= hash >> 33;
+	return (unsigned long)hash;
+}
+
+//Position of the first point with hash >= given hash
+static size_t hash_ring_lower_bound(const HashRing *ring, unsigned long hash){
+	size_t low = 0, high = ring->size;
+	while(low < high){
+		size_t mid = low + (high - low) / 2;
+		if(ring->points[mid].hash < hash){
+			low = mid + 1;
+		}
+		else{
+			high = mid;
+		}
+	}
+	return low;
+}
+
+
+// -----------------------------------------------------------------------------
+// Functions
+// -----------------------------------------------------------------------------
+
+void hash_ring_init(HashRing *ring, size_t nb_vnodes){
+	assert(ring != NULL);
+	ring->points	= NULL;
+	ring->size		= 0;
+	ring->capacity	= 0;
+	ring->nb_vnodes	= (nb_vnodes == 0) ? 1 : nb_vnodes;
+}
+
+void hash_ring_clear(HashRing *ring){
+	assert(ring != NULL);
+	free(ring->points);
+	ring->points	= NULL;
+	ring->size		= 0;
+	ring->capacity	= 0;
+}
+
+int hash_ring_add(HashRing *ring, const char *name, void *member){
+	assert(ring != NULL);
+	assert(name != NULL);
+	assert(member != NULL);
+	size_t k;
+	char vnode[256];
+
+	//Grow array for all points of the member
+	if(ring->size + ring->nb_vnodes > ring->capacity){
+		size_t capacity			= (ring->size + ring->nb_vnodes) * 2;
+		HashRingPoint *points	= (HashRingPoint*)realloc(ring->points, capacity * sizeof(HashRingPoint));
+		if(points == NULL){
+			return -1;
+		}
+		ring->points	= points;
+		ring->capacity	= capacity;
+	}
+	//Insert each point at its place ('name#k')
+	for(k=0; k<ring->nb_vnodes; k++){
+		snprintf(vnode, sizeof(vnode), "%s#%zu", name, k);
+		unsigned long hash	= hash_ring_hash(vnode);
+		size_t pos			= hash_ring_lower_bound(ring, hash);
+		memmove(ring->points + pos + 1, ring->points + pos, (ring->size - pos) * sizeof(HashRingPoint));
+		ring->points[pos].hash		= hash;
+		ring->points[pos].member	= member;
+		ring->size++;
+	}
+	return 1;
+}
+
+void hash_ring_remove(HashRing *ring, void *member){
+	assert(ring != NULL);
+	size_t k, nb = 0;
+	for(k=0; k<ring->size; k++){
+		if(ring->points[k].member != member){
+			ring->points[nb++] = ring->points[k];
+		}
+	}
+	ring->size = nb;
+}
+
+void* hash_ring_get(const HashRing *ring, const char *key){
+	assert(ring != NULL);
+	assert(key != NULL);
+	if(ring->size == 0){
+		return NULL;
+	}
+	size_t pos = hash_ring_lower_bound(ring, hash_ring_hash(key));
+	return ring->points[(pos == ring->size) ? 0 : pos].member;
+}
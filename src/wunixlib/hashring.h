@@ -0,0 +1,99 @@
+// -----------------------------------------------------------------------------
+/**
+ * \file	hashring.h
+ * \author	Constantin MASSON
+ * \date	July 5, 2016
+ *
+ * \brief	Consistent hash ring (Key -> member)
+ * \note	C Library for the Unix Programming Project
+ *
+ * Each member is placed several times on the ring (Virtual nodes) at the
+ * hash of its name. A key belongs to the first point after its hash.
+ * Adding or removing a member only changes the owner of about 1/N keys.
+ * Members must have the same names on each process to agree on owners.
+ *
+ * \warning	Ring is not thread safe. Caller must lock it if shared.
+ */
+// -----------------------------------------------------------------------------
+
+#ifndef WUNIXLIB_HASHRING_H
+#define WUNIXLIB_HASHRING_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+
+// -----------------------------------------------------------------------------
+// Structures / Data
+// -----------------------------------------------------------------------------
+
+/** \brief One point (Virtual node) on the ring. */
+typedef struct _hash_ring_point{
+	unsigned long	hash;
+	void			*member;
+} HashRingPoint;
+
+/** \brief Define a hash ring (Must be initialized with init function). */
+typedef struct _hash_ring{
+	HashRingPoint	*points; //Sorted by hash
+	size_t			size;
+	size_t			capacity;
+	size_t			nb_vnodes; //Number of points for each member
+} HashRing;
+
+
+// -----------------------------------------------------------------------------
+// Functions prototypes
+// -----------------------------------------------------------------------------
+
+/**
+ * \brief			Initialize an empty ring.
+ * \warning			If ring is NULL, assert error thrown.
+ *
+ * \param ring		Ring to initialize
+ * \param nb_vnodes	Number of points for each member (More is more balanced)
+ */
+void hash_ring_init(HashRing *ring, size_t nb_vnodes);
+
+/**
+ * \brief			Free the points of the ring (Members are not freed).
+ *
+ * \param ring		Ring to clear
+ */
+void hash_ring_clear(HashRing *ring);
+
+/**
+ * \brief			Place a member on the ring.
+ * \warning			Parameters must be not null.
+ *
+ * \param ring		Ring where to add
+ * \param name		Name of the member (Place of its points)
+ * \param member	Member returned for keys it owns
+ * \return			1 if added, otherwise, return -1 (malloc)
+ */
+int hash_ring_add(HashRing *ring, const char *name, void *member);
+
+/**
+ * \brief			Remove all points of a member.
+ *
+ * \param ring		Ring where to remove
+ * \param member	Member to remove
+ */
+void hash_ring_remove(HashRing *ring, void *member);
+
+/**
+ * \brief			Get the member owning the key.
+ *
+ * \param ring		Ring where to look for
+ * \param key		Key to place
+ * \return			Owner of the key or NULL if ring is empty
+ */
+void* hash_ring_get(const HashRing *ring, const char *key);
+
+
+#endif
+
+
+
@@ -0,0 +1,146 @@
+// -----------------------------------------------------------------------------
+/**
+ * \file	intern.c
+ * \author	Constantin MASSON
+ * \date	June 28, 2016
+ *
+ * \brief	String intern table (name <-> integer id)
+ * \note	C Library for the Unix Programming Project
+ */
+// -----------------------------------------------------------------------------
+
+#include "intern.h"
+
+
+// -----------------------------------------------------------------------------
+// Static functions
+// -----------------------------------------------------------------------------
+
+//Double the number of buckets (Keep old buckets if malloc fails)
+static void intern_grow(InternTable *table){
+	size_t			k;
+	size_t			nb		= table->nb_buckets * 2;
+	InternEntry		**new	= (InternEntry**)calloc(nb, sizeof(InternEntry*));
+	if(new == NULL){
+		return;
+	}
+	for(k=0; k<table->nb_buckets; k++){
+		InternEntry *current = table->buckets[k];
+		while(current != NULL){
+			InternEntry *next	= current->next;
+			size_t pos			= intern_hash(current->name) % nb;
+			current->next		= new[pos];
+			new[pos]			= current;
+			current				= next;
+		}
+	}
+	free(table->buckets);
+	table->buckets		= new;
+	table->nb_buckets	= nb;
+}
+
+
+// -----------------------------------------------------------------------------
+// Functions
+// -----------------------------------------------------------------------------
+
+int intern_init(InternTable *table, size_t nb_buckets){
+	assert(table != NULL);
+	nb_buckets = (nb_buckets == 0) ? 1 : nb_buckets;
+	table->buckets		= (InternEntry**)calloc(nb_buckets, sizeof(InternEntry*));
+	table->nb_buckets	= nb_buckets;
+	table->size			= 0;
+	table->next_id		= 1; //0 is never used (Means 'no id')
+	return (table->buckets == NULL) ? -1 : 1;
+}
+
+void intern_clear(InternTable *table){
+	assert(table != NULL);
+	size_t k;
+	for(k=0; k<table->nb_buckets; k++){
+		InternEntry *current = table->buckets[k];
+		while(current != NULL){
+			InternEntry *next = current->next;
+			free(current);
+			current = next;
+		}
+		table->buckets[k] = NULL;
+	}
+	table->size = 0;
+}
+
+InternEntry* intern_get(const InternTable *table, const char *name){
+	assert(table != NULL);
+	assert(name != NULL);
+	InternEntry *current = table->buckets[intern_hash(name) % table->nb_buckets];
+	while(current != NULL){
+		if(strcmp(current->name, name) == 0){
+			return current;
+		}
+		current = current->next;
+	}
+	return NULL;
+}
+
+InternEntry* intern_add(InternTable *table, const char *name){
+	assert(table != NULL);
+	assert(name != NULL);
+	InternEntry *entry = intern_get(table, name);
+	if(entry != NULL){
+		return entry;
+	}
+
+	//Create the new entry (Name is stored right after the struct)
+	size_t len	= strlen(name);
+	entry		= (InternEntry*)malloc(sizeof(InternEntry) + len + 1);
+	if(entry == NULL){
+		return NULL;
+	}
+	memcpy(entry->name, name, len + 1);
+	entry->id	= table->next_id++;
+	entry->refs	= 0;
+	entry->data	= NULL;
+
+	//Place it in its bucket (Grow first if too many elements)
+	if(table->size >= table->nb_buckets * 2){
+		intern_grow(table);
+	}
+	size_t pos				= intern_hash(name) % table->nb_buckets;
+	entry->next				= table->buckets[pos];
+	table->buckets[pos]		= entry;
+	table->size++;
+	return entry;
+}
+
+void intern_retain(InternEntry *entry){
+	assert(entry != NULL);
+	entry->refs++;
+}
+
+void intern_release(InternTable *table, InternEntry *entry){
+	assert(table != NULL);
+	if(entry == NULL){
+		return;
+	}
+	if(entry->refs > 0 && --entry->refs > 0){
+		return;
+	}
+	InternEntry **current = &(table->buckets[intern_hash(entry->name) % table->nb_buckets]);
+	while(*current != NULL && *current != entry){
+		current = &((*current)->next);
+	}
+	if(*current == entry){
+		*current = entry->next;
+		table->size--;
+	}
+	free(entry);
+}
+
+unsigned long intern_hash(const char *str){
+	unsigned long hash = 14695981039346656037UL;
+	while(*str != '\0'){
+		hash ^= (unsigned char)*str++;
+		hash *= 1099511628211UL;
+	}
+	return hash;
+}
@@ -0,0 +1,129 @@
+// -----------------------------------------------------------------------------
+/**
+ * \file	intern.h
+ * \author	Constantin MASSON
+ * \date	June 28, 2016
+ *
+ * \brief	String intern table (name <-> integer id)
+ * \note	C Library for the Unix Programming Project
+ *
+ * Each distinct name is given a stable integer id the first time it is
+ * added. The id doesn't change while the name is referenced (See
+ * intern_retain), even if the object bound to this name disappears (data
+ * set back to NULL). Entry is removed once its last reference is released:
+ * the name gets a new id if added again.
+ *
+ * \warning	Table is not thread safe. Caller must lock it if shared.
+ */
+// -----------------------------------------------------------------------------
+
+#ifndef WUNIXLIB_INTERN_H
+#define WUNIXLIB_INTERN_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+
+// -----------------------------------------------------------------------------
+// Structures / Data
+// -----------------------------------------------------------------------------
+
+/** \brief Define one interned name. */
+typedef struct _intern_entry{
+	unsigned int			id; //Stable id (Never 0)
+	unsigned int			refs; //References held (See intern_retain)
+	void					*data; //Object currently bound to this name (Or NULL)
+	struct _intern_entry	*next;
+	char					name[]; //Copy of the name (With '\0')
+} InternEntry;
+
+/** \brief Define an intern table (Must be initialized with init function). */
+typedef struct _intern_table{
+	InternEntry		**buckets;
+	size_t			nb_buckets;
+	size_t			size; //Number of interned names
+	unsigned int	next_id;
+} InternTable;
+
+
+// -----------------------------------------------------------------------------
+// Functions prototypes
+// -----------------------------------------------------------------------------
+
+/**
+ * \brief			Initialize an empty intern table.
+ * \warning			If table is NULL, assert error thrown.
+ *
+ * \param table		Table to initialize
+ * \param nb_buckets	Initial number of buckets (Grows automatically)
+ * \return			1 if successfully initialized, otherwise, return -1 (malloc)
+ */
+int intern_init(InternTable *table, size_t nb_buckets);
+
+/**
+ * \brief			Free all entries of the table.
+ * \details			Bound data are not free (Table doesn't own them).
+ * \warning			If table is NULL, assert error thrown.
+ *
+ * \param table		Table to clear
+ */
+void intern_clear(InternTable *table);
+
+/**
+ * \brief			Get the entry for the given name.
+ * \warning			Parameters must be not null.
+ *
+ * \param table		Table where to look for
+ * \param name		Name to look for
+ * \return			The entry or NULL if this name was never interned
+ */
+InternEntry* intern_get(const InternTable *table, const char *name);
+
+/**
+ * \brief			Intern the given name.
+ * \details			If already interned, return the existing entry.
+ * 					Otherwise, create a new entry with a new id, no data and
+ * 					no reference (Removed by intern_release if never retained).
+ * \warning			Parameters must be not null.
+ *
+ * \param table		Table where to add
+ * \param name		Name to intern
+ * \return			The entry or NULL if internal error (malloc)
+ */
+InternEntry* intern_add(InternTable *table, const char *name);
+
+/**
+ * \brief			Keep the entry (And its id) until intern_release.
+ * \warning			If entry is NULL, assert error thrown.
+ *
+ * \param entry		Entry to keep
+ */
+void intern_retain(InternEntry *entry);
+
+/**
+ * \brief			Release a reference on the entry.
+ * \details			Entry is removed (And freed) once no reference is left.
+ * 					Nothing done if entry is NULL.
+ * \warning			Table must not be NULL.
+ *
+ * \param table		Table of the entry
+ * \param entry		Entry to release
+ */
+void intern_release(InternTable *table, InternEntry *entry);
+
+/**
+ * \brief			Compute the hash of a string.
+ * \details			FNV-1a (Fast, non cryptographic).
+ *
+ * \param str		String to hash
+ * \return			Hash value
+ */
+unsigned long intern_hash(const char *str);
+
+
+#endif
+
+
+
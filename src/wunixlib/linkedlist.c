@@ -30,6 +30,7 @@ void list_clear(Linkedlist *list){
 		if(list->freefct != NULL){
 			list->freefct(current->data);
 		}
+		free(current);
 	}
 	//Reset the data (Not required, but one never knows)
 	list->size		= 0;
@@ -173,8 +174,14 @@ void* list_remove_where(Linkedlist *list, void* value, compfct f){
 			else{
 				previous->next = current->next;
 			}
+			//If it was the last element, previous is the new last
+			if(list->last == current){
+				list->last = previous;
+			}
 			list->size--;
-			return current;
+			void *data = current->data;
+			free(current);
+			return data;
 		}
 		previous	= current;
 		current		= current->next;
@@ -204,10 +211,14 @@ int list_free_where(Linkedlist *list, void* value, compfct f){
 		else{
 			previous->next = current->next;
 		}
+		if(list->last == current){
+			list->last = previous;
+		}
 		list->size--;
 		if(list->freefct != NULL){
-			list->freefct(current);
+			list->freefct(current->data);
 		}
+		free(current);
 		return 1;
 	}
 	return -1;
@@ -9,6 +9,7 @@
  */
 // -----------------------------------------------------------------------------
 
+#define _GNU_SOURCE //struct ucred (SO_PEERCRED)
 #include "network.h"
 
 int accept_client(const int socket){
@@ -36,6 +37,10 @@ int make_socket(int domain, int type){
 }
 
 int create_server_tcp_socket(const uint16_t port, const int backlog){
+	return create_server_tcp_socket_on(NULL, port, backlog);
+}
+
+int create_server_tcp_socket_on(const char *address, const uint16_t port, const int backlog){
 	struct sockaddr_in addr;
 	int sock;
 
@@ -45,14 +50,21 @@ int create_server_tcp_socket(const uint16_t port, const int backlog){
 		return -1;
 	}
 
-	//Create address
-	addr.sin_family			= AF_INET;
-	addr.sin_port			= htons(port);
-	addr.sin_addr.s_addr	= htonl(INADDR_ANY);
+	//Create address (Any local address if none given)
+	if(address == NULL){
+		addr.sin_family			= AF_INET;
+		addr.sin_port			= htons(port);
+		addr.sin_addr.s_addr	= htonl(INADDR_ANY);
+	}
+	else if(recover_address(address, port, &addr) < 0){
+		close(sock);
+		return -1;
+	}
 	
 	//Bind socket with create address
 	if(bind(sock, (struct sockaddr*)&addr, sizeof(addr)) < 0){
 		LOG_ERR("bind");
+		close(sock);
 		return -1;
 	}
 
@@ -88,6 +100,126 @@ int create_client_tcp_socket(const char *address, const uint16_t port){
 	return socket;
 }
 
+int create_server_unix_socket(const char *path, int type, int backlog){
+	struct sockaddr_un addr;
+	int sock;
+	if(strlen(path) >= sizeof(addr.sun_path)){
+		fprintf(stderr, "[ERR] Unix socket path too long: %s\n", path);
+		return -1;
+	}
+
+	//Create socket
+	sock = make_socket(AF_UNIX, type);
+	if(sock < 0){
+		return -1;
+	}
+
+	//Create address (Remove old socket file if any)
+	memset(&addr, 0x00, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, path);
+	unlink(path);
+
+	//Bind socket and start listening
+	if(bind(sock, (struct sockaddr*)&addr, sizeof(addr)) < 0){
+		LOG_ERR("bind");
+		close(sock);
+		return -1;
+	}
+	if(listen(sock, backlog) < 0){
+		LOG_ERR("listen");
+		close(sock);
+		return -1;
+	}
+	return sock;
+}
+
+int create_client_unix_socket(const char *path, int type){
+	struct sockaddr_un addr;
+	int sock;
+	if(strlen(path) >= sizeof(addr.sun_path)){
+		fprintf(stderr, "[ERR] Unix socket path too long: %s\n", path);
+		return -1;
+	}
+	sock = make_socket(AF_UNIX, type);
+	if(sock < 0){
+		return -1;
+	}
+	memset(&addr, 0x00, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, path);
+	if(TEMP_FAILURE_RETRY(connect(sock, (struct sockaddr*)&addr, sizeof(addr))) < 0){
+		close(sock);
+		return -1;
+	}
+	return sock;
+}
+
+int check_peer_user(int socket){
+	struct ucred cred;
+	socklen_t len = sizeof(cred);
+	if(getsockopt(socket, SOL_SOCKET, SO_PEERCRED, &cred, &len) < 0){
+		LOG_ERR("getsockopt");
+		return -1;
+	}
+	return (cred.uid == geteuid()) ? 1 : -1;
+}
+
+int send_fd(int socket, const void *buf, size_t len, int fd){
+	struct msghdr	msg;
+	struct iovec	iov;
+	char			control[CMSG_SPACE(sizeof(int))];
+	memset(&msg, 0x00, sizeof(msg));
+	iov.iov_base	= (void*)buf;
+	iov.iov_len		= len;
+	msg.msg_iov		= &iov;
+	msg.msg_iovlen	= 1;
+
+	//Attach the descriptor if any
+	if(fd >= 0){
+		memset(control, 0x00, sizeof(control));
+		msg.msg_control		= control;
+		msg.msg_controllen	= sizeof(control);
+		struct cmsghdr *cmsg	= CMSG_FIRSTHDR(&msg);
+		cmsg->cmsg_level		= SOL_SOCKET;
+		cmsg->cmsg_type			= SCM_RIGHTS;
+		cmsg->cmsg_len			= CMSG_LEN(sizeof(int));
+		memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+	}
+	if(TEMP_FAILURE_RETRY(sendmsg(socket, &msg, 0)) < 0){
+		LOG_ERR("sendmsg");
+		return -1;
+	}
+	return 1;
+}
+
+int64_t recv_fd(int socket, void *buf, size_t len, int *fd){
+	struct msghdr	msg;
+	struct iovec	iov;
+	char			control[CMSG_SPACE(sizeof(int))];
+	int64_t			c;
+	memset(&msg, 0x00, sizeof(msg));
+	iov.iov_base		= buf;
+	iov.iov_len			= len;
+	msg.msg_iov			= &iov;
+	msg.msg_iovlen		= 1;
+	msg.msg_control		= control;
+	msg.msg_controllen	= sizeof(control);
+	*fd = -1;
+
+	c = TEMP_FAILURE_RETRY(recvmsg(socket, &msg, 0));
+	if(c < 0){
+		LOG_ERR("recvmsg");
+		return -1;
+	}
+	//Recover the descriptor if any
+	struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+	if(cmsg != NULL && cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS){
+		memcpy(fd, CMSG_DATA(cmsg), sizeof(int));
+	}
+	return c;
+}
+
 int recover_address(const char *address, const uint16_t port, struct sockaddr_in *addr){
 	struct hostent *hostinfo;
 	
@@ -16,6 +16,8 @@
 #include <stdlib.h>
 #include <sys/socket.h>
 #include <sys/types.h>
+#include <sys/un.h>
+#include <string.h>
 #include <errno.h>
 #include <netdb.h>
 #include <arpa/inet.h>
@@ -59,6 +61,18 @@ int make_socket(int domain, int type);
  */
 int create_server_tcp_socket(uint16_t port, int backlog);
 
+/**
+ * \brief			Create a new tcp server socket on one local address.
+ * \details			Same as create_server_tcp_socket, but only connections to
+ * 					this address are accepted (INADDR_ANY if NULL).
+ *
+ * \param address	Local address where to listen (ex: 127.0.0.1)
+ * \param port		Connection port for this socket
+ * \param backlog	Listen backlog
+ * \return			The socket value if created successfully, otherwise, return -1
+ */
+int create_server_tcp_socket_on(const char *address, const uint16_t port, const int backlog);
+
 /**
  * \brief			Create a new socket for a client.
  * \details			The socket is created and connected with the requested server.
@@ -70,6 +84,60 @@ int create_server_tcp_socket(uint16_t port, int backlog);
  */
 int create_client_tcp_socket(const char *address, const uint16_t port);
 
+/**
+ * \brief			Create a new unix domain server socket.
+ * \details			Socket is bound to the given path (Previous file at this
+ * 					path is removed) and start listening as soon as created.
+ *
+ * \param path		File path of the socket
+ * \param type		Type of socket (SOCK_STREAM, SOCK_SEQPACKET...)
+ * \param backlog	Listen backlog
+ * \return			The socket value if created successfully, otherwise, return -1
+ */
+int create_server_unix_socket(const char *path, int type, int backlog);
+
+/**
+ * \brief			Create a new unix domain socket connected to a server.
+ *
+ * \param path		File path of the server socket
+ * \param type		Type of socket (SOCK_STREAM, SOCK_SEQPACKET...)
+ * \return			The created socket or -1 if unable to connect
+ */
+int create_client_unix_socket(const char *path, int type);
+
+/**
+ * \brief			Check the peer of a unix domain socket runs as the same user.
+ *
+ * \param socket	Connected unix socket
+ * \return			1 if same user, otherwise, return -1
+ */
+int check_peer_user(int socket);
+
+/**
+ * \brief			Send data with a file descriptor (SCM_RIGHTS).
+ * \details			Receiver gets its own copy of the descriptor.
+ * 					Should be used with message oriented socket (SOCK_SEQPACKET)
+ * 					so that data and descriptor stay together.
+ *
+ * \param socket	Unix domain socket where to send
+ * \param buf		Data to send
+ * \param len		Size of data
+ * \param fd		Descriptor to send (Or -1 for data only)
+ * \return			1 if successfully sent, otherwise, return -1
+ */
+int send_fd(int socket, const void *buf, size_t len, int fd);
+
+/**
+ * \brief			Receive data with an optional file descriptor (SCM_RIGHTS).
+ *
+ * \param socket	Unix domain socket where to receive
+ * \param buf		Buffer for data
+ * \param len		Size of buffer
+ * \param fd		Set with received descriptor (Or -1 if none)
+ * \return			Number of bytes received, 0 if closed, -1 if error
+ */
+int64_t recv_fd(int socket, void *buf, size_t len, int *fd);
+
 /**
  * \brief			Recover the sockaddr_in data from the string name
  *
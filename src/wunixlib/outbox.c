@@ -0,0 +1,598 @@
+// -----------------------------------------------------------------------------
+/**
+ * \file	outbox.c
+ * \author	Constantin MASSON
+ * \date	July 7, 2016
+ *
+ * \brief	Outgoing data queued per socket (Write coalescing)
+ * \note	C Library for the Unix Programming Project
+ */
+// -----------------------------------------------------------------------------
+
+#include "outbox.h"
+
+
+//Part of a file queued (Sent by the kernel, never copied)
+typedef struct _outbox_file{
+	int		fd; //Own copy of the file descriptor (Closed once sent)
+	off_t	offset; //Next byte to send
+	size_t	len; //Bytes not sent yet
+	size_t	pos; //Position in data where the file is sent
+} OutboxFile;
+
+//Data queued for one socket
+typedef struct _outbox{
+	pthread_mutex_t	mutex;
+	char			*data;
+	size_t			size;
+	size_t			capacity;
+	OutboxFile		*files; //Sent in order, each one once data before its pos is sent
+	size_t			nb_files;
+	size_t			files_capacity;
+	int				dirty; //1 if in the dirty list
+	int				held; //1 if data after hold wait (See outbox_hold)
+	size_t			hold; //End of data that can be sent, where the holder writes
+	size_t			hold_files; //Files that can be sent while held
+	uint64_t		sent; //Bytes sent since start (Data and files, see outbox_wait)
+} Outbox;
+
+static Outbox			*outboxes		= NULL; //Indexed by fd
+static size_t			outbox_max		= 0;
+static size_t			outbox_bytes	= 0; //Sent without waiting the window once reached
+static struct timespec	outbox_window;
+
+//Locks of sockets without outbox (One for several sockets, fd % OUTBOX_NB_DIRECT_LOCKS)
+static pthread_mutex_t	outbox_direct_locks[OUTBOX_NB_DIRECT_LOCKS];
+static pthread_once_t	outbox_direct_once = PTHREAD_ONCE_INIT;
+
+//Sockets with queued data (Flushed by the flusher thread)
+static pthread_mutex_t	outbox_dirty_mutex = PTHREAD_MUTEX_INITIALIZER;
+static int				*outbox_dirty		= NULL;
+static size_t			outbox_nb_dirty		= 0;
+static int				outbox_running		= 0; //Flusher stops once 0 (See outbox_stop)
+static pthread_t		outbox_thread;
+
+//Socket held by this thread (-1 if none)
+static __thread int		outbox_holding		= -1;
+static __thread pthread_mutex_t *outbox_held_lock = NULL; //Direct lock taken by outbox_hold
+
+
+// -----------------------------------------------------------------------------
+// Static functions
+// -----------------------------------------------------------------------------
+
+//Add socket in the dirty list (Outbox must be locked)
+static void outbox_mark_dirty(Outbox *box, int socket){
+	if(box->dirty == 1){
+		return;
+	}
+	box->dirty = 1;
+	pthread_mutex_lock(&outbox_dirty_mutex);
+	outbox_dirty[outbox_nb_dirty++] = socket; //Never full: one entry per fd
+	pthread_mutex_unlock(&outbox_dirty_mutex);
+}
+
+//Bytes that can be sent (Outbox must be locked)
+static size_t outbox_ready(Outbox *box){
+	return (box->held == 1) ? box->hold : box->size;
+}
+
+//Files that can be sent (Outbox must be locked)
+static size_t outbox_ready_files(Outbox *box){
+	return (box->held == 1) ? box->hold_files : box->nb_files;
+}
+
+//Send part of a queued file. Without wait, socket is non blocking for this call only.
+static ssize_t outbox_send_file(int socket, OutboxFile *file, int wait){
+	int flags = fcntl(socket, F_GETFL);
+	if(wait == 0 && flags >= 0 && (flags & O_NONBLOCK) == 0){
+		fcntl(socket, F_SETFL, flags | O_NONBLOCK);
+	}
+	ssize_t	c		= TEMP_FAILURE_RETRY(sendfile(socket, file->fd, &(file->offset), file->len));
+	int		error	= errno;
+	if(wait == 0 && flags >= 0 && (flags & O_NONBLOCK) == 0){
+		fcntl(socket, F_SETFL, flags);
+	}
+	errno = error;
+	if(c > 0){
+		file->len -= c;
+	}
+	return c;
+}
+
+//Forget all queued data and files (Outbox must be locked)
+static void outbox_drop(Outbox *box){
+	size_t k;
+	for(k=0; k<box->nb_files; k++){
+		TEMP_FAILURE_RETRY(close(box->files[k].fd));
+	}
+	box->nb_files	= 0;
+	box->hold_files	= 0;
+	box->size		= 0;
+	box->hold		= 0;
+}
+
+//Send queued data and files (Outbox must be locked). Without wait, remaining data stay queued.
+//If more data follow (more = 1), kernel is told to wait for them (MSG_MORE).
+//Return -1 if connection lost (Data dropped).
+static int outbox_send(Outbox *box, int socket, int wait, int more){
+	size_t sent = 0, done = 0, k, ready = outbox_ready(box), ready_files = outbox_ready_files(box);
+	int err = 1;
+	int flags = MSG_NOSIGNAL | (wait == 1 ? 0 : MSG_DONTWAIT) | (more == 1 ? MSG_MORE : 0);
+	ssize_t c;
+	while(1){
+		//Data up to the next file, then the file
+		size_t stop = (done < ready_files) ? box->files[done].pos : ready;
+		if(sent < stop){
+			c = TEMP_FAILURE_RETRY(send(socket, box->data + sent, stop - sent, flags));
+		}
+		else if(done < ready_files){
+			c = outbox_send_file(socket, &(box->files[done]), wait);
+			box->sent += (c > 0) ? (uint64_t)c : 0;
+			if(c == 0 || box->files[done].len == 0){
+				TEMP_FAILURE_RETRY(close(box->files[done].fd)); //Sent (Or file shorter than queued)
+				done++;
+			}
+		}
+		else{
+			break;
+		}
+		if(c < 0){
+			if(errno != EAGAIN && errno != EWOULDBLOCK){
+				for(k=done; k<ready_files; k++){
+					TEMP_FAILURE_RETRY(close(box->files[k].fd));
+				}
+				box->sent += sent; //Connection lost: drop data (Not counted as sent)
+				sent = ready;
+				done = ready_files;
+				err = -1;
+			}
+			break;
+		}
+		sent += (sent < stop) ? (size_t)c : 0;
+	}
+	box->sent += (err == 1) ? sent : 0;
+	memmove(box->data, box->data + sent, box->size - sent);
+	box->size -= sent;
+	box->hold = (box->held == 1) ? box->hold - sent : 0;
+	memmove(box->files, box->files + done, (box->nb_files - done) * sizeof(OutboxFile));
+	box->nb_files -= done;
+	box->hold_files = (box->held == 1) ? box->hold_files - done : 0;
+	for(k=0; k<box->nb_files; k++){
+		box->files[k].pos -= sent;
+	}
+	return err;
+}
+
+//Make room for needed bytes (Outbox must be locked). Return -1 if over OUTBOX_MAX_QUEUED.
+static int outbox_grow(Outbox *box, size_t needed){
+	size_t capacity = (box->capacity == 0) ? outbox_bytes : box->capacity;
+	if(needed <= box->capacity){
+		return 1;
+	}
+	if(needed > OUTBOX_MAX_QUEUED){
+		return -1;
+	}
+	while(capacity < needed){
+		capacity *= 2;
+	}
+	char *data = (char*)realloc(box->data, capacity);
+	if(data == NULL){
+		return -1;
+	}
+	box->data		= data;
+	box->capacity	= capacity;
+	return 1;
+}
+
+//Room for one more file (Outbox must be locked). Return -1 if over OUTBOX_MAX_FILES.
+static int outbox_grow_files(Outbox *box){
+	size_t capacity = (box->files_capacity == 0) ? 4 : box->files_capacity * 2;
+	if(box->nb_files < box->files_capacity){
+		return 1;
+	}
+	if(box->nb_files >= OUTBOX_MAX_FILES){
+		return -1;
+	}
+	OutboxFile *files = (OutboxFile*)realloc(box->files, capacity * sizeof(OutboxFile));
+	if(files == NULL){
+		return -1;
+	}
+	box->files			= files;
+	box->files_capacity	= capacity;
+	return 1;
+}
+
+//Free a big outbox once empty (Outbox must be locked)
+static void outbox_shrink(Outbox *box){
+	if(box->size == 0 && box->capacity > outbox_bytes){
+		free(box->data);
+		box->data		= NULL;
+		box->capacity	= 0;
+	}
+	if(box->nb_files == 0 && box->files != NULL){
+		free(box->files);
+		box->files			= NULL;
+		box->files_capacity	= 0;
+	}
+}
+
+static void outbox_direct_init(void){
+	int k;
+	for(k=0; k<OUTBOX_NB_DIRECT_LOCKS; k++){
+		pthread_mutex_init(&(outbox_direct_locks[k]), NULL);
+	}
+}
+
+//Lock of a socket without outbox (Its frames are never mixed)
+static pthread_mutex_t *outbox_direct_lock(int socket){
+	pthread_once(&outbox_direct_once, outbox_direct_init);
+	return &(outbox_direct_locks[socket % OUTBOX_NB_DIRECT_LOCKS]);
+}
+
+//Lock a socket without outbox (Unless this thread holds its lock, see outbox_hold)
+static pthread_mutex_t *outbox_direct_enter(int socket){
+	pthread_mutex_t *lock = outbox_direct_lock(socket);
+	if(lock != outbox_held_lock){
+		pthread_mutex_lock(lock);
+	}
+	return lock;
+}
+
+static void outbox_direct_leave(pthread_mutex_t *lock){
+	if(lock != outbox_held_lock){
+		pthread_mutex_unlock(lock);
+	}
+}
+
+//Send data now (Socket without outbox)
+static int64_t outbox_send_direct(int socket, const char *data, size_t len){
+	pthread_mutex_t *lock = outbox_direct_enter(socket);
+	size_t sent = 0;
+	while(sent < len){
+		ssize_t c = TEMP_FAILURE_RETRY(send(socket, data + sent, len - sent, MSG_NOSIGNAL));
+		if(c < 0){
+			outbox_direct_leave(lock);
+			return -1;
+		}
+		sent += c;
+	}
+	outbox_direct_leave(lock);
+	return (int64_t)sent;
+}
+
+//Send outboxes of dirty sockets every window
+static void *outbox_flusher(void *args){
+	(void)args;
+	int *sockets = (int*)malloc(outbox_max * sizeof(int));
+	size_t k, nb;
+	if(sockets == NULL){
+		fprintf(stderr, "[ERR] Outbox flusher can't start (malloc)\n");
+		return NULL;
+	}
+	while(1){
+		nanosleep(&outbox_window, NULL);
+		pthread_mutex_lock(&outbox_dirty_mutex);
+		if(outbox_running == 0){
+			pthread_mutex_unlock(&outbox_dirty_mutex);
+			break;
+		}
+		nb = outbox_nb_dirty;
+		memcpy(sockets, outbox_dirty, nb * sizeof(int));
+		outbox_nb_dirty = 0;
+		pthread_mutex_unlock(&outbox_dirty_mutex);
+		for(k=0; k<nb; k++){
+			Outbox *box = &(outboxes[sockets[k]]);
+			pthread_mutex_lock(&(box->mutex));
+			box->dirty = 0;
+			outbox_send(box, sockets[k], 0, 0);
+			if(outbox_ready(box) > 0 || outbox_ready_files(box) > 0){
+				outbox_mark_dirty(box, sockets[k]); //Slow receiver: next window
+			}
+			outbox_shrink(box);
+			pthread_mutex_unlock(&(box->mutex));
+		}
+	}
+	free(sockets);
+	return NULL;
+}
+
+
+// -----------------------------------------------------------------------------
+// Functions
+// -----------------------------------------------------------------------------
+
+int outbox_init(int window_ms, size_t max_bytes){
+	size_t k;
+	if(outboxes != NULL || window_ms <= 0){
+		return -1;
+	}
+	outbox_max		= OUTBOX_MAX_FD;
+	outbox_bytes	= (max_bytes == 0) ? 1 : max_bytes;
+	outboxes		= (Outbox*)calloc(outbox_max, sizeof(Outbox));
+	outbox_dirty	= (int*)malloc(outbox_max * sizeof(int));
+	if(outboxes == NULL || outbox_dirty == NULL){
+		free(outboxes);
+		free(outbox_dirty);
+		outboxes = NULL;
+		return -1;
+	}
+	for(k=0; k<outbox_max; k++){
+		pthread_mutex_init(&(outboxes[k].mutex), NULL); //Data allocated at first use
+	}
+	outbox_window.tv_sec	= window_ms / 1000;
+	outbox_window.tv_nsec	= (window_ms % 1000) * 1000000L;
+	outbox_running = 1;
+	if(pthread_create(&outbox_thread, NULL, outbox_flusher, NULL) != 0){
+		outbox_running = 0;
+		free(outboxes);
+		free(outbox_dirty);
+		outboxes = NULL; //Data sent directly by the writers
+		return -1;
+	}
+	return 1;
+}
+
+int64_t outbox_write(int socket, const char *data, size_t len){
+	if(socket < 0){
+		return -1;
+	}
+	if(outboxes == NULL || (size_t)socket >= outbox_max){
+		return outbox_send_direct(socket, data, len);
+	}
+	Outbox *box = &(outboxes[socket]);
+	pthread_mutex_lock(&(box->mutex));
+	//Full: send what the socket takes now (Never wait, rest stays queued)
+	if(box->size > 0 && box->size + len > outbox_bytes){
+		outbox_send(box, socket, 0, 0);
+	}
+	//Receiver too slow (Or no memory): connection is shut down, its thread removes it
+	if(outbox_grow(box, box->size + len) != 1){
+		fprintf(stderr, "[ERR] Outbox of socket %d full, connection closed\n", socket);
+		outbox_drop(box);
+		outbox_shrink(box);
+		shutdown(socket, SHUT_RDWR);
+		pthread_mutex_unlock(&(box->mutex));
+		return -1;
+	}
+	//Holder data go before the data (And files) written by others meanwhile
+	if(box->held == 1 && outbox_holding == socket){
+		size_t k;
+		memmove(box->data + box->hold + len, box->data + box->hold, box->size - box->hold);
+		memcpy(box->data + box->hold, data, len);
+		box->hold += len;
+		for(k=box->hold_files; k<box->nb_files; k++){
+			box->files[k].pos += len;
+		}
+	}
+	else{
+		memcpy(box->data + box->size, data, len);
+	}
+	box->size += len;
+	outbox_mark_dirty(box, socket);
+	pthread_mutex_unlock(&(box->mutex));
+	return (int64_t)len;
+}
+
+int64_t outbox_sendfile(int socket, int fd, off_t offset, size_t len){
+	if(socket < 0){
+		return -1;
+	}
+	if(outboxes == NULL || (size_t)socket >= outbox_max){
+		pthread_mutex_t *lock = outbox_direct_enter(socket);
+		int64_t err = bulk_sendfile(socket, fd, offset, len);
+		outbox_direct_leave(lock);
+		return err;
+	}
+	if(len == 0){
+		return 0;
+	}
+	//Small part: read in the outbox (Cheaper than a sendfile call)
+	if(len < OUTBOX_FILE_MIN){
+		char	data[OUTBOX_FILE_MIN];
+		size_t	done = 0;
+		ssize_t	c;
+		while(done < len && (c = TEMP_FAILURE_RETRY(pread(fd, data + done, len - done, offset + done))) > 0){
+			done += c;
+		}
+		return (done > 0) ? outbox_write(socket, data, done) : (int64_t)done;
+	}
+	//Otherwise, queued: the kernel sends it when the outbox is flushed (Caller may close fd)
+	OutboxFile file;
+	file.fd		= dup(fd);
+	file.offset	= offset;
+	file.len	= len;
+	if(file.fd < 0){
+		LOG_ERR("dup");
+		return -1;
+	}
+	Outbox *box = &(outboxes[socket]);
+	pthread_mutex_lock(&(box->mutex));
+	if(outbox_grow_files(box) != 1){
+		fprintf(stderr, "[ERR] Outbox of socket %d full, connection closed\n", socket);
+		TEMP_FAILURE_RETRY(close(file.fd));
+		outbox_drop(box);
+		outbox_shrink(box);
+		shutdown(socket, SHUT_RDWR);
+		pthread_mutex_unlock(&(box->mutex));
+		return -1;
+	}
+	//Holder file goes before the data (And files) written by others meanwhile
+	if(box->held == 1 && outbox_holding == socket){
+		memmove(box->files + box->hold_files + 1, box->files + box->hold_files,
+				(box->nb_files - box->hold_files) * sizeof(OutboxFile));
+		file.pos = box->hold;
+		box->files[box->hold_files++] = file;
+	}
+	else{
+		file.pos = box->size;
+		box->files[box->nb_files] = file;
+	}
+	box->nb_files++;
+	outbox_mark_dirty(box, socket);
+	pthread_mutex_unlock(&(box->mutex));
+	return (int64_t)len;
+}
+
+int outbox_hold(int socket){
+	if(socket < 0 || outbox_holding >= 0){
+		return -1;
+	}
+	//Without outbox, others wait on the lock of the socket until released
+	if(outboxes == NULL || (size_t)socket >= outbox_max){
+		outbox_held_lock	= outbox_direct_lock(socket);
+		outbox_holding		= socket;
+		pthread_mutex_lock(outbox_held_lock);
+		return 1;
+	}
+	Outbox *box = &(outboxes[socket]);
+	pthread_mutex_lock(&(box->mutex));
+	box->held		= 1;
+	box->hold		= box->size;
+	box->hold_files	= box->nb_files;
+	outbox_holding	= socket;
+	pthread_mutex_unlock(&(box->mutex));
+	return 1;
+}
+
+int outbox_release(int socket){
+	if(outbox_holding < 0 || outbox_holding != socket){
+		return -1;
+	}
+	if(outbox_held_lock != NULL){
+		pthread_mutex_unlock(outbox_held_lock);
+		outbox_held_lock	= NULL;
+		outbox_holding		= -1;
+		return 1;
+	}
+	Outbox *box = &(outboxes[socket]);
+	pthread_mutex_lock(&(box->mutex));
+	box->held		= 0;
+	box->hold		= 0;
+	box->hold_files	= 0;
+	outbox_holding	= -1;
+	if(box->size > 0 || box->nb_files > 0){
+		outbox_mark_dirty(box, socket);
+	}
+	pthread_mutex_unlock(&(box->mutex));
+	return 1;
+}
+
+int outbox_wait(int socket, const int timeout){
+	struct timespec now;
+	size_t k;
+	if(socket < 0){
+		return -1;
+	}
+	if(outboxes == NULL || (size_t)socket >= outbox_max){
+		return 1; //Sent at once
+	}
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	double end = now.tv_sec + now.tv_nsec / 1e9 + timeout / 1000.0, left;
+	//Data that can be sent now (Only those of the holder if held)
+	Outbox *box = &(outboxes[socket]);
+	pthread_mutex_lock(&(box->mutex));
+	uint64_t mark = box->sent + outbox_ready(box);
+	for(k=0; k<outbox_ready_files(box); k++){
+		mark += box->files[k].len;
+	}
+	//Socket is waited without lock: others keep writing
+	while(1){
+		int lost = (outbox_send(box, socket, 0, 0) < 0) ? 1 : 0;
+		int done = (box->sent >= mark) ? 1 : 0;
+		pthread_mutex_unlock(&(box->mutex));
+		if(lost == 1 || done == 1){
+			return (done == 1) ? 1 : -1;
+		}
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		left = end - (now.tv_sec + now.tv_nsec / 1e9);
+		if(left <= 0 || wait_writable(socket, (int)(left * 1000) + 1) < 0){
+			return -1;
+		}
+		pthread_mutex_lock(&(box->mutex));
+	}
+}
+
+void outbox_close(int socket){
+	if(outboxes == NULL || socket < 0 || (size_t)socket >= outbox_max){
+		return;
+	}
+	Outbox *box = &(outboxes[socket]);
+	pthread_mutex_lock(&(box->mutex));
+	outbox_send(box, socket, 0, 0);
+	outbox_drop(box);
+	box->held = 0;
+	outbox_shrink(box);
+	//Still in dirty list: flusher will find an empty outbox
+	pthread_mutex_unlock(&(box->mutex));
+}
+
+//Send all outboxes without waiting. Return 1 if data are left.
+static int outbox_flush_pass(void){
+	size_t k;
+	int left = 0;
+	for(k=0; k<outbox_max; k++){
+		Outbox *box = &(outboxes[k]);
+		pthread_mutex_lock(&(box->mutex));
+		box->held = 0; //Holder won't release it in this process
+		if(box->size > 0 || box->nb_files > 0){
+			outbox_send(box, (int)k, 0, 0);
+			left = (box->size > 0 || box->nb_files > 0) ? 1 : left;
+		}
+		pthread_mutex_unlock(&(box->mutex));
+	}
+	return left;
+}
+
+//Forget the data left in all outboxes (Connection shut down if shut = 1). Return number of sockets.
+static int outbox_drop_all(int shut){
+	size_t k;
+	int nb = 0;
+	for(k=0; k<outbox_max; k++){
+		Outbox *box = &(outboxes[k]);
+		pthread_mutex_lock(&(box->mutex));
+		if(box->size > 0 || box->nb_files > 0){
+			if(shut == 1){
+				fprintf(stderr, "[ERR] Outbox of socket %zu not sent in time, connection closed\n", k);
+				shutdown((int)k, SHUT_RDWR);
+			}
+			outbox_drop(box);
+			outbox_shrink(box);
+			nb++;
+		}
+		pthread_mutex_unlock(&(box->mutex));
+	}
+	return nb;
+}
+
+int outbox_flush_all(const int timeout){
+	struct timespec now;
+	if(outboxes == NULL){
+		return 0;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	double end = now.tv_sec + now.tv_nsec / 1e9 + timeout / 1000.0;
+	//Never waits for one receiver: a socket not read can't stop the others
+	while(outbox_flush_pass() == 1){
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		if(now.tv_sec + now.tv_nsec / 1e9 >= end){
+			break;
+		}
+		usleep(1000);
+	}
+	return outbox_drop_all(1);
+}
+
+void outbox_stop(void){
+	pthread_mutex_lock(&outbox_dirty_mutex);
+	int running = outbox_running;
+	outbox_running = 0;
+	pthread_mutex_unlock(&outbox_dirty_mutex);
+	if(running == 1){
+		pthread_join(outbox_thread, NULL);
+	}
+	if(outboxes != NULL){
+		outbox_flush_pass();
+		outbox_drop_all(0);
+	}
+}
@@ -0,0 +1,162 @@
+// -----------------------------------------------------------------------------
+/**
+ * \file	outbox.h
+ * \author	Constantin MASSON
+ * \date	July 7, 2016
+ *
+ * \brief	Outgoing data queued per socket (Write coalescing)
+ * \note	C Library for the Unix Programming Project
+ *
+ * Data written on a socket are appended to its outbox instead of being sent
+ * at once. A flusher thread sends each outbox (One send for all its data)
+ * every window. An outbox is sent at once when it reaches its max size.
+ * Several small frames for the same socket become one syscall and fewer
+ * packets, added latency is at most one window.
+ *
+ * Writing never waits for the receiver: data not taken by the socket stay
+ * queued (Outbox grows). A receiver too slow to keep its outbox under
+ * OUTBOX_MAX_QUEUED bytes has its connection shut down.
+ *
+ * Outboxes are indexed by fd (Only fd < OUTBOX_MAX_FD, others are sent at
+ * once, with a lock per socket). Each outbox has its own lock: can be used
+ * from any thread.
+ * Outbox of a socket must be closed before the socket (See outbox_close).
+ *
+ * A thread may hold an outbox (See outbox_hold): data it writes then are
+ * sent before the data written by other threads meanwhile, which wait until
+ * it is released. Frames prepared with a lock can be written once unlocked.
+ */
+// -----------------------------------------------------------------------------
+
+#ifndef WUNIXLIB_OUTBOX_H
+#define WUNIXLIB_OUTBOX_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+
+#include "assets.h"
+#include "stream.h"
+
+#define OUTBOX_MAX_FD 65536
+#define OUTBOX_MAX_QUEUED (4 * 1024 * 1024) //Max bytes queued for a socket
+#define OUTBOX_NB_DIRECT_LOCKS 64 //Locks of sockets without outbox
+#define OUTBOX_MAX_FILES 4096 //Max parts of files queued for a socket
+#define OUTBOX_FILE_MIN 4096 //Smaller parts of files are read in the outbox
+
+
+// -----------------------------------------------------------------------------
+// Functions prototypes
+// -----------------------------------------------------------------------------
+
+/**
+ * \brief			Create outboxes and start the flusher thread.
+ * \details			Must be called once, before any other outbox function.
+ *
+ * \param window_ms	Max time data wait in an outbox (Milliseconds, > 0)
+ * \param max_bytes	Outbox is sent without waiting the window when it reaches this size
+ * \return			1 if started, otherwise, return -1
+ */
+int outbox_init(int window_ms, size_t max_bytes);
+
+/**
+ * \brief			Queue data to send on the socket.
+ * \details			Sent directly if outboxes are not initialized.
+ * 					Never waits for the receiver (Except when sent directly):
+ * 					if queue is over OUTBOX_MAX_QUEUED, connection is shut down.
+ *
+ * \param socket	Socket where to send
+ * \param data		Data to send
+ * \param len		Number of bytes
+ * \return			Number of bytes queued (Or sent) or -1 if error
+ */
+int64_t outbox_write(int socket, const char *data, size_t len);
+
+/**
+ * \brief			Send part of a file on the socket (After its queued data).
+ * \details			Part is queued with a copy of fd (Caller may close it):
+ * 					the kernel sends it when the outbox is flushed (No
+ * 					copy, see sendfile). Parts under OUTBOX_FILE_MIN bytes
+ * 					are read in the outbox. Socket without outbox gets it
+ * 					now (See bulk_sendfile), which waits until all is sent.
+ *
+ * \param socket	Socket where to send
+ * \param fd		File to send
+ * \param offset	Position in file
+ * \param len		Number of bytes
+ * \return			Number of bytes of file queued (Or sent) or -1 if error
+ */
+int64_t outbox_sendfile(int socket, int fd, off_t offset, size_t len);
+
+/**
+ * \brief			Keep the next data written by this thread before the data of others.
+ * \details			Data written by other threads from now wait until
+ * 					outbox_release, data of this thread are sent at once
+ * 					(After the data already queued). One socket at a time
+ * 					for a thread. Socket without outbox: its lock is kept
+ * 					until released (Others wait to write on it).
+ *
+ * \param socket	Socket to hold
+ * \return			1 if held, -1 if thread already holds one
+ */
+int outbox_hold(int socket);
+
+/**
+ * \brief			Send the data written by others since outbox_hold.
+ *
+ * \param socket	Socket held by this thread
+ * \return			1 if released, -1 if not held by this thread
+ */
+int outbox_release(int socket);
+
+/**
+ * \brief			Wait until the data queued for the socket are sent.
+ * \details			Only data that can be sent now (Those of the holder if
+ * 					held by this thread), data written after may stay queued.
+ * 					Outbox is not locked while waiting for the socket.
+ *
+ * \param socket	Socket to wait for
+ * \param timeout	Max time to wait in ms
+ * \return			1 if sent (Or socket without outbox), -1 if timeout or connection lost
+ */
+int outbox_wait(int socket, const int timeout);
+
+/**
+ * \brief			Send (Without waiting) then forget data queued for the socket.
+ * \details			Must be called before the socket is closed
+ * 					(The fd may be reused by another socket).
+ *
+ * \param socket	Socket closed
+ */
+void outbox_close(int socket);
+
+/**
+ * \brief			Send all queued data now (Wait until sent, at most timeout).
+ * \details			Sockets are never waited one by one: a receiver not
+ * 					reading doesn't delay the others. Sockets with data
+ * 					still queued after timeout are shut down (Data lost).
+ *
+ * \param timeout	Max time to wait in ms (0 to send only what fits now)
+ * \return			Number of sockets shut down
+ */
+int outbox_flush_all(const int timeout);
+
+/**
+ * \brief			Stop the flusher thread (Wait for it).
+ * \details			Data queued are sent if sockets take them at once,
+ * 					forgotten otherwise (Sockets are left open: see
+ * 					outbox_flush_all to send them before).
+ */
+void outbox_stop(void);
+
+
+#endif
+
+
+
@@ -0,0 +1,52 @@
+// -----------------------------------------------------------------------------
+/**
+ * \file	recentwindow.c
+ * \author	Constantin MASSON
+ * \date	July 11, 2016
+ *
+ * \brief	Window of recent data (Find repeats)
+ * \note	C Library for the Unix Programming Project
+ */
+// -----------------------------------------------------------------------------
+
+#include "recentwindow.h"
+
+
+void recent_window_init(RecentWindow *window, double duration){
+	assert(window != NULL);
+	int k;
+	window->duration	= duration;
+	window->next		= 0;
+	for(k=0; k<RECENT_WINDOW_SIZE; k++){
+		window->hashes[k]	= 0;
+		window->times[k]	= 0;
+	}
+}
+
+int recent_window_add(RecentWindow *window, const char *data, const size_t len){
+	assert(window != NULL && data != NULL);
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	double		time	= now.tv_sec + now.tv_nsec / 1e9;
+	uint64_t	hash	= recent_window_hash(data, len);
+	int			k;
+	for(k=0; k<RECENT_WINDOW_SIZE; k++){
+		if(window->times[k] > 0 && window->hashes[k] == hash && time - window->times[k] < window->duration){
+			return 0;
+		}
+	}
+	window->hashes[window->next]	= hash;
+	window->times[window->next]		= time;
+	window->next					= (window->next + 1) % RECENT_WINDOW_SIZE;
+	return 1;
+}
+
+uint64_t recent_window_hash(const char *data, const size_t len){
+	uint64_t	hash = 14695981039346656037ULL;
+	size_t		k;
+	for(k=0; k<len; k++){
+		hash ^= (unsigned char)data[k];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
@@ -0,0 +1,72 @@
+// -----------------------------------------------------------------------------
+/**
+ * \file	recentwindow.h
+ * \author	Constantin MASSON
+ * \date	July 11, 2016
+ *
+ * \brief	Window of recent data (Find repeats)
+ * \note	C Library for the Unix Programming Project
+ *
+ * Only a hash of each data is kept (64 bits FNV-1a), in a small ring:
+ * the oldest one is replaced by the new one.
+ */
+// -----------------------------------------------------------------------------
+
+#ifndef WUNIXLIB_RECENTWINDOW_H
+#define WUNIXLIB_RECENTWINDOW_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <time.h>
+#include <assert.h>
+
+#define RECENT_WINDOW_SIZE 8 //Number of data remembered
+
+
+// -----------------------------------------------------------------------------
+// Structures / Data
+// -----------------------------------------------------------------------------
+
+/** \brief Define a window of recent data (Must be initialized with init function). */
+typedef struct _recent_window{
+	double		duration; //Data is forgotten after this time (Seconds)
+	int			next; //Slot replaced by the next data
+	uint64_t	hashes[RECENT_WINDOW_SIZE];
+	double		times[RECENT_WINDOW_SIZE]; //When data was added (CLOCK_MONOTONIC, 0 if free)
+} RecentWindow;
+
+
+// -----------------------------------------------------------------------------
+// Functions prototypes
+// -----------------------------------------------------------------------------
+
+/**
+ * \brief			Initialize an empty window.
+ *
+ * \param window	Window to initialize
+ * \param duration	Time a data is remembered (Seconds)
+ */
+void recent_window_init(RecentWindow *window, double duration);
+
+/**
+ * \brief			Check whether the same data was added recently, add it otherwise.
+ * \details			A repeat doesn't extend the time the data is remembered.
+ *
+ * \param window	Window of recent data
+ * \param data		Data to check
+ * \param len		Size of data
+ * \return			1 if data is new (Added), 0 if repeat
+ */
+int recent_window_add(RecentWindow *window, const char *data, const size_t len);
+
+/**
+ * \brief			Hash data (FNV-1a, 64 bits).
+ *
+ * \param data		Data to hash
+ * \param len		Size of data
+ * \return			Hash of data
+ */
+uint64_t recent_window_hash(const char *data, const size_t len);
+
+#endif
+
@@ -0,0 +1,144 @@
+// -----------------------------------------------------------------------------
+/**
+ * \file	scan.c
+ * \author	Constantin MASSON
+ * \date	July 8, 2016
+ *
+ * \brief	Split a string on a delimiter (Vectorized)
+ * \note	C Library for the Unix Programming Project
+ */
+// -----------------------------------------------------------------------------
+
+#include "scan.h"
+
+#if defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__))
+#define SCAN_X86
+#include <immintrin.h>
+#endif
+
+
+// -----------------------------------------------------------------------------
+// Blocks
+// -----------------------------------------------------------------------------
+
+//Bit i is set if byte i of the (aligned) block is c or '\0'
+typedef uint32_t(*scan_block_fct)(const char *block, const char c);
+
+typedef enum _scan_mode{
+	SCAN_UNKNOWN,
+	SCAN_SCALAR,
+	SCAN_SSE2,
+	SCAN_AVX2
+} ScanMode;
+
+static volatile ScanMode scan_mode = SCAN_UNKNOWN; //Chosen on first use
+
+#ifdef SCAN_X86
+static uint32_t scan_block_sse2(const char *block, const char c){
+	__m128i data = _mm_load_si128((const __m128i*)block);
+	__m128i hits = _mm_or_si128(_mm_cmpeq_epi8(data, _mm_set1_epi8(c)),
+								_mm_cmpeq_epi8(data, _mm_setzero_si128()));
+	return (uint32_t)_mm_movemask_epi8(hits);
+}
+
+__attribute__((target("avx2")))
+static uint32_t scan_block_avx2(const char *block, const char c){
+	__m256i data = _mm256_load_si256((const __m256i*)block);
+	__m256i hits = _mm256_or_si256(_mm256_cmpeq_epi8(data, _mm256_set1_epi8(c)),
+								_mm256_cmpeq_epi8(data, _mm256_setzero_si256()));
+	return (uint32_t)_mm256_movemask_epi8(hits);
+}
+#endif
+
+static ScanMode scan_select(void){
+	if(scan_mode == SCAN_UNKNOWN){
+#ifdef SCAN_X86
+		__builtin_cpu_init();
+		scan_mode = __builtin_cpu_supports("avx2") ? SCAN_AVX2 : SCAN_SSE2;
+#else
+		scan_mode = SCAN_SCALAR;
+#endif
+	}
+	return scan_mode;
+}
+
+//Blocks are aligned: a block never crosses a page, bytes read after the '\0'
+//are always readable (And ignored).
+static int scan_split_blocks(char *str, const char *delim, char **fields, const int max,
+		const size_t width, scan_block_fct scan_block){
+	size_t		len		= strlen(delim);
+	int			nb		= 1;
+	char		*skip	= str; //Chars before are part of a delimiter already found
+	char		*block	= (char*)((uintptr_t)str & ~(uintptr_t)(width - 1));
+	uint32_t	hits	= scan_block(block, delim[0]) & (~0u << (str - block));
+	fields[0] = str;
+	while(nb < max){
+		while(hits != 0){
+			char *p = block + __builtin_ctz(hits);
+			hits &= hits - 1;
+			if(*p == '\0'){
+				return nb;
+			}
+			if(p < skip || strncmp(p, delim, len) != 0){
+				continue;
+			}
+			*p				= '\0';
+			fields[nb++]	= p + len;
+			skip			= p + len;
+			if(nb == max){
+				return nb;
+			}
+		}
+		block	+= width;
+		hits	= scan_block(block, delim[0]);
+	}
+	return nb;
+}
+
+
+// -----------------------------------------------------------------------------
+// Functions
+// -----------------------------------------------------------------------------
+
+int scan_split(char *str, const char *delim, char **fields, const int max){
+	assert(str != NULL && delim != NULL && fields != NULL);
+	assert(delim[0] != '\0' && max > 0);
+	switch(scan_select()){
+#ifdef SCAN_X86
+		case SCAN_AVX2:
+			return scan_split_blocks(str, delim, fields, max, 32, scan_block_avx2);
+		case SCAN_SSE2:
+			return scan_split_blocks(str, delim, fields, max, 16, scan_block_sse2);
+#endif
+		default:
+			return scan_split_scalar(str, delim, fields, max);
+	}
+}
+
+int scan_split_scalar(char *str, const char *delim, char **fields, const int max){
+	assert(str != NULL && delim != NULL && fields != NULL);
+	assert(delim[0] != '\0' && max > 0);
+	size_t	len	= strlen(delim);
+	int		nb	= 1;
+	char	*p;
+	fields[0] = str;
+	for(p=str; nb < max && *p != '\0'; p++){
+		if(*p == delim[0] && strncmp(p, delim, len) == 0){
+			*p				= '\0';
+			fields[nb++]	= p + len;
+			p				+= len - 1;
+		}
+	}
+	return nb;
+}
+
+const char* scan_implementation(void){
+	switch(scan_select()){
+		case SCAN_AVX2:
+			return "avx2";
+		case SCAN_SSE2:
+			return "sse2";
+		default:
+			return "scalar";
+	}
+}
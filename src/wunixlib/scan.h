@@ -0,0 +1,61 @@
+// -----------------------------------------------------------------------------
+/**
+ * \file	scan.h
+ * \author	Constantin MASSON
+ * \date	July 8, 2016
+ *
+ * \brief	Split a string on a delimiter (Vectorized)
+ * \note	C Library for the Unix Programming Project
+ *
+ * The string is scanned block by block (SSE2, or AVX2 if the processor has it):
+ * the first byte of the delimiter and the '\0' are found in the whole block
+ * at once. Only these positions are checked one by one.
+ * Other processors use the scalar version.
+ */
+// -----------------------------------------------------------------------------
+
+#ifndef WUNIXLIB_SCAN_H
+#define WUNIXLIB_SCAN_H
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <assert.h>
+
+
+// -----------------------------------------------------------------------------
+// Functions prototypes
+// -----------------------------------------------------------------------------
+
+/**
+ * \brief			Split the string in fields separated by the delimiter.
+ * \details			Each delimiter found is replaced by '\0' (String is altered)
+ * 					and fields point in the string. Unlike strtok, empty fields
+ * 					are kept (Fields keep their position).
+ * 					The last field is the rest of the string if there are
+ * 					more than max fields.
+ * \warning			Assert error thrown if null parameter or empty delimiter.
+ *
+ * \param str		String to split ('\0' terminated)
+ * \param delim		Delimiter (Several chars)
+ * \param fields	Where to place the fields
+ * \param max		Max number of fields (Size of fields, at least 1)
+ * \return			Number of fields (At least 1)
+ */
+int scan_split(char *str, const char *delim, char **fields, const int max);
+
+/**
+ * \brief			Same as scan_split, one char after the other.
+ * \details			Used by processors without vector instructions.
+ */
+int scan_split_scalar(char *str, const char *delim, char **fields, const int max);
+
+/**
+ * \brief			Name of the instructions used by scan_split.
+ *
+ * \return			"avx2", "sse2" or "scalar"
+ */
+const char* scan_implementation(void);
+
+#endif
+
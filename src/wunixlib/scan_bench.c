@@ -0,0 +1,72 @@
+// -----------------------------------------------------------------------------
+/**
+ * \file	scan_bench.c
+ * \author	Constantin MASSON
+ * \date	July 8, 2016
+ *
+ * \brief	Benchmark of scan_split against strtok (make bench CF_FLAGS=-O2)
+ * \note	C Library for the Unix Programming Project
+ */
+// -----------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "scan.h"
+
+#define BENCH_DELIMITER ";;;"
+#define BENCH_FIELDS 4
+#define BENCH_ROUNDS 2000000
+
+
+typedef int(*split_fct)(char *str, const char *delim, char **fields, const int max);
+
+//Split as messaging did before (strtok, one call per field)
+static int split_strtok(char *str, const char *delim, char **fields, const int max){
+	int nb = 0;
+	char *token = strtok(str, delim);
+	while(token != NULL && nb < max){
+		fields[nb++]	= token;
+		token			= strtok(NULL, delim);
+	}
+	return nb;
+}
+
+static double now(void){
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+static void bench(const char *name, split_fct split, const char *frame){
+	char	buffer[2048], *fields[BENCH_FIELDS];
+	size_t	len		= strlen(frame) + 1;
+	long	k, nb	= 0;
+	double	start	= now();
+	for(k=0; k<BENCH_ROUNDS; k++){
+		memcpy(buffer, frame, len); //Frame is altered by split
+		nb += split(buffer, BENCH_DELIMITER, fields, BENCH_FIELDS);
+	}
+	double elapsed = now() - start;
+	fprintf(stdout, "\t%-8s %7.1f ns/frame %8.1f MB/s (%ld fields)\n", name,
+			elapsed * 1e9 / BENCH_ROUNDS, len * BENCH_ROUNDS / elapsed / 1e6, nb / BENCH_ROUNDS);
+}
+
+int main(int argc, char **argv){
+	char	frames[3][1024];
+	int		k;
+	snprintf(frames[0], sizeof(frames[0]), "whisper;;;alice;;;bob;;;hello");
+	snprintf(frames[1], sizeof(frames[1]), "bdcast;;;%0*d;;;enterroom;;;alice", 200, 7);
+	snprintf(frames[2], sizeof(frames[2]), "bdcast;;;%0*d;;;enterroom;;;alice", 900, 7);
+
+	fprintf(stdout, "scan_split uses %s\n", scan_implementation());
+	for(k=0; k<3; k++){
+		fprintf(stdout, "Frame of %zu bytes:\n", strlen(frames[k]));
+		bench("strtok", split_strtok, frames[k]);
+		bench("scalar", scan_split_scalar, frames[k]);
+		bench("scan", scan_split, frames[k]);
+	}
+	return EXIT_SUCCESS;
+}
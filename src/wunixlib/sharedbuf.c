@@ -0,0 +1,71 @@
+// -----------------------------------------------------------------------------
+/**
+ * \file	sharedbuf.c
+ * \author	Constantin MASSON
+ * \date	June 30, 2016
+ *
+ * \brief	Reference counted buffer
+ * \note	C Library for the Unix Programming Project
+ */
+// -----------------------------------------------------------------------------
+
+#include "sharedbuf.h"
+
+
+SharedBuffer* sharedbuf_create(size_t capacity){
+	SharedBuffer *buffer = (SharedBuffer*)malloc(sizeof(SharedBuffer) + capacity);
+	if(buffer == NULL){
+		return NULL;
+	}
+	buffer->refcount	= 1;
+	buffer->size		= 0;
+	buffer->capacity	= capacity;
+	buffer->variant		= NULL;
+	return buffer;
+}
+
+int sharedbuf_append(SharedBuffer **buffer, const char *data, size_t len){
+	assert(buffer != NULL && *buffer != NULL);
+	SharedBuffer *buf = *buffer;
+	//Grow buffer if needed
+	if(buf->size + len > buf->capacity){
+		size_t capacity = buf->capacity * 2;
+		if(capacity < buf->size + len){
+			capacity = buf->size + len;
+		}
+		buf = (SharedBuffer*)realloc(buf, sizeof(SharedBuffer) + capacity);
+		if(buf == NULL){
+			return -1;
+		}
+		buf->capacity	= capacity;
+		*buffer			= buf;
+	}
+	memcpy(buf->data + buf->size, data, len);
+	buf->size += len;
+	return 1;
+}
+
+SharedBuffer* sharedbuf_retain(SharedBuffer *buffer){
+	assert(buffer != NULL);
+	__sync_add_and_fetch(&(buffer->refcount), 1);
+	return buffer;
+}
+
+SharedBuffer* sharedbuf_set_variant(SharedBuffer *buffer, SharedBuffer *variant){
+	assert(buffer != NULL && variant != NULL);
+	if(__sync_bool_compare_and_swap(&(buffer->variant), NULL, variant)){
+		return variant;
+	}
+	sharedbuf_release(variant);
+	return buffer->variant;
+}
+
+void sharedbuf_release(SharedBuffer *buffer){
+	if(buffer == NULL){
+		return;
+	}
+	if(__sync_sub_and_fetch(&(buffer->refcount), 1) == 0){
+		sharedbuf_release(buffer->variant);
+		free(buffer);
+	}
+}
@@ -0,0 +1,94 @@
+// -----------------------------------------------------------------------------
+/**
+ * \file	sharedbuf.h
+ * \author	Constantin MASSON
+ * \date	June 30, 2016
+ *
+ * \brief	Reference counted buffer
+ * \note	C Library for the Unix Programming Project
+ *
+ * A shared buffer is built once, then shared (read only) by everyone
+ * who retains it. It is free when the last reference is released.
+ * Reference count is atomic, retain / release can be done from any thread.
+ */
+// -----------------------------------------------------------------------------
+
+#ifndef WUNIXLIB_SHAREDBUF_H
+#define WUNIXLIB_SHAREDBUF_H
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+
+// -----------------------------------------------------------------------------
+// Structures / Data
+// -----------------------------------------------------------------------------
+
+/** \brief Define a shared buffer. */
+typedef struct _shared_buffer{
+	int						refcount;
+	size_t					size; //Number of bytes used
+	size_t					capacity; //Number of bytes allocated for data
+	struct _shared_buffer	*variant; //Same data encoded for some receivers (Built once, NULL if none)
+	char					data[];
+} SharedBuffer;
+
+
+// -----------------------------------------------------------------------------
+// Functions prototypes
+// -----------------------------------------------------------------------------
+
+/**
+ * \brief			Create an empty buffer (With one reference).
+ *
+ * \param capacity	Initial capacity
+ * \return			The buffer or NULL if malloc failed
+ */
+SharedBuffer* sharedbuf_create(size_t capacity);
+
+/**
+ * \brief			Append data at the end of the buffer.
+ * \details			Buffer is moved if capacity is too small (realloc).
+ * \warning			Only while buffer is built (Not shared yet).
+ *
+ * \param buffer	Pointer to the buffer (Updated if moved)
+ * \param data		Data to append
+ * \param len		Number of bytes to append
+ * \return			1 if appended, otherwise, return -1 (Buffer unchanged)
+ */
+int sharedbuf_append(SharedBuffer **buffer, const char *data, size_t len);
+
+/**
+ * \brief			Get one more reference on the buffer.
+ *
+ * \param buffer	Buffer to retain
+ * \return			The same buffer
+ */
+SharedBuffer* sharedbuf_retain(SharedBuffer *buffer);
+
+/**
+ * \brief			Attach a variant of the buffer (Same data, other encoding).
+ * \details			Only the first variant is kept: if another thread already
+ * 					set one, the given one is released and the existing one returned.
+ * 					Variant is released with the buffer.
+ *
+ * \param buffer	Shared buffer
+ * \param variant	Variant to attach (Reference given to the buffer)
+ * \return			The variant attached to the buffer
+ */
+SharedBuffer* sharedbuf_set_variant(SharedBuffer *buffer, SharedBuffer *variant);
+
+/**
+ * \brief			Release one reference (Free buffer if it was the last one).
+ * \details			Do nothing if buffer is NULL.
+ *
+ * \param buffer	Buffer to release
+ */
+void sharedbuf_release(SharedBuffer *buffer);
+
+
+#endif
+
+
+
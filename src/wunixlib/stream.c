@@ -43,6 +43,22 @@ int64_t bulk_write(int fd, char *buf, size_t buffsize){
 	return len ;
 }
 
+int64_t bulk_sendfile(int out_fd, int in_fd, off_t offset, size_t len){
+	ssize_t	c;
+	size_t	sent = 0;
+	while(sent < len){
+		c = TEMP_FAILURE_RETRY(sendfile(out_fd, in_fd, &offset, len - sent)); //offset moved by sendfile
+		if(c < 0){
+			return -1;
+		}
+		if(c == 0){
+			break; //End of file
+		}
+		sent += c;
+	}
+	return sent;
+}
+
 int append_to_file(char *filename, char *buf, size_t len){
 	int fd, flags, perms;
 	flags = O_WRONLY|O_APPEND|O_CREAT;
@@ -63,3 +79,100 @@ int append_to_file(char *filename, char *buf, size_t len){
 	return 1;
 }
 
+int wait_readable(int fd, int timeout){
+	struct pollfd pfd;
+	pfd.fd		= fd;
+	pfd.events	= POLLIN;
+	pfd.revents	= 0;
+	int c = TEMP_FAILURE_RETRY(poll(&pfd, 1, timeout));
+	if(c < 0){
+		return -1;
+	}
+	return (c == 0) ? 0 : 1;
+}
+
+int wait_writable(int fd, int timeout){
+	struct pollfd pfd;
+	pfd.fd		= fd;
+	pfd.events	= POLLOUT;
+	pfd.revents	= 0;
+	int c = TEMP_FAILURE_RETRY(poll(&pfd, 1, timeout));
+	if(c < 0){
+		return -1;
+	}
+	return (c == 0) ? 0 : 1;
+}
+
+
+// ----------------------------------------------------------------------------
+// Frame reader
+// ----------------------------------------------------------------------------
+
+void frame_reader_init(FrameReader *reader, int fd){
+	assert(reader != NULL);
+	reader->fd		= fd;
+	reader->start	= 0;
+	reader->end		= 0;
+	reader->skip	= 0;
+}
+
+//Move remaining data at the beginning
+static void frame_reader_compact(FrameReader *reader){
+	if(reader->start > 0){
+		memmove(reader->buffer, reader->buffer + reader->start, reader->end - reader->start);
+		reader->end		-= reader->start;
+		reader->start	= 0;
+	}
+}
+
+int64_t frame_reader_fill(FrameReader *reader){
+	assert(reader != NULL);
+	frame_reader_compact(reader);
+	//Keep one place for the '\0' of a truncated frame
+	int64_t c = TEMP_FAILURE_RETRY(read(reader->fd, reader->buffer + reader->end, FRAME_READER_SIZE - 1 - reader->end));
+	if(c > 0){
+		reader->end += c;
+	}
+	return c;
+}
+
+size_t frame_reader_push(FrameReader *reader, const char *data, size_t len){
+	assert(reader != NULL && data != NULL);
+	frame_reader_compact(reader);
+	size_t space = FRAME_READER_SIZE - 1 - reader->end; //Same room as fill
+	if(len > space){
+		len = space;
+	}
+	memcpy(reader->buffer + reader->end, data, len);
+	reader->end += len;
+	return len;
+}
+
+char* frame_reader_next(FrameReader *reader){
+	assert(reader != NULL);
+	char *frame	= reader->buffer + reader->start;
+	char *eof	= memchr(frame, '\0', reader->end - reader->start);
+	//End of a truncated frame: dropped up to its '\0'
+	if(reader->skip == 1){
+		if(eof == NULL){
+			reader->start = reader->end;
+			return NULL;
+		}
+		reader->skip	= 0;
+		reader->start	= (eof - reader->buffer) + 1;
+		frame			= eof + 1;
+		eof				= memchr(frame, '\0', reader->end - reader->start);
+	}
+	if(eof == NULL){
+		//Frame too big: return what we have (Truncated), skip the rest
+		if(reader->start == 0 && reader->end == FRAME_READER_SIZE - 1){
+			reader->buffer[reader->end]	= '\0';
+			reader->start				= reader->end;
+			reader->skip				= 1;
+			return frame;
+		}
+		return NULL;
+	}
+	reader->start = (eof - reader->buffer) + 1;
+	return frame;
+}
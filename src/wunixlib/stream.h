@@ -22,10 +22,33 @@
 #include <unistd.h>
 #include <string.h>
 #include <ctype.h>
+#include <poll.h>
+#include <sys/sendfile.h>
 
 #include "assets.h"
 
 
+// ----------------------------------------------------------------------------
+// Structures
+// ----------------------------------------------------------------------------
+
+/** \brief Size of the frame reader buffer (Max size of one frame). */
+#define FRAME_READER_SIZE 4096
+
+/**
+ * \brief		Read NUL terminated frames from a stream.
+ * \details		Bytes read from the stream are kept until a full frame
+ * 				(Ending with '\0') is available.
+ */
+typedef struct _frame_reader{
+	int		fd;
+	size_t	start; //Position of the first byte not returned yet
+	size_t	end; //Position after the last byte read
+	int		skip; //1 while the end of a truncated frame is skipped (Up to its '\0')
+	char	buffer[FRAME_READER_SIZE];
+} FrameReader;
+
+
 // ----------------------------------------------------------------------------
 // Prototypes
 // ----------------------------------------------------------------------------
@@ -56,6 +79,18 @@ int64_t bulk_read(int, char*, size_t);
  */
 int64_t bulk_write(int, char*, size_t);
 
+/**
+ * \brief			Send part of a file on a stream without copy in user space.
+ * \details			Block untill all bytes are sent (Or end of file reached).
+ *
+ * \param out_fd	Stream where to send (Socket etc)
+ * \param in_fd		File to send
+ * \param offset	Position of the first byte in file
+ * \param len		Number of bytes to send
+ * \return			Number of bytes sent (negative if error)
+ */
+int64_t bulk_sendfile(int out_fd, int in_fd, off_t offset, size_t len);
+
 /**
  * \brief			Add content in file
  * \details			Open the given file, add buf inside (To the end) and close file.
@@ -68,6 +103,71 @@ int64_t bulk_write(int, char*, size_t);
  */
 int append_to_file(char *filename, char *buf, size_t len);
 
+/**
+ * \brief			Wait until data can be read from the file descriptor.
+ * \details			Also returns when peer closed the stream or on error
+ * 					(Next read won't block).
+ *
+ * \param fd		File descriptor to watch
+ * \param timeout	Max time to wait in ms (-1 for no limit)
+ * \return			1 if readable, 0 if timeout, -1 if error
+ */
+int wait_readable(int fd, int timeout);
+
+/**
+ * \brief			Wait until data can be written on the file descriptor.
+ * \details			Also returns when peer closed the stream or on error
+ * 					(Next write won't block).
+ *
+ * \param fd		File descriptor to watch
+ * \param timeout	Max time to wait in ms (-1 for no limit)
+ * \return			1 if writable, 0 if timeout, -1 if error
+ */
+int wait_writable(int fd, int timeout);
+
+/**
+ * \brief			Initialize a frame reader for the given stream.
+ *
+ * \param reader	Reader to initialize
+ * \param fd		File descriptor to read from
+ */
+void frame_reader_init(FrameReader *reader, int fd);
+
+/**
+ * \brief			Add data already read from the stream (Decoded data etc).
+ * \details			Only what fits in the reader is added: get frames
+ * 					with frame_reader_next, then push the rest.
+ *
+ * \param reader	Reader where to add
+ * \param data		Data to add
+ * \param len		Size of data
+ * \return			Number of bytes added
+ */
+size_t frame_reader_push(FrameReader *reader, const char *data, size_t len);
+
+/**
+ * \brief			Read available data from the stream (One read call).
+ * \details			Block if no data available. Already returned frames are
+ * 					removed from the buffer first.
+ *
+ * \param reader	Reader to fill
+ * \return			Number of bytes read, 0 if EOF, negative if error
+ */
+int64_t frame_reader_fill(FrameReader *reader);
+
+/**
+ * \brief			Get the next complete frame.
+ * \details			Returned frame is in the reader buffer and stay valid
+ * 					until the next fill call. If buffer is full without
+ * 					any '\0', the whole buffer is returned as one frame
+ * 					(Truncated): the rest of this frame is skipped, never
+ * 					read as a new frame.
+ *
+ * \param reader	Reader where to look for
+ * \return			The frame (NUL terminated) or NULL if no complete frame
+ */
+char* frame_reader_next(FrameReader *reader);
+
 
 #endif //end WUNIXLIB_STREAM_H
 
@@ -0,0 +1,43 @@
+// -----------------------------------------------------------------------------
+/**
+ * \file	ticketlock.c
+ * \author	Constantin MASSON
+ * \date	June 28, 2016
+ *
+ * \brief	Fair (FIFO) lock
+ * \note	C Library for the Unix Programming Project
+ */
+// -----------------------------------------------------------------------------
+
+#include "ticketlock.h"
+
+
+void ticket_lock_init(TicketLock *lock){
+	assert(lock != NULL);
+	int k;
+	pthread_mutex_init(&(lock->mutex), NULL);
+	for(k=0; k<TICKET_LOCK_SLOTS; k++){
+		pthread_cond_init(&(lock->slots[k]), NULL);
+	}
+	lock->next		= 0;
+	lock->serving	= 0;
+}
+
+void ticket_lock(TicketLock *lock){
+	assert(lock != NULL);
+	pthread_mutex_lock(&(lock->mutex));
+	unsigned long ticket = lock->next++;
+	while(ticket != lock->serving){
+		pthread_cond_wait(&(lock->slots[ticket % TICKET_LOCK_SLOTS]), &(lock->mutex));
+	}
+	pthread_mutex_unlock(&(lock->mutex));
+}
+
+void ticket_unlock(TicketLock *lock){
+	assert(lock != NULL);
+	pthread_mutex_lock(&(lock->mutex));
+	lock->serving++;
+	//Waiters of other tickets on this slot (More than TICKET_LOCK_SLOTS waiting) wait again
+	pthread_cond_broadcast(&(lock->slots[lock->serving % TICKET_LOCK_SLOTS]));
+	pthread_mutex_unlock(&(lock->mutex));
+}
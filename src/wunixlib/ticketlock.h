@@ -0,0 +1,70 @@
+// -----------------------------------------------------------------------------
+/**
+ * \file	ticketlock.h
+ * \author	Constantin MASSON
+ * \date	June 28, 2016
+ *
+ * \brief	Fair (FIFO) lock
+ * \note	C Library for the Unix Programming Project
+ *
+ * Threads get the lock in the order they asked for it (Ticket order).
+ * A thread releasing then asking again the lock goes back at the end of
+ * the queue, so a busy thread can't starve the others.
+ */
+// -----------------------------------------------------------------------------
+
+#ifndef WUNIXLIB_TICKETLOCK_H
+#define WUNIXLIB_TICKETLOCK_H
+
+#include <pthread.h>
+#include <assert.h>
+
+#define TICKET_LOCK_SLOTS 64 //Conditions: waiter of ticket t waits on slot t % TICKET_LOCK_SLOTS
+
+
+// -----------------------------------------------------------------------------
+// Structures / Data
+// -----------------------------------------------------------------------------
+
+/** \brief Define a ticket lock (Must be initialized with init function). */
+typedef struct _ticket_lock{
+	pthread_mutex_t	mutex;
+	pthread_cond_t	slots[TICKET_LOCK_SLOTS]; //Unlock wakes only the slot of the next ticket
+	unsigned long	next; //Next ticket to give
+	unsigned long	serving; //Ticket currently owning the lock
+} TicketLock;
+
+
+// -----------------------------------------------------------------------------
+// Functions prototypes
+// -----------------------------------------------------------------------------
+
+/**
+ * \brief		Initialize the lock (Unlocked).
+ * \warning		If lock is NULL, assert error thrown.
+ *
+ * \param lock	Lock to initialize
+ */
+void ticket_lock_init(TicketLock *lock);
+
+/**
+ * \brief		Take the lock (Block until our turn).
+ * \warning		If lock is NULL, assert error thrown.
+ *
+ * \param lock	Lock to take
+ */
+void ticket_lock(TicketLock *lock);
+
+/**
+ * \brief		Release the lock (Give it to the next ticket).
+ * \warning		Must be owned by the caller.
+ *
+ * \param lock	Lock to release
+ */
+void ticket_unlock(TicketLock *lock);
+
+
+#endif
+
+
+
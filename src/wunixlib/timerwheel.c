@@ -0,0 +1,118 @@
+// -----------------------------------------------------------------------------
+/**
+ * \file	timerwheel.c
+ * \author	Constantin MASSON
+ * \date	June 29, 2016
+ *
+ * \brief	Hierarchical timer wheel
+ * \note	C Library for the Unix Programming Project
+ */
+// -----------------------------------------------------------------------------
+
+#include "timerwheel.h"
+
+
+// -----------------------------------------------------------------------------
+// Static functions
+// -----------------------------------------------------------------------------
+
+//Place the timer in the slot matching its expiration tick
+static void timer_wheel_place(TimerWheel *wheel, Timer *timer){
+	unsigned long	delta	= timer->expire - wheel->now;
+	int				level	= 0;
+	while(level < TIMER_WHEEL_LEVELS - 1 && delta >= (1UL << (TIMER_WHEEL_BITS * (level + 1)))){
+		level++;
+	}
+	int		pos		= (timer->expire >> (TIMER_WHEEL_BITS * level)) & TIMER_WHEEL_MASK;
+	Timer	*head	= &(wheel->slots[level][pos]);
+	timer->prev		= head->prev;
+	timer->next		= head;
+	head->prev->next	= timer;
+	head->prev			= timer;
+}
+
+//Move down all timers of one upper slot
+static void timer_wheel_cascade(TimerWheel *wheel, int level, int pos){
+	Timer *head = &(wheel->slots[level][pos]);
+	while(head->next != head){
+		Timer *timer = head->next;
+		timer_wheel_remove(timer);
+		timer_wheel_place(wheel, timer);
+	}
+}
+
+
+// -----------------------------------------------------------------------------
+// Functions
+// -----------------------------------------------------------------------------
+
+void timer_wheel_init(TimerWheel *wheel, void *data){
+	assert(wheel != NULL);
+	int level, pos;
+	wheel->data	= data;
+	wheel->now	= 0;
+	for(level=0; level<TIMER_WHEEL_LEVELS; level++){
+		for(pos=0; pos<TIMER_WHEEL_SLOTS; pos++){
+			Timer *head	= &(wheel->slots[level][pos]);
+			head->prev	= head;
+			head->next	= head;
+		}
+	}
+}
+
+void timer_init(Timer *timer, timerfct f, void *data){
+	assert(timer != NULL);
+	assert(f != NULL);
+	timer->expire	= 0;
+	timer->callback	= f;
+	timer->data		= data;
+	timer->prev		= NULL;
+	timer->next		= NULL;
+}
+
+int timer_is_pending(const Timer *timer){
+	return timer->next != NULL;
+}
+
+void timer_wheel_add(TimerWheel *wheel, Timer *timer, unsigned long ticks){
+	assert(wheel != NULL);
+	assert(timer != NULL);
+	unsigned long max = (1UL << (TIMER_WHEEL_BITS * TIMER_WHEEL_LEVELS)) - 1;
+	ticks = (ticks == 0) ? 1 : (ticks > max) ? max : ticks;
+	timer_wheel_remove(timer);
+	timer->expire = wheel->now + ticks;
+	timer_wheel_place(wheel, timer);
+}
+
+void timer_wheel_remove(Timer *timer){
+	assert(timer != NULL);
+	if(timer_is_pending(timer) == 0){
+		return;
+	}
+	timer->prev->next	= timer->next;
+	timer->next->prev	= timer->prev;
+	timer->prev			= NULL;
+	timer->next			= NULL;
+}
+
+void timer_wheel_tick(TimerWheel *wheel){
+	assert(wheel != NULL);
+	int level;
+	wheel->now++;
+
+	//Cascade upper levels each time the level below wraps
+	for(level=1; level<TIMER_WHEEL_LEVELS; level++){
+		if(((wheel->now >> (TIMER_WHEEL_BITS * (level - 1))) & TIMER_WHEEL_MASK) != 0){
+			break;
+		}
+		timer_wheel_cascade(wheel, level, (wheel->now >> (TIMER_WHEEL_BITS * level)) & TIMER_WHEEL_MASK);
+	}
+
+	//Run expired timers (Callback may add timer again)
+	Timer *head = &(wheel->slots[0][wheel->now & TIMER_WHEEL_MASK]);
+	while(head->next != head){
+		Timer *timer = head->next;
+		timer_wheel_remove(timer);
+		timer->callback(wheel, timer, timer->data);
+	}
+}
@@ -0,0 +1,132 @@
+// -----------------------------------------------------------------------------
+/**
+ * \file	timerwheel.h
+ * \author	Constantin MASSON
+ * \date	June 29, 2016
+ *
+ * \brief	Hierarchical timer wheel
+ * \note	C Library for the Unix Programming Project
+ *
+ * Timers are placed in slots according to their expiration tick.
+ * Level 0 has one slot per tick, each upper level has one slot per
+ * TIMER_WHEEL_SLOTS ticks of the level below. When the lower level wraps,
+ * the timers of the current upper slot are moved down (Cascade).
+ * Add / remove are O(1), one tick is O(1) amortized plus expired timers.
+ *
+ * \warning	Wheel is not thread safe. Caller must lock it if shared.
+ */
+// -----------------------------------------------------------------------------
+
+#ifndef WUNIXLIB_TIMERWHEEL_H
+#define WUNIXLIB_TIMERWHEEL_H
+
+#include <stdlib.h>
+#include <assert.h>
+
+
+// -----------------------------------------------------------------------------
+// Defines
+// -----------------------------------------------------------------------------
+#define TIMER_WHEEL_BITS	6
+#define TIMER_WHEEL_SLOTS	(1 << TIMER_WHEEL_BITS)
+#define TIMER_WHEEL_MASK	(TIMER_WHEEL_SLOTS - 1)
+#define TIMER_WHEEL_LEVELS	3 //Max delay: SLOTS^LEVELS - 1 ticks
+
+
+// -----------------------------------------------------------------------------
+// Structures / Data
+// -----------------------------------------------------------------------------
+
+struct _timer;
+struct _timer_wheel;
+
+/**
+ * \brief		Function called when a timer expires.
+ * \details		Timer is not in the wheel anymore and can be added again.
+ *
+ * \param wheel	Wheel where timer expired
+ * \param timer	Expired timer
+ * \param data	Data given at timer initialization
+ */
+typedef void(*timerfct)(struct _timer_wheel *wheel, struct _timer *timer, void *data);
+
+/** \brief Define a timer (Must be initialized with timer_init). */
+typedef struct _timer{
+	unsigned long	expire; //Tick of expiration
+	timerfct		callback;
+	void			*data;
+	struct _timer	*prev;
+	struct _timer	*next;
+} Timer;
+
+/** \brief Define a timer wheel (Must be initialized with init function). */
+typedef struct _timer_wheel{
+	void			*data; //User data (Given at init)
+	unsigned long	now; //Current tick
+	Timer			slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS]; //List heads
+} TimerWheel;
+
+
+// -----------------------------------------------------------------------------
+// Functions prototypes
+// -----------------------------------------------------------------------------
+
+/**
+ * \brief			Initialize an empty wheel (Tick 0).
+ * \warning			If wheel is NULL, assert error thrown.
+ *
+ * \param wheel		Wheel to initialize
+ * \param data		User data kept in the wheel (Can be NULL)
+ */
+void timer_wheel_init(TimerWheel *wheel, void *data);
+
+/**
+ * \brief			Initialize a timer (Not in any wheel).
+ * \warning			If timer or callback is NULL, assert error thrown.
+ *
+ * \param timer		Timer to initialize
+ * \param f			Function called at expiration
+ * \param data		Data given to f
+ */
+void timer_init(Timer *timer, timerfct f, void *data);
+
+/**
+ * \brief			Check whether the timer is in a wheel.
+ *
+ * \param timer		Timer to check
+ * \return			1 if pending, otherwise, return 0
+ */
+int timer_is_pending(const Timer *timer);
+
+/**
+ * \brief			Add the timer in the wheel.
+ * \details			If timer was already pending, it is moved (Re-armed).
+ * 					Too long delay is reduced to the max possible delay.
+ *
+ * \param wheel		Wheel where to add
+ * \param timer		Timer to add
+ * \param ticks		Number of ticks before expiration (At least 1)
+ */
+void timer_wheel_add(TimerWheel *wheel, Timer *timer, unsigned long ticks);
+
+/**
+ * \brief			Remove the timer from its wheel.
+ * \details			Do nothing if not pending.
+ *
+ * \param timer		Timer to remove
+ */
+void timer_wheel_remove(Timer *timer);
+
+/**
+ * \brief			Move the wheel one tick forward.
+ * \details			Call the function of each expired timer.
+ *
+ * \param wheel		Wheel to move
+ */
+void timer_wheel_tick(TimerWheel *wheel);
+
+
+#endif
+
+
+
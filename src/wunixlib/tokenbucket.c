@@ -0,0 +1,42 @@
+// -----------------------------------------------------------------------------
+/**
+ * \file	tokenbucket.c
+ * \author	Constantin MASSON
+ * \date	June 28, 2016
+ *
+ * \brief	Token bucket rate limiter
+ * \note	C Library for the Unix Programming Project
+ */
+// -----------------------------------------------------------------------------
+
+#include "tokenbucket.h"
+
+
+void token_bucket_init(TokenBucket *bucket, double rate, double burst){
+	assert(bucket != NULL);
+	bucket->rate	= rate;
+	bucket->burst	= burst;
+	bucket->tokens	= burst;
+	clock_gettime(CLOCK_MONOTONIC, &(bucket->last));
+}
+
+int token_bucket_take(TokenBucket *bucket, double nb){
+	assert(bucket != NULL);
+	//Refill according to elapsed time
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	double elapsed	= (now.tv_sec - bucket->last.tv_sec)
+					+ (now.tv_nsec - bucket->last.tv_nsec) / 1e9;
+	bucket->last	= now;
+	bucket->tokens	+= elapsed * bucket->rate;
+	if(bucket->tokens > bucket->burst){
+		bucket->tokens = bucket->burst;
+	}
+
+	//Take tokens if enough
+	if(bucket->tokens < nb){
+		return 0;
+	}
+	bucket->tokens -= nb;
+	return 1;
+}
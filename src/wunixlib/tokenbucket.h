@@ -0,0 +1,64 @@
+// -----------------------------------------------------------------------------
+/**
+ * \file	tokenbucket.h
+ * \author	Constantin MASSON
+ * \date	June 28, 2016
+ *
+ * \brief	Token bucket rate limiter
+ * \note	C Library for the Unix Programming Project
+ *
+ * Bucket is refilled with 'rate' tokens per second, up to 'burst' tokens.
+ * Each action takes tokens, action is refused if bucket doesn't have enough.
+ */
+// -----------------------------------------------------------------------------
+
+#ifndef WUNIXLIB_TOKENBUCKET_H
+#define WUNIXLIB_TOKENBUCKET_H
+
+#include <time.h>
+#include <assert.h>
+
+
+// -----------------------------------------------------------------------------
+// Structures / Data
+// -----------------------------------------------------------------------------
+
+/** \brief Define a token bucket (Must be initialized with init function). */
+typedef struct _token_bucket{
+	double			rate; //Tokens added per second
+	double			burst; //Max number of tokens
+	double			tokens; //Current number of tokens
+	struct timespec	last; //Last refill time (CLOCK_MONOTONIC)
+} TokenBucket;
+
+
+// -----------------------------------------------------------------------------
+// Functions prototypes
+// -----------------------------------------------------------------------------
+
+/**
+ * \brief			Initialize a full bucket.
+ * \warning			If bucket is NULL, assert error thrown.
+ *
+ * \param bucket	Bucket to initialize
+ * \param rate		Tokens added per second
+ * \param burst		Max number of tokens
+ */
+void token_bucket_init(TokenBucket *bucket, double rate, double burst);
+
+/**
+ * \brief			Try to take tokens from the bucket.
+ * \details			Bucket is refilled first according to elapsed time.
+ * \warning			If bucket is NULL, assert error thrown.
+ *
+ * \param bucket	Bucket where to take
+ * \param nb		Number of tokens to take
+ * \return			1 if tokens were taken, otherwise, return 0 (Nothing taken)
+ */
+int token_bucket_take(TokenBucket *bucket, double nb);
+
+
+#endif
+
+
+
@@ -0,0 +1,222 @@
+// -----------------------------------------------------------------------------
+/**
+ * \file	utf8.c
+ * \author	Constantin MASSON
+ * \date	July 9, 2016
+ *
+ * \brief	UTF-8 validation (Vectorized) and sanitization
+ * \note	C Library for the Unix Programming Project
+ */
+// -----------------------------------------------------------------------------
+
+#include "utf8.h"
+
+#if defined(__x86_64__) || (defined(__i386__) && defined(__SSE2__))
+#define UTF8_X86
+#include <immintrin.h>
+#endif
+
+
+// -----------------------------------------------------------------------------
+// Scalar
+// -----------------------------------------------------------------------------
+
+//Size of the valid char starting at p (0 if invalid)
+static size_t utf8_char_size(const unsigned char *p, const size_t avail){
+	if(p[0] < 0x80){
+		return 1;
+	}
+	if(p[0] < 0xC2){
+		return 0; //Continuation byte or overlong form of ASCII
+	}
+	if(p[0] < 0xE0){
+		return (avail >= 2 && (p[1] & 0xC0) == 0x80) ? 2 : 0;
+	}
+	if(p[0] < 0xF0){
+		if(avail < 3 || (p[1] & 0xC0) != 0x80 || (p[2] & 0xC0) != 0x80){
+			return 0;
+		}
+		if((p[0] == 0xE0 && p[1] < 0xA0) || (p[0] == 0xED && p[1] >= 0xA0)){
+			return 0; //Overlong or surrogate
+		}
+		return 3;
+	}
+	if(p[0] < 0xF5){
+		if(avail < 4 || (p[1] & 0xC0) != 0x80 || (p[2] & 0xC0) != 0x80 || (p[3] & 0xC0) != 0x80){
+			return 0;
+		}
+		if((p[0] == 0xF0 && p[1] < 0x90) || (p[0] == 0xF4 && p[1] >= 0x90)){
+			return 0; //Overlong or above U+10FFFF
+		}
+		return 4;
+	}
+	return 0;
+}
+
+int utf8_validate_scalar(const char *data, const size_t len){
+	assert(data != NULL);
+	const unsigned char	*p = (const unsigned char*)data;
+	size_t				k = 0, size;
+	while(k < len){
+		if((size = utf8_char_size(p + k, len - k)) == 0){
+			return 0;
+		}
+		k += size;
+	}
+	return 1;
+}
+
+
+// -----------------------------------------------------------------------------
+// AVX2
+// -----------------------------------------------------------------------------
+
+#ifdef UTF8_X86
+//Error found for a pair (Previous byte, byte). A pair is invalid if the 3
+//lookups (High and low nibble of previous byte, high nibble of byte) have a
+//common bit.
+#define UTF8_TOO_SHORT		(1<<0) //11______ 0_______ or 11______ 11______
+#define UTF8_TOO_LONG		(1<<1) //0_______ 10______
+#define UTF8_OVERLONG_3		(1<<2) //11100000 100_____
+#define UTF8_TOO_LARGE		(1<<3) //11110100 1001____ or 11110101+ 10______
+#define UTF8_SURROGATE		(1<<4) //11101101 101_____
+#define UTF8_OVERLONG_2		(1<<5) //1100000_ 10______
+#define UTF8_TOO_LARGE_1000	(1<<6) //11110101+ 1000____
+#define UTF8_OVERLONG_4		(1<<6) //11110000 1000____
+#define UTF8_TWO_CONTS		(1<<7) //10______ 10______ (Valid only in 3 or 4 bytes char)
+#define UTF8_CARRY			(UTF8_TOO_SHORT | UTF8_TOO_LONG | UTF8_TWO_CONTS)
+
+//Same 16 entries table in both lanes (Lookup is done per lane)
+#define UTF8_TABLE(a,b,c,d,e,f,g,h,i,j,k,l,m,n,o,p) \
+	_mm256_setr_epi8(a,b,c,d,e,f,g,h,i,j,k,l,m,n,o,p,a,b,c,d,e,f,g,h,i,j,k,l,m,n,o,p)
+
+//Bytes of input shifted by n (Last n bytes of prev first)
+#define UTF8_PREV(input, prev, n) \
+	_mm256_alignr_epi8(input, _mm256_permute2x128_si256(prev, input, 0x21), 16 - (n))
+
+__attribute__((target("avx2")))
+static inline __m256i utf8_high_nibbles(const __m256i v){
+	return _mm256_and_si256(_mm256_srli_epi16(v, 4), _mm256_set1_epi8(0x0F));
+}
+
+//Errors of the 32 bytes of input (prev is the previous 32 bytes)
+__attribute__((target("avx2")))
+static inline __m256i utf8_check_block(const __m256i input, const __m256i prev){
+	const __m256i byte_1_high = UTF8_TABLE(
+			UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG,
+			UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG, UTF8_TOO_LONG,
+			UTF8_TWO_CONTS, UTF8_TWO_CONTS, UTF8_TWO_CONTS, UTF8_TWO_CONTS,
+			UTF8_TOO_SHORT | UTF8_OVERLONG_2,
+			UTF8_TOO_SHORT,
+			UTF8_TOO_SHORT | UTF8_OVERLONG_3 | UTF8_SURROGATE,
+			UTF8_TOO_SHORT | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000 | UTF8_OVERLONG_4);
+	const __m256i byte_1_low = UTF8_TABLE(
+			UTF8_CARRY | UTF8_OVERLONG_3 | UTF8_OVERLONG_2 | UTF8_OVERLONG_4,
+			UTF8_CARRY | UTF8_OVERLONG_2,
+			UTF8_CARRY,
+			UTF8_CARRY,
+			UTF8_CARRY | UTF8_TOO_LARGE,
+			UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+			UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+			UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+			UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+			UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+			UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+			UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+			UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+			UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000 | UTF8_SURROGATE,
+			UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000,
+			UTF8_CARRY | UTF8_TOO_LARGE | UTF8_TOO_LARGE_1000);
+	const __m256i byte_2_high = UTF8_TABLE(
+			UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT,
+			UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT,
+			UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_OVERLONG_3 | UTF8_TOO_LARGE_1000 | UTF8_OVERLONG_4,
+			UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_OVERLONG_3 | UTF8_TOO_LARGE,
+			UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_SURROGATE | UTF8_TOO_LARGE,
+			UTF8_TOO_LONG | UTF8_OVERLONG_2 | UTF8_TWO_CONTS | UTF8_SURROGATE | UTF8_TOO_LARGE,
+			UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT, UTF8_TOO_SHORT);
+	__m256i prev1		= UTF8_PREV(input, prev, 1);
+	__m256i special		= _mm256_and_si256(
+			_mm256_and_si256(_mm256_shuffle_epi8(byte_1_high, utf8_high_nibbles(prev1)),
+							_mm256_shuffle_epi8(byte_1_low, _mm256_and_si256(prev1, _mm256_set1_epi8(0x0F)))),
+			_mm256_shuffle_epi8(byte_2_high, utf8_high_nibbles(input)));
+	//Two continuations in a row are valid only after a 3 or 4 bytes lead
+	__m256i third		= _mm256_subs_epu8(UTF8_PREV(input, prev, 2), _mm256_set1_epi8(0xE0 - 0x80));
+	__m256i fourth		= _mm256_subs_epu8(UTF8_PREV(input, prev, 3), _mm256_set1_epi8(0xF0 - 0x80));
+	__m256i must_cont	= _mm256_and_si256(_mm256_or_si256(third, fourth), _mm256_set1_epi8((char)0x80));
+	return _mm256_xor_si256(must_cont, special);
+}
+
+__attribute__((target("avx2")))
+static int utf8_validate_avx2(const char *data, const size_t len){
+	__m256i	prev	= _mm256_setzero_si256();
+	__m256i	error	= _mm256_setzero_si256();
+	__m256i	input;
+	char	last[32] __attribute__((aligned(32)));
+	size_t	k;
+	for(k=0; k+32 <= len; k+=32){
+		input	= _mm256_loadu_si256((const __m256i*)(data + k));
+		error	= _mm256_or_si256(error, utf8_check_block(input, prev));
+		prev	= input;
+	}
+	//Rest of data padded with '\0', then a '\0' block: a truncated char at
+	//the end is followed by ASCII (Error)
+	memset(last, 0x00, sizeof(last));
+	memcpy(last, data + k, len - k);
+	input	= _mm256_load_si256((const __m256i*)last);
+	error	= _mm256_or_si256(error, utf8_check_block(input, prev));
+	error	= _mm256_or_si256(error, utf8_check_block(_mm256_setzero_si256(), input));
+	return _mm256_testz_si256(error, error);
+}
+#endif
+
+
+// -----------------------------------------------------------------------------
+// Functions
+// -----------------------------------------------------------------------------
+
+static volatile int utf8_avx2 = -1; //Chosen on first use
+
+static int utf8_has_avx2(void){
+	if(utf8_avx2 < 0){
+#ifdef UTF8_X86
+		__builtin_cpu_init();
+		utf8_avx2 = __builtin_cpu_supports("avx2") ? 1 : 0;
+#else
+		utf8_avx2 = 0;
+#endif
+	}
+	return utf8_avx2;
+}
+
+int utf8_validate(const char *data, const size_t len){
+	assert(data != NULL);
+#ifdef UTF8_X86
+	if(utf8_has_avx2() == 1){
+		return utf8_validate_avx2(data, len);
+	}
+#endif
+	return utf8_validate_scalar(data, len);
+}
+
+size_t utf8_sanitize(char *data, const size_t len){
+	assert(data != NULL);
+	if(utf8_validate(data, len) == 1){
+		return 0;
+	}
+	unsigned char	*p	= (unsigned char*)data;
+	size_t			k	= 0, nb = 0, size;
+	while(k < len){
+		if((size = utf8_char_size(p + k, len - k)) == 0){
+			p[k++] = UTF8_REPLACEMENT;
+			nb++;
+			continue;
+		}
+		k += size;
+	}
+	return nb;
+}
+
+const char* utf8_implementation(void){
+	return (utf8_has_avx2() == 1) ? "avx2" : "scalar";
+}
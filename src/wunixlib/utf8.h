@@ -0,0 +1,68 @@
+// -----------------------------------------------------------------------------
+/**
+ * \file	utf8.h
+ * \author	Constantin MASSON
+ * \date	July 9, 2016
+ *
+ * \brief	UTF-8 validation (Vectorized) and sanitization
+ * \note	C Library for the Unix Programming Project
+ *
+ * Valid UTF-8 is checked as RFC 3629: no overlong form, no surrogate,
+ * nothing above U+10FFFF, no truncated sequence.
+ * With AVX2, 32 bytes are checked at once: each byte is checked with the
+ * 3 previous ones using lookup tables (Keiser and Lemire algorithm).
+ * Other processors use the scalar version.
+ */
+// -----------------------------------------------------------------------------
+
+#ifndef WUNIXLIB_UTF8_H
+#define WUNIXLIB_UTF8_H
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <assert.h>
+
+#define UTF8_REPLACEMENT '?' //Replace invalid bytes (Same size, done in place)
+
+
+// -----------------------------------------------------------------------------
+// Functions prototypes
+// -----------------------------------------------------------------------------
+
+/**
+ * \brief			Check whether the data is valid UTF-8.
+ * \warning			Assert error thrown if null parameter.
+ *
+ * \param data		Data to check
+ * \param len		Size of data
+ * \return			1 if valid, otherwise, 0
+ */
+int utf8_validate(const char *data, const size_t len);
+
+/**
+ * \brief			Same as utf8_validate, one char after the other.
+ * \details			Used by processors without vector instructions.
+ */
+int utf8_validate_scalar(const char *data, const size_t len);
+
+/**
+ * \brief			Replace each byte which is not part of a valid UTF-8 char.
+ * \details			Valid data (The usual case) is only checked.
+ * \warning			Assert error thrown if null parameter.
+ *
+ * \param data		Data to sanitize (Altered)
+ * \param len		Size of data
+ * \return			Number of bytes replaced by UTF8_REPLACEMENT
+ */
+size_t utf8_sanitize(char *data, const size_t len);
+
+/**
+ * \brief			Name of the instructions used by utf8_validate.
+ *
+ * \return			"avx2" or "scalar"
+ */
+const char* utf8_implementation(void);
+
+#endif
+
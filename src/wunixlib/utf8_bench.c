@@ -0,0 +1,66 @@
+// -----------------------------------------------------------------------------
+/**
+ * \file	utf8_bench.c
+ * \author	Constantin MASSON
+ * \date	July 9, 2016
+ *
+ * \brief	Benchmark of utf8_validate against the scalar version (make bench CF_FLAGS=-O2)
+ * \note	C Library for the Unix Programming Project
+ */
+// -----------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "utf8.h"
+
+#define BENCH_BYTES (64 * 1024 * 1024) //Checked by each run
+
+
+typedef int(*validate_fct)(const char *data, const size_t len);
+
+static double now(void){
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+static void bench(const char *name, validate_fct validate, const char *text, const size_t len){
+	long	k, rounds = BENCH_BYTES / len, nb_valid = 0;
+	double	start = now();
+	for(k=0; k<rounds; k++){
+		nb_valid += validate(text, len);
+	}
+	double elapsed = now() - start;
+	fprintf(stdout, "\t%-8s %7.1f ns/message %8.2f GB/s (%ld / %ld valid)\n", name,
+			elapsed * 1e9 / rounds, (double)len * rounds / elapsed / 1e9, nb_valid, rounds);
+}
+
+//Fill text with the given chars (Until len)
+static void fill(char *text, const size_t len, const char *chars){
+	size_t k, size = strlen(chars);
+	for(k=0; k+size <= len; k+=size){
+		memcpy(text + k, chars, size);
+	}
+	memset(text + k, 'a', len - k);
+}
+
+int main(int argc, char **argv){
+	static char	text[4096];
+	size_t		sizes[3] = {32, 500, 4096};
+	const char	*kinds[2][2] = {{"ascii", "Hello world! "}, {"mixed", "h\xc3\xa9llo \xe2\x82\xac \xf0\x9f\x98\x80 "}};
+	int			k, i;
+
+	fprintf(stdout, "utf8_validate uses %s\n", utf8_implementation());
+	for(i=0; i<2; i++){
+		for(k=0; k<3; k++){
+			fill(text, sizes[k], kinds[i][1]);
+			fprintf(stdout, "%s message of %zu bytes:\n", kinds[i][0], sizes[k]);
+			bench("scalar", utf8_validate_scalar, text, sizes[k]);
+			bench("validate", utf8_validate, text, sizes[k]);
+		}
+	}
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,124 @@
+// -----------------------------------------------------------------------------
+/**
+ * \file	workpool.c
+ * \author	Constantin MASSON
+ * \date	July 6, 2016
+ *
+ * \brief	Pool of worker threads (Jobs queue)
+ * \note	C Library for the Unix Programming Project
+ */
+// -----------------------------------------------------------------------------
+
+#include "workpool.h"
+
+
+// -----------------------------------------------------------------------------
+// Static functions
+// -----------------------------------------------------------------------------
+
+//Worker loop: wait for a job, run it
+static void *work_pool_worker(void *args){
+	WorkPool *pool = (WorkPool*)args;
+	while(1){
+		pthread_mutex_lock(&(pool->mutex));
+		while(pool->first == NULL && pool->stopping == 0){
+			pthread_cond_wait(&(pool->cond), &(pool->mutex));
+		}
+		if(pool->first == NULL){
+			pool->nb_workers--; //Stopped
+			pthread_cond_broadcast(&(pool->idle));
+			pthread_mutex_unlock(&(pool->mutex));
+			return NULL;
+		}
+		WorkJob *job	= pool->first;
+		pool->first		= job->next;
+		if(pool->first == NULL){
+			pool->last = NULL;
+		}
+		pthread_mutex_unlock(&(pool->mutex));
+		job->fct(job->arg);
+		free(job);
+		pthread_mutex_lock(&(pool->mutex));
+		if(--pool->nb_pending == 0){
+			pthread_cond_broadcast(&(pool->idle));
+		}
+		pthread_mutex_unlock(&(pool->mutex));
+	}
+	return NULL;
+}
+
+
+// -----------------------------------------------------------------------------
+// Functions
+// -----------------------------------------------------------------------------
+
+int work_pool_init(WorkPool *pool, size_t nb_workers){
+	assert(pool != NULL);
+	size_t k;
+	pthread_t thread_id;
+	pthread_mutex_init(&(pool->mutex), NULL);
+	pthread_cond_init(&(pool->cond), NULL);
+	pthread_cond_init(&(pool->idle), NULL);
+	pool->first			= NULL;
+	pool->last			= NULL;
+	pool->nb_workers	= 0;
+	pool->nb_pending	= 0;
+	pool->stopping		= 0;
+	for(k=0; k<nb_workers; k++){
+		if(pthread_create(&thread_id, NULL, work_pool_worker, (void*)pool) != 0){
+			break;
+		}
+		pthread_detach(thread_id);
+		pool->nb_workers++;
+	}
+	return (pool->nb_workers == 0) ? -1 : (int)pool->nb_workers;
+}
+
+int work_pool_push(WorkPool *pool, workfct fct, void *arg){
+	assert(pool != NULL);
+	assert(fct != NULL);
+	WorkJob *job = (WorkJob*)malloc(sizeof(WorkJob));
+	if(job == NULL){
+		return -1;
+	}
+	job->fct	= fct;
+	job->arg	= arg;
+	job->next	= NULL;
+	pthread_mutex_lock(&(pool->mutex));
+	if(pool->stopping == 1){
+		pthread_mutex_unlock(&(pool->mutex));
+		free(job);
+		return -1;
+	}
+	if(pool->last == NULL){
+		pool->first = job;
+	}
+	else{
+		pool->last->next = job;
+	}
+	pool->last = job;
+	pool->nb_pending++;
+	pthread_cond_signal(&(pool->cond));
+	pthread_mutex_unlock(&(pool->mutex));
+	return 1;
+}
+
+void work_pool_wait(WorkPool *pool){
+	assert(pool != NULL);
+	pthread_mutex_lock(&(pool->mutex));
+	while(pool->nb_pending > 0){
+		pthread_cond_wait(&(pool->idle), &(pool->mutex));
+	}
+	pthread_mutex_unlock(&(pool->mutex));
+}
+
+void work_pool_stop(WorkPool *pool){
+	assert(pool != NULL);
+	pthread_mutex_lock(&(pool->mutex));
+	pool->stopping = 1;
+	pthread_cond_broadcast(&(pool->cond));
+	while(pool->nb_workers > 0){
+		pthread_cond_wait(&(pool->idle), &(pool->mutex));
+	}
+	pthread_mutex_unlock(&(pool->mutex));
+}
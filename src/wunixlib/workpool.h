@@ -0,0 +1,98 @@
+// -----------------------------------------------------------------------------
+/**
+ * \file	workpool.h
+ * \author	Constantin MASSON
+ * \date	July 6, 2016
+ *
+ * \brief	Pool of worker threads (Jobs queue)
+ * \note	C Library for the Unix Programming Project
+ *
+ * Jobs are run in push order by the first free worker.
+ * Queue is protected by its own mutex: pool can be used from any thread.
+ */
+// -----------------------------------------------------------------------------
+
+#ifndef WUNIXLIB_WORKPOOL_H
+#define WUNIXLIB_WORKPOOL_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <pthread.h>
+
+
+// -----------------------------------------------------------------------------
+// Structures / Data
+// -----------------------------------------------------------------------------
+
+/** \brief Function run by a worker (Job argument given). */
+typedef void(*workfct)(void *arg);
+
+/** \brief One job in the queue. */
+typedef struct _work_job{
+	workfct				fct;
+	void				*arg;
+	struct _work_job	*next;
+} WorkJob;
+
+/** \brief Define a pool (Must be initialized with init function). */
+typedef struct _work_pool{
+	pthread_mutex_t	mutex;
+	pthread_cond_t	cond; //Signaled when a job is pushed
+	pthread_cond_t	idle; //Signaled when last job is done
+	WorkJob			*first;
+	WorkJob			*last;
+	size_t			nb_workers;
+	size_t			nb_pending; //Jobs queued or running
+	int				stopping; //1 once stopped: workers quit when queue is empty
+} WorkPool;
+
+
+// -----------------------------------------------------------------------------
+// Functions prototypes
+// -----------------------------------------------------------------------------
+
+/**
+ * \brief			Initialize the pool and start its workers.
+ * \details			Workers are detached and run until the pool is stopped.
+ * \warning			If pool is NULL, assert error thrown.
+ *
+ * \param pool		Pool to initialize
+ * \param nb_workers	Number of worker threads
+ * \return			Number of started workers (-1 if none)
+ */
+int work_pool_init(WorkPool *pool, size_t nb_workers);
+
+/**
+ * \brief			Add a job in the queue.
+ * \warning			If pool or fct is NULL, assert error thrown.
+ *
+ * \param pool		Pool where to run the job
+ * \param fct		Function to run
+ * \param arg		Argument given to the function
+ * \return			1 if pushed, otherwise, return -1 (malloc or pool stopped)
+ */
+int work_pool_push(WorkPool *pool, workfct fct, void *arg);
+
+/**
+ * \brief			Wait until all jobs pushed are done.
+ * \warning			If pool is NULL, assert error thrown.
+ *
+ * \param pool		Pool to wait for
+ */
+void work_pool_wait(WorkPool *pool);
+
+/**
+ * \brief			Run the jobs queued then stop the workers (Wait for them).
+ * \details			Jobs pushed after are refused (See work_pool_push).
+ * \warning			If pool is NULL, assert error thrown.
+ *
+ * \param pool		Pool to stop
+ */
+void work_pool_stop(WorkPool *pool);
+
+
+#endif
+
+
+
@@ -0,0 +1,213 @@
+// -----------------------------------------------------------------------------
+/**
+ * \file	zblock.c
+ * \author	Constantin MASSON
+ * \date	July 12, 2016
+ *
+ * \brief	Compressed blocks on a stream (Deflate with preset dictionary)
+ * \note	C Library for the Unix Programming Project
+ */
+// -----------------------------------------------------------------------------
+
+#include "zblock.h"
+
+#define ZBLOCK_WINDOW_BITS -15 //Raw deflate (No zlib header, dictionary is known by both sides)
+#define ZBLOCK_MEM_LEVEL 8
+#define ZBLOCK_LEVEL 6
+#define ZBLOCK_POOL_SIZE 8 //Compressors kept for reuse (Others are freed after use)
+
+//Compressors not in use (About 256KB each: shared by all threads)
+static pthread_mutex_t	zblock_pool_mutex = PTHREAD_MUTEX_INITIALIZER;
+static z_stream			*zblock_pool[ZBLOCK_POOL_SIZE];
+static size_t			zblock_pool_nb = 0;
+
+
+// -----------------------------------------------------------------------------
+// Static functions
+// -----------------------------------------------------------------------------
+
+//Take a compressor from the pool (Created if none left)
+static z_stream* zblock_stream_take(void){
+	z_stream *stream = NULL;
+	pthread_mutex_lock(&zblock_pool_mutex);
+	if(zblock_pool_nb > 0){
+		stream = zblock_pool[--zblock_pool_nb];
+	}
+	pthread_mutex_unlock(&zblock_pool_mutex);
+	if(stream != NULL){
+		return stream;
+	}
+	stream = (z_stream*)calloc(1, sizeof(z_stream));
+	if(stream == NULL){
+		return NULL;
+	}
+	if(deflateInit2(stream, ZBLOCK_LEVEL, Z_DEFLATED, ZBLOCK_WINDOW_BITS, ZBLOCK_MEM_LEVEL, Z_DEFAULT_STRATEGY) != Z_OK){
+		free(stream);
+		return NULL;
+	}
+	return stream;
+}
+
+//Give back a compressor (Freed if pool is full)
+static void zblock_stream_give(z_stream *stream){
+	if(stream == NULL){
+		return;
+	}
+	pthread_mutex_lock(&zblock_pool_mutex);
+	if(zblock_pool_nb < ZBLOCK_POOL_SIZE){
+		zblock_pool[zblock_pool_nb++] = stream;
+		pthread_mutex_unlock(&zblock_pool_mutex);
+		return;
+	}
+	pthread_mutex_unlock(&zblock_pool_mutex);
+	deflateEnd(stream);
+	free(stream);
+}
+
+static void zblock_set_header(char *block, const size_t size, const int kind){
+	block[0] = (char)((size >> 16) & 0xFF);
+	block[1] = (char)((size >> 8) & 0xFF);
+	block[2] = (char)(size & 0xFF);
+	block[3] = (char)kind;
+}
+
+//Compress one block content, return its size, 0 if not smaller than raw
+static size_t zblock_deflate(z_stream *stream, const char *data, const size_t len, char *out,
+							const char *dict, const size_t dict_len){
+	if(stream == NULL || len < ZBLOCK_MIN_DEFLATE || deflateReset(stream) != Z_OK){
+		return 0;
+	}
+	if(dict != NULL && deflateSetDictionary(stream, (const Bytef*)dict, dict_len) != Z_OK){
+		return 0;
+	}
+	stream->next_in		= (Bytef*)data;
+	stream->avail_in	= len;
+	stream->next_out	= (Bytef*)out;
+	stream->avail_out	= len - 1;
+	if(deflate(stream, Z_FINISH) != Z_STREAM_END){
+		return 0; //Doesn't fit in less than raw
+	}
+	return stream->total_out;
+}
+
+
+// -----------------------------------------------------------------------------
+// Encode
+// -----------------------------------------------------------------------------
+
+size_t zblock_bound(const size_t len){
+	size_t nb = (len + ZBLOCK_MAX_SIZE - 1) / ZBLOCK_MAX_SIZE;
+	return len + ((nb == 0) ? 1 : nb) * ZBLOCK_HEADER_SIZE;
+}
+
+int64_t zblock_encode(const char *data, const size_t len, char *blocks, const char *dict, const size_t dict_len){
+	assert(data != NULL && blocks != NULL);
+	z_stream	*stream	= zblock_stream_take();
+	size_t		done	= 0, size, chunk;
+	int64_t		total	= 0;
+	do{
+		chunk	= (len - done > ZBLOCK_MAX_SIZE) ? ZBLOCK_MAX_SIZE : len - done;
+		size	= zblock_deflate(stream, data + done, chunk, blocks + total + ZBLOCK_HEADER_SIZE, dict, dict_len);
+		if(size > 0){
+			zblock_set_header(blocks + total, size, ZBLOCK_DEFLATE);
+		}
+		else{
+			size = chunk;
+			memcpy(blocks + total + ZBLOCK_HEADER_SIZE, data + done, chunk);
+			zblock_set_header(blocks + total, size, ZBLOCK_RAW);
+		}
+		total	+= ZBLOCK_HEADER_SIZE + size;
+		done	+= chunk;
+	} while(done < len);
+	zblock_stream_give(stream);
+	return total;
+}
+
+
+// -----------------------------------------------------------------------------
+// Decode
+// -----------------------------------------------------------------------------
+
+int zblock_reader_init(ZBlockReader *reader, int fd, const char *dict, const size_t dict_len){
+	assert(reader != NULL);
+	memset(&(reader->stream), 0x00, sizeof(z_stream));
+	if(inflateInit2(&(reader->stream), ZBLOCK_WINDOW_BITS) != Z_OK){
+		return -1;
+	}
+	reader->fd			= fd;
+	reader->dict		= dict;
+	reader->dict_len	= dict_len;
+	reader->start		= 0;
+	reader->end			= 0;
+	return 1;
+}
+
+int zblock_reader_push(ZBlockReader *reader, const char *data, const size_t len){
+	assert(reader != NULL && data != NULL);
+	if(reader->end + len > sizeof(reader->buffer)){
+		return -1;
+	}
+	memcpy(reader->buffer + reader->end, data, len);
+	reader->end += len;
+	return 1;
+}
+
+int64_t zblock_reader_fill(ZBlockReader *reader){
+	assert(reader != NULL);
+	if(reader->start > 0){
+		memmove(reader->buffer, reader->buffer + reader->start, reader->end - reader->start);
+		reader->end		-= reader->start;
+		reader->start	= 0;
+	}
+	int64_t nb = TEMP_FAILURE_RETRY(read(reader->fd, reader->buffer + reader->end, sizeof(reader->buffer) - reader->end));
+	if(nb > 0){
+		reader->end += nb;
+	}
+	return nb;
+}
+
+int zblock_reader_next(ZBlockReader *reader, char **data, size_t *len){
+	assert(reader != NULL && data != NULL && len != NULL);
+	if(reader->end - reader->start < ZBLOCK_HEADER_SIZE){
+		return 0;
+	}
+	unsigned char	*block	= (unsigned char*)reader->buffer + reader->start;
+	size_t			size	= ((size_t)block[0] << 16) | ((size_t)block[1] << 8) | block[2];
+	int				kind	= block[3];
+	if(size > ZBLOCK_MAX_SIZE || (kind != ZBLOCK_RAW && kind != ZBLOCK_DEFLATE)){
+		return -1;
+	}
+	if(reader->end - reader->start < ZBLOCK_HEADER_SIZE + size){
+		return 0;
+	}
+	reader->start += ZBLOCK_HEADER_SIZE + size;
+	if(kind == ZBLOCK_RAW){
+		*data	= (char*)block + ZBLOCK_HEADER_SIZE;
+		*len	= size;
+		return 1;
+	}
+	z_stream *stream = &(reader->stream);
+	if(inflateReset(stream) != Z_OK){
+		return -1;
+	}
+	if(reader->dict != NULL && inflateSetDictionary(stream, (const Bytef*)reader->dict, reader->dict_len) != Z_OK){
+		return -1;
+	}
+	stream->next_in		= block + ZBLOCK_HEADER_SIZE;
+	stream->avail_in	= size;
+	stream->next_out	= (Bytef*)reader->data;
+	stream->avail_out	= sizeof(reader->data);
+	if(inflate(stream, Z_FINISH) != Z_STREAM_END){
+		return -1;
+	}
+	*data	= reader->data;
+	*len	= stream->total_out;
+	return 1;
+}
+
+void zblock_reader_destroy(ZBlockReader *reader){
+	if(reader == NULL){
+		return;
+	}
+	inflateEnd(&(reader->stream));
+}
@@ -0,0 +1,131 @@
+// -----------------------------------------------------------------------------
+/**
+ * \file	zblock.h
+ * \author	Constantin MASSON
+ * \date	July 12, 2016
+ *
+ * \brief	Compressed blocks on a stream (Deflate with preset dictionary)
+ * \note	C Library for the Unix Programming Project
+ *
+ * Data is sent in blocks: 3 bytes size (Big endian), 1 byte kind, content.
+ * Each block is compressed alone (Raw deflate, preset dictionary): the same
+ * block can be sent on several streams (Encoded once for all receivers).
+ * Block is sent raw if compression doesn't make it smaller.
+ * Data is at most ZBLOCK_MAX_SIZE bytes per block (Bigger data uses several).
+ */
+// -----------------------------------------------------------------------------
+
+#ifndef WUNIXLIB_ZBLOCK_H
+#define WUNIXLIB_ZBLOCK_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <assert.h>
+#include <errno.h>
+#include <zlib.h>
+
+#include "assets.h"
+
+#define ZBLOCK_HEADER_SIZE 4
+#define ZBLOCK_MAX_SIZE 16384 //Max data in one block
+#define ZBLOCK_MIN_DEFLATE 48 //Smaller data is not compressed
+#define ZBLOCK_RAW 0 //Kind of block: content is the data
+#define ZBLOCK_DEFLATE 1 //Kind of block: content is the data compressed
+
+
+// -----------------------------------------------------------------------------
+// Structures / Data
+// -----------------------------------------------------------------------------
+
+/** \brief Read blocks from a stream (Must be initialized with init function). */
+typedef struct _zblock_reader{
+	int			fd;
+	const char	*dict; //Preset dictionary (Same as encoder)
+	size_t		dict_len;
+	z_stream	stream;
+	size_t		start; //Beginning of next block in buffer
+	size_t		end; //End of data in buffer
+	char		buffer[ZBLOCK_HEADER_SIZE + ZBLOCK_MAX_SIZE]; //Received blocks
+	char		data[ZBLOCK_MAX_SIZE]; //Data of the last block
+} ZBlockReader;
+
+
+// -----------------------------------------------------------------------------
+// Functions prototypes
+// -----------------------------------------------------------------------------
+
+/**
+ * \brief			Max size of the blocks of len bytes of data.
+ *
+ * \param len		Size of data
+ * \return			Size to allocate for zblock_encode
+ */
+size_t zblock_bound(const size_t len);
+
+/**
+ * \brief			Encode data in blocks.
+ * \details			Can be called from any thread (Compressors are shared in a small pool).
+ *
+ * \param data		Data to encode
+ * \param len		Size of data
+ * \param blocks	Where to place the blocks (See zblock_bound)
+ * \param dict		Preset dictionary
+ * \param dict_len	Size of dictionary
+ * \return			Size of blocks or -1 if error
+ */
+int64_t zblock_encode(const char *data, const size_t len, char *blocks, const char *dict, const size_t dict_len);
+
+/**
+ * \brief			Initialize a reader for the given stream.
+ *
+ * \param reader	Reader to initialize
+ * \param fd		File descriptor to read from
+ * \param dict		Preset dictionary (Must stay valid)
+ * \param dict_len	Size of dictionary
+ * \return			1 if success, otherwise, -1
+ */
+int zblock_reader_init(ZBlockReader *reader, int fd, const char *dict, const size_t dict_len);
+
+/**
+ * \brief			Add data already read from the stream (Before first fill).
+ *
+ * \param reader	Reader where to add
+ * \param data		Data received
+ * \param len		Size of data (Must fit the buffer)
+ * \return			1 if added, otherwise, -1 (Too big)
+ */
+int zblock_reader_push(ZBlockReader *reader, const char *data, const size_t len);
+
+/**
+ * \brief			Read available data from the stream (One read call).
+ * \details			Block if no data available.
+ *
+ * \param reader	Reader to fill
+ * \return			Number of bytes read, 0 if EOF, negative if error
+ */
+int64_t zblock_reader_fill(ZBlockReader *reader);
+
+/**
+ * \brief			Get the data of the next complete block.
+ * \details			Data stays valid until the next call.
+ *
+ * \param reader	Reader where to look for
+ * \param data		Set to the data of the block
+ * \param len		Set to the size of data
+ * \return			1 if a block was decoded, 0 if no complete block, -1 if invalid block
+ */
+int zblock_reader_next(ZBlockReader *reader, char **data, size_t *len);
+
+/**
+ * \brief			Free the reader resources.
+ *
+ * \param reader	Reader to destroy
+ */
+void zblock_reader_destroy(ZBlockReader *reader);
+
+#endif
+
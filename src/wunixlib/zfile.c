@@ -0,0 +1,180 @@
+// -----------------------------------------------------------------------------
+/**
+ * \file	zfile.c
+ * \author	Constantin MASSON
+ * \date	July 15, 2016
+ *
+ * \brief	Compressed file with random access (Blocks and block index)
+ * \note	C Library for the Unix Programming Project
+ */
+// -----------------------------------------------------------------------------
+
+#include "zfile.h"
+
+
+// -----------------------------------------------------------------------------
+// Static functions
+// -----------------------------------------------------------------------------
+
+//Block holding the offset (Binary search, last block starting before)
+static size_t zfile_find_block(const ZFile *file, const uint64_t offset){
+	size_t low = 0, high = file->nb_blocks, mid;
+	while(low < high){
+		mid = (low + high) / 2;
+		if(file->entries[mid].raw_offset <= offset){
+			low = mid + 1;
+		}
+		else{
+			high = mid;
+		}
+	}
+	return (low == 0) ? 0 : low - 1;
+}
+
+//Decode the block in data (Kept if already there)
+static int zfile_decode(ZFile *file, const size_t block){
+	if(file->block == (int64_t)block){
+		return 1;
+	}
+	uint64_t	start	= file->entries[block].file_offset;
+	uint64_t	end		= (block + 1 < file->nb_blocks) ? file->entries[block+1].file_offset : file->index_offset;
+	size_t		size	= end - start;
+	ZBlockReader *reader = &(file->reader);
+	if(end < start || size > sizeof(reader->buffer)){
+		return -1;
+	}
+	file->block		= -1;
+	reader->start	= 0;
+	reader->end		= 0;
+	if(TEMP_FAILURE_RETRY(pread(file->fd, reader->buffer, size, start)) != (ssize_t)size){
+		return -1;
+	}
+	reader->end = size;
+	if(zblock_reader_next(reader, &(file->data), &(file->data_len)) != 1){
+		return -1;
+	}
+	file->block = block;
+	return 1;
+}
+
+
+// -----------------------------------------------------------------------------
+// Functions
+// -----------------------------------------------------------------------------
+
+int64_t zfile_compress(int in, int out, const char *dict, const size_t dict_len){
+	char		*data	= (char*)malloc(ZBLOCK_MAX_SIZE);
+	char		*blocks	= (char*)malloc(zblock_bound(ZBLOCK_MAX_SIZE));
+	ZFileEntry	*entries = NULL, *tmp;
+	ZFileFooter	footer;
+	size_t		nb = 0, capacity = 0;
+	int64_t		len, size;
+	uint64_t	raw_offset = 0, file_offset = 0;
+	if(data == NULL || blocks == NULL){
+		free(data);
+		free(blocks);
+		return -1;
+	}
+	while((len = TEMP_FAILURE_RETRY(pread(in, data, ZBLOCK_MAX_SIZE, raw_offset))) > 0){
+		if(nb == capacity){
+			capacity	= (capacity == 0) ? 64 : capacity * 2;
+			tmp			= (ZFileEntry*)realloc(entries, capacity * sizeof(ZFileEntry));
+			if(tmp == NULL){
+				break;
+			}
+			entries = tmp;
+		}
+		size = zblock_encode(data, len, blocks, dict, dict_len);
+		if(size < 0 || bulk_write(out, blocks, size) != size){
+			break;
+		}
+		entries[nb].raw_offset	= raw_offset;
+		entries[nb].file_offset	= file_offset;
+		nb++;
+		raw_offset	+= len;
+		file_offset	+= size;
+	}
+	free(data);
+	free(blocks);
+	if(len != 0){
+		free(entries);
+		return -1;
+	}
+	memset(&footer, 0x00, sizeof(ZFileFooter));
+	strcpy(footer.magic, ZFILE_MAGIC);
+	footer.raw_size		= raw_offset;
+	footer.index_offset	= file_offset;
+	footer.nb_blocks	= nb;
+	size = nb * sizeof(ZFileEntry);
+	if((nb > 0 && bulk_write(out, (char*)entries, size) != size)
+			|| bulk_write(out, (char*)&footer, sizeof(ZFileFooter)) != sizeof(ZFileFooter)){
+		free(entries);
+		return -1;
+	}
+	free(entries);
+	return file_offset + size + sizeof(ZFileFooter);
+}
+
+int zfile_open(ZFile *file, int fd, const char *dict, const size_t dict_len){
+	assert(file != NULL);
+	struct stat	st;
+	ZFileFooter	footer;
+	memset(file, 0x00, sizeof(ZFile));
+	file->fd	= -1;
+	file->block	= -1;
+	if(fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(ZFileFooter)
+			|| TEMP_FAILURE_RETRY(pread(fd, &footer, sizeof(footer), st.st_size - sizeof(footer))) != sizeof(footer)
+			|| strncmp(footer.magic, ZFILE_MAGIC, ZFILE_MAGIC_SIZE) != 0
+			|| footer.index_offset + footer.nb_blocks * sizeof(ZFileEntry) + sizeof(footer) != (uint64_t)st.st_size){
+		return -1;
+	}
+	size_t size		= footer.nb_blocks * sizeof(ZFileEntry);
+	file->entries	= (ZFileEntry*)malloc(size + 1);
+	if(file->entries == NULL || TEMP_FAILURE_RETRY(pread(fd, file->entries, size, footer.index_offset)) != (ssize_t)size){
+		free(file->entries);
+		file->entries = NULL;
+		return -1;
+	}
+	if(zblock_reader_init(&(file->reader), -1, dict, dict_len) != 1){
+		free(file->entries);
+		file->entries = NULL;
+		return -1;
+	}
+	file->fd			= fd;
+	file->raw_size		= footer.raw_size;
+	file->index_offset	= footer.index_offset;
+	file->nb_blocks		= footer.nb_blocks;
+	return 1;
+}
+
+int64_t zfile_read(ZFile *file, char *buf, const size_t len, const uint64_t offset){
+	assert(file != NULL && buf != NULL);
+	size_t done = 0, block, start, nb;
+	if(offset >= file->raw_size || file->nb_blocks == 0){
+		return 0;
+	}
+	block = zfile_find_block(file, offset);
+	while(done < len && block < file->nb_blocks && offset + done < file->raw_size){
+		if(zfile_decode(file, block) != 1){
+			return -1;
+		}
+		start	= offset + done - file->entries[block].raw_offset;
+		nb		= (file->data_len > start) ? file->data_len - start : 0;
+		nb		= (nb > len - done) ? len - done : nb;
+		memcpy(buf + done, file->data + start, nb);
+		done	+= nb;
+		block++;
+	}
+	return done;
+}
+
+void zfile_close(ZFile *file){
+	if(file == NULL || file->fd < 0){
+		return;
+	}
+	TEMP_FAILURE_RETRY(close(file->fd));
+	zblock_reader_destroy(&(file->reader));
+	free(file->entries);
+	file->entries	= NULL;
+	file->fd		= -1;
+}
@@ -0,0 +1,115 @@
+// -----------------------------------------------------------------------------
+/**
+ * \file	zfile.h
+ * \author	Constantin MASSON
+ * \date	July 15, 2016
+ *
+ * \brief	Compressed file with random access (Blocks and block index)
+ * \note	C Library for the Unix Programming Project
+ *
+ * Data is compressed in blocks of ZBLOCK_MAX_SIZE bytes (See zblock.h), then
+ * comes the index (One ZFileEntry per block) and the ZFileFooter.
+ * Reading at an offset decodes only the blocks holding the data (Found by
+ * binary search in the index). Last decoded block is kept for the next read.
+ * Numbers are in host byte order (File is read by the host which wrote it).
+ */
+// -----------------------------------------------------------------------------
+
+#ifndef WUNIXLIB_ZFILE_H
+#define WUNIXLIB_ZFILE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <assert.h>
+#include <sys/stat.h>
+
+#include "assets.h"
+#include "stream.h"
+#include "zblock.h"
+
+#define ZFILE_MAGIC "ZFILE01"
+#define ZFILE_MAGIC_SIZE 8
+
+
+// -----------------------------------------------------------------------------
+// Structures / Data
+// -----------------------------------------------------------------------------
+
+/** \brief Position of one block (Written as it is in the file). */
+typedef struct _zfile_entry{
+	uint64_t	raw_offset; //Position of the block data in the original file
+	uint64_t	file_offset; //Position of the block in the compressed file
+} ZFileEntry;
+
+/** \brief End of the compressed file. */
+typedef struct _zfile_footer{
+	char		magic[ZFILE_MAGIC_SIZE]; //ZFILE_MAGIC
+	uint64_t	raw_size; //Size of the original file
+	uint64_t	index_offset; //Position of the index
+	uint64_t	nb_blocks;
+} ZFileFooter;
+
+/** \brief Compressed file opened for reading (Must be opened with open function). */
+typedef struct _zfile{
+	int				fd;
+	uint64_t		raw_size;
+	uint64_t		index_offset;
+	size_t			nb_blocks;
+	ZFileEntry		*entries;
+	int64_t			block; //Block decoded in data (-1 if none)
+	char			*data;
+	size_t			data_len;
+	ZBlockReader	reader;
+} ZFile;
+
+
+// -----------------------------------------------------------------------------
+// Functions prototypes
+// -----------------------------------------------------------------------------
+
+/**
+ * \brief			Compress a whole file.
+ *
+ * \param in		File to compress (Read from its beginning)
+ * \param out		Where to write the compressed file
+ * \param dict		Preset dictionary (Same for reading)
+ * \param dict_len	Size of dictionary
+ * \return			Size of the compressed file, -1 if error
+ */
+int64_t zfile_compress(int in, int out, const char *dict, const size_t dict_len);
+
+/**
+ * \brief			Open a compressed file.
+ * \details			File descriptor is owned by the ZFile once opened.
+ *
+ * \param file		File to initialize
+ * \param fd		Compressed file
+ * \param dict		Preset dictionary (Must stay valid)
+ * \param dict_len	Size of dictionary
+ * \return			1 if opened, otherwise, -1 (Invalid file, fd not closed)
+ */
+int zfile_open(ZFile *file, int fd, const char *dict, const size_t dict_len);
+
+/**
+ * \brief			Read data of the original file.
+ *
+ * \param file		File where to read
+ * \param buf		Where to place the data
+ * \param len		Number of bytes to read
+ * \param offset	Position in the original file
+ * \return			Number of bytes read (Less at end of file), -1 if error
+ */
+int64_t zfile_read(ZFile *file, char *buf, const size_t len, const uint64_t offset);
+
+/**
+ * \brief			Close the file and free its resources.
+ *
+ * \param file		File to close
+ */
+void zfile_close(ZFile *file);
+
+#endif
+